@@ -0,0 +1,416 @@
+/*
+ * agg.c - MiniDB 分组聚合实现
+ * 每个线程处理一段连续的行，聚合到自己的表中（不需要加锁），
+ * 全部结束后把各表合并到第一张表，再取出非空分组排序输出
+ */
+
+#include "agg.h"
+#include "output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>  // sysconf
+
+#define AGG_HASH_INIT_CAP 1024
+#define AGG_SIGN_BIAS     0x80000000u  // 有符号分组键加上偏置后，无符号顺序与有符号顺序一致
+
+/*
+ * 聚合表
+ * direct 为 true 时 slots[key] 直接对应分组键；
+ * 否则为线性探测哈希表，count == 0 的槽位为空
+ */
+typedef struct AggTable {
+    AggGroup *slots;
+    size_t cap;             // 槽位数（哈希表为 2 的幂）
+    size_t size;            // 哈希表已用槽位数
+    bool direct;
+} AggTable;
+
+/* 线程任务：聚合 [begin, end) 行 */
+typedef struct AggTask {
+    const Database *db;
+    const AggOptions *opt;
+    int begin;
+    int end;
+    AggTable table;
+    bool ok;
+} AggTask;
+
+void agg_options_init(AggOptions *opt, GroupKey key) {
+    opt->key = key;
+    opt->bucket = 10;
+    opt->flags_set = 0;
+    opt->flags_clear = 0;
+    opt->threads = 0;
+}
+
+/* 分组键的取值个数；0 表示范围不固定，需要使用哈希表 */
+static size_t agg_domain(const AggOptions *opt) {
+    switch (opt->key) {
+        case GROUP_BY_AGE:          return 256;
+        case GROUP_BY_AGE_BUCKET:   return 256 / (size_t)opt->bucket + 1;
+        case GROUP_BY_FLAGS:        return 16;
+        case GROUP_BY_AGE_FLAGS:    return 256 * 16;
+        default:                    return 0;  // 姓名；成绩（导入的数据可能超出 0-100）
+    }
+}
+
+/* 计算一行的分组键 */
+static inline uint32_t agg_key(const Database *db, const AggOptions *opt, int row) {
+    const Record *r = &db->rows[row];
+    switch (opt->key) {
+        case GROUP_BY_AGE:          return r->age;
+        case GROUP_BY_AGE_BUCKET:   return (uint32_t)(r->age / opt->bucket);
+        case GROUP_BY_FLAGS:        return r->flags & 0x0F;
+        case GROUP_BY_AGE_FLAGS:    return ((uint32_t)r->age << 4) | (r->flags & 0x0F);
+        case GROUP_BY_NAME:         return db->names[row].off;  // 姓名已去重，偏移相同即姓名相同
+        case GROUP_BY_SCORE_BUCKET: {
+            /* 向下取整，负分也落在正确的段 */
+            int32_t q = (int32_t)(r->score / opt->bucket);
+            if ((double)q * opt->bucket > r->score) {
+                q--;
+            }
+            return (uint32_t)q + AGG_SIGN_BIAS;
+        }
+    }
+    return 0;
+}
+
+static bool agg_table_init(AggTable *table, size_t domain) {
+    table->direct = domain > 0;
+    table->cap = domain > 0 ? domain : AGG_HASH_INIT_CAP;
+    table->size = 0;
+    table->slots = calloc(table->cap, sizeof(AggGroup));
+    return table->slots != NULL;
+}
+
+static void agg_table_free(AggTable *table) {
+    free(table->slots);
+    table->slots = NULL;
+}
+
+static inline size_t agg_hash(uint32_t key, size_t mask) {
+    uint32_t h = key * 0x9E3779B1u;
+    h ^= h >> 16;
+    return (size_t)h & mask;
+}
+
+/* 哈希表中查找或新建分组，内存不足返回 NULL */
+static AggGroup *agg_table_slot(AggTable *table, uint32_t key);
+
+static bool agg_table_grow(AggTable *table) {
+    AggTable bigger;
+    bigger.direct = false;
+    bigger.cap = table->cap * 2;
+    bigger.size = 0;
+    bigger.slots = calloc(bigger.cap, sizeof(AggGroup));
+    if (bigger.slots == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < table->cap; i++) {
+        if (table->slots[i].count > 0) {
+            *agg_table_slot(&bigger, table->slots[i].key) = table->slots[i];
+        }
+    }
+    free(table->slots);
+    *table = bigger;
+    return true;
+}
+
+static AggGroup *agg_table_slot(AggTable *table, uint32_t key) {
+    if (table->direct) {
+        AggGroup *g = &table->slots[key];
+        g->key = key;
+        return g;
+    }
+    size_t mask = table->cap - 1;
+    size_t i = agg_hash(key, mask);
+    while (table->slots[i].count > 0) {
+        if (table->slots[i].key == key) {
+            return &table->slots[i];
+        }
+        i = (i + 1) & mask;
+    }
+    /* 新分组：装载因子超过 1/2 时先扩容再重新定位 */
+    if ((table->size + 1) * 2 > table->cap) {
+        if (!agg_table_grow(table)) {
+            return NULL;
+        }
+        return agg_table_slot(table, key);
+    }
+    table->size++;
+    table->slots[i].key = key;
+    return &table->slots[i];
+}
+
+/* 把一组部分聚合值并入 g */
+static inline void agg_combine(AggGroup *g, const AggGroup *part) {
+    if (g->count == 0) {
+        g->sum = part->sum;
+        g->min = part->min;
+        g->max = part->max;
+    } else {
+        g->sum += part->sum;
+        if (part->min < g->min) {
+            g->min = part->min;
+        }
+        if (part->max > g->max) {
+            g->max = part->max;
+        }
+    }
+    g->count += part->count;
+}
+
+/* 线程入口：聚合一段行 */
+static void *agg_worker(void *arg) {
+    AggTask *task = arg;
+    const Database *db = task->db;
+    const AggOptions *opt = task->opt;
+    uint8_t must = opt->flags_set;
+    uint8_t reject = opt->flags_clear | FLAG_DELETED;
+
+    for (int row = task->begin; row < task->end; row++) {
+        const Record *r = &db->rows[row];
+        if ((r->flags & must) != must || (r->flags & reject) != 0) {
+            continue;
+        }
+        AggGroup *g = agg_table_slot(&task->table, agg_key(db, opt, row));
+        if (g == NULL) {
+            task->ok = false;
+            return NULL;
+        }
+        if (g->count == 0) {
+            g->min = r->score;
+            g->max = r->score;
+            g->sum = 0.0;
+        } else {
+            if (r->score < g->min) {
+                g->min = r->score;
+            }
+            if (r->score > g->max) {
+                g->max = r->score;
+            }
+        }
+        g->sum += r->score;
+        g->count++;
+    }
+    return NULL;
+}
+
+/* 决定线程数：每个线程至少 AGG_MIN_ROWS_PER_THREAD 行 */
+static int agg_thread_count(const Database *db, const AggOptions *opt) {
+    int threads = opt->threads;
+    if (threads <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+#else
+        threads = 1;
+#endif
+    }
+    if (threads > AGG_MAX_THREADS) {
+        threads = AGG_MAX_THREADS;
+    }
+    int by_rows = db->count / AGG_MIN_ROWS_PER_THREAD;
+    if (threads > by_rows) {
+        threads = by_rows;
+    }
+    return threads < 1 ? 1 : threads;
+}
+
+static const Database *sort_agg_db = NULL;
+
+/* 排序：按分组键升序；姓名分组按姓名字典序 */
+static int compare_group_key(const void *a, const void *b) {
+    uint32_t ka = ((const AggGroup *)a)->key, kb = ((const AggGroup *)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+static int compare_group_name(const void *a, const void *b) {
+    NameRef ra = {((const AggGroup *)a)->key, 0};
+    NameRef rb = {((const AggGroup *)b)->key, 0};
+    return strcmp(strheap_str(&sort_agg_db->name_heap, ra), strheap_str(&sort_agg_db->name_heap, rb));
+}
+
+/*
+ * db_group_by - 分组聚合
+ * 返回值：false 表示参数无效或内存不足
+ */
+bool db_group_by(const Database *db, const AggOptions *opt, AggResult *out) {
+    out->groups = NULL;
+    out->n = 0;
+    out->threads = 0;
+    if ((opt->key == GROUP_BY_AGE_BUCKET || opt->key == GROUP_BY_SCORE_BUCKET) && opt->bucket < 1) {
+        printf("错误：分段宽度必须为正整数！\n");
+        return false;
+    }
+
+    int threads = agg_thread_count(db, opt);
+    size_t domain = agg_domain(opt);
+    AggTask tasks[AGG_MAX_THREADS];
+    pthread_t tids[AGG_MAX_THREADS];
+    bool started[AGG_MAX_THREADS];
+    bool ok = true;
+
+    /* 行区间均分给各线程 */
+    for (int t = 0; t < threads; t++) {
+        tasks[t].db = db;
+        tasks[t].opt = opt;
+        tasks[t].begin = (int)((long long)db->count * t / threads);
+        tasks[t].end = (int)((long long)db->count * (t + 1) / threads);
+        tasks[t].ok = agg_table_init(&tasks[t].table, domain);
+        started[t] = false;
+        ok = ok && tasks[t].ok;
+    }
+    if (ok) {
+        /* 第 0 段由当前线程处理，线程创建失败时也在当前线程补做 */
+        for (int t = 1; t < threads; t++) {
+            started[t] = pthread_create(&tids[t], NULL, agg_worker, &tasks[t]) == 0;
+        }
+        agg_worker(&tasks[0]);
+        for (int t = 1; t < threads; t++) {
+            if (started[t]) {
+                pthread_join(tids[t], NULL);
+            } else {
+                agg_worker(&tasks[t]);
+            }
+        }
+        for (int t = 0; t < threads; t++) {
+            ok = ok && tasks[t].ok;
+        }
+    }
+
+    /* 合并部分聚合值 */
+    AggTable *merged = &tasks[0].table;
+    for (int t = 1; t < threads && ok; t++) {
+        const AggTable *part = &tasks[t].table;
+        for (size_t i = 0; i < part->cap && ok; i++) {
+            if (part->slots[i].count == 0) {
+                continue;
+            }
+            AggGroup *g = agg_table_slot(merged, part->slots[i].key);
+            if (g == NULL) {
+                ok = false;
+            } else {
+                agg_combine(g, &part->slots[i]);
+            }
+        }
+    }
+
+    /* 取出非空分组，就地压缩到表的前部 */
+    if (ok) {
+        size_t n = 0;
+        for (size_t i = 0; i < merged->cap; i++) {
+            if (merged->slots[i].count > 0) {
+                merged->slots[n++] = merged->slots[i];
+            }
+        }
+        if (opt->key == GROUP_BY_NAME) {
+            sort_agg_db = db;
+            qsort(merged->slots, n, sizeof(AggGroup), compare_group_name);
+            sort_agg_db = NULL;
+        } else if (!merged->direct) {
+            qsort(merged->slots, n, sizeof(AggGroup), compare_group_key);
+        }
+        out->groups = merged->slots;
+        out->n = n;
+        out->threads = threads;
+        merged->slots = NULL;
+    } else {
+        printf("内存分配失败！\n");
+    }
+
+    for (int t = 0; t < threads; t++) {
+        agg_table_free(&tasks[t].table);
+    }
+    return ok;
+}
+
+void agg_result_free(AggResult *result) {
+    free(result->groups);
+    result->groups = NULL;
+    result->n = 0;
+}
+
+/* 输出分组键 */
+static void agg_out_key(OutBuf *ob, const Database *db, const AggOptions *opt, uint32_t key) {
+    switch (opt->key) {
+        case GROUP_BY_AGE:
+            out_int(ob, (int)key);
+            break;
+        case GROUP_BY_AGE_BUCKET:
+            out_int(ob, (int)key * opt->bucket);
+            out_char(ob, '-');
+            out_int(ob, (int)(key + 1) * opt->bucket - 1);
+            break;
+        case GROUP_BY_SCORE_BUCKET: {
+            /* 成绩段为左闭右开区间 [下限, 上限) */
+            int q = (int)(int32_t)(key - AGG_SIGN_BIAS);
+            out_char(ob, '[');
+            out_int(ob, q * opt->bucket);
+            out_puts(ob, ", ");
+            out_int(ob, (q + 1) * opt->bucket);
+            out_char(ob, ')');
+            break;
+        }
+        case GROUP_BY_FLAGS:
+            out_flag_names(ob, (uint8_t)key);
+            break;
+        case GROUP_BY_AGE_FLAGS:
+            out_int(ob, (int)(key >> 4));
+            out_char(ob, '/');
+            out_flag_names(ob, (uint8_t)(key & 0x0F));
+            break;
+        case GROUP_BY_NAME: {
+            NameRef ref = {key, 0};
+            out_puts(ob, strheap_str(&db->name_heap, ref));
+            break;
+        }
+    }
+}
+
+/*
+ * db_print_group_by - 执行分组聚合并输出
+ * 每组一行：分组、人数、平均分、最高分、最低分（制表符分隔）
+ */
+void db_print_group_by(const Database *db, const AggOptions *opt) {
+    if (db == NULL || db_live_count(db) == 0) {
+        printf("暂无学生记录。\n");
+        return;
+    }
+
+    AggResult result;
+    if (!db_group_by(db, opt, &result)) {
+        return;
+    }
+    if (result.n == 0) {
+        printf("没有满足条件的记录。\n");
+        agg_result_free(&result);
+        return;
+    }
+
+    OutBuf ob;
+    out_init(&ob, stdout);
+    if (out_get_mode() == OUTPUT_PRETTY) {
+        out_puts(&ob, "=== 分组统计 ===\n分组\t人数\t平均分\t最高分\t最低分\n");
+    }
+    for (size_t i = 0; i < result.n; i++) {
+        const AggGroup *g = &result.groups[i];
+        agg_out_key(&ob, db, opt, g->key);
+        out_char(&ob, '\t');
+        out_int(&ob, (int)g->count);
+        out_char(&ob, '\t');
+        out_fixed2(&ob, g->sum / g->count);
+        out_char(&ob, '\t');
+        out_fixed2(&ob, g->max);
+        out_char(&ob, '\t');
+        out_fixed2(&ob, g->min);
+        out_char(&ob, '\n');
+    }
+    out_flush(&ob);
+    if (out_get_mode() == OUTPUT_PRETTY) {
+        printf("共 %zu 组（%d 个线程）\n", result.n, result.threads);
+    }
+    agg_result_free(&result);
+}
@@ -0,0 +1,66 @@
+/*
+ * agg.h - MiniDB 分组聚合头文件
+ * GROUP BY 年龄、年龄段、状态组合、姓名或成绩段，
+ * 每组输出人数、平均分、最高分、最低分；
+ * 取值范围小的分组键直接用数组下标定位，其余用开放寻址哈希表；
+ * 记录较多时按行区间分给多个线程，各自聚合后再合并
+ */
+
+#ifndef AGG_H
+#define AGG_H
+
+#include "db.h"
+
+#define AGG_MAX_THREADS          8       // 最多使用的线程数
+#define AGG_MIN_ROWS_PER_THREAD  65536   // 每个线程至少分到的行数，太少时不值得开线程
+
+/*
+ * 分组键
+ */
+typedef enum GroupKey {
+    GROUP_BY_AGE = 1,       // 年龄
+    GROUP_BY_AGE_BUCKET,    // 年龄段（宽度为 bucket 岁）
+    GROUP_BY_FLAGS,         // 状态标志组合
+    GROUP_BY_AGE_FLAGS,     // 年龄 + 状态标志组合
+    GROUP_BY_NAME,          // 姓名
+    GROUP_BY_SCORE_BUCKET   // 成绩段（宽度为 bucket 分）
+} GroupKey;
+
+/*
+ * 分组聚合选项
+ */
+typedef struct AggOptions {
+    GroupKey key;           // 分组键
+    int bucket;             // 年龄段 / 成绩段的宽度
+    uint8_t flags_set;      // 必须全部开启的标志位，0 表示不过滤
+    uint8_t flags_clear;    // 必须全部关闭的标志位，0 表示不过滤
+    int threads;            // 线程数，0 表示按 CPU 核数自动选择
+} AggOptions;
+
+/*
+ * 一个分组的聚合值（32 字节，一个缓存行放两组）
+ * count == 0 表示空槽
+ */
+typedef struct AggGroup {
+    uint32_t key;           // 分组键的编码值
+    uint32_t count;         // 人数
+    double sum;             // 成绩之和
+    double min;             // 最低分
+    double max;             // 最高分
+} AggGroup;
+
+/*
+ * 聚合结果：按分组键排好序
+ */
+typedef struct AggResult {
+    AggGroup *groups;
+    size_t n;
+    int threads;            // 实际使用的线程数
+} AggResult;
+
+void agg_options_init(AggOptions *opt, GroupKey key);                          // 默认选项：无过滤、自动线程数
+bool db_group_by(const Database *db, const AggOptions *opt, AggResult *out);   // 执行分组聚合
+void agg_result_free(AggResult *result);                                       // 释放结果
+void db_print_group_by(const Database *db, const AggOptions *opt);             // 执行并输出分组结果
+
+#endif /* AGG_H */
@@ -0,0 +1,522 @@
+/*
+ * aio.c - MiniDB 异步文件 I/O 实现
+ * io_uring 后端：一个提交队列深度为 AIO_QUEUE_DEPTH 的环，每块一个槽，
+ *   第 b 块固定使用第 b % AIO_QUEUE_DEPTH 个槽，按块号顺序提交、按块号顺序等待完成；
+ *   不完整的读写（很少出现）用同步 pread / pwrite 补齐
+ * stdio 后端：只用一个槽，提交即同步 fwrite，取块即同步 fread
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE         // O_DIRECT
+#endif
+#define _FILE_OFFSET_BITS 64
+
+#include "aio.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define AIO_HAVE_URING 1
+#endif
+#endif
+
+#ifdef AIO_HAVE_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* 一个在途请求 */
+typedef struct AioSlot {
+    unsigned char *buf;     // 块缓冲区（aio_read_file 时为 NULL，直接读到目标内存）
+    uint64_t offset;        // 文件偏移
+    size_t len;             // 请求的字节数
+    size_t done;            // 完成的字节数
+    bool busy;              // 已提交、尚未完成
+#ifdef AIO_HAVE_URING
+    struct iovec iov;
+#endif
+} AioSlot;
+
+#ifdef AIO_HAVE_URING
+/* io_uring 的共享内存环 */
+typedef struct AioRing {
+    int fd;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len, sqes_len;
+} AioRing;
+#endif
+
+struct AioFile {
+    int flags;
+    bool failed;
+    FILE *fp;                       // stdio 后端；为 NULL 时使用 io_uring
+    uint64_t pos;                   // 写：已提交的字节数；读：下一个读请求的偏移
+    uint64_t size;                  // 读：文件大小
+    uint64_t block;                 // 写：当前块号；读：下一个交给调用者的块号
+    bool padded;                    // O_DIRECT 写：最后一块补齐过，关闭时截断
+    AioSlot slots[AIO_QUEUE_DEPTH];
+#ifdef AIO_HAVE_URING
+    int fd;
+    AioRing ring;
+#endif
+};
+
+/*
+ * ==================== io_uring ====================
+ */
+
+#ifdef AIO_HAVE_URING
+
+static bool ring_init(AioRing *r) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    r->fd = (int)syscall(__NR_io_uring_setup, AIO_QUEUE_DEPTH, &p);
+    if (r->fd < 0) {
+        return false;
+    }
+    r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->sq_len = r->cq_len = r->sq_len > r->cq_len ? r->sq_len : r->cq_len;
+    }
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    r->cq_ptr = (p.features & IORING_FEAT_SINGLE_MMAP) ? r->sq_ptr :
+                mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_CQ_RING);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (r->sq_ptr == MAP_FAILED || r->cq_ptr == MAP_FAILED || r->sqes == MAP_FAILED) {
+        if (r->sq_ptr != MAP_FAILED) {
+            munmap(r->sq_ptr, r->sq_len);
+        }
+        if (r->cq_ptr != MAP_FAILED && r->cq_ptr != r->sq_ptr) {
+            munmap(r->cq_ptr, r->cq_len);
+        }
+        if (r->sqes != MAP_FAILED) {
+            munmap(r->sqes, r->sqes_len);
+        }
+        close(r->fd);
+        return false;
+    }
+    char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return true;
+}
+
+static void ring_free(AioRing *r) {
+    munmap(r->sqes, r->sqes_len);
+    if (r->cq_ptr != r->sq_ptr) {
+        munmap(r->cq_ptr, r->cq_len);
+    }
+    munmap(r->sq_ptr, r->sq_len);
+    close(r->fd);
+}
+
+/* 提交第 k 个槽的读 / 写请求 */
+static bool ring_submit(AioFile *f, int k, unsigned char *buf, size_t len, uint64_t offset) {
+    AioRing *r = &f->ring;
+    AioSlot *s = &f->slots[k];
+    s->offset = offset;
+    s->len = len;
+    s->done = 0;
+    s->iov.iov_base = buf;
+    s->iov.iov_len = len;
+
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (f->flags & AIO_WRITE) ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = f->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&s->iov;
+    sqe->len = 1;
+    sqe->off = offset;
+    sqe->user_data = (uint64_t)k;
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    long ret;
+    do {
+        ret = syscall(__NR_io_uring_enter, r->fd, 1, 0, 0, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret != 1) {
+        return false;
+    }
+    s->busy = true;
+    return true;
+}
+
+/* 请求只完成了一部分时用同步 I/O 补齐 */
+static bool ring_complete_rest(AioFile *f, AioSlot *s) {
+    unsigned char *base = s->iov.iov_base;
+    while (s->done < s->len) {
+        ssize_t n = (f->flags & AIO_WRITE)
+            ? pwrite(f->fd, base + s->done, s->len - s->done, (off_t)(s->offset + s->done))
+            : pread(f->fd, base + s->done, s->len - s->done, (off_t)(s->offset + s->done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return n == 0 && !(f->flags & AIO_WRITE);  /* 读到文件末尾 */
+        }
+        s->done += (size_t)n;
+    }
+    return true;
+}
+
+/* 等待第 k 个槽的请求完成（期间收割到的其他槽的完成也一并记下） */
+static bool ring_wait(AioFile *f, int k) {
+    AioRing *r = &f->ring;
+    while (f->slots[k].busy) {
+        unsigned head = *r->cq_head;
+        if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+            long ret = syscall(__NR_io_uring_enter, r->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+            if (ret < 0 && errno != EINTR) {
+                return false;
+            }
+            continue;
+        }
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        AioSlot *s = &f->slots[cqe->user_data];
+        int res = cqe->res;
+        __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+        s->busy = false;
+        if (res < 0) {
+            f->failed = true;
+            continue;
+        }
+        s->done = (size_t)res;
+        /* 读请求在文件末尾本来就不满，只有文件中间的不完整读写需要补齐 */
+        bool at_end = !(f->flags & AIO_WRITE) && s->offset + s->done >= f->size;
+        if (s->done < s->len && !at_end && !ring_complete_rest(f, s)) {
+            f->failed = true;
+        }
+    }
+    return !f->failed;
+}
+
+/* 打开文件和环；O_DIRECT 不被文件系统支持时改用普通方式打开 */
+static bool ring_open(AioFile *f, const char *path) {
+    int mode = (f->flags & AIO_WRITE) ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+    f->fd = -1;
+    if (f->flags & AIO_DIRECT) {
+        f->fd = open(path, mode | O_DIRECT, 0644);
+        if (f->fd < 0 && errno != EINVAL) {
+            return false;
+        }
+    }
+    if (f->fd < 0) {
+        f->flags &= ~AIO_DIRECT;
+        f->fd = open(path, mode, 0644);
+        if (f->fd < 0) {
+            return false;
+        }
+    }
+    struct stat st;
+    if (fstat(f->fd, &st) != 0 || !ring_init(&f->ring)) {
+        close(f->fd);
+        return false;
+    }
+    f->size = (uint64_t)st.st_size;
+    return true;
+}
+
+#endif /* AIO_HAVE_URING */
+
+/*
+ * ==================== 读写接口 ====================
+ */
+
+/* 分配块缓冲区（O_DIRECT 需要对齐） */
+static unsigned char *aio_alloc(size_t size) {
+#ifdef AIO_HAVE_URING
+    void *p;
+    return posix_memalign(&p, AIO_ALIGN, size) == 0 ? p : NULL;
+#else
+    return malloc(size);
+#endif
+}
+
+static AioFile *aio_new(int flags) {
+    AioFile *f = calloc(1, sizeof(AioFile));
+    if (f != NULL) {
+        f->flags = flags;
+    }
+    return f;
+}
+
+static void aio_free(AioFile *f) {
+    for (int k = 0; k < AIO_QUEUE_DEPTH; k++) {
+        free(f->slots[k].buf);
+    }
+    free(f);
+}
+
+/*
+ * aio_open_backend - 打开文件：先试 io_uring，不可用时用 stdio
+ * 不分配块缓冲区（aio_read_file 直接读到目标内存）
+ */
+static AioFile *aio_open_backend(const char *path, int flags) {
+    AioFile *f = aio_new(flags);
+    if (f == NULL) {
+        return NULL;
+    }
+#ifdef AIO_HAVE_URING
+    if (ring_open(f, path)) {
+        return f;
+    }
+    if (errno == ENOENT || errno == EACCES) {
+        free(f);
+        return NULL;
+    }
+#endif
+    f->flags &= ~AIO_DIRECT;
+    f->fp = fopen(path, (flags & AIO_WRITE) ? "wb" : "rb");
+    if (f->fp == NULL) {
+        free(f);
+        return NULL;
+    }
+    if (!(flags & AIO_WRITE)) {
+        uint64_t end;
+        f->size = file_size(f->fp, &end) == 0 ? end : 0;  /* 64 位长度，超过 2 GB 的文件也正确 */
+        rewind(f->fp);
+    }
+    return f;
+}
+
+#ifdef AIO_HAVE_URING
+/* 读：为第 block 块提交读请求（超出文件末尾的块不提交） */
+static void aio_read_ahead(AioFile *f, uint64_t block) {
+    uint64_t offset = block * AIO_BLOCK_SIZE;
+    int k = (int)(block % AIO_QUEUE_DEPTH);
+    if (offset < f->size && !ring_submit(f, k, f->slots[k].buf, AIO_BLOCK_SIZE, offset)) {
+        f->failed = true;
+    }
+}
+#endif
+
+/*
+ * aio_open - 打开文件用于顺序读或写
+ * 读时立即为前 AIO_QUEUE_DEPTH 块提交读请求
+ */
+AioFile *aio_open(const char *path, int flags) {
+    AioFile *f = aio_open_backend(path, flags);
+    if (f == NULL) {
+        return NULL;
+    }
+    int nslots = f->fp != NULL ? 1 : AIO_QUEUE_DEPTH;
+    for (int k = 0; k < nslots; k++) {
+        f->slots[k].buf = aio_alloc(AIO_BLOCK_SIZE);
+        if (f->slots[k].buf == NULL) {
+            f->failed = true;
+            aio_close(f);
+            return NULL;
+        }
+    }
+#ifdef AIO_HAVE_URING
+    if (f->fp == NULL && !(flags & AIO_WRITE)) {
+        for (uint64_t b = 0; b < AIO_QUEUE_DEPTH; b++) {
+            aio_read_ahead(f, b);
+        }
+    }
+#endif
+    return f;
+}
+
+const char *aio_backend(const AioFile *f) {
+    return f->fp != NULL ? "stdio" : "io_uring";
+}
+
+/*
+ * aio_block - 写：返回当前块的缓冲区
+ * 该槽上一次的写请求尚未完成时先等待
+ */
+unsigned char *aio_block(AioFile *f) {
+    if (f->fp != NULL) {
+        return f->slots[0].buf;
+    }
+#ifdef AIO_HAVE_URING
+    int k = (int)(f->block % AIO_QUEUE_DEPTH);
+    if (!ring_wait(f, k)) {
+        f->failed = true;
+    }
+    return f->slots[k].buf;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * aio_submit - 写：提交当前块的前 len 字节，写在已提交内容之后
+ * O_DIRECT 时不满一个对齐单位的最后一块补零提交，关闭时再截断到实际长度
+ */
+bool aio_submit(AioFile *f, size_t len) {
+    if (f->failed || len > AIO_BLOCK_SIZE || f->padded) {
+        f->failed = true;
+        return false;
+    }
+    if (f->fp != NULL) {
+        if (fwrite(f->slots[0].buf, 1, len, f->fp) != len) {
+            f->failed = true;
+            return false;
+        }
+        f->pos += len;
+        return true;
+    }
+#ifdef AIO_HAVE_URING
+    int k = (int)(f->block % AIO_QUEUE_DEPTH);
+    size_t io_len = len;
+    if ((f->flags & AIO_DIRECT) && len % AIO_ALIGN != 0) {
+        io_len = (len + AIO_ALIGN - 1) / AIO_ALIGN * AIO_ALIGN;
+        memset(f->slots[k].buf + len, 0, io_len - len);
+        f->padded = true;
+    }
+    if (!ring_submit(f, k, f->slots[k].buf, io_len, f->pos)) {
+        f->failed = true;
+        return false;
+    }
+    f->pos += len;
+    f->block++;
+#endif
+    return true;
+}
+
+/*
+ * aio_next - 读：返回下一块及其长度
+ * 返回的缓冲区在下一次调用 aio_next 前有效；取下一块前先为上一块的槽补提交读请求
+ */
+const unsigned char *aio_next(AioFile *f, size_t *len) {
+    *len = 0;
+    if (f->failed) {
+        return NULL;
+    }
+    if (f->fp != NULL) {
+        size_t n = fread(f->slots[0].buf, 1, AIO_BLOCK_SIZE, f->fp);
+        if (ferror(f->fp)) {
+            f->failed = true;
+        }
+        *len = n;
+        return n > 0 ? f->slots[0].buf : NULL;
+    }
+#ifdef AIO_HAVE_URING
+    if (f->block > 0) {
+        aio_read_ahead(f, f->block - 1 + AIO_QUEUE_DEPTH);
+    }
+    if (f->block * AIO_BLOCK_SIZE >= f->size) {
+        return NULL;
+    }
+    int k = (int)(f->block % AIO_QUEUE_DEPTH);
+    if (!ring_wait(f, k) || f->slots[k].done == 0) {
+        f->failed = true;
+        return NULL;
+    }
+    f->block++;
+    *len = f->slots[k].done;
+    return f->slots[k].buf;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * aio_close - 等待全部在途请求完成后关闭
+ * 返回值：false 表示有读写失败
+ */
+bool aio_close(AioFile *f) {
+    if (f == NULL) {
+        return false;
+    }
+    bool ok = !f->failed;
+    if (f->fp != NULL) {
+        ok = fclose(f->fp) == 0 && ok;
+    }
+#ifdef AIO_HAVE_URING
+    else {
+        for (int k = 0; k < AIO_QUEUE_DEPTH; k++) {
+            ok = ring_wait(f, k) && ok;
+        }
+        if (f->padded && ftruncate(f->fd, (off_t)f->pos) != 0) {
+            ok = false;
+        }
+        ring_free(&f->ring);
+        ok = close(f->fd) == 0 && ok;
+    }
+#endif
+    aio_free(f);
+    return ok;
+}
+
+/*
+ * aio_read_file - 把整个文件读入一块内存
+ * io_uring 后端把文件按块同时提交多个读请求，直接读进结果缓冲区，不经过中间拷贝
+ * 返回值：缓冲区（调用者 free），失败返回 NULL
+ */
+unsigned char *aio_read_file(const char *path, size_t *size, int flags) {
+    AioFile *f = aio_open_backend(path, flags & ~AIO_WRITE);
+    if (f == NULL) {
+        return NULL;
+    }
+    /* 缓冲区按对齐单位向上取整，O_DIRECT 读最后一块时不会越界 */
+    size_t cap = (size_t)(f->size + AIO_ALIGN - 1) / AIO_ALIGN * AIO_ALIGN;
+    unsigned char *buf = aio_alloc(cap > 0 ? cap : AIO_ALIGN);
+    size_t got = 0;
+    if (buf == NULL) {
+        f->failed = true;
+    } else if (f->fp != NULL) {
+        got = fread(buf, 1, cap, f->fp);
+        f->failed = ferror(f->fp) != 0;
+    }
+#ifdef AIO_HAVE_URING
+    else {
+        /* 每个槽再次提交前先收割它上一块的结果，最后收割仍在途的各块 */
+        uint64_t nblocks = (f->size + AIO_BLOCK_SIZE - 1) / AIO_BLOCK_SIZE;
+        uint64_t b = 0;
+        for (; b < nblocks && !f->failed; b++) {
+            int k = (int)(b % AIO_QUEUE_DEPTH);
+            uint64_t offset = b * AIO_BLOCK_SIZE;
+            size_t len = cap - offset < AIO_BLOCK_SIZE ? cap - offset : AIO_BLOCK_SIZE;
+            if (b >= AIO_QUEUE_DEPTH) {
+                ring_wait(f, k);
+                got += f->slots[k].done;
+            }
+            if (!ring_submit(f, k, buf + offset, len, offset)) {
+                f->failed = true;
+            }
+        }
+        for (uint64_t t = b > AIO_QUEUE_DEPTH ? b - AIO_QUEUE_DEPTH : 0; t < b; t++) {
+            int k = (int)(t % AIO_QUEUE_DEPTH);
+            ring_wait(f, k);
+            got += f->slots[k].done;
+        }
+    }
+#endif
+    bool ok = !f->failed && got == f->size;
+    *size = got;
+    aio_close(f);
+    if (!ok) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
@@ -0,0 +1,34 @@
+/*
+ * aio.h - MiniDB 异步文件 I/O 头文件
+ * 顺序读写大文件时让多个大块请求同时在途，计算（编码 / 解码）与 I/O 重叠：
+ * - Linux 下使用 io_uring（直接系统调用，不依赖 liburing），可选 O_DIRECT 绕过页缓存
+ * - 其他平台或 io_uring 不可用时退回同步的 stdio 读写，接口不变
+ * 写：调用者向 aio_block 取得的块中填数据，满后 aio_submit 提交，随即取下一块继续填
+ * 读：打开时就提交前几块的读请求，调用者用 aio_next 按顺序取块，取走一块就补提交一块
+ */
+
+#ifndef AIO_H
+#define AIO_H
+
+#include "config.h"
+#include <stddef.h>
+
+#define AIO_BLOCK_SIZE   (1u << 20)  // 每块 1 MB
+#define AIO_QUEUE_DEPTH  4           // 同时在途的块数
+#define AIO_ALIGN        4096        // O_DIRECT 要求的缓冲区、偏移和长度对齐
+
+/* 打开选项 */
+#define AIO_WRITE   1       // 写（截断已有文件）；不设为读
+#define AIO_DIRECT  2       // 使用 O_DIRECT（写时只有最后一块可以不满 AIO_BLOCK_SIZE）
+
+typedef struct AioFile AioFile;
+
+AioFile *aio_open(const char *path, int flags);                 // 打开文件，失败返回 NULL
+unsigned char *aio_block(AioFile *f);                           // 写：取当前空闲块（AIO_BLOCK_SIZE 字节）
+bool aio_submit(AioFile *f, size_t len);                        // 写：提交当前块的前 len 字节
+const unsigned char *aio_next(AioFile *f, size_t *len);         // 读：按顺序取下一块，结束或出错返回 NULL（出错时 aio_close 返回 false）
+bool aio_close(AioFile *f);                                     // 等待在途请求并关闭，返回是否全部成功
+const char *aio_backend(const AioFile *f);                      // 实际使用的后端："io_uring" 或 "stdio"
+unsigned char *aio_read_file(const char *path, size_t *size, int flags);  // 把整个文件读入内存（用 free 释放）
+
+#endif /* AIO_H */
@@ -0,0 +1,375 @@
+/*
+ * arrow.c - MiniDB Arrow 导出实现
+ * 文件结构（Arrow IPC 文件格式，元数据版本 V5）：
+ *   "ARROW1" + 2 字节填充
+ *   Schema 消息、若干 RecordBatch 消息（流格式，每条为 0xFFFFFFFF + 元数据长度 + 元数据 + 正文）
+ *   流结束标记 0xFFFFFFFF 0x00000000
+ *   Footer（Schema + 各记录批在文件中的位置）、Footer 长度、"ARROW1"
+ * 元数据为 FlatBuffers 编码的表。这里只需要少数几种固定结构，
+ * 用一个从前往后写的小编码器生成：子对象总是写在父对象之后，偏移都指向后方，
+ * 写完子对象再回填父对象中的偏移。数值按本机字节序写出，与快照文件相同（小端）
+ */
+
+#include "arrow.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARROW_COLUMNS    5      // 列数
+#define ARROW_BUFFERS    11     // 正文缓冲区数：每列一个有效位图（长度 0），定长列一个数据区，姓名列偏移 + 数据两个
+#define ARROW_V5         4      // MetadataVersion::V5
+#define ARROW_SCHEMA     1      // MessageHeader::Schema
+#define ARROW_BATCH      3      // MessageHeader::RecordBatch
+#define ARROW_TYPE_INT   2      // Type::Int
+#define ARROW_TYPE_FLOAT 3      // Type::FloatingPoint
+#define ARROW_TYPE_UTF8  5      // Type::Utf8
+#define ARROW_DOUBLE     2      // Precision::DOUBLE
+
+/* 列定义：列名、类型、整数位宽与是否有符号 */
+static const struct {
+    const char *name;
+    uint8_t type;
+    int32_t bits;
+    bool is_signed;
+} columns[ARROW_COLUMNS] = {
+    { "id",    ARROW_TYPE_INT,   32, true  },
+    { "name",  ARROW_TYPE_UTF8,  0,  false },
+    { "age",   ARROW_TYPE_INT,   32, true  },
+    { "score", ARROW_TYPE_FLOAT, 0,  false },
+    { "flags", ARROW_TYPE_INT,   8,  false },
+};
+
+/* 记录批在文件中的位置（Footer 中的 Block） */
+typedef struct ArrowBlock {
+    int64_t offset;             // 消息起始位置
+    int32_t meta_len;           // 元数据长度（含 8 字节前缀与填充）
+    int64_t body_len;           // 正文长度
+} ArrowBlock;
+
+/*
+ * ==================== FlatBuffers 编码 ====================
+ * 偏移与对齐都相对于缓冲区起点；缓冲区写入文件时位于 8 字节对齐的位置
+ */
+
+/* 编码缓冲区：容量一次分配，超出时置 ok 为 false，之后的写入都被忽略 */
+typedef struct Fb {
+    unsigned char *buf;
+    size_t len;
+    size_t cap;
+    bool ok;
+} Fb;
+
+/* 表中的一个标量字段：size 为 0 表示不写（取默认值）；偏移字段 size 为 4，之后用 fb_link 回填 */
+typedef struct FbField {
+    uint8_t size;
+    uint64_t value;
+} FbField;
+
+/* 先填充 pad 字节，再分配 n 个清零的字节，返回其位置 */
+static size_t fb_alloc(Fb *fb, size_t pad, size_t n) {
+    if (!fb->ok || fb->len + pad + n > fb->cap) {
+        fb->ok = false;
+        return 0;
+    }
+    memset(fb->buf + fb->len, 0, pad + n);
+    fb->len += pad + n;
+    return fb->len - n;
+}
+
+/* 按 align 对齐后分配 n 个字节 */
+static size_t fb_aligned(Fb *fb, size_t n, size_t align) {
+    return fb_alloc(fb, (align - fb->len % align) % align, n);
+}
+
+static void fb_put(Fb *fb, size_t pos, const void *src, size_t n) {
+    if (fb->ok) {
+        memcpy(fb->buf + pos, src, n);
+    }
+}
+
+/* 在 at 处写入指向 target 的偏移（target 总在 at 之后） */
+static void fb_link(Fb *fb, size_t at, size_t target) {
+    uint32_t off = (uint32_t)(target - at);
+    fb_put(fb, at, &off, 4);
+}
+
+/*
+ * fb_table - 写一张表：先写虚表，再写表本体（虚表偏移 + 按大小从大到小排列的字段）
+ * where[i] 返回第 i 个字段的位置，供回填偏移
+ */
+static size_t fb_table(Fb *fb, const FbField *fields, int n, size_t *where) {
+    size_t vtable = fb_aligned(fb, 4 + 2 * (size_t)n, 2);
+    size_t table = fb_aligned(fb, 4, 8);
+    for (int size = 8; size >= 1; size /= 2) {
+        for (int i = 0; i < n; i++) {
+            if (fields[i].size == size) {
+                where[i] = fb_aligned(fb, (size_t)size, (size_t)size);
+                fb_put(fb, where[i], &fields[i].value, (size_t)size);  /* 小端：取低 size 字节 */
+            }
+        }
+    }
+    uint16_t head[2] = { (uint16_t)(4 + 2 * n), (uint16_t)(fb->len - table) };
+    fb_put(fb, vtable, head, sizeof(head));
+    for (int i = 0; i < n; i++) {
+        uint16_t off = fields[i].size != 0 ? (uint16_t)(where[i] - table) : 0;
+        fb_put(fb, vtable + 4 + 2 * (size_t)i, &off, 2);
+    }
+    int32_t soff = (int32_t)(table - vtable);
+    fb_put(fb, table, &soff, 4);
+    return table;
+}
+
+/* 写一个向量的长度，元素（count 个，每个 size 字节，按 align 对齐）紧随其后，返回长度字段的位置 */
+static size_t fb_vector(Fb *fb, uint32_t count, size_t size, size_t align) {
+    size_t a = align > 4 ? align : 4;
+    size_t pos = fb_alloc(fb, (a - (fb->len + 4) % a) % a, 4 + count * size);
+    fb_put(fb, pos, &count, 4);
+    return pos;
+}
+
+static size_t fb_string(Fb *fb, const char *s) {
+    uint32_t n = (uint32_t)strlen(s);
+    size_t pos = fb_aligned(fb, 4 + n + 1, 4);
+    fb_put(fb, pos, &n, 4);
+    fb_put(fb, pos + 4, s, n);
+    return pos;
+}
+
+/* Field 表：name、nullable、type_type、type、dictionary（不写）、children（空向量） */
+static size_t fb_field(Fb *fb, int col) {
+    FbField f[6] = { {4, 0}, {1, 0}, {1, columns[col].type}, {4, 0}, {0, 0}, {4, 0} };
+    size_t w[6];
+    size_t field = fb_table(fb, f, 6, w);
+    fb_link(fb, w[0], fb_string(fb, columns[col].name));
+
+    size_t type;
+    size_t tw[2];
+    if (columns[col].type == ARROW_TYPE_INT) {
+        FbField t[2] = { {4, (uint32_t)columns[col].bits}, {1, columns[col].is_signed} };
+        type = fb_table(fb, t, 2, tw);
+    } else if (columns[col].type == ARROW_TYPE_FLOAT) {
+        FbField t[1] = { {2, ARROW_DOUBLE} };
+        type = fb_table(fb, t, 1, tw);
+    } else {
+        type = fb_table(fb, NULL, 0, tw);  /* Utf8 没有字段 */
+    }
+    fb_link(fb, w[3], type);
+    fb_link(fb, w[5], fb_vector(fb, 0, 4, 4));  /* 部分读取器要求 children 存在 */
+    return field;
+}
+
+/* Schema 表：endianness（小端）、fields */
+static size_t fb_schema(Fb *fb) {
+    FbField f[2] = { {2, 0}, {4, 0} };
+    size_t w[2];
+    size_t schema = fb_table(fb, f, 2, w);
+    size_t vec = fb_vector(fb, ARROW_COLUMNS, 4, 4);
+    fb_link(fb, w[1], vec);
+    for (int i = 0; i < ARROW_COLUMNS; i++) {
+        fb_link(fb, vec + 4 + 4 * (size_t)i, fb_field(fb, i));
+    }
+    return schema;
+}
+
+/* Message 表：version、header_type、header（由调用者回填）、bodyLength；返回 header 字段的位置 */
+static size_t fb_message(Fb *fb, uint8_t header_type, int64_t body_len) {
+    size_t root = fb_aligned(fb, 4, 4);
+    FbField f[4] = { {2, ARROW_V5}, {1, header_type}, {4, 0}, {8, (uint64_t)body_len} };
+    size_t w[4];
+    fb_link(fb, root, fb_table(fb, f, 4, w));
+    return w[2];
+}
+
+/*
+ * ==================== 写文件 ====================
+ */
+
+/* 写一条消息的元数据部分：0xFFFFFFFF、长度、元数据，填充到 8 字节；返回写入的字节数，失败返回 0 */
+static int32_t write_metadata(FILE *fp, const Fb *fb) {
+    static const unsigned char zeros[8] = {0};
+    if (!fb->ok) {
+        return 0;
+    }
+    uint32_t padded = (uint32_t)((fb->len + 7) & ~(size_t)7);
+    uint32_t prefix[2] = { 0xFFFFFFFFu, padded };
+    if (fwrite(prefix, sizeof(prefix), 1, fp) != 1 ||
+        fwrite(fb->buf, 1, fb->len, fp) != fb->len ||
+        fwrite(zeros, 1, padded - fb->len, fp) != padded - fb->len) {
+        return 0;
+    }
+    return (int32_t)(8 + padded);
+}
+
+/* 缓冲区长度向上取整到 8 字节 */
+static size_t pad8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+/*
+ * write_batch - 写一个记录批：rows 为 n 个有效行的下标，name_bytes 为这些行的姓名总字节数，
+ * *file_pos 为当前写入位置（写完后前移）
+ * 各列依次组到一块正文缓冲区中，一次写出
+ */
+static bool write_batch(FILE *fp, const Database *db, const uint32_t *rows, uint32_t n,
+                        size_t name_bytes, Fb *fb, ArrowBlock *block, uint64_t *file_pos) {
+    /* 正文布局：id、姓名偏移、姓名数据、age、score、flags（有效位图长度均为 0） */
+    size_t len[6] = { 4 * (size_t)n, 4 * ((size_t)n + 1), name_bytes, 4 * (size_t)n, 8 * (size_t)n, n };
+    size_t off[6];
+    size_t body_len = 0;
+    for (int i = 0; i < 6; i++) {
+        off[i] = body_len;
+        body_len += pad8(len[i]);
+    }
+    unsigned char *body = calloc(body_len > 0 ? body_len : 1, 1);
+    if (body == NULL) {
+        fprintf(stderr, "内存分配失败！\n");
+        return false;
+    }
+    int32_t *ids = (int32_t *)(body + off[0]);
+    int32_t *name_offs = (int32_t *)(body + off[1]);
+    char *names = (char *)(body + off[2]);
+    int32_t *ages = (int32_t *)(body + off[3]);
+    double *scores = (double *)(body + off[4]);
+    uint8_t *flags = body + off[5];
+    int32_t pos = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        const Record *r = &db->rows[rows[i]];
+        uint32_t name_len = db->names[rows[i]].len;
+        ids[i] = r->id;
+        name_offs[i] = pos;
+        memcpy(names + pos, db_name(db, r), name_len);
+        pos += (int32_t)name_len;
+        ages[i] = r->age;
+        scores[i] = r->score;
+        flags[i] = r->flags;
+    }
+    name_offs[n] = pos;
+
+    /* RecordBatch 表：length、nodes、buffers */
+    fb->len = 0;
+    size_t header = fb_message(fb, ARROW_BATCH, (int64_t)body_len);
+    FbField f[3] = { {8, n}, {4, 0}, {4, 0} };
+    size_t w[3];
+    fb_link(fb, header, fb_table(fb, f, 3, w));
+    size_t nodes = fb_vector(fb, ARROW_COLUMNS, 16, 8);
+    fb_link(fb, w[1], nodes);
+    for (int i = 0; i < ARROW_COLUMNS; i++) {
+        int64_t node[2] = { n, 0 };  /* 长度、空值数 */
+        fb_put(fb, nodes + 4 + 16 * (size_t)i, node, sizeof(node));
+    }
+    /* 各列的缓冲区：有效位图（长度 0）+ 数据，姓名列多一个偏移数组 */
+    int64_t bufs[ARROW_BUFFERS][2] = {
+        { (int64_t)off[0], 0 }, { (int64_t)off[0], (int64_t)len[0] },
+        { (int64_t)off[1], 0 }, { (int64_t)off[1], (int64_t)len[1] }, { (int64_t)off[2], (int64_t)len[2] },
+        { (int64_t)off[3], 0 }, { (int64_t)off[3], (int64_t)len[3] },
+        { (int64_t)off[4], 0 }, { (int64_t)off[4], (int64_t)len[4] },
+        { (int64_t)off[5], 0 }, { (int64_t)off[5], (int64_t)len[5] },
+    };
+    size_t buffers = fb_vector(fb, ARROW_BUFFERS, 16, 8);
+    fb_link(fb, w[2], buffers);
+    fb_put(fb, buffers + 4, bufs, sizeof(bufs));
+
+    block->offset = (int64_t)*file_pos;
+    block->meta_len = write_metadata(fp, fb);
+    block->body_len = (int64_t)body_len;
+    bool ok = block->meta_len > 0 && fwrite(body, 1, body_len, fp) == body_len;
+    *file_pos += (uint64_t)block->meta_len + body_len;
+    free(body);
+    return ok;
+}
+
+/*
+ * arrow_export - 把有效记录导出为 Arrow IPC 文件
+ * 参数：db - 数据库指针
+ *       filename - 文件名
+ * 返回值：0 表示成功，-1 表示失败
+ */
+int arrow_export(const Database *db, const char *filename) {
+    if (db == NULL || filename == NULL) {
+        fprintf(stderr, "错误：参数为空！\n");
+        return -1;
+    }
+
+    uint32_t live = (uint32_t)db_live_count(db);
+    uint32_t nbatches = (live + ARROW_BATCH_ROWS - 1) / ARROW_BATCH_ROWS;
+    uint32_t *rows = malloc(sizeof(uint32_t) * ARROW_BATCH_ROWS);
+    ArrowBlock *blocks = malloc(sizeof(ArrowBlock) * (nbatches > 0 ? nbatches : 1));
+    Fb fb = { NULL, 0, 4096 + 24 * (size_t)nbatches, true };
+    fb.buf = malloc(fb.cap);
+    if (rows == NULL || blocks == NULL || fb.buf == NULL) {
+        free(rows);
+        free(blocks);
+        free(fb.buf);
+        fprintf(stderr, "内存分配失败！\n");
+        return -1;
+    }
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "错误：无法打开文件 '%s' 进行写入！\n", filename);
+        perror("fopen");
+        free(rows);
+        free(blocks);
+        free(fb.buf);
+        return -1;
+    }
+
+    /* 文件头与 Schema 消息 */
+    bool ok = fwrite("ARROW1\0\0", 1, 8, fp) == 8;
+    size_t header = fb_message(&fb, ARROW_SCHEMA, 0);
+    fb_link(&fb, header, fb_schema(&fb));
+    int32_t schema_len = write_metadata(fp, &fb);
+    uint64_t file_pos = 8 + (uint64_t)schema_len;
+    ok = ok && schema_len > 0;
+
+    /* 按行存储顺序每次取至多 ARROW_BATCH_ROWS 个有效行写成一个记录批 */
+    uint32_t row = 0, batch = 0;
+    uint64_t exported = 0;
+    while (ok && batch < nbatches) {
+        uint32_t n = 0;
+        size_t name_bytes = 0;
+        for (; row < (uint32_t)db->count && n < ARROW_BATCH_ROWS; row++) {
+            if (!db_is_dead(&db->rows[row])) {
+                rows[n++] = row;
+                name_bytes += db->names[row].len;
+            }
+        }
+        ok = write_batch(fp, db, rows, n, name_bytes, &fb, &blocks[batch++], &file_pos);
+        exported += n;
+    }
+
+    /* 流结束标记与 Footer：version、schema、dictionaries（空）、recordBatches */
+    static const uint32_t eos[2] = { 0xFFFFFFFFu, 0 };
+    ok = ok && fwrite(eos, sizeof(eos), 1, fp) == 1;
+    fb.len = 0;
+    size_t root = fb_aligned(&fb, 4, 4);
+    FbField f[4] = { {2, ARROW_V5}, {4, 0}, {4, 0}, {4, 0} };
+    size_t w[4];
+    fb_link(&fb, root, fb_table(&fb, f, 4, w));
+    fb_link(&fb, w[1], fb_schema(&fb));
+    fb_link(&fb, w[2], fb_vector(&fb, 0, 24, 8));
+    size_t vec = fb_vector(&fb, nbatches, 24, 8);
+    fb_link(&fb, w[3], vec);
+    for (uint32_t i = 0; i < nbatches; i++) {
+        unsigned char b[24] = {0};  /* Block 结构：offset、metaDataLength、4 字节填充、bodyLength */
+        memcpy(b, &blocks[i].offset, 8);
+        memcpy(b + 8, &blocks[i].meta_len, 4);
+        memcpy(b + 16, &blocks[i].body_len, 8);
+        fb_put(&fb, vec + 4 + 24 * (size_t)i, b, sizeof(b));
+    }
+    int32_t footer_len = (int32_t)fb.len;
+    ok = ok && fb.ok &&
+         fwrite(fb.buf, 1, fb.len, fp) == fb.len &&
+         fwrite(&footer_len, 4, 1, fp) == 1 &&
+         fwrite("ARROW1", 1, 6, fp) == 6;
+
+    free(rows);
+    free(blocks);
+    free(fb.buf);
+    if (fclose(fp) != 0 || !ok) {
+        fprintf(stderr, "错误：写入 Arrow 文件失败！\n");
+        return -1;
+    }
+    printf("成功导出 %llu 条记录到 Arrow 文件 '%s'（%u 个记录批）\n",
+           (unsigned long long)exported, filename, nbatches);
+    return 0;
+}
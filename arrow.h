@@ -0,0 +1,20 @@
+/*
+ * arrow.h - MiniDB Arrow 导出头文件
+ * 把有效记录按列写成 Apache Arrow IPC 文件格式（.arrow / Feather V2），
+ * pyarrow、DuckDB、Polars 等可直接内存映射读取，不需要解析：
+ * - 列：id int32、name utf8、age int32、score float64、flags uint8，均不含空值
+ * - 记录按行存储顺序（即加入的先后）分批写出，每批至多 ARROW_BATCH_ROWS 行，
+ *   每批各列先在内存中组好，整块写出
+ * - 元数据（FlatBuffers）由本模块直接编码，不依赖 Arrow 库
+ */
+
+#ifndef ARROW_H
+#define ARROW_H
+
+#include "db.h"
+
+#define ARROW_BATCH_ROWS (1u << 20)   // 每个记录批的最大行数
+
+int arrow_export(const Database *db, const char *filename);  // 导出为 Arrow 文件，0 成功 / -1 失败
+
+#endif /* ARROW_H */
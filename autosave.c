@@ -0,0 +1,235 @@
+/*
+ * autosave.c - MiniDB 后台自动保存实现
+ * 一把互斥锁保护数据库：前台在访问数据库期间持有，后台线程在检查修改计数和编码快照时持有；
+ * 后台线程在条件变量上等待，到期或被前台唤醒后检查修改计数，有修改时编码有修改的块
+ * （不能增量保存时编码整个快照）、清零修改计数，然后释放锁写文件（见 io_snapshot_prepare）
+ */
+
+#include "autosave.h"
+#include "io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define AUTOSAVE_PATH_MAX 512
+
+/* 自动保存状态，除 path 外都由 lock 保护 */
+static struct {
+    Database *db;                   // 被保存的数据库，NULL 表示未启动或已停止
+    char path[AUTOSAVE_PATH_MAX];   // 快照文件名（启动后不变）
+    int interval;                   // 保存间隔（秒），0 表示只按修改次数保存
+    uint64_t threshold;             // 修改次数阈值，0 表示只按时间保存
+    pthread_mutex_t lock;
+    pthread_cond_t wake;            // 唤醒后台线程：停止或修改次数达到阈值
+    pthread_cond_t idle;            // 后台线程写完文件
+    pthread_t thread;
+    bool running;                   // 后台线程已启动
+    bool stop;                      // 请求后台线程退出
+    bool kick;                      // 修改次数达到阈值，立即检查
+    bool writing;                   // 后台线程正在写文件（不持锁）
+    double last_save;               // 上次保存或检查的时间
+    uint64_t saves;                 // 成功保存次数
+    uint64_t skips;                 // 到期但没有修改而跳过的次数
+    uint64_t failures;              // 保存失败次数
+    uint64_t last_changes;          // 上次保存包含的修改次数
+    uint32_t last_blocks;           // 上次保存写入的块数
+    uint64_t last_bytes;            // 上次保存写入的字节数
+    double last_lock_ms;            // 上次保存持锁编码的时间
+    double last_write_ms;           // 上次保存写文件的时间
+} as = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+};
+
+static double autosave_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * autosave_save_locked - 保存一次（调用时持锁，返回时仍持锁）
+ * 持锁期间只编码到内存并清零修改计数，写文件时释放锁；
+ * 写失败时把修改计数加回去（块布局随之丢弃，下次整体重写）
+ */
+static bool autosave_save_locked(void) {
+    Database *db = as.db;
+    double t0 = autosave_now();
+    uint64_t changes = db->changes;
+    SnapshotPlan *plan = io_snapshot_prepare(db, as.path);
+    if (plan == NULL) {
+        as.failures++;
+        return false;
+    }
+    db_mark_clean(db);
+    uint32_t blocks = io_snapshot_blocks(plan);
+    uint64_t bytes = io_snapshot_size(plan);
+    double t1 = autosave_now();
+
+    as.writing = true;
+    pthread_mutex_unlock(&as.lock);
+    bool ok = io_snapshot_write(plan);
+    double t2 = autosave_now();
+    pthread_mutex_lock(&as.lock);
+    io_snapshot_finish(db, plan, ok);
+    as.writing = false;
+    pthread_cond_broadcast(&as.idle);
+
+    if (!ok) {
+        db_touch_all(db);
+        db->changes += changes;
+        as.failures++;
+        return false;
+    }
+    as.saves++;
+    as.last_changes = changes;
+    as.last_blocks = blocks;
+    as.last_bytes = bytes;
+    as.last_lock_ms = (t1 - t0) * 1000.0;
+    as.last_write_ms = (t2 - t1) * 1000.0;
+    return true;
+}
+
+/* 后台线程：等到下次保存时间或被唤醒，有修改才保存 */
+static void *autosave_thread(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&as.lock);
+    while (!as.stop) {
+        if (!as.kick) {
+            if (as.interval <= 0) {
+                pthread_cond_wait(&as.wake, &as.lock);
+                continue;
+            }
+            double due = as.last_save + as.interval;
+            if (autosave_now() < due) {
+                struct timespec ts;
+                ts.tv_sec = (time_t)due;
+                ts.tv_nsec = (long)((due - (double)ts.tv_sec) * 1e9);
+                pthread_cond_timedwait(&as.wake, &as.lock, &ts);
+                continue;
+            }
+        }
+        as.kick = false;
+        if (as.db->changes == 0) {
+            as.skips++;
+        } else {
+            autosave_save_locked();
+        }
+        as.last_save = autosave_now();
+    }
+    pthread_mutex_unlock(&as.lock);
+    return NULL;
+}
+
+/*
+ * autosave_start - 启动自动保存
+ * interval 秒内有修改时保存一次；修改次数达到 changes 时提前保存（0 表示不按次数）；
+ * 两者都为 0 时不启动后台线程，只在 autosave_stop 时保存
+ * 调用前应已加载数据并 db_mark_clean，否则第一次到期时会把刚加载的数据原样写回
+ */
+bool autosave_start(Database *db, const char *filename, int interval, uint64_t changes) {
+    pthread_mutex_lock(&as.lock);
+    as.db = db;
+    snprintf(as.path, sizeof(as.path), "%s", filename);
+    as.interval = interval > 0 ? interval : 0;
+    as.threshold = changes;
+    as.stop = false;
+    as.kick = false;
+    as.last_save = autosave_now();
+    pthread_mutex_unlock(&as.lock);
+
+    if (as.interval == 0 && as.threshold == 0) {
+        return true;
+    }
+    if (pthread_create(&as.thread, NULL, autosave_thread, NULL) != 0) {
+        fprintf(stderr, "警告：无法启动自动保存线程，只在退出时保存。\n");
+        return false;
+    }
+    as.running = true;
+    return true;
+}
+
+/*
+ * autosave_stop - 停止后台线程，有未保存的修改时保存一次
+ * 可重复调用（退出命令中调用一次，atexit 再调用一次）
+ */
+void autosave_stop(void) {
+    pthread_mutex_lock(&as.lock);
+    if (as.db == NULL) {
+        pthread_mutex_unlock(&as.lock);
+        return;
+    }
+    if (as.running) {
+        as.stop = true;
+        pthread_cond_signal(&as.wake);
+        pthread_mutex_unlock(&as.lock);
+        pthread_join(as.thread, NULL);
+        pthread_mutex_lock(&as.lock);
+        as.running = false;
+    }
+
+    if (as.db->changes == 0) {
+        printf("数据没有修改，无需保存。\n");
+    } else if (autosave_save_locked()) {
+        printf("成功保存 %d 条记录到 '%s'\n", db_live_count(as.db), as.path);
+    } else {
+        fprintf(stderr, "错误：自动保存到 '%s' 失败！\n", as.path);
+    }
+    as.db = NULL;
+    pthread_mutex_unlock(&as.lock);
+}
+
+void autosave_begin(void) {
+    pthread_mutex_lock(&as.lock);
+}
+
+void autosave_end(void) {
+    if (as.running && as.threshold > 0 && as.db != NULL && as.db->changes >= as.threshold) {
+        as.kick = true;
+        pthread_cond_signal(&as.wake);
+    }
+    pthread_mutex_unlock(&as.lock);
+}
+
+/*
+ * autosave_sync - 等待后台线程正在进行的写文件完成
+ * 前台直接读写快照文件前调用，避免后台线程随后改名时用较旧的快照覆盖
+ */
+void autosave_sync(void) {
+    while (as.writing) {
+        pthread_cond_wait(&as.idle, &as.lock);
+    }
+}
+
+void autosave_print_status(void) {
+    if (as.db == NULL) {
+        printf("自动保存未启用。\n");
+        return;
+    }
+    printf("自动保存到 '%s'：", as.path);
+    if (!as.running) {
+        printf("后台线程未运行，只在退出时保存\n");
+    } else {
+        if (as.interval > 0) {
+            printf("每 %d 秒", as.interval);
+        }
+        if (as.threshold > 0) {
+            printf("%s修改达到 %llu 次时", as.interval > 0 ? "或" : "",
+                   (unsigned long long)as.threshold);
+        }
+        printf("保存（没有修改时跳过）\n");
+    }
+    printf("未保存的修改：%llu 次，涉及 %u 个块（每块 %d 行）\n",
+           (unsigned long long)as.db->changes, db_dirty_blocks(as.db), DB_BLOCK_ROWS);
+    printf("已保存 %llu 次，无修改跳过 %llu 次，失败 %llu 次\n",
+           (unsigned long long)as.saves, (unsigned long long)as.skips,
+           (unsigned long long)as.failures);
+    if (as.saves > 0) {
+        printf("上次保存：%llu 次修改，写入 %u 块 %.1f KB，持锁编码 %.1f 毫秒，写文件 %.1f 毫秒\n",
+               (unsigned long long)as.last_changes, as.last_blocks, as.last_bytes / 1024.0,
+               as.last_lock_ms, as.last_write_ms);
+    }
+}
@@ -0,0 +1,21 @@
+/*
+ * autosave.h - MiniDB 后台自动保存头文件
+ * 后台线程在有修改时按时间间隔或修改次数把数据库保存到快照文件，没有修改时跳过：
+ * - 前台只在访问数据库期间持有数据库锁（autosave_begin / autosave_end），读取用户输入时不持有
+ * - 后台只在把有修改的块编码到内存期间持锁，写文件时不持锁，前台不必等待磁盘
+ * - 增量保存最后才改写文件头，整体重写先写临时文件再改名，保存中途崩溃或被杀不会破坏上一次的快照
+ */
+
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include "db.h"
+
+bool autosave_start(Database *db, const char *filename, int interval, uint64_t changes);  // 启动，interval 为 0 时不启动后台线程
+void autosave_stop(void);           // 停止后台线程，有未保存的修改时保存一次（可重复调用）
+void autosave_begin(void);          // 前台开始访问数据库（加锁）
+void autosave_end(void);            // 前台访问结束（解锁），修改次数达到阈值时唤醒后台线程
+void autosave_sync(void);           // 等待后台正在进行的写文件完成（须在持有数据库锁时调用）
+void autosave_print_status(void);   // 输出自动保存设置与统计（须在持有数据库锁时调用）
+
+#endif /* AUTOSAVE_H */
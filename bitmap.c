@@ -0,0 +1,605 @@
+/*
+ * bitmap.c - MiniDB 压缩位图实现
+ * 数组块元素数超过 BM_ARRAY_MAX 时转为位集块，位集块元素数
+ * 降到 BM_ARRAY_MAX 及以下时转回数组块；空块立即删除
+ */
+
+#include "bitmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* 64 位字中 1 的个数 */
+static inline uint32_t popcount64(uint64_t w) {
+    return (uint32_t)__builtin_popcountll(w);
+}
+
+/* 在有序数组中二分查找，找到返回下标，否则返回 -(插入位置) - 1 */
+static int32_t arr_search(const uint16_t *a, uint32_t n, uint16_t v) {
+    int32_t lo = 0, hi = (int32_t)n - 1;
+    while (lo <= hi) {
+        int32_t mid = (lo + hi) >> 1;
+        if (a[mid] < v) {
+            lo = mid + 1;
+        } else if (a[mid] > v) {
+            hi = mid - 1;
+        } else {
+            return mid;
+        }
+    }
+    return -lo - 1;
+}
+
+/* 按 key 查找块，规则同 arr_search */
+static int32_t bm_find(const Bitmap *bm, uint16_t key) {
+    int32_t lo = 0, hi = (int32_t)bm->n - 1;
+    while (lo <= hi) {
+        int32_t mid = (lo + hi) >> 1;
+        uint16_t k = bm->conts[mid].key;
+        if (k < key) {
+            lo = mid + 1;
+        } else if (k > key) {
+            hi = mid - 1;
+        } else {
+            return mid;
+        }
+    }
+    return -lo - 1;
+}
+
+static void cont_free(BmContainer *c) {
+    free(c->data);
+    c->data = NULL;
+    c->card = 0;
+    c->cap = 0;
+}
+
+/* 数组块 -> 位集块 */
+static bool cont_to_bitset(BmContainer *c) {
+    uint64_t *words = calloc(BM_WORDS, sizeof(uint64_t));
+    if (words == NULL) {
+        return false;
+    }
+    const uint16_t *arr = c->data;
+    for (uint32_t i = 0; i < c->card; i++) {
+        words[arr[i] >> 6] |= 1ULL << (arr[i] & 63);
+    }
+    free(c->data);
+    c->data = words;
+    c->type = BM_BITSET;
+    c->cap = 0;
+    return true;
+}
+
+/* 位集块 -> 数组块 */
+static bool cont_to_array(BmContainer *c) {
+    uint32_t cap = c->card > 0 ? c->card : 1;
+    uint16_t *arr = malloc(cap * sizeof(uint16_t));
+    if (arr == NULL) {
+        return false;
+    }
+    const uint64_t *words = c->data;
+    uint32_t n = 0;
+    for (uint32_t w = 0; w < BM_WORDS; w++) {
+        uint64_t bits = words[w];
+        while (bits != 0) {
+            arr[n++] = (uint16_t)(w * 64 + (uint32_t)__builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+    free(c->data);
+    c->data = arr;
+    c->type = BM_ARRAY;
+    c->cap = cap;
+    return true;
+}
+
+/* 位集块元素较少时转回数组块（内存不足时保持位集） */
+static void cont_shrink(BmContainer *c) {
+    if (c->type == BM_BITSET && c->card <= BM_ARRAY_MAX) {
+        cont_to_array(c);
+    }
+}
+
+/* 在 idx 处插入一个空的数组块 */
+static BmContainer *bm_insert_container(Bitmap *bm, uint32_t idx, uint16_t key) {
+    if (bm->n == bm->cap) {
+        uint32_t cap = bm->cap > 0 ? bm->cap * 2 : 4;
+        BmContainer *conts = realloc(bm->conts, cap * sizeof(BmContainer));
+        if (conts == NULL) {
+            return NULL;
+        }
+        bm->conts = conts;
+        bm->cap = cap;
+    }
+    memmove(&bm->conts[idx + 1], &bm->conts[idx], (bm->n - idx) * sizeof(BmContainer));
+    BmContainer *c = &bm->conts[idx];
+    c->key = key;
+    c->type = BM_ARRAY;
+    c->card = 0;
+    c->cap = 0;
+    c->data = NULL;
+    bm->n++;
+    return c;
+}
+
+static void bm_remove_container(Bitmap *bm, uint32_t idx) {
+    cont_free(&bm->conts[idx]);
+    memmove(&bm->conts[idx], &bm->conts[idx + 1], (bm->n - idx - 1) * sizeof(BmContainer));
+    bm->n--;
+}
+
+/* 把已构造好的块追加到位图末尾（key 必须大于已有块），接管其内存 */
+static bool bm_append(Bitmap *bm, BmContainer *c) {
+    if (c->card == 0) {
+        cont_free(c);
+        return true;
+    }
+    if (bm->n == bm->cap) {
+        uint32_t cap = bm->cap > 0 ? bm->cap * 2 : 4;
+        BmContainer *conts = realloc(bm->conts, cap * sizeof(BmContainer));
+        if (conts == NULL) {
+            cont_free(c);
+            return false;
+        }
+        bm->conts = conts;
+        bm->cap = cap;
+    }
+    bm->conts[bm->n++] = *c;
+    return true;
+}
+
+void bitmap_init(Bitmap *bm) {
+    bm->conts = NULL;
+    bm->n = 0;
+    bm->cap = 0;
+}
+
+void bitmap_clear(Bitmap *bm) {
+    for (uint32_t i = 0; i < bm->n; i++) {
+        cont_free(&bm->conts[i]);
+    }
+    bm->n = 0;
+}
+
+void bitmap_free(Bitmap *bm) {
+    bitmap_clear(bm);
+    free(bm->conts);
+    bitmap_init(bm);
+}
+
+bool bitmap_add(Bitmap *bm, uint32_t x) {
+    uint16_t key = (uint16_t)(x >> 16);
+    uint16_t low = (uint16_t)(x & 0xFFFF);
+    int32_t idx = bm_find(bm, key);
+    BmContainer *c;
+    if (idx < 0) {
+        c = bm_insert_container(bm, (uint32_t)(-idx - 1), key);
+        if (c == NULL) {
+            return false;
+        }
+    } else {
+        c = &bm->conts[idx];
+    }
+
+    if (c->type == BM_ARRAY) {
+        uint16_t *arr = c->data;
+        int32_t pos = arr_search(arr, c->card, low);
+        if (pos >= 0) {
+            return true;
+        }
+        if (c->card >= BM_ARRAY_MAX) {
+            if (!cont_to_bitset(c)) {
+                return false;
+            }
+        } else {
+            if (c->card == c->cap) {
+                uint32_t cap = c->cap > 0 ? c->cap * 2 : 4;
+                if (cap > BM_ARRAY_MAX) {
+                    cap = BM_ARRAY_MAX;
+                }
+                arr = realloc(c->data, cap * sizeof(uint16_t));
+                if (arr == NULL) {
+                    if (c->card == 0) {
+                        bm_remove_container(bm, (uint32_t)(c - bm->conts));
+                    }
+                    return false;
+                }
+                c->data = arr;
+                c->cap = cap;
+            }
+            uint32_t ins = (uint32_t)(-pos - 1);
+            memmove(&arr[ins + 1], &arr[ins], (c->card - ins) * sizeof(uint16_t));
+            arr[ins] = low;
+            c->card++;
+            return true;
+        }
+    }
+
+    uint64_t *words = c->data;
+    uint64_t bit = 1ULL << (low & 63);
+    if ((words[low >> 6] & bit) == 0) {
+        words[low >> 6] |= bit;
+        c->card++;
+    }
+    return true;
+}
+
+void bitmap_remove(Bitmap *bm, uint32_t x) {
+    int32_t idx = bm_find(bm, (uint16_t)(x >> 16));
+    if (idx < 0) {
+        return;
+    }
+    BmContainer *c = &bm->conts[idx];
+    uint16_t low = (uint16_t)(x & 0xFFFF);
+
+    if (c->type == BM_ARRAY) {
+        uint16_t *arr = c->data;
+        int32_t pos = arr_search(arr, c->card, low);
+        if (pos < 0) {
+            return;
+        }
+        memmove(&arr[pos], &arr[pos + 1], (c->card - (uint32_t)pos - 1) * sizeof(uint16_t));
+        c->card--;
+    } else {
+        uint64_t *words = c->data;
+        uint64_t bit = 1ULL << (low & 63);
+        if ((words[low >> 6] & bit) == 0) {
+            return;
+        }
+        words[low >> 6] &= ~bit;
+        c->card--;
+        cont_shrink(c);
+    }
+    if (c->card == 0) {
+        bm_remove_container(bm, (uint32_t)idx);
+    }
+}
+
+bool bitmap_contains(const Bitmap *bm, uint32_t x) {
+    int32_t idx = bm_find(bm, (uint16_t)(x >> 16));
+    if (idx < 0) {
+        return false;
+    }
+    const BmContainer *c = &bm->conts[idx];
+    uint16_t low = (uint16_t)(x & 0xFFFF);
+    if (c->type == BM_ARRAY) {
+        return arr_search(c->data, c->card, low) >= 0;
+    }
+    const uint64_t *words = c->data;
+    return (words[low >> 6] >> (low & 63)) & 1;
+}
+
+uint64_t bitmap_cardinality(const Bitmap *bm) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < bm->n; i++) {
+        total += bm->conts[i].card;
+    }
+    return total;
+}
+
+bool bitmap_fill(Bitmap *bm, uint32_t n) {
+    bitmap_clear(bm);
+    uint32_t start = 0;
+    while (start < n) {
+        uint32_t span = n - start > 65536 ? 65536 : n - start;
+        BmContainer c;
+        c.key = (uint16_t)(start >> 16);
+        c.card = span;
+        if (span > BM_ARRAY_MAX) {
+            uint64_t *words = calloc(BM_WORDS, sizeof(uint64_t));
+            if (words == NULL) {
+                return false;
+            }
+            uint32_t full = span / 64;
+            memset(words, 0xFF, full * sizeof(uint64_t));
+            if (span % 64) {
+                words[full] = (1ULL << (span % 64)) - 1;
+            }
+            c.type = BM_BITSET;
+            c.cap = 0;
+            c.data = words;
+        } else {
+            uint16_t *arr = malloc(span * sizeof(uint16_t));
+            if (arr == NULL) {
+                return false;
+            }
+            for (uint32_t i = 0; i < span; i++) {
+                arr[i] = (uint16_t)i;
+            }
+            c.type = BM_ARRAY;
+            c.cap = span;
+            c.data = arr;
+        }
+        if (!bm_append(bm, &c)) {
+            return false;
+        }
+        start += span;
+    }
+    return true;
+}
+
+static bool cont_copy(const BmContainer *src, BmContainer *dst) {
+    *dst = *src;
+    size_t bytes = src->type == BM_ARRAY ? src->card * sizeof(uint16_t)
+                                         : BM_WORDS * sizeof(uint64_t);
+    dst->data = malloc(bytes > 0 ? bytes : 1);
+    if (dst->data == NULL) {
+        return false;
+    }
+    memcpy(dst->data, src->data, bytes);
+    if (src->type == BM_ARRAY) {
+        dst->cap = src->card;
+    }
+    return true;
+}
+
+bool bitmap_copy(Bitmap *dst, const Bitmap *src) {
+    bitmap_clear(dst);
+    for (uint32_t i = 0; i < src->n; i++) {
+        BmContainer c;
+        if (!cont_copy(&src->conts[i], &c) || !bm_append(dst, &c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 分配一个容量为 cap 的空数组块 */
+static bool cont_new_array(BmContainer *c, uint16_t key, uint32_t cap) {
+    c->key = key;
+    c->type = BM_ARRAY;
+    c->card = 0;
+    c->cap = cap > 0 ? cap : 1;
+    c->data = malloc(c->cap * sizeof(uint16_t));
+    return c->data != NULL;
+}
+
+/* 块交集 */
+static bool cont_and(const BmContainer *a, const BmContainer *b, BmContainer *out) {
+    if (a->type == BM_BITSET && b->type == BM_BITSET) {
+        uint64_t *words = malloc(BM_WORDS * sizeof(uint64_t));
+        if (words == NULL) {
+            return false;
+        }
+        const uint64_t *wa = a->data, *wb = b->data;
+        uint32_t card = 0;
+        for (uint32_t w = 0; w < BM_WORDS; w++) {
+            words[w] = wa[w] & wb[w];
+            card += popcount64(words[w]);
+        }
+        out->key = a->key;
+        out->type = BM_BITSET;
+        out->card = card;
+        out->cap = 0;
+        out->data = words;
+        cont_shrink(out);
+        return true;
+    }
+    if (a->type == BM_BITSET) {
+        const BmContainer *t = a;
+        a = b;
+        b = t;
+    }
+    /* 此时 a 为数组块 */
+    if (!cont_new_array(out, a->key, a->card)) {
+        return false;
+    }
+    const uint16_t *arr = a->data;
+    uint16_t *res = out->data;
+    if (b->type == BM_BITSET) {
+        const uint64_t *wb = b->data;
+        for (uint32_t i = 0; i < a->card; i++) {
+            if ((wb[arr[i] >> 6] >> (arr[i] & 63)) & 1) {
+                res[out->card++] = arr[i];
+            }
+        }
+    } else {
+        const uint16_t *brr = b->data;
+        uint32_t i = 0, j = 0;
+        while (i < a->card && j < b->card) {
+            if (arr[i] < brr[j]) {
+                i++;
+            } else if (arr[i] > brr[j]) {
+                j++;
+            } else {
+                res[out->card++] = arr[i];
+                i++;
+                j++;
+            }
+        }
+    }
+    return true;
+}
+
+/* 块差集 a AND NOT b */
+static bool cont_andnot(const BmContainer *a, const BmContainer *b, BmContainer *out) {
+    if (a->type == BM_BITSET) {
+        uint64_t *words = malloc(BM_WORDS * sizeof(uint64_t));
+        if (words == NULL) {
+            return false;
+        }
+        memcpy(words, a->data, BM_WORDS * sizeof(uint64_t));
+        uint32_t card = 0;
+        if (b->type == BM_BITSET) {
+            const uint64_t *wb = b->data;
+            for (uint32_t w = 0; w < BM_WORDS; w++) {
+                words[w] &= ~wb[w];
+                card += popcount64(words[w]);
+            }
+        } else {
+            const uint16_t *brr = b->data;
+            card = a->card;
+            for (uint32_t j = 0; j < b->card; j++) {
+                uint64_t bit = 1ULL << (brr[j] & 63);
+                if (words[brr[j] >> 6] & bit) {
+                    words[brr[j] >> 6] &= ~bit;
+                    card--;
+                }
+            }
+        }
+        out->key = a->key;
+        out->type = BM_BITSET;
+        out->card = card;
+        out->cap = 0;
+        out->data = words;
+        cont_shrink(out);
+        return true;
+    }
+
+    if (!cont_new_array(out, a->key, a->card)) {
+        return false;
+    }
+    const uint16_t *arr = a->data;
+    uint16_t *res = out->data;
+    if (b->type == BM_BITSET) {
+        const uint64_t *wb = b->data;
+        for (uint32_t i = 0; i < a->card; i++) {
+            if (((wb[arr[i] >> 6] >> (arr[i] & 63)) & 1) == 0) {
+                res[out->card++] = arr[i];
+            }
+        }
+    } else {
+        const uint16_t *brr = b->data;
+        uint32_t i = 0, j = 0;
+        while (i < a->card) {
+            if (j >= b->card || arr[i] < brr[j]) {
+                res[out->card++] = arr[i++];
+            } else if (arr[i] > brr[j]) {
+                j++;
+            } else {
+                i++;
+                j++;
+            }
+        }
+    }
+    return true;
+}
+
+bool bitmap_and(const Bitmap *a, const Bitmap *b, Bitmap *out) {
+    bitmap_clear(out);
+    uint32_t i = 0, j = 0;
+    while (i < a->n && j < b->n) {
+        uint16_t ka = a->conts[i].key, kb = b->conts[j].key;
+        if (ka < kb) {
+            i++;
+        } else if (ka > kb) {
+            j++;
+        } else {
+            BmContainer c;
+            if (!cont_and(&a->conts[i], &b->conts[j], &c) || !bm_append(out, &c)) {
+                return false;
+            }
+            i++;
+            j++;
+        }
+    }
+    return true;
+}
+
+bool bitmap_andnot(const Bitmap *a, const Bitmap *b, Bitmap *out) {
+    bitmap_clear(out);
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < a->n; i++) {
+        uint16_t ka = a->conts[i].key;
+        while (j < b->n && b->conts[j].key < ka) {
+            j++;
+        }
+        BmContainer c;
+        bool ok = (j < b->n && b->conts[j].key == ka)
+                  ? cont_andnot(&a->conts[i], &b->conts[j], &c)
+                  : cont_copy(&a->conts[i], &c);
+        if (!ok || !bm_append(out, &c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t bitmap_and_cardinality(const Bitmap *a, const Bitmap *b) {
+    uint64_t total = 0;
+    uint32_t i = 0, j = 0;
+    while (i < a->n && j < b->n) {
+        const BmContainer *ca = &a->conts[i], *cb = &b->conts[j];
+        if (ca->key < cb->key) {
+            i++;
+            continue;
+        }
+        if (ca->key > cb->key) {
+            j++;
+            continue;
+        }
+        if (ca->type == BM_BITSET && cb->type == BM_BITSET) {
+            const uint64_t *wa = ca->data, *wb = cb->data;
+            for (uint32_t w = 0; w < BM_WORDS; w++) {
+                total += popcount64(wa[w] & wb[w]);
+            }
+        } else if (ca->type == BM_BITSET || cb->type == BM_BITSET) {
+            const BmContainer *arr_c = ca->type == BM_ARRAY ? ca : cb;
+            const BmContainer *bs_c = ca->type == BM_ARRAY ? cb : ca;
+            const uint16_t *arr = arr_c->data;
+            const uint64_t *words = bs_c->data;
+            for (uint32_t k = 0; k < arr_c->card; k++) {
+                total += (words[arr[k] >> 6] >> (arr[k] & 63)) & 1;
+            }
+        } else {
+            const uint16_t *x = ca->data, *y = cb->data;
+            uint32_t p = 0, q = 0;
+            while (p < ca->card && q < cb->card) {
+                if (x[p] < y[q]) {
+                    p++;
+                } else if (x[p] > y[q]) {
+                    q++;
+                } else {
+                    total++;
+                    p++;
+                    q++;
+                }
+            }
+        }
+        i++;
+        j++;
+    }
+    return total;
+}
+
+void bitmap_iter_init(BitmapIter *it, const Bitmap *bm) {
+    it->bm = bm;
+    it->ci = 0;
+    it->i = 0;
+    it->word = 0;
+    if (bm->n > 0 && bm->conts[0].type == BM_BITSET) {
+        it->word = ((const uint64_t *)bm->conts[0].data)[0];
+    }
+}
+
+bool bitmap_iter_next(BitmapIter *it, uint32_t *out) {
+    const Bitmap *bm = it->bm;
+    while (it->ci < bm->n) {
+        const BmContainer *c = &bm->conts[it->ci];
+        uint32_t high = (uint32_t)c->key << 16;
+        if (c->type == BM_ARRAY) {
+            if (it->i < c->card) {
+                *out = high | ((const uint16_t *)c->data)[it->i++];
+                return true;
+            }
+        } else {
+            const uint64_t *words = c->data;
+            while (it->word == 0 && ++it->i < BM_WORDS) {
+                it->word = words[it->i];
+            }
+            if (it->word != 0) {
+                *out = high | (it->i * 64 + (uint32_t)__builtin_ctzll(it->word));
+                it->word &= it->word - 1;
+                return true;
+            }
+        }
+        /* 进入下一个块 */
+        it->ci++;
+        it->i = 0;
+        it->word = 0;
+        if (it->ci < bm->n && bm->conts[it->ci].type == BM_BITSET) {
+            it->word = ((const uint64_t *)bm->conts[it->ci].data)[0];
+        }
+    }
+    return false;
+}
@@ -0,0 +1,69 @@
+/*
+ * bitmap.h - MiniDB 压缩位图头文件
+ * 仿 Roaring Bitmap：按 32 位整数的高 16 位分块，
+ * 稀疏块用有序 uint16 数组存储，稠密块用 1024 个 64 位字存储；
+ * 用于按状态标志索引行下标，组合条件用按字 AND / ANDNOT 和 popcount 计算
+ */
+
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include "config.h"
+#include <stddef.h>
+
+#define BM_ARRAY_MAX  4096   // 数组块最多元素数，超过后转为位集块
+#define BM_WORDS      1024   // 位集块的 64 位字数（65536 位）
+
+/* 块类型 */
+typedef enum BmType {
+    BM_ARRAY = 1,   // 有序 uint16 数组
+    BM_BITSET       // 65536 位的位集
+} BmType;
+
+/*
+ * 位图块：覆盖高 16 位相同的 65536 个整数
+ */
+typedef struct BmContainer {
+    uint16_t key;       // 高 16 位
+    uint16_t type;      // BmType
+    uint32_t card;      // 元素个数
+    uint32_t cap;       // 数组块的容量（元素数）
+    void *data;         // uint16_t[cap] 或 uint64_t[BM_WORDS]
+} BmContainer;
+
+/*
+ * 压缩位图：块按 key 升序排列
+ */
+typedef struct Bitmap {
+    BmContainer *conts;
+    uint32_t n;         // 块数
+    uint32_t cap;       // conts 容量
+} Bitmap;
+
+/*
+ * 位图迭代器：按升序逐个取出元素
+ */
+typedef struct BitmapIter {
+    const Bitmap *bm;
+    uint32_t ci;        // 当前块下标
+    uint32_t i;         // 数组块：元素下标；位集块：字下标
+    uint64_t word;      // 位集块中当前字尚未取出的位
+} BitmapIter;
+
+void bitmap_init(Bitmap *bm);                                 // 初始化为空位图
+void bitmap_free(Bitmap *bm);                                 // 释放内存
+void bitmap_clear(Bitmap *bm);                                // 清空（释放所有块）
+bool bitmap_add(Bitmap *bm, uint32_t x);                      // 加入元素，内存不足返回 false
+void bitmap_remove(Bitmap *bm, uint32_t x);                   // 删除元素
+bool bitmap_contains(const Bitmap *bm, uint32_t x);           // 是否包含元素
+uint64_t bitmap_cardinality(const Bitmap *bm);                // 元素个数
+bool bitmap_fill(Bitmap *bm, uint32_t n);                     // 置为 [0, n) 全集
+bool bitmap_copy(Bitmap *dst, const Bitmap *src);             // 复制（dst 原有内容被替换）
+bool bitmap_and(const Bitmap *a, const Bitmap *b, Bitmap *out);     // out = a AND b
+bool bitmap_andnot(const Bitmap *a, const Bitmap *b, Bitmap *out);  // out = a AND NOT b
+uint64_t bitmap_and_cardinality(const Bitmap *a, const Bitmap *b);  // |a AND b|，不生成结果
+
+void bitmap_iter_init(BitmapIter *it, const Bitmap *bm);      // 初始化迭代器
+bool bitmap_iter_next(BitmapIter *it, uint32_t *out);         // 取下一个元素，没有时返回 false
+
+#endif /* BITMAP_H */
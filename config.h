@@ -7,9 +7,31 @@
 
 #define MAX_NAME_LEN 64  // 姓名最大长度
 
+#define OUT_BUF_SIZE  (64 * 1024)    // 记录输出缓冲区大小（字节）
+
+/* 墓碑回收阈值：墓碑行数不少于 VACUUM_MIN_DEAD 且占总行数的比例超过
+ * VACUUM_DEAD_PERCENT% 时，批量压缩行存储和索引 */
+#define VACUUM_MIN_DEAD      64
+#define VACUUM_DEAD_PERCENT  25
+
+/* 快照读写是否使用 O_DIRECT 绕过页缓存（只对 Linux 的 io_uring 后端生效；
+ * 适合远大于内存、读写一次就不再访问的文件，文件在页缓存中时反而更慢） */
+#define SNAPSHOT_DIRECT_IO  0
+
+/* 后台自动保存：有修改且距上次保存超过 AUTOSAVE_INTERVAL 秒，或修改次数达到
+ * AUTOSAVE_CHANGES 时保存；没有修改时不保存。可用命令行参数覆盖 */
+#define AUTOSAVE_INTERVAL   30
+#define AUTOSAVE_CHANGES    1000
+
+/* 复制：副本没有新的操作日志时，每隔 REPL_POLL_MS 毫秒检查一次日志文件 */
+#define REPL_POLL_MS        10
+
 /* 文件名称常量 */
 #define DB_FILENAME   "minidb.dat"   // 二进制数据库文件
 #define CSV_FILENAME  "minidb.csv"   // CSV 导出文件
+#define PAGED_FILENAME "minidb.pdb"  // 页式存储文件
+#define LOG_FILENAME  "minidb.log"   // 操作日志（复制用）
+#define ARROW_FILENAME "minidb.arrow" // Arrow 导出文件
 
 /* 调试模式开关 */
 #ifdef DEBUG
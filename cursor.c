@@ -0,0 +1,237 @@
+/*
+ * cursor.c - MiniDB 游标实现
+ * 显示顺序：沿 order 数组前进，续读时通过 ID 索引找到令牌记录的行，
+ * 再由 order 的逆 order_pos 直接取得其位置，O(1)；令牌记录在回收前
+ * 被删除也能定位，因为墓碑行仍留在 order 中；
+ * ID 顺序：沿数据库缓存的按 ID 排序结果（sort_perm）前进，缓存之后追加的行
+ * 在打开游标时单独排序并归并；续读时二分查找令牌 ID 之后的位置，
+ * 只访问存在的行，与 ID 的取值范围无关（调用者可先用 db_sort_cache 让缓存覆盖全部行）
+ */
+
+#include "cursor.h"
+#include "output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void cursor_options_init(CursorOptions *opt) {
+    opt->order = CURSOR_ORDER_LIST;
+    opt->name_like = NULL;
+    opt->flags_set = 0;
+    opt->flags_clear = 0;
+    opt->offset = 0;
+    opt->limit = 0;
+    opt->after_id = 0;
+}
+
+/* 比较函数：(ID << 32 | 行下标) 键 */
+static int compare_key(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * cursor_open_by_id - 准备 ID 顺序遍历
+ * 取缓存的按 ID 排序结果，之后追加的行组成 (ID << 32 | 行下标) 键单独排序，
+ * 再在两者中各二分查找第一个 ID 大于令牌的位置
+ * 返回值：false 表示内存不足
+ */
+static bool cursor_open_by_id(Cursor *cursor) {
+    const Database *db = cursor->db;
+    int f = SORT_BY_ID - SORT_BY_ID;  /* sort_perm 按排序字段从 SORT_BY_ID 起编号 */
+    uint32_t built = db->sort_built[f];
+    cursor->by_id = db->sort_perm[f];
+    cursor->by_id_n = built;
+    cursor->tail_n = (uint32_t)db->count - built;
+    if (cursor->tail_n > 0) {
+        cursor->tail = malloc(sizeof(uint64_t) * cursor->tail_n);
+        if (cursor->tail == NULL) {
+            return false;
+        }
+        for (uint32_t i = 0; i < cursor->tail_n; i++) {
+            uint32_t row = built + i;
+            cursor->tail[i] = (uint64_t)(uint32_t)db->rows[row].id << 32 | row;
+        }
+        qsort(cursor->tail, cursor->tail_n, sizeof(uint64_t), compare_key);
+    }
+
+    int after = cursor->opt.after_id;
+    uint32_t lo = 0, hi = cursor->by_id_n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (db->rows[cursor->by_id[mid]].id <= after) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    cursor->pos = (int)lo;
+    lo = 0;
+    hi = cursor->tail_n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if ((int)(cursor->tail[mid] >> 32) <= after) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    cursor->tail_pos = lo;
+    return true;
+}
+
+Cursor *cursor_open(const Database *db, const CursorOptions *opt) {
+    if (db == NULL) {
+        return NULL;
+    }
+
+    Cursor *cursor = malloc(sizeof(Cursor));
+    if (cursor == NULL) {
+        printf("内存分配失败！\n");
+        return NULL;
+    }
+    cursor->db = db;
+    if (opt != NULL) {
+        cursor->opt = *opt;
+    } else {
+        cursor_options_init(&cursor->opt);
+    }
+    cursor->skipped = 0;
+    cursor->returned = 0;
+    cursor->last_id = cursor->opt.after_id;
+
+    cursor->pos = 0;
+    cursor->by_id = NULL;
+    cursor->by_id_n = 0;
+    cursor->tail = NULL;
+    cursor->tail_n = 0;
+    cursor->tail_pos = 0;
+    if (cursor->opt.order == CURSOR_ORDER_ID) {
+        if (!cursor_open_by_id(cursor)) {
+            printf("内存分配失败！\n");
+            free(cursor);
+            return NULL;
+        }
+    } else if (cursor->opt.after_id > 0) {
+        /* 显示顺序续读：令牌记录必须仍然存在 */
+        uint32_t row = idmap_get(&db->ids, cursor->opt.after_id);
+        if (row == IDMAP_NONE) {
+            printf("续读令牌无效：ID 为 %d 的记录不存在！\n", cursor->opt.after_id);
+            free(cursor);
+            return NULL;
+        }
+        cursor->pos = (int)db->order_pos[row] + 1;
+    }
+    return cursor;
+}
+
+/*
+ * 记录是否满足过滤条件（墓碑行总是跳过）
+ * 游标按显示顺序或 ID 顺序前进，行已在手边，标志直接检查行内的 flags 字节；
+ * 不依赖顺序的统计使用 db_flag_select 的位图
+ */
+static bool cursor_match(const Cursor *cursor, const Record *r) {
+    const CursorOptions *opt = &cursor->opt;
+    if (db_is_dead(r) || (r->flags & opt->flags_set) != opt->flags_set || (r->flags & opt->flags_clear) != 0) {
+        return false;
+    }
+    return opt->name_like == NULL || strstr(db_name(cursor->db, r), opt->name_like) != NULL;
+}
+
+/* 取下一个满足过滤条件的记录，没有更多记录时返回 NULL */
+static const Record *cursor_step(Cursor *cursor) {
+    const Database *db = cursor->db;
+
+    if (cursor->opt.order == CURSOR_ORDER_ID) {
+        /* 归并缓存部分与追加部分，每次取 ID 较小的一行 */
+        for (;;) {
+            bool in_cache = (uint32_t)cursor->pos < cursor->by_id_n;
+            bool in_tail = cursor->tail_pos < cursor->tail_n;
+            uint32_t row;
+            if (in_cache && (!in_tail || db->rows[cursor->by_id[cursor->pos]].id <
+                                         (int)(cursor->tail[cursor->tail_pos] >> 32))) {
+                row = cursor->by_id[cursor->pos++];
+            } else if (in_tail) {
+                row = (uint32_t)cursor->tail[cursor->tail_pos++];
+            } else {
+                return NULL;
+            }
+            if (cursor_match(cursor, &db->rows[row])) {
+                return &db->rows[row];
+            }
+        }
+    }
+
+    while (cursor->pos < db->count) {
+        const Record *r = &db->rows[db->order[cursor->pos++]];
+        if (cursor_match(cursor, r)) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+int cursor_next(Cursor *cursor, const Record **out, int max) {
+    int n = 0;
+    while (n < max) {
+        if (cursor->opt.limit > 0 && cursor->returned >= cursor->opt.limit) {
+            break;
+        }
+        const Record *r = cursor_step(cursor);
+        if (r == NULL) {
+            break;
+        }
+        if (cursor->skipped < cursor->opt.offset) {
+            cursor->skipped++;
+            continue;
+        }
+        out[n++] = r;
+        cursor->returned++;
+        cursor->last_id = r->id;
+    }
+    return n;
+}
+
+int cursor_token(const Cursor *cursor) {
+    return cursor->last_id;
+}
+
+void cursor_close(Cursor *cursor) {
+    if (cursor != NULL) {
+        free(cursor->tail);
+    }
+    free(cursor);
+}
+
+/*
+ * cursor_print_page - 按游标选项输出一页记录
+ * 输出后提示续读令牌，下一页可用该令牌继续
+ */
+int cursor_print_page(const Database *db, const CursorOptions *opt) {
+    Cursor *cursor = cursor_open(db, opt);
+    if (cursor == NULL) {
+        return 0;
+    }
+
+    OutBuf ob;
+    out_init(&ob, stdout);
+    const Record *batch[CURSOR_BATCH];
+    int total = 0;
+    int n;
+    while ((n = cursor_next(cursor, batch, CURSOR_BATCH)) > 0) {
+        for (int i = 0; i < n; i++) {
+            out_record(&ob, db, batch[i]);
+        }
+        total += n;
+    }
+    out_flush(&ob);
+
+    if (total == 0) {
+        printf("本页没有记录。\n");
+    } else {
+        printf("本页共 %d 条记录，续读令牌：%d\n", total, cursor_token(cursor));
+    }
+    cursor_close(cursor);
+    return total;
+}
@@ -0,0 +1,63 @@
+/*
+ * cursor.h - MiniDB 游标头文件
+ * 以批为单位遍历记录，支持 LIMIT/OFFSET 和可续读的令牌；
+ * 列表、搜索和导出都基于游标实现
+ */
+
+#ifndef CURSOR_H
+#define CURSOR_H
+
+#include "db.h"
+
+#define CURSOR_BATCH 256  // 内部遍历时每批取出的记录数
+
+/*
+ * 游标遍历顺序
+ */
+typedef enum CursorOrder {
+    CURSOR_ORDER_LIST = 1,  // 当前显示顺序（受排序影响）
+    CURSOR_ORDER_ID         // ID 升序
+} CursorOrder;
+
+/*
+ * 游标选项
+ * after_id 为续读令牌：上一批最后一条记录的 ID，
+ * 从该记录之后继续，不需要重新遍历前面的记录
+ */
+typedef struct CursorOptions {
+    CursorOrder order;      // 遍历顺序
+    const char *name_like;  // 姓名子串过滤，NULL 表示不过滤
+    uint8_t flags_set;      // 必须全部开启的标志位，0 表示不过滤
+    uint8_t flags_clear;    // 必须全部关闭的标志位，0 表示不过滤
+    int offset;             // 跳过前 offset 条匹配记录
+    int limit;              // 最多返回的记录数，0 表示不限
+    int after_id;           // 续读令牌，0 表示从头开始
+} CursorOptions;
+
+/*
+ * 游标
+ * 打开期间不能修改数据库；跨越修改操作继续遍历时请使用续读令牌
+ */
+typedef struct Cursor {
+    const Database *db;
+    CursorOptions opt;
+    int pos;                // 显示顺序：下一个待检查的位置（order 下标）；ID 顺序：by_id 中的位置
+    const uint32_t *by_id;  // ID 顺序：数据库缓存的按 ID 排序结果（前 by_id_n 行）
+    uint32_t by_id_n;
+    uint64_t *tail;         // ID 顺序：缓存之后追加的行，(ID << 32 | 行下标) 升序
+    uint32_t tail_n;
+    uint32_t tail_pos;      // tail 中下一个待检查的位置
+    int skipped;            // 已跳过的匹配记录数（用于 offset）
+    int returned;           // 已返回的记录数（用于 limit）
+    int last_id;            // 最近返回记录的 ID（即续读令牌）
+} Cursor;
+
+void cursor_options_init(CursorOptions *opt);                        // 默认选项：显示顺序、无过滤、不限条数
+Cursor *cursor_open(const Database *db, const CursorOptions *opt);   // 打开游标，令牌无效时返回 NULL
+int cursor_next(Cursor *cursor, const Record **out, int max);        // 取下一批（最多 max 条），返回条数，0 表示结束
+int cursor_token(const Cursor *cursor);                              // 当前续读令牌
+void cursor_close(Cursor *cursor);                                   // 关闭游标
+
+int cursor_print_page(const Database *db, const CursorOptions *opt); // 输出一页记录并提示续读令牌，返回条数
+
+#endif /* CURSOR_H */
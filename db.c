@@ -7,7 +7,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <time.h>
 #include "utils.h"
+#include "output.h"
+#include "cursor.h"
+#include "query.h"
+#include "fuzzy.h"
+#include "prefix.h"
+#include "namesort.h"
+#include "io.h"
+#include "repl.h"
+
+#define DELETED_INDEX 3  // FLAG_DELETED 在 flag_index 中的下标
 
 Database *db_create(void){
     Database *db;
@@ -16,94 +28,548 @@ Database *db_create(void){
         printf("内存分配失败！\n");
         return NULL;
     }
-    // 创建头节点（不存储实际数据）
-    db->head = malloc(sizeof(Record));
-    if (db->head == NULL) {
+    // 行存储按需扩容，初始为空
+    db->rows = NULL;
+    db->names = NULL;
+    db->order = NULL;
+    db->order_pos = NULL;
+    db->count = 0;
+    db->dead = 0;
+    db->capacity = 0;
+    db->next_id = 1;
+    if (!idmap_init(&db->ids)) {
         printf("内存分配失败！\n");
         free(db);
         return NULL;
     }
-    db->head->next = NULL;
-    // 头节点的数据字段可初始化为默认值（可选）
-    db->head->id = 0;
-    db->head->name[0] = '\0';
-    db->head->age = 0;
-    db->head->score = 0.0;
-    db->head->flags = 0;  // 初始化标志位为 0
-    db->count = 0;
-    db->next_id = 1;
+    if (!strheap_init(&db->name_heap)) {
+        printf("内存分配失败！\n");
+        idmap_free(&db->ids);
+        free(db);
+        return NULL;
+    }
+    for (int i = 0; i < FLAG_COUNT; i++) {
+        bitmap_init(&db->flag_index[i]);
+    }
+    kll_init(&db->score_sketch);
+    memset(db->age_hist, 0, sizeof(db->age_hist));
+    db->row_version = 1;
+    db->qcache = NULL;
+    db->fuzzy = NULL;
+    db->prefix = NULL;
+    for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+        db->sort_perm[f] = NULL;
+        db->sort_built[f] = 0;
+    }
+    db->dirty = NULL;
+    db->changes = 0;
+    db->snap = NULL;
+    db->log = NULL;
+    db->lsn = 0;
     return db;
 }
 
 void db_destroy(Database *db)
 {
-    Record *p = db->head;
-    Record *q;
-    while(p!=NULL){
-        q=p;
-        p=p->next;
-        free(q);
-    }
-    db->head = NULL;  /* 防止悬空指针 */
+    free(db->rows);
+    free(db->names);
+    free(db->order);
+    free(db->order_pos);
+    db->rows = NULL;  /* 防止悬空指针 */
+    db->names = NULL;
+    db->order = NULL;
+    db->order_pos = NULL;
+    idmap_free(&db->ids);
+    strheap_free(&db->name_heap);
+    for (int i = 0; i < FLAG_COUNT; i++) {
+        bitmap_free(&db->flag_index[i]);
+    }
+    kll_free(&db->score_sketch);
+    query_cache_free(db->qcache);
+    fuzzy_index_free(db->fuzzy);
+    prefix_index_free(db->prefix);
+    for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+        free(db->sort_perm[f]);
+    }
+    free(db->dirty);
+    io_snap_free(db->snap);
     free(db);
 }
 
-void db_add(Database *db)
+/*
+ * db_clear - 删除所有记录，保留已分配的容量与 next_id
+ */
+void db_clear(Database *db)
 {
-    Record *new_record = malloc(sizeof(Record));
-    if (new_record == NULL) {
-        printf("内存分配失败！\n");
-        return;
+    db->count = 0;
+    db->dead = 0;
+    idmap_clear(&db->ids);
+    strheap_clear(&db->name_heap);
+    for (int i = 0; i < FLAG_COUNT; i++) {
+        bitmap_clear(&db->flag_index[i]);
     }
+    kll_clear(&db->score_sketch);
+    memset(db->age_hist, 0, sizeof(db->age_hist));
+    db->row_version++;
+    for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+        db->sort_built[f] = 0;  /* 保留已分配的内存 */
+    }
+    prefix_index_free(db->prefix);  /* 重新加载时不逐行维护，下次查找时整体重建 */
+    db->prefix = NULL;
+    db->changes++;
+    io_snap_free(db->snap);  /* 行全部替换，快照文件中的块不再对应 */
+    db->snap = NULL;
+    if (db->log != NULL) {
+        repl_log_reset(db);
+    }
+}
 
-    new_record->id = db->next_id;
+/* 块数：容纳 rows 行需要的脏块计数个数 */
+static size_t db_block_count(int rows)
+{
+    return ((size_t)rows + DB_BLOCK_ROWS - 1) >> DB_BLOCK_SHIFT;
+}
 
-    // 输入并验证姓名
-    while (1) {
-        printf("请输入学生姓名：\n");
-        scanf("%63s", new_record->name); // 注意：假设输入不包含空格
-        if (validate_name(new_record->name)) {
-            break; // 姓名有效
+/* 显示顺序整体改变后（排序、回收）重建其逆 order_pos */
+static void db_index_order(Database *db)
+{
+    for (int i = 0; i < db->count; i++) {
+        db->order_pos[db->order[i]] = (uint32_t)i;
+    }
+}
+
+/* 记录第 row 行被修改（新增、删除、改标志） */
+static void db_touch(Database *db, uint32_t row)
+{
+    db->dirty[row >> DB_BLOCK_SHIFT]++;
+    db->changes++;
+}
+
+/*
+ * db_reserve - 确保行存储至少能容纳 need 行
+ * 三个数组一起按两倍扩容，脏块计数随之扩充（新块清零）
+ */
+static bool db_reserve(Database *db, int need)
+{
+    if (need <= db->capacity) {
+        return true;
+    }
+    int cap = db->capacity > 0 ? db->capacity : 64;
+    while (cap < need) {
+        cap *= 2;
+    }
+    Record *rows = realloc(db->rows, sizeof(Record) * cap);
+    if (rows == NULL) {
+        return false;
+    }
+    db->rows = rows;
+    NameRef *names = realloc(db->names, sizeof(NameRef) * cap);
+    if (names == NULL) {
+        return false;
+    }
+    db->names = names;
+    uint32_t *order = realloc(db->order, sizeof(uint32_t) * cap);
+    if (order == NULL) {
+        return false;
+    }
+    db->order = order;
+    uint32_t *order_pos = realloc(db->order_pos, sizeof(uint32_t) * cap);
+    if (order_pos == NULL) {
+        return false;
+    }
+    db->order_pos = order_pos;
+    uint32_t *dirty = realloc(db->dirty, sizeof(uint32_t) * db_block_count(cap));
+    if (dirty == NULL) {
+        return false;
+    }
+    size_t old_blocks = db_block_count(db->capacity);
+    memset(dirty + old_blocks, 0, sizeof(uint32_t) * (db_block_count(cap) - old_blocks));
+    db->dirty = dirty;
+    db->capacity = cap;
+    return true;
+}
+
+/*
+ * db_mark_clean - 数据库已与快照文件一致：清零修改计数和各块的脏块计数
+ */
+void db_mark_clean(Database *db)
+{
+    if (db->dirty != NULL) {
+        memset(db->dirty, 0, sizeof(uint32_t) * db_block_count(db->capacity));
+    }
+    db->changes = 0;
+}
+
+/*
+ * db_touch_all - 行下标整体改变（回收墓碑）或保存失败时，把所有行所在的块记为已修改
+ */
+void db_touch_all(Database *db)
+{
+    size_t blocks = db_block_count(db->count);
+    for (size_t b = 0; b < blocks; b++) {
+        db->dirty[b]++;
+    }
+    db->changes++;
+}
+
+/*
+ * db_dirty_blocks - 自上次保存以来有修改的块数
+ */
+uint32_t db_dirty_blocks(const Database *db)
+{
+    uint32_t n = 0;
+    size_t blocks = db_block_count(db->count);
+    for (size_t b = 0; b < blocks; b++) {
+        n += db->dirty[b] != 0;
+    }
+    return n;
+}
+
+/* 把行下标从 flags 中每个开启位的位图里移除 */
+static void db_unindex_flags(Database *db, uint32_t row, uint8_t flags)
+{
+    for (int i = 0; i < FLAG_COUNT; i++) {
+        if (flags & (1 << i)) {
+            bitmap_remove(&db->flag_index[i], row);
         }
-        printf("请重新输入。\n");
     }
+}
 
-    // 输入并验证年龄
-    while (1) {
-        printf("请输入学生年龄：\n");
-        scanf("%d", &new_record->age);
-        if (validate_age(new_record->age)) {
-            break; // 年龄有效
+/*
+ * db_index_flags - 把行下标加入 flags 中每个开启位的位图
+ * 返回值：false 表示内存不足（已加入的位会被撤销）
+ */
+static bool db_index_flags(Database *db, uint32_t row, uint8_t flags)
+{
+    for (int i = 0; i < FLAG_COUNT; i++) {
+        if ((flags & (1 << i)) && !bitmap_add(&db->flag_index[i], row)) {
+            db_unindex_flags(db, row, flags & ((1 << i) - 1));
+            return false;
         }
-        printf("请重新输入。\n");
     }
+    return true;
+}
+
+/*
+ * db_apply_flags - 把第 row 行的标志改为 flags
+ * 同步标志位图，软删除标志改变时同步墓碑计数和年龄直方图，并记入脏块和操作日志
+ * 返回值：false 表示内存不足（标志保持不变）
+ */
+static bool db_apply_flags(Database *db, uint32_t row, uint8_t flags)
+{
+    Record *p = &db->rows[row];
+    uint8_t changed = p->flags ^ flags;
+    if (!db_index_flags(db, row, changed & flags)) {
+        return false;
+    }
+    db_unindex_flags(db, row, changed & p->flags);
+    if (changed & FLAG_DELETED) {
+        bool dead = (flags & FLAG_DELETED) != 0;
+        db->dead += dead ? 1 : -1;
+        db->age_hist[p->age] += dead ? -1 : 1;
+        prefix_index_set_dead(db, row, dead);
+    }
+    p->flags = flags;
+    db_touch(db, row);
+    if (db->log != NULL) {
+        repl_log_flags(db, p->id, flags);
+    }
+    return true;
+}
 
-    // 输入并验证成绩
-    while (1) {
-        printf("请输入学生成绩：\n");
-        scanf("%lf", &new_record->score);
-        if (validate_score(new_record->score)) {
-            break; // 成绩有效
+/*
+ * db_insert_record - 追加一条记录
+ * 热数据复制到行存储末尾，姓名驻留到字符串堆，
+ * 并同步更新 ID 索引、标志位图和显示顺序
+ * 返回值：false 表示内存不足，记录未插入
+ */
+bool db_insert_record(Database *db, const Record *record, const char *name)
+{
+    if (!db_reserve(db, db->count + 1)) {
+        return false;
+    }
+    uint32_t row = (uint32_t)db->count;
+    if (!strheap_intern(&db->name_heap, name, strlen(name), &db->names[row]) ||
+        !idmap_put(&db->ids, record->id, row)) {
+        return false;
+    }
+    if (!db_index_flags(db, row, record->flags)) {
+        idmap_remove(&db->ids, record->id);
+        return false;
+    }
+    db->rows[row] = *record;
+    db->rows[row].reserved = 0;
+    db->order[row] = row;  /* 新记录排在当前顺序的末尾 */
+    db->order_pos[row] = row;
+    db->count++;
+    db_touch(db, row);
+    if (db->log != NULL) {
+        repl_log_insert(db, row);
+    }
+    if (db_is_dead(record)) {
+        db->dead++;
+    } else {
+        db->age_hist[record->age]++;
+    }
+    prefix_index_add(db, row);
+    /* 草图只用于近似统计，内存不足时少计一个值即可，不影响插入 */
+    kll_update(&db->score_sketch, record->score);
+    return true;
+}
+
+/*
+ * db_append_batch - 批量追加已解码的记录（并行加载的汇合步骤）
+ * names[i] 指向快照编码中的姓名长度字节，其后紧跟姓名（不含 '\0'）；
+ * sketch 非 NULL 时为调用者在各线程中为这批记录建立的成绩草图，直接合并，
+ * 否则逐条更新草图；ids 非 NULL 时为调用者已按 rows 建好的 ID 索引（行下标从 0 开始），
+ * 只能用于空数据库，直接接管（*ids 置空），否则逐条插入。
+ * 行存储与 ID 索引一次预留到位，不再逐次扩容
+ * 返回值：false 表示内存不足（已追加的记录保留）
+ */
+bool db_append_batch(Database *db, const Record *rows, const unsigned char *const *names,
+                     uint32_t n, const KllSketch *sketch, IdMap *ids)
+{
+    if (ids != NULL && db->count != 0) {
+        return false;
+    }
+    if (!db_reserve(db, db->count + (int)n)) {
+        return false;
+    }
+    if (ids != NULL) {
+        idmap_free(&db->ids);
+        db->ids = *ids;
+        memset(ids, 0, sizeof(*ids));
+    } else if (!idmap_reserve(&db->ids, db->ids.size + n)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t row = (uint32_t)db->count;
+        const Record *record = &rows[i];
+        if (!strheap_intern(&db->name_heap, (const char *)names[i] + 1, names[i][0], &db->names[row]) ||
+            (ids == NULL && !idmap_put(&db->ids, record->id, row)) ||
+            !db_index_flags(db, row, record->flags)) {
+            return false;
+        }
+        db->rows[row] = *record;
+        db->rows[row].reserved = 0;
+        db->order[row] = row;
+        db->order_pos[row] = row;
+        db->count++;
+        db_touch(db, row);
+        if (db->log != NULL) {
+            repl_log_insert(db, row);
+        }
+        if (db_is_dead(record)) {
+            db->dead++;
+        } else {
+            db->age_hist[record->age]++;
+        }
+        prefix_index_add(db, row);
+        if (sketch == NULL) {
+            kll_update(&db->score_sketch, record->score);
+        }
+    }
+    if (sketch != NULL) {
+        kll_merge(&db->score_sketch, sketch);
+    }
+    return true;
+}
+
+/*
+ * db_update_record - 按 ID 改写记录的姓名、年龄和成绩（标志不变，已删除的行也能改写）
+ * 同步年龄直方图；成绩草图只增加新值（旧值留到回收时随草图重建去掉）；
+ * 行内容变了，各字段的排序缓存和查询索引整体失效
+ * 返回值：false 表示未找到或内存不足（记录保持不变）
+ */
+bool db_update_record(Database *db, int id, const char *name, uint8_t age, double score)
+{
+    uint32_t row = idmap_get(&db->ids, id);
+    NameRef ref;
+    if (row == IDMAP_NONE || !strheap_intern(&db->name_heap, name, strlen(name), &ref)) {
+        return false;
+    }
+    Record *p = &db->rows[row];
+    if (!db_is_dead(p)) {
+        db->age_hist[p->age]--;
+        db->age_hist[age]++;
+    }
+    if (score != p->score) {
+        kll_update(&db->score_sketch, score);
+    }
+    NameRef old_name = db->names[row];
+    p->age = age;
+    p->score = score;
+    db->names[row] = ref;
+    if (ref.off != old_name.off) {
+        prefix_index_rename(db, row, old_name);
+    }
+    for (int f = SORT_BY_NAME - SORT_BY_ID; f < SORT_FIELD_COUNT; f++) {
+        db->sort_built[f] = 0;  /* ID 不变，按 ID 的排序缓存仍然有效 */
+    }
+    db->row_version++;
+    db_touch(db, row);
+    if (db->log != NULL) {
+        repl_log_update(db, row);
+    }
+    return true;
+}
+
+/*
+ * db_lookup - 通过 ID 索引查找记录，O(1)
+ * 已打墓碑的记录视为不存在
+ */
+Record *db_lookup(const Database *db, int id)
+{
+    uint32_t row = idmap_get(&db->ids, id);
+    if (row == IDMAP_NONE || db_is_dead(&db->rows[row])) {
+        return NULL;
+    }
+    return &db->rows[row];
+}
+
+/*
+ * db_vacuum - 回收墓碑行
+ * 一次顺序扫描压缩行存储和显示顺序（保持相对顺序不变），
+ * 然后批量重建 ID 索引、标志位图和姓名字符串堆
+ * 返回值：false 表示内存不足，数据库保持原样
+ */
+bool db_vacuum(Database *db)
+{
+    if (db->dead == 0) {
+        return true;
+    }
+
+    uint32_t *remap = malloc(sizeof(uint32_t) * db->count);
+    NameRef *names = malloc(sizeof(NameRef) * (db->count - db->dead + 1));
+    StrHeap heap;
+    if (remap == NULL || names == NULL || !strheap_init(&heap)) {
+        free(remap);
+        free(names);
+        return false;
+    }
+
+    /* 先把存活记录的姓名驻留到新堆，失败时不触动原数据 */
+    uint32_t live = 0;
+    for (int i = 0; i < db->count; i++) {
+        if (db_is_dead(&db->rows[i])) {
+            continue;
+        }
+        const char *name = strheap_str(&db->name_heap, db->names[i]);
+        if (!strheap_intern(&heap, name, db->names[i].len, &names[live])) {
+            free(remap);
+            free(names);
+            strheap_free(&heap);
+            return false;
+        }
+        live++;
+    }
+
+    /* 压缩行存储，记录旧行下标到新行下标的映射 */
+    live = 0;
+    for (int i = 0; i < db->count; i++) {
+        if (db_is_dead(&db->rows[i])) {
+            remap[i] = IDMAP_NONE;
+            continue;
+        }
+        db->rows[live] = db->rows[i];
+        remap[i] = live++;
+    }
+    memcpy(db->names, names, sizeof(NameRef) * live);
+    free(names);
+    strheap_free(&db->name_heap);
+    db->name_heap = heap;
+
+    /* 压缩显示顺序和缓存的排序结果（删去墓碑行，相对顺序不变，不必重新排序） */
+    int j = 0;
+    for (int i = 0; i < db->count; i++) {
+        uint32_t r = remap[db->order[i]];
+        if (r != IDMAP_NONE) {
+            db->order[j++] = r;
+        }
+    }
+    for (int f = 0; f < SORT_FIELD_COUNT; f++) {
+        uint32_t *perm = db->sort_perm[f];
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < db->sort_built[f]; i++) {
+            uint32_t r = remap[perm[i]];
+            if (r != IDMAP_NONE) {
+                perm[kept++] = r;
+            }
         }
-        printf("请重新输入。\n");
+        db->sort_built[f] = kept;
+    }
+    free(remap);
+    db->count = (int)live;
+    db->dead = 0;
+    db_index_order(db);
+    db->row_version++;  /* 行下标已改变，查询索引失效 */
+    prefix_index_free(db->prefix);
+    db->prefix = NULL;
+    db_touch_all(db);
+
+    /* 批量重建 ID 索引、标志位图（按行下标升序追加）和成绩草图 */
+    bool ok = true;
+    idmap_clear(&db->ids);
+    for (int i = 0; i < FLAG_COUNT; i++) {
+        bitmap_clear(&db->flag_index[i]);
+    }
+    kll_clear(&db->score_sketch);
+    for (uint32_t row = 0; row < live; row++) {
+        ok = idmap_put(&db->ids, db->rows[row].id, row) &&
+             db_index_flags(db, row, db->rows[row].flags) && ok;
+        kll_update(&db->score_sketch, db->rows[row].score);
+    }
+    if (!ok) {
+        printf("内存分配失败！索引可能不完整。\n");
+    }
+    DEBUG_PRINT("回收墓碑行完成，剩余 %d 行", db->count);
+    return ok;
+}
+
+/*
+ * db_maybe_vacuum - 墓碑比例超过阈值时回收
+ * 每次回收至少清理 count * VACUUM_DEAD_PERCENT% 行，摊还到每次删除为 O(1)
+ */
+static void db_maybe_vacuum(Database *db)
+{
+    if (db->dead >= VACUUM_MIN_DEAD &&
+        (long long)db->dead * 100 > (long long)db->count * VACUUM_DEAD_PERCENT) {
+        db_vacuum(db);
+    }
+}
+
+/*
+ * db_add - 追加一条新记录，分配下一个 ID
+ * 姓名、年龄和成绩由调用者读入并验证（读入时不持有数据库锁）
+ */
+void db_add(Database *db, const char *name, uint8_t age, double score)
+{
+    if (db->next_id == INT_MAX) {
+        printf("错误：ID 已用尽，无法添加记录！\n");
+        return;
     }
+    Record new_record;
+    new_record.id = db->next_id;
+    new_record.age = age;
+    new_record.score = score;
 
     // 初始化标志位
-    new_record->flags = 0;
+    new_record.flags = 0;
 
-    // 头插法：新节点插入到头节点之后
-    new_record->next = db->head->next;
-    db->head->next = new_record;
+    // 追加到行存储末尾
+    if (!db_insert_record(db, &new_record, name)) {
+        printf("内存分配失败！\n");
+        return;
+    }
 
-    db->count++;
     db->next_id++;  // 为下一条记录准备 ID
 
-    printf("记录完成！学生 ID：%d\n", new_record->id);
+    printf("记录完成！学生 ID：%d\n", new_record.id);
 }
 
 void db_delete(Database *db,int id){
-    // 检查空链表
-    if (db->head == NULL || db->head->next == NULL) {
+    // 检查空表
+    if (db_live_count(db) == 0) {
         printf("删除失败：数据库为空！\n");
         return;
     }
@@ -113,220 +579,268 @@ void db_delete(Database *db,int id){
         return;
     }
 
-    Record *prev = db->head;      // 前驱节点，初始为头节点
-    Record *curr = db->head->next; // 当前节点，从第一个数据节点开始
-
-    // 遍历查找匹配的节点
-    while (curr != NULL && curr->id != id) {
-        prev = curr;
-        curr = curr->next;
-    }
-
-    // 未找到匹配节点
-    if (curr == NULL) {
+    // 通过 ID 索引定位行
+    uint32_t row = idmap_get(&db->ids, id);
+    if (row == IDMAP_NONE || db_is_dead(&db->rows[row])) {
         printf("删除失败：未找到 ID 为%d的记录！\n", id);
         return;
     }
 
-    // 找到匹配节点，执行删除
-    prev->next = curr->next;
-    free(curr);
-    db->count--;
+    // 只打墓碑，O(1)；行存储和索引留给 db_vacuum 批量回收
+    if (!db_apply_flags(db, row, db->rows[row].flags | FLAG_DELETED)) {
+        printf("内存分配失败！\n");
+        return;
+    }
 
     printf("删除成功！已删除 ID 为%d的记录。\n", id);
+    db_maybe_vacuum(db);
 }
 
 void db_list_all(const Database *db){
-    // 检查空链表：头节点的 next 为 NULL 表示没有数据节点
-    if (db->head == NULL || db->head->next == NULL) {
+    // 检查空表
+    if (db_live_count(db) == 0) {
         printf("暂无学生记录。\n");
         return;
     }
 
-    printf("=== 所有学生记录 ===\n");
-    Record *p = db->head->next;
-    while(p != NULL){
-        print_record(p);
-        p = p->next;
+    OutBuf ob;
+    out_init(&ob, stdout);
+    if (out_get_mode() == OUTPUT_PRETTY) {
+        out_puts(&ob, "=== 所有学生记录 ===\n");
+    }
+    Cursor *cursor = cursor_open(db, NULL);
+    if (cursor != NULL) {
+        const Record *batch[CURSOR_BATCH];
+        int n;
+        while ((n = cursor_next(cursor, batch, CURSOR_BATCH)) > 0) {
+            for (int i = 0; i < n; i++) {
+                out_record(&ob, db, batch[i]);
+            }
+        }
+        cursor_close(cursor);
     }
+    out_flush(&ob);
 }
 
-void db_find_by_id(const Database *db){
-    // 检查空链表：头节点的 next 为 NULL 表示没有数据节点
-    if (db->head == NULL || db->head->next == NULL) {
+void db_find_by_id(Database *db, int target_id){
+    // 检查空表
+    if (db_live_count(db) == 0) {
         printf("暂无学生记录。\n");
         return;
     }
 
-    int target_id;
-    printf("请输入你要查找的学生 ID：\n");
-    scanf("%d", &target_id);
-
     // 基本验证：ID 必须为正数
     if (!validate_id_range(target_id)) {
         return;
     }
 
-    // 遍历链表查找匹配的 ID（从头节点之后开始）
-    Record *p = db->head->next;
-    while(p != NULL){
-        if(p->id == target_id){
+    // 经查询层规划，必然选中 ID 索引直接定位
+    Query q;
+    query_init(&q);
+    q.id = target_id;
+    QueryResult result;
+    if (!query_run(db, &q, &result)) {
+        return;
+    }
+    if (result.n > 0) {
+        if (out_get_mode() == OUTPUT_PRETTY) {
             printf("=== 学生信息 ===\n");
-            print_record(p);
-            return;
         }
-        p = p->next;
+        print_record(db, &db->rows[result.rows[0]]);
+    } else {
+        printf("学生不存在！\n");
     }
-    printf("学生不存在！\n");
+    query_result_free(&result);
 }
 
-void db_find_by_name(const Database *db)
+/*
+ * db_find_by_name - 按姓名子串查找
+ * 经查询层规划：姓名 n-gram 索引（第一次查找时建立）或全表扫描，
+ * 结果按 ID 升序输出
+ */
+void db_find_by_name(Database *db, const char *keyword)
 {
-    // 检查空链表：头节点的 next 为 NULL 表示没有数据节点
-    if (db->head == NULL || db->head->next == NULL) {
+    // 检查空表
+    if (db_live_count(db) == 0) {
         printf("暂无学生记录。\n");
         return;
     }
 
-    printf("请输入要查找的姓名或部分姓名：\n");
-    char keyword[MAX_NAME_LEN+1];
-    scanf("%s", keyword);  // 读取搜索关键字
-
-    int found = 0;
+    Query q;
+    query_init(&q);
+    q.name_like = keyword;
+    QueryResult result;
+    if (!query_run(db, &q, &result)) {
+        return;
+    }
 
-    Record *p = db->head->next;
-    while(p != NULL){
-        if(strstr(p->name, keyword) != NULL){
-            if(found == 0){
-                printf("=== 找到以下匹配的学生 ===\n");
-            }
-            print_record(p);
-            found = 1;
-        }
-        p = p->next;
+    OutBuf ob;
+    out_init(&ob, stdout);
+    if (result.n > 0 && out_get_mode() == OUTPUT_PRETTY) {
+        out_puts(&ob, "=== 找到以下匹配的学生 ===\n");
+    }
+    for (size_t i = 0; i < result.n; i++) {
+        out_record(&ob, db, &db->rows[result.rows[i]]);
     }
-    if(found == 0){
+    out_flush(&ob);
+    if (result.n == 0) {
         printf("未找到包含\"%s\"的学生记录。\n", keyword);
     }
+    query_result_free(&result);
 }
 
 /*
  * print_record - 打印单个学生记录
  */
-void print_record(const Record *record) {
-    printf("-----------------\n");
-    printf("学生 ID：%d\n", record->id);
-    printf("姓名：%s\n", record->name);
-    printf("年龄：%d 岁\n", record->age);
-    printf("成绩：%.2f 分\n", record->score);
+void print_record(const Database *db, const Record *record) {
+    OutBuf ob;
+    out_init(&ob, stdout);
+    out_record(&ob, db, record);
+    out_flush(&ob);
 }
 
 /*
  * print_record_verbose - 打印单个学生记录（含状态标志）
  */
-void print_record_verbose(const Record *record) {
-    printf("-----------------\n");
-    printf("学生 ID：%d\n", record->id);
-    printf("姓名：%s\n", record->name);
-    printf("年龄：%d 岁\n", record->age);
-    printf("成绩：%.2f 分\n", record->score);
-    printf("状态：");
-    if (record->flags == 0) {
-        printf("正常");
-    } else {
-        int first = 1;
-        if (record->flags & FLAG_READONLY) {
-            if (!first) printf(", ");
-            printf("只读");
-            first = 0;
-        }
-        if (record->flags & FLAG_ARCHIVED) {
-            if (!first) printf(", ");
-            printf("已归档");
-            first = 0;
-        }
-        if (record->flags & FLAG_VIP) {
-            if (!first) printf(", ");
-            printf("VIP");
-            first = 0;
-        }
-        if (record->flags & FLAG_DELETED) {
-            if (!first) printf(", ");
-            printf("软删除");
-            first = 0;
-        }
-    }
-    printf("\n");
+void print_record_verbose(const Database *db, const Record *record) {
+    OutBuf ob;
+    out_init(&ob, stdout);
+    out_record_verbose(&ob, db, record);
+    out_flush(&ob);
 }
 
 /*
  * ==================== 排序功能实现 ====================
- * 使用 qsort 对链表进行排序
- * 策略：链表 -> 数组 -> qsort -> 重建链表
+ * 对显示顺序（行下标数组）排序，行存储本身不移动；
+ * 每个字段的排序结果缓存在 sort_perm 中，再次按同一字段排序时直接复制，
+ * 之后追加的行单独排序后归并进缓存，回收时随行下标一起压缩；
+ * 按姓名排序用预先组好的姓名前缀键做基数排序（见 namesort.h），其余字段用 qsort
  */
 
+/* 排序时使用的数据库（qsort 比较函数无法传递额外参数） */
+static const Database *sort_db = NULL;
+
 /* 比较函数：按 ID 排序 */
 static int compare_by_id(const void *a, const void *b) {
-    const Record *ra = *(const Record **)a;
-    const Record *rb = *(const Record **)b;
-    return ra->id - rb->id;
+    const Record *ra = &sort_db->rows[*(const uint32_t *)a];
+    const Record *rb = &sort_db->rows[*(const uint32_t *)b];
+    return (ra->id > rb->id) - (ra->id < rb->id);
 }
 
-/* 比较函数：按姓名排序（字典序） */
+/* 比较函数：按姓名排序（字典序），相同时按 ID */
 static int compare_by_name(const void *a, const void *b) {
-    const Record *ra = *(const Record **)a;
-    const Record *rb = *(const Record **)b;
-    return strcmp(ra->name, rb->name);
+    const Record *ra = &sort_db->rows[*(const uint32_t *)a];
+    const Record *rb = &sort_db->rows[*(const uint32_t *)b];
+    int c = strcmp(db_name(sort_db, ra), db_name(sort_db, rb));
+    return c != 0 ? c : compare_by_id(a, b);
 }
 
-/* 比较函数：按年龄排序 */
+/* 比较函数：按年龄排序，相同时按 ID */
 static int compare_by_age(const void *a, const void *b) {
-    const Record *ra = *(const Record **)a;
-    const Record *rb = *(const Record **)b;
-    return ra->age - rb->age;
+    const Record *ra = &sort_db->rows[*(const uint32_t *)a];
+    const Record *rb = &sort_db->rows[*(const uint32_t *)b];
+    int c = ra->age - rb->age;
+    return c != 0 ? c : compare_by_id(a, b);
 }
 
-/* 比较函数：按成绩排序 */
+/* 比较函数：按成绩排序，相同时按 ID */
 static int compare_by_score(const void *a, const void *b) {
-    const Record *ra = *(const Record **)a;
-    const Record *rb = *(const Record **)b;
+    const Record *ra = &sort_db->rows[*(const uint32_t *)a];
+    const Record *rb = &sort_db->rows[*(const uint32_t *)b];
     if (ra->score < rb->score) return -1;
     if (ra->score > rb->score) return 1;
-    return 0;
+    return compare_by_id(a, b);
+}
+
+/* 按姓名排序行下标，姓名相同时按 ID（与 compare_by_name 的顺序一致） */
+static bool sort_rows_by_name(const Database *db, uint32_t *rows, uint32_t n) {
+    return name_sort(db->name_heap.data, &db->names[0].off, sizeof(NameRef),
+                     &db->rows[0].id, sizeof(Record), rows, n);
 }
 
 /*
- * db_sort - 按指定字段排序数据库记录
- * 参数：db - 数据库指针
- *       field - 排序字段（SORT_BY_ID / SORT_BY_NAME / SORT_BY_AGE / SORT_BY_SCORE）
+ * sort_perm_update - 让字段的排序缓存覆盖全部行
+ * 缓存之后追加的 k 行先单独排序（sort_rows 为 NULL 时用 qsort），再与缓存从后往前归并：
+ * k 远小于缓存行数时每行二分定位插入位置、中间成段后移（O(k log n) 次比较），
+ * 否则逐个比较（O(n)）；比较时 ID 决定相同键的先后，结果与整体重新排序完全一致
+ * 返回值：false 表示内存不足，缓存保持原样
  */
-void db_sort(Database *db, int field) {
-    if (db == NULL || db->head->next == NULL) {
-        printf("数据库为空，无需排序！\n");
-        return;
+static bool sort_perm_update(Database *db, int f, int (*compare)(const void *, const void *),
+                             bool (*sort_rows)(const Database *, uint32_t *, uint32_t)) {
+    uint32_t n = (uint32_t)db->count;
+    uint32_t built = db->sort_built[f];
+    if (db->sort_perm[f] != NULL && built == n) {
+        return true;
+    }
+    uint32_t *perm = realloc(db->sort_perm[f], sizeof(uint32_t) * n);
+    if (perm == NULL) {
+        return false;
     }
+    db->sort_perm[f] = perm;
 
-    /* 将链表转为指针数组 */
-    Record **records = malloc(sizeof(Record *) * db->count);
-    if (records == NULL) {
-        printf("错误：内存不足！\n");
-        return;
+    uint32_t k = n - built;
+    uint32_t *tail = malloc(sizeof(uint32_t) * k);
+    if (tail == NULL) {
+        return false;
+    }
+    for (uint32_t i = 0; i < k; i++) {
+        tail[i] = built + i;
+    }
+    sort_db = db;
+    if (sort_rows == NULL) {
+        qsort(tail, k, sizeof(uint32_t), compare);
+    } else if (!sort_rows(db, tail, k)) {
+        sort_db = NULL;
+        free(tail);
+        return false;
     }
 
-    Record *p = db->head->next;
-    for (int i = 0; i < db->count; i++) {
-        records[i] = p;
-        p = p->next;
+    /* 从后往前归并，缓存部分原地后移，不需要额外的 n 个临时空间 */
+    uint32_t i = built, j = k, w = n;
+    bool search = (uint64_t)k * 32 < built;
+    while (j > 0) {
+        if (search) {
+            /* 缓存中大于 tail[j - 1] 的一段整体后移 */
+            uint32_t lo = 0, hi = i;
+            while (lo < hi) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (compare(&perm[mid], &tail[j - 1]) > 0) {
+                    hi = mid;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+            memmove(perm + w - (i - lo), perm + lo, sizeof(uint32_t) * (i - lo));
+            w -= i - lo;
+            i = lo;
+            perm[--w] = tail[--j];
+        } else if (i > 0 && compare(&perm[i - 1], &tail[j - 1]) > 0) {
+            perm[--w] = perm[--i];
+        } else {
+            perm[--w] = tail[--j];
+        }
     }
+    sort_db = NULL;
+    free(tail);
+    db->sort_built[f] = n;
+    return true;
+}
 
+/*
+ * db_sort_cache - 让字段的排序缓存 sort_perm 覆盖全部行（含墓碑行）
+ * 返回值：false 表示字段无效或内存不足（缓存保持原样）
+ */
+bool db_sort_cache(Database *db, int field) {
     /* 选择比较函数 */
     int (*compare)(const void *, const void *);
+    bool (*sort_rows)(const Database *, uint32_t *, uint32_t) = NULL;
     switch (field) {
         case SORT_BY_ID:
             compare = compare_by_id;
             break;
         case SORT_BY_NAME:
             compare = compare_by_name;
+            sort_rows = sort_rows_by_name;
             break;
         case SORT_BY_AGE:
             compare = compare_by_age;
@@ -335,22 +849,36 @@ void db_sort(Database *db, int field) {
             compare = compare_by_score;
             break;
         default:
-            printf("错误：未知的排序字段！\n");
-            free(records);
-            return;
+            return false;
     }
+    if (db->count == 0) {
+        return true;
+    }
+    return sort_perm_update(db, field - SORT_BY_ID, compare, sort_rows);
+}
 
-    /* 使用 qsort 排序 */
-    qsort(records, db->count, sizeof(Record *), compare);
-
-    /* 重建链表 */
-    for (int i = 0; i < db->count - 1; i++) {
-        records[i]->next = records[i + 1];
+/*
+ * db_sort - 按指定字段排序数据库记录
+ * 参数：db - 数据库指针
+ *       field - 排序字段（SORT_BY_ID / SORT_BY_NAME / SORT_BY_AGE / SORT_BY_SCORE）
+ */
+void db_sort(Database *db, int field) {
+    if (db == NULL || db_live_count(db) == 0) {
+        printf("数据库为空，无需排序！\n");
+        return;
+    }
+    if (field < SORT_BY_ID || field > SORT_BY_SCORE) {
+        printf("错误：未知的排序字段！\n");
+        return;
     }
-    records[db->count - 1]->next = NULL;
-    db->head->next = records[0];
 
-    free(records);
+    /* 更新该字段的排序缓存，再整体复制到显示顺序 */
+    if (!db_sort_cache(db, field)) {
+        printf("内存分配失败！\n");
+        return;
+    }
+    memcpy(db->order, db->sort_perm[field - SORT_BY_ID], sizeof(uint32_t) * db->count);
+    db_index_order(db);
 
     printf("排序完成！\n");
 }
@@ -359,54 +887,174 @@ void db_sort(Database *db, int field) {
  * ==================== 统计功能实现 ====================
  */
 
+/*
+ * 统计累加器：db_stats 与 db_stats_where 共用
+ */
+typedef struct StatsAcc {
+    int count;
+    double sum_score;
+    double max_score;
+    double min_score;
+    int max_age;
+    int min_age;
+} StatsAcc;
+
+static void stats_init(StatsAcc *acc) {
+    acc->count = 0;
+    acc->sum_score = 0.0;
+    acc->max_score = -1.0;
+    acc->min_score = 101.0;
+    acc->max_age = -1;
+    acc->min_age = 151;
+}
+
+static void stats_add(StatsAcc *acc, const Record *p) {
+    acc->count++;
+    acc->sum_score += p->score;
+
+    if (p->score > acc->max_score) {
+        acc->max_score = p->score;
+    }
+    if (p->score < acc->min_score) {
+        acc->min_score = p->score;
+    }
+    if (p->age > acc->max_age) {
+        acc->max_age = p->age;
+    }
+    if (p->age < acc->min_age) {
+        acc->min_age = p->age;
+    }
+}
+
+static void stats_print(const StatsAcc *acc, const char *title) {
+    double avg_score = acc->sum_score / acc->count;
+
+    printf("\n=== %s ===\n", title);
+    printf("记录总数：%d\n", acc->count);
+    printf("成绩统计：\n");
+    printf("  - 平均分：%.2f\n", avg_score);
+    printf("  - 最高分：%.2f\n", acc->max_score);
+    printf("  - 最低分：%.2f\n", acc->min_score);
+    printf("年龄统计：\n");
+    printf("  - 最大年龄：%d 岁\n", acc->max_age);
+    printf("  - 最小年龄：%d 岁\n", acc->min_age);
+}
+
 /*
  * db_stats - 输出数据库统计信息
  */
 void db_stats(const Database *db) {
-    if (db == NULL || db->head->next == NULL) {
+    if (db == NULL || db_live_count(db) == 0) {
         printf("数据库为空，无统计信息！\n");
         return;
     }
 
-    int count = 0;
-    double sum_score = 0.0;
-    double max_score = -1.0;
-    double min_score = 101.0;
-    int max_age = -1;
-    int min_age = 151;
-
-    Record *p = db->head->next;
-    while (p != NULL) {
-        count++;
-        sum_score += p->score;
+    StatsAcc acc;
+    stats_init(&acc);
 
-        if (p->score > max_score) {
-            max_score = p->score;
-        }
-        if (p->score < min_score) {
-            min_score = p->score;
-        }
-        if (p->age > max_age) {
-            max_age = p->age;
-        }
-        if (p->age < min_age) {
-            min_age = p->age;
+    /* 统计与顺序无关，直接顺序扫描热数据行，跳过墓碑行 */
+    for (int i = 0; i < db->count; i++) {
+        if (!db_is_dead(&db->rows[i])) {
+            stats_add(&acc, &db->rows[i]);
         }
+    }
+    stats_print(&acc, "数据库统计信息");
+}
+
+/*
+ * db_stats_where - 只统计标志满足条件的记录
+ * 参数：must_set - 必须全部开启的标志位
+ *       must_clear - 必须全部关闭的标志位
+ * 先用标志位图求出行集合，再按行下标升序访问命中的行
+ */
+void db_stats_where(const Database *db, uint8_t must_set, uint8_t must_clear) {
+    if (db == NULL || db_live_count(db) == 0) {
+        printf("数据库为空，无统计信息！\n");
+        return;
+    }
+    if (must_set == 0 && must_clear == 0) {
+        db_stats(db);
+        return;
+    }
 
-        p = p->next;
+    Bitmap selected;
+    bitmap_init(&selected);
+    if (!db_flag_select(db, must_set, must_clear, &selected)) {
+        printf("内存分配失败！\n");
+        bitmap_free(&selected);
+        return;
     }
 
-    double avg_score = sum_score / count;
+    StatsAcc acc;
+    stats_init(&acc);
+    BitmapIter it;
+    uint32_t row;
+    bitmap_iter_init(&it, &selected);
+    while (bitmap_iter_next(&it, &row)) {
+        stats_add(&acc, &db->rows[row]);
+    }
+    bitmap_free(&selected);
 
-    printf("\n=== 数据库统计信息 ===\n");
-    printf("记录总数：%d\n", count);
-    printf("成绩统计：\n");
-    printf("  - 平均分：%.2f\n", avg_score);
-    printf("  - 最高分：%.2f\n", max_score);
-    printf("  - 最低分：%.2f\n", min_score);
-    printf("年龄统计：\n");
-    printf("  - 最大年龄：%d 岁\n", max_age);
-    printf("  - 最小年龄：%d 岁\n", min_age);
+    if (acc.count == 0) {
+        printf("没有满足条件的记录。\n");
+        return;
+    }
+    stats_print(&acc, "筛选统计信息");
+}
+
+/*
+ * db_quantiles - 输出成绩与年龄的中位数、P90、P99
+ * 成绩同时给出两种结果：
+ *   近似：直接查询插入时维护的 KLL 草图，O(k log k)，与记录数无关；
+ *   精确：复制有效记录的成绩后做线性时间选择，O(n) 时间、8n 字节临时内存
+ * 年龄由直方图直接得出精确值
+ */
+void db_quantiles(const Database *db) {
+    if (db == NULL || db_live_count(db) == 0) {
+        printf("数据库为空，无统计信息！\n");
+        return;
+    }
+
+    static const double qs[3] = {0.5, 0.9, 0.99};
+    double approx[3], exact[3];
+    int ages[3];
+
+    printf("\n=== 分位数统计（中位数 / P90 / P99）===\n");
+
+    clock_t start = clock();
+    if (kll_quantiles(&db->score_sketch, qs, 3, approx)) {
+        double ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+        printf("成绩（近似）：%.2f / %.2f / %.2f\n", approx[0], approx[1], approx[2]);
+        printf("  - KLL 草图：保留 %u 个样本，%zu 字节，查询用时 %.3f 毫秒\n",
+               db->score_sketch.size, kll_memory(&db->score_sketch), ms);
+        printf("  - 误差：排名偏差不超过 ±%.2f%%（99%% 置信度）\n", KLL_RANK_ERROR * 100);
+        if (db->dead > 0) {
+            printf("  - 草图中包含 %d 条尚未回收的已删除记录\n", db->dead);
+        }
+    }
+
+    size_t n = (size_t)db_live_count(db);
+    double *values = malloc(sizeof(double) * n);
+    if (values == NULL) {
+        printf("内存分配失败！无法计算精确分位数。\n");
+    } else {
+        start = clock();
+        size_t m = 0;
+        for (int i = 0; i < db->count; i++) {
+            if (!db_is_dead(&db->rows[i])) {
+                values[m++] = db->rows[i].score;
+            }
+        }
+        quantile_exact(values, m, qs, 3, exact);
+        double ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+        free(values);
+        printf("成绩（精确）：%.2f / %.2f / %.2f\n", exact[0], exact[1], exact[2]);
+        printf("  - 线性时间选择：用时 %.3f 毫秒，临时内存 %zu 字节\n", ms, n * sizeof(double));
+    }
+
+    quantile_histogram(db->age_hist, 256, qs, 3, ages);
+    printf("年龄（精确）：%d / %d / %d 岁\n", ages[0], ages[1], ages[2]);
+    printf("  - 由年龄直方图直接得出\n");
 }
 
 /*
@@ -421,24 +1069,25 @@ void db_stats(const Database *db) {
  * 返回值：true 表示成功，false 表示失败
  */
 bool db_toggle_flag(Database *db, int id, uint8_t flag) {
-    if (db == NULL || db->head->next == NULL) {
+    if (db == NULL || db->count == 0) {
         printf("数据库为空！\n");
         return false;
     }
 
-    // 查找记录
-    Record *p = db->head->next;
-    while (p != NULL && p->id != id) {
-        p = p->next;
-    }
+    // 通过 ID 索引查找记录；已删除的记录只能切换软删除标志（即恢复）
+    uint32_t row = idmap_get(&db->ids, id);
+    Record *p = row == IDMAP_NONE ? NULL : &db->rows[row];
 
-    if (p == NULL) {
+    if (p == NULL || (db_is_dead(p) && flag != FLAG_DELETED)) {
         printf("未找到 ID 为 %d 的记录！\n", id);
         return false;
     }
 
-    // 使用异或操作切换标志位
-    p->flags ^= flag;
+    // 使用异或操作切换标志位，并同步标志位图
+    if (!db_apply_flags(db, row, p->flags ^ flag)) {
+        printf("内存分配失败！\n");
+        return false;
+    }
 
     // 显示操作结果
     const char *flag_name;
@@ -450,7 +1099,30 @@ bool db_toggle_flag(Database *db, int id, uint8_t flag) {
 
     bool is_set = (p->flags & flag) != 0;
     printf("已将记录\"%s\"的%s状态%s。\n",
-           p->name, flag_name, is_set ? "设为开启" : "设为关闭");
+           db_name(db, p), flag_name, is_set ? "设为开启" : "设为关闭");
+    if (flag == FLAG_DELETED && is_set) {
+        db_maybe_vacuum(db);
+    }
+    return true;
+}
+
+/*
+ * db_set_flags - 把 ID 对应行的标志直接设为 flags（副本应用操作日志用）
+ * 与 db_toggle_flag 一样按 ID 索引定位（已删除的行也能设置），不输出信息
+ * 返回值：false 表示未找到或内存不足
+ */
+bool db_set_flags(Database *db, int id, uint8_t flags) {
+    uint32_t row = idmap_get(&db->ids, id);
+    if (row == IDMAP_NONE) {
+        return false;
+    }
+    bool newly_dead = !db_is_dead(&db->rows[row]) && (flags & FLAG_DELETED) != 0;
+    if (!db_apply_flags(db, row, flags)) {
+        return false;
+    }
+    if (newly_dead) {
+        db_maybe_vacuum(db);
+    }
     return true;
 }
 
@@ -458,41 +1130,113 @@ bool db_toggle_flag(Database *db, int id, uint8_t flag) {
  * db_show_flags - 显示所有记录的状态标志
  */
 void db_show_flags(const Database *db) {
-    if (db == NULL || db->head->next == NULL) {
+    if (db == NULL || db_live_count(db) == 0) {
         printf("数据库为空！\n");
         return;
     }
 
-    printf("\n=== 记录状态列表 ===\n");
-    Record *p = db->head->next;
-    while (p != NULL) {
-        printf("ID: %d, 姓名：%s, 状态：", p->id, p->name);
-        if (p->flags == 0) {
-            printf("正常");
-        } else {
-            int first = 1;
-            if (p->flags & FLAG_READONLY) {
-                if (!first) printf(", ");
-                printf("只读");
-                first = 0;
-            }
-            if (p->flags & FLAG_ARCHIVED) {
-                if (!first) printf(", ");
-                printf("已归档");
-                first = 0;
-            }
-            if (p->flags & FLAG_VIP) {
-                if (!first) printf(", ");
-                printf("VIP");
-                first = 0;
-            }
-            if (p->flags & FLAG_DELETED) {
-                if (!first) printf(", ");
-                printf("软删除");
-                first = 0;
+    OutBuf ob;
+    out_init(&ob, stdout);
+    if (out_get_mode() == OUTPUT_PRETTY) {
+        out_puts(&ob, "\n=== 记录状态列表 ===\n");
+    }
+    Cursor *cursor = cursor_open(db, NULL);
+    if (cursor != NULL) {
+        const Record *batch[CURSOR_BATCH];
+        int n;
+        while ((n = cursor_next(cursor, batch, CURSOR_BATCH)) > 0) {
+            for (int i = 0; i < n; i++) {
+                out_record_flags(&ob, db, batch[i]);
             }
         }
-        printf("\n");
-        p = p->next;
+        cursor_close(cursor);
+    }
+    out_flush(&ob);
+}
+
+/*
+ * db_flag_select - 求标志满足条件的行下标集合
+ * 参数：must_set - 必须全部开启的标志位（0 表示不限，从全部行开始）
+ *       must_clear - 必须全部关闭的标志位
+ *       out - 结果位图（原有内容被替换）
+ * 返回值：false 表示内存不足
+ *
+ * 墓碑行总是被排除，例如 "VIP 且未归档"：
+ * flag_index[VIP] ANDNOT flag_index[归档] ANDNOT flag_index[软删除]
+ */
+bool db_flag_select(const Database *db, uint8_t must_set, uint8_t must_clear, Bitmap *out) {
+    if (must_set & FLAG_DELETED) {
+        bitmap_clear(out);
+        return true;
+    }
+    must_clear |= FLAG_DELETED;
+
+    Bitmap tmp;
+    bitmap_init(&tmp);
+    bool ok = true;
+    bool first = true;
+
+    for (int i = 0; i < FLAG_COUNT && ok; i++) {
+        if ((must_set & (1 << i)) == 0) {
+            continue;
+        }
+        if (first) {
+            ok = bitmap_copy(out, &db->flag_index[i]);
+            first = false;
+        } else {
+            ok = bitmap_and(out, &db->flag_index[i], &tmp);
+            Bitmap swap = *out;
+            *out = tmp;
+            tmp = swap;
+        }
+    }
+    if (ok && first) {
+        ok = bitmap_fill(out, (uint32_t)db->count);
+    }
+
+    for (int i = 0; i < FLAG_COUNT && ok; i++) {
+        if ((must_clear & (1 << i)) == 0) {
+            continue;
+        }
+        ok = bitmap_andnot(out, &db->flag_index[i], &tmp);
+        Bitmap swap = *out;
+        *out = tmp;
+        tmp = swap;
     }
+    bitmap_free(&tmp);
+    return ok;
+}
+
+/*
+ * db_flag_count - 统计标志满足条件的（未删除）记录数
+ * 不限条件和单个标志直接由位图的元素数和交集 popcount 得出，
+ * 其余组合先求行集合再计数；内存不足时返回 0
+ */
+uint64_t db_flag_count(const Database *db, uint8_t must_set, uint8_t must_clear) {
+    int set_bits[FLAG_COUNT];
+    int n_set = 0;
+    for (int i = 0; i < FLAG_COUNT; i++) {
+        if (must_set & (1 << i)) {
+            set_bits[n_set++] = i;
+        }
+    }
+
+    if ((must_clear & ~FLAG_DELETED) == 0 && (must_set & FLAG_DELETED) == 0) {
+        if (n_set == 0) {
+            return (uint64_t)db_live_count(db);
+        }
+        if (n_set == 1) {
+            /* |S ANDNOT D| = |S| - |S AND D| */
+            const Bitmap *bm = &db->flag_index[set_bits[0]];
+            return bitmap_cardinality(bm) -
+                   bitmap_and_cardinality(bm, &db->flag_index[DELETED_INDEX]);
+        }
+    }
+
+    Bitmap selected;
+    bitmap_init(&selected);
+    uint64_t total = db_flag_select(db, must_set, must_clear, &selected)
+                     ? bitmap_cardinality(&selected) : 0;
+    bitmap_free(&selected);
+    return total;
 }
@@ -8,6 +8,16 @@
 #define DB_H
 
 #include "config.h"
+#include "idmap.h"
+#include "strheap.h"
+#include "bitmap.h"
+#include "quantile.h"
+
+struct QueryCache;  // 组合条件查询的索引缓存（见 query.h）
+struct FuzzyIndex;  // 姓名模糊查找索引（见 fuzzy.h）
+struct PrefixIndex; // 姓名前缀索引（见 prefix.h）
+struct SnapLayout;  // 上次保存或加载的第 3 版快照的块布局（见 io.c）
+struct ReplLog;     // 主库的操作日志（见 repl.h）
 
 /*
  * 记录状态标志（位字段）
@@ -16,29 +26,57 @@
 #define FLAG_READONLY  (1 << 0)  // 0x01 只读
 #define FLAG_ARCHIVED  (1 << 1)  // 0x02 已归档
 #define FLAG_VIP       (1 << 2)  // 0x04 VIP
-#define FLAG_DELETED   (1 << 3)  // 0x08 软删除
+#define FLAG_DELETED   (1 << 3)  // 0x08 软删除（墓碑：遍历、统计、导出时跳过，回收前可恢复）
+#define FLAG_COUNT     4         // 标志位个数（flag_index 的长度）
+
+#define SORT_FIELD_COUNT 4       // 排序字段个数（sort_perm 的长度，见 SortField）
+
+#define DB_BLOCK_SHIFT   12      // 脏块跟踪：每块 2^12 = 4096 行
+#define DB_BLOCK_ROWS    (1 << DB_BLOCK_SHIFT)
 
 /*
- * 记录结构体
- * 使用链表存储，每个节点代表一条学生记录
+ * 记录结构体（热数据行，16 字节）
+ * 扫描时常用的字段紧凑存放，一个 64 字节缓存行可容纳 4 行；
+ * 姓名属于冷数据，单独存放在 Database.names 中，与行下标一一对应
  */
 typedef struct Record {
-    int id;                     // 学生 ID
-    char name[MAX_NAME_LEN];    // 姓名
-    int age;                    // 年龄
     double score;               // 成绩
+    int32_t id;                 // 学生 ID
+    uint8_t age;                // 年龄（1-150）
     uint8_t flags;              // 位字段状态（只读/归档/VIP/软删除）
-    struct Record *next;        // 指向下一个节点的指针
+    uint16_t reserved;          // 保留，填充到 16 字节
 } Record;
 
 /*
  * 数据库结构体
- * 管理整个链表和状态信息
+ * 行存储按插入顺序追加，排序只重排 order 中的 32 位行下标；
+ * 删除只给行打上 FLAG_DELETED 墓碑，墓碑达到阈值后由 db_vacuum 批量回收
  */
 typedef struct Database {
-    Record *head;   // 链表头节点（哨兵节点）
-    int count;      // 记录总数
-    int next_id;    // 下一个可用的 ID
+    Record *rows;       // 热数据行数组
+    NameRef *names;     // 冷数据：姓名引用，names[i] 对应 rows[i]
+    uint32_t *order;    // 当前显示顺序（行下标数组）
+    uint32_t *order_pos;  // order 的逆：order_pos[row] 为第 row 行在 order 中的位置（游标续读用）
+    int count;          // 行数（含墓碑行）
+    int dead;           // 墓碑行数
+    int capacity;       // rows / names / order 已分配的行数
+    int next_id;        // 下一个可用的 ID
+    IdMap ids;          // ID 索引：ID -> 行下标
+    StrHeap name_heap;  // 姓名字符串堆（去重存储）
+    Bitmap flag_index[FLAG_COUNT];  // 标志位图索引：flag_index[i] 为第 i 位开启的行下标集合
+    KllSketch score_sketch;         // 成绩分位数草图：覆盖全部行（含未回收的墓碑行），回收时重建
+    uint32_t age_hist[256];         // 年龄直方图：只统计有效记录
+    uint32_t row_version;           // 行存储版本：回收或清空使行下标改变、改写使行内容改变时递增
+    struct QueryCache *qcache;      // 组合条件查询按需建立的索引，NULL 表示尚未建立
+    struct FuzzyIndex *fuzzy;       // 模糊姓名查找按需建立的索引，NULL 表示尚未建立
+    struct PrefixIndex *prefix;     // 姓名前缀索引，建立后随增删改名增量维护，NULL 表示尚未建立
+    uint32_t *sort_perm[SORT_FIELD_COUNT];  // 各排序字段的排序结果（行下标），第一次按该字段排序时建立
+    uint32_t sort_built[SORT_FIELD_COUNT];  // sort_perm 覆盖的行数，之后追加的行在下次排序时归并进来
+    uint32_t *dirty;                // 脏块计数：dirty[b] 为第 b 块行（DB_BLOCK_ROWS 行）自上次保存以来的修改次数
+    uint64_t changes;               // 自上次保存以来的修改次数（清空、回收等整体修改也计入）
+    struct SnapLayout *snap;        // 快照文件的块布局，增量保存据此只写有修改的块；NULL 表示下次整体重写
+    struct ReplLog *log;            // 操作日志（作为复制主库时），NULL 表示不记录
+    uint64_t lsn;                   // 最后一项操作日志的序号（快照中保存；副本上为已应用的序号）
 } Database;
 
 /*
@@ -55,7 +93,9 @@ typedef enum Command {
     CMD_FILE,           // 文件操作
     CMD_STATS,          // 统计信息
     CMD_FLAG,           // 记录状态管理
-    CMD_QUIT            // 退出程序
+    CMD_QUIT,           // 退出程序
+    CMD_QUERY,          // 高级查询（分页浏览等）
+    CMD_PAGED           // 页式存储（缓冲池）
 } Command;
 
 /*
@@ -79,20 +119,35 @@ typedef enum SortField {
  */
 Database *db_create(void);               // 创建新数据库
 void db_destroy(Database *db);          // 销毁数据库，释放所有内存
+void db_clear(Database *db);            // 删除所有记录（保留数据库本身）
 
 /*
  * 增删改查操作
  */
-void db_add(Database *db);              // 添加新记录（交互式输入）
+void db_add(Database *db, const char *name, uint8_t age, double score);  // 添加新记录（输入已验证）
 void db_delete(Database *db, int id);   // 删除指定 ID 的记录
 void db_list_all(const Database *db);   // 列出所有记录
-void db_find_by_id(const Database *db); // 按 ID 查找记录（交互式）
-void db_find_by_name(const Database *db); // 按姓名模糊查找（交互式）
+void db_find_by_id(Database *db, int id);  // 按 ID 查找记录
+void db_find_by_name(Database *db, const char *keyword);  // 按姓名模糊查找
+bool db_insert_record(Database *db, const Record *record, const char *name);  // 追加一条记录（维护索引）
+bool db_append_batch(Database *db, const Record *rows, const unsigned char *const *names,
+                     uint32_t n, const KllSketch *sketch, IdMap *ids);  // 批量追加已解码的记录（并行加载）
+bool db_update_record(Database *db, int id, const char *name, uint8_t age, double score);  // 按 ID 改写记录（维护索引）
+Record *db_lookup(const Database *db, int id);         // 通过 ID 索引查找记录，未找到或已删除返回 NULL
+bool db_vacuum(Database *db);                          // 回收墓碑行，压缩行存储与索引
+
+/*
+ * 修改跟踪（自动保存用）
+ */
+void db_mark_clean(Database *db);                      // 已保存：清零修改计数和脏块计数
+void db_touch_all(Database *db);                       // 把所有行所在的块记为已修改
+uint32_t db_dirty_blocks(const Database *db);          // 有修改的块数
 
 /*
  * 排序操作
  */
 void db_sort(Database *db, int field);  // 按指定字段排序
+bool db_sort_cache(Database *db, int field);  // 只更新该字段的排序缓存（不改变显示顺序）
 
 /*
  * 统计操作
@@ -103,12 +158,42 @@ void db_stats(const Database *db);  // 输出统计信息
  * 记录状态管理
  */
 bool db_toggle_flag(Database *db, int id, uint8_t flag);  // 切换记录标志
+bool db_set_flags(Database *db, int id, uint8_t flags);   // 直接设置标志（含已删除的行，不输出信息）
 void db_show_flags(const Database *db);                   // 显示所有记录的状态
+bool db_flag_select(const Database *db, uint8_t must_set, uint8_t must_clear, Bitmap *out);  // 按标志组合求行集合
+uint64_t db_flag_count(const Database *db, uint8_t must_set, uint8_t must_clear);            // 按标志组合计数
+void db_stats_where(const Database *db, uint8_t must_set, uint8_t must_clear);               // 按标志组合统计
+void db_quantiles(const Database *db);  // 输出成绩与年龄的分位数（近似与精确）
 
 /*
  * 辅助函数
  */
-void print_record(const Record *record);  // 打印单条记录
-void print_record_verbose(const Record *record);  // 打印单条记录（含状态）
+void print_record(const Database *db, const Record *record);  // 打印单条记录
+void print_record_verbose(const Database *db, const Record *record);  // 打印单条记录（含状态）
+
+/* 有效（未删除）记录数 */
+static inline int db_live_count(const Database *db) {
+    return db->count - db->dead;
+}
+
+/* 记录是否已删除（墓碑） */
+static inline bool db_is_dead(const Record *record) {
+    return (record->flags & FLAG_DELETED) != 0;
+}
+
+/* 取记录的行下标（record 必须指向 db->rows 中的元素） */
+static inline uint32_t db_row(const Database *db, const Record *record) {
+    return (uint32_t)(record - db->rows);
+}
+
+/* 取记录的姓名（以 '\0' 结尾） */
+static inline const char *db_name(const Database *db, const Record *record) {
+    return strheap_str(&db->name_heap, db->names[record - db->rows]);
+}
+
+/* 取记录姓名的字节长度 */
+static inline uint32_t db_name_len(const Database *db, const Record *record) {
+    return db->names[record - db->rows].len;
+}
 
 #endif /* DB_H */
@@ -0,0 +1,781 @@
+/*
+ * extsort.c - MiniDB 外部排序实现
+ * 第一阶段：按内存上限分批读入记录，编码后顺序放进一整块内存（从低地址往上），
+ *   排序项（键前缀 + 偏移）从高地址往下放，块满时排序并写成一个顺串；
+ *   输入一次就能装下时直接写出结果，不产生临时文件
+ * 第二阶段：败者树 k 路归并，k 受"每个文件至少 EXTSORT_MIN_BUFFER 缓冲区"限制，
+ *   顺串数超过 k 时先把每 k 个归并成一个更长的顺串，直到一趟就能归并完
+ * 顺串与快照使用同一种记录编码（第 2 版，见 io.c）；第 3 版快照按块映射逐块流式读取，
+ *   结果写成第 2 版快照（选项 2 可直接加载）
+ */
+
+#include "extsort.h"
+#include "io.h"
+#include "output.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EXT_MAGIC      SNAPSHOT_MAGIC
+#define EXT_MAGIC_LEN  4
+#define EXT_REC_FIXED  15   // id(4) + score(8) + age(1) + flags(1) + name_len(1)
+#define EXT_REC_MAX    (EXT_REC_FIXED + MAX_NAME_LEN)
+
+/*
+ * 文件格式
+ */
+typedef enum ExtFormat {
+    EXT_SNAPSHOT = 1,   // 二进制快照（输入第 2 或第 3 版，输出第 2 版）
+    EXT_CSV             // CSV 文本：id,name,age,score
+} ExtFormat;
+
+/*
+ * 解码后的一条记录
+ */
+typedef struct ExtRecord {
+    uint64_t key;               // 排序键前缀（见 ext_key）
+    int32_t id;
+    double score;
+    uint8_t age;
+    uint8_t flags;
+    uint8_t name_len;
+    char name[MAX_NAME_LEN];    // 不以 '\0' 结尾
+} ExtRecord;
+
+/*
+ * 内存中的排序项：键前缀相同时再回到编码区比较
+ */
+typedef struct ExtEntry {
+    uint64_t key;
+    uint64_t off;               // 记录在编码区中的偏移
+} ExtEntry;
+
+/*
+ * 输入文件
+ */
+typedef struct ExtReader {
+    FILE *fp;
+    ExtFormat format;
+    int line;                   // CSV 当前行号
+    int remaining;              // 快照（第 3 版为当前块）中尚未读取的记录数
+    int32_t next_id;            // 快照头中的 next_id；CSV 为最大 ID + 1
+    SnapBlock *map;             // 第 3 版快照的块映射，其他格式为 NULL
+    uint32_t nblocks;           // 块数
+    uint32_t block;             // 下一个要读的块
+    uint32_t block_left;        // 当前块中尚未读取的字节数
+} ExtReader;
+
+/*
+ * 输出文件（顺串或最终结果）
+ */
+typedef struct ExtWriter {
+    FILE *fp;
+    ExtFormat format;
+    bool run;                   // 是否为临时顺串（只写记录，无文件头）
+    OutBuf *ob;                 // CSV 格式化缓冲区
+    uint64_t bytes;             // 已写出的字节数
+} ExtWriter;
+
+/*
+ * 归并时的一个输入顺串
+ */
+typedef struct ExtRun {
+    char *path;
+    FILE *fp;
+    char *buf;
+    ExtRecord rec;              // 当前记录
+    bool done;                  // 是否已读完
+} ExtRun;
+
+/* 排序字段（qsort 比较函数无法传递额外参数） */
+static int ext_field = SORT_BY_ID;
+static const unsigned char *ext_arena = NULL;
+
+/*
+ * ext_key - 64 位排序键前缀，按无符号整数比较即可得到字段顺序
+ * ID：偏置后的 ID；年龄：年龄 + ID（完整键）；
+ * 成绩：保序变换后的 IEEE 754 位模式；姓名：前 8 个字节（大端，不足补 0）
+ */
+static uint64_t ext_key(int field, int32_t id, double score, uint8_t age, const char *name, uint8_t name_len) {
+    uint64_t biased_id = (uint32_t)id ^ 0x80000000u;
+    switch (field) {
+        case SORT_BY_NAME: {
+            uint64_t key = 0;
+            for (int i = 0; i < 8; i++) {
+                key = (key << 8) | (i < name_len ? (unsigned char)name[i] : 0);
+            }
+            return key;
+        }
+        case SORT_BY_AGE:
+            return ((uint64_t)age << 32) | biased_id;
+        case SORT_BY_SCORE: {
+            uint64_t bits;
+            if (score == 0.0) {
+                score = 0.0;  /* -0.0 与 0.0 视为相等 */
+            }
+            memcpy(&bits, &score, sizeof(bits));
+            return (bits & 0x8000000000000000ull) ? ~bits : bits | 0x8000000000000000ull;
+        }
+        default:
+            return biased_id;
+    }
+}
+
+/* 键前缀相同时的完整比较：姓名逐字节比较，最后按 ID */
+static int ext_tiebreak(int field, int32_t id_a, const char *name_a, uint8_t len_a,
+                        int32_t id_b, const char *name_b, uint8_t len_b) {
+    if (field == SORT_BY_NAME) {
+        int c = memcmp(name_a, name_b, len_a < len_b ? len_a : len_b);
+        if (c != 0) {
+            return c;
+        }
+        if (len_a != len_b) {
+            return len_a < len_b ? -1 : 1;
+        }
+    }
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+static int ext_compare(const ExtRecord *a, const ExtRecord *b) {
+    if (a->key != b->key) {
+        return a->key < b->key ? -1 : 1;
+    }
+    return ext_tiebreak(ext_field, a->id, a->name, a->name_len, b->id, b->name, b->name_len);
+}
+
+/* 比较函数：内存中的排序项 */
+static int compare_entry(const void *a, const void *b) {
+    const ExtEntry *ea = a;
+    const ExtEntry *eb = b;
+    if (ea->key != eb->key) {
+        return ea->key < eb->key ? -1 : 1;
+    }
+    const unsigned char *ra = ext_arena + ea->off;
+    const unsigned char *rb = ext_arena + eb->off;
+    int32_t id_a, id_b;
+    memcpy(&id_a, ra, 4);
+    memcpy(&id_b, rb, 4);
+    return ext_tiebreak(ext_field, id_a, (const char *)ra + EXT_REC_FIXED, ra[14],
+                        id_b, (const char *)rb + EXT_REC_FIXED, rb[14]);
+}
+
+/* 把记录编码为第 2 版快照格式，返回字节数 */
+static size_t ext_encode(const ExtRecord *rec, unsigned char *buf) {
+    memcpy(buf, &rec->id, 4);
+    memcpy(buf + 4, &rec->score, 8);
+    buf[12] = rec->age;
+    buf[13] = rec->flags;
+    buf[14] = rec->name_len;
+    memcpy(buf + EXT_REC_FIXED, rec->name, rec->name_len);
+    return EXT_REC_FIXED + rec->name_len;
+}
+
+/* 从顺串或快照读取一条编码记录，返回值：1 成功，0 文件结束，-1 格式错误 */
+static int ext_read_encoded(FILE *fp, ExtRecord *rec) {
+    unsigned char buf[EXT_REC_FIXED];
+    size_t got = fread(buf, 1, EXT_REC_FIXED, fp);
+    if (got == 0) {
+        return 0;
+    }
+    if (got != EXT_REC_FIXED) {
+        return -1;
+    }
+    memcpy(&rec->id, buf, 4);
+    memcpy(&rec->score, buf + 4, 8);
+    rec->age = buf[12];
+    rec->flags = buf[13];
+    rec->name_len = buf[14];
+    if (rec->name_len >= MAX_NAME_LEN || fread(rec->name, 1, rec->name_len, fp) != rec->name_len) {
+        return -1;
+    }
+    rec->key = ext_key(ext_field, rec->id, rec->score, rec->age, rec->name, rec->name_len);
+    return 1;
+}
+
+/*
+ * ==================== 输入 ====================
+ */
+
+/* 打开输入文件并识别格式：以 "MDB2" 或 "MDB3" 开头为快照，以 "id," 开头为 CSV */
+static int ext_open_input(ExtReader *in, const char *path, char *iobuf, size_t iobuf_size) {
+    in->fp = fopen(path, "rb");
+    if (in->fp == NULL) {
+        fprintf(stderr, "错误：无法打开文件 '%s' 进行读取！\n", path);
+        perror("fopen");
+        return -1;
+    }
+    setvbuf(in->fp, iobuf, _IOFBF, iobuf_size);
+    in->line = 0;
+    in->remaining = 0;
+    in->next_id = 1;
+    in->map = NULL;
+    in->nblocks = 0;
+    in->block = 0;
+    in->block_left = 0;
+
+    char head[EXT_MAGIC_LEN];
+    if (fread(head, 1, EXT_MAGIC_LEN, in->fp) != EXT_MAGIC_LEN) {
+        fprintf(stderr, "错误：文件 '%s' 太短，无法识别格式！\n", path);
+        fclose(in->fp);
+        return -1;
+    }
+    if (memcmp(head, EXT_MAGIC, EXT_MAGIC_LEN) == 0) {
+        in->format = EXT_SNAPSHOT;
+        if (fread(&in->remaining, sizeof(int), 1, in->fp) != 1 ||
+            fread(&in->next_id, sizeof(int), 1, in->fp) != 1 || in->remaining < 0) {
+            fprintf(stderr, "错误：读取文件头失败！文件可能已损坏。\n");
+            fclose(in->fp);
+            return -1;
+        }
+        return 0;
+    }
+    if (memcmp(head, SNAPSHOT3_MAGIC, EXT_MAGIC_LEN) == 0) {
+        SnapHeader h;
+        in->format = EXT_SNAPSHOT;
+        if (!io_read_snapshot3(in->fp, &h, &in->map)) {
+            fprintf(stderr, "错误：读取文件头或块映射失败！文件可能已损坏。\n");
+            fclose(in->fp);
+            return -1;
+        }
+        in->nblocks = h.nblocks;
+        in->next_id = h.next_id;
+        return 0;
+    }
+    if (memcmp(head, "id,", 3) == 0) {
+        in->format = EXT_CSV;
+        rewind(in->fp);
+        return 0;
+    }
+    fprintf(stderr, "错误：无法识别文件 '%s' 的格式（支持第 2、3 版快照和 CSV；第 1 版快照请先加载后导出为 CSV 或分区保存）！\n", path);
+    fclose(in->fp);
+    return -1;
+}
+
+/* 读取下一条记录，返回值：1 成功，0 文件结束，-1 错误 */
+static int ext_read_input(ExtReader *in, ExtRecord *rec, ExtSortStats *stats) {
+    while (in->format == EXT_SNAPSHOT) {
+        if (in->remaining == 0) {
+            /* 第 3 版：当前块读完后核对字节数，再定位到下一块（块在文件中不一定连续） */
+            if (in->block_left != 0) {
+                break;
+            }
+            if (in->map == NULL || in->block == in->nblocks) {
+                return 0;
+            }
+            const SnapBlock *b = &in->map[in->block++];
+            if (b->rows > 0 && file_seek(in->fp, b->off) != 0) {
+                break;
+            }
+            in->remaining = (int)b->rows;
+            in->block_left = b->len;
+            continue;
+        }
+        if (ext_read_encoded(in->fp, rec) != 1) {
+            break;
+        }
+        in->remaining--;
+        if (in->map != NULL) {
+            uint32_t len = EXT_REC_FIXED + rec->name_len;
+            if (len > in->block_left) {
+                break;
+            }
+            in->block_left -= len;
+        }
+        if (rec->flags & FLAG_DELETED) {
+            continue;  /* 墓碑行不是有效记录，不写入结果 */
+        }
+        return 1;
+    }
+    if (in->format == EXT_SNAPSHOT) {
+        fprintf(stderr, "错误：读取记录失败！文件可能已损坏。\n");
+        return -1;
+    }
+
+    /* CSV：解析规则与导入相同，格式错误的行跳过 */
+    char line[256];
+    while (fgets(line, sizeof(line), in->fp) != NULL) {
+        in->line++;
+        if (in->line == 1) {
+            continue;  /* 表头 */
+        }
+        char name[MAX_NAME_LEN];
+        int id, age;
+        double score;
+        if (sscanf(line, "%d,%63[^,],%d,%lf", &id, name, &age, &score) != 4 || age < 1 || age > 150) {
+            fprintf(stderr, "警告：第%d行格式错误，跳过。\n", in->line);
+            stats->skipped++;
+            continue;
+        }
+        rec->id = id;
+        rec->score = score;
+        rec->age = (uint8_t)age;
+        rec->flags = 0;
+        rec->name_len = (uint8_t)strlen(name);
+        memcpy(rec->name, name, rec->name_len);
+        rec->key = ext_key(ext_field, rec->id, rec->score, rec->age, rec->name, rec->name_len);
+        if (id >= in->next_id) {
+            in->next_id = id + 1;
+        }
+        return 1;
+    }
+    return ferror(in->fp) ? -1 : 0;
+}
+
+/*
+ * ==================== 输出 ====================
+ */
+
+static int ext_open_writer(ExtWriter *w, const char *path, ExtFormat format, bool run,
+                           char *iobuf, size_t iobuf_size) {
+    w->fp = fopen(path, "wb");
+    if (w->fp == NULL) {
+        fprintf(stderr, "错误：无法打开文件 '%s' 进行写入！\n", path);
+        perror("fopen");
+        return -1;
+    }
+    setvbuf(w->fp, iobuf, _IOFBF, iobuf_size);
+    w->format = format;
+    w->run = run;
+    w->ob = NULL;
+    w->bytes = 0;
+    if (format == EXT_CSV && !run) {
+        w->ob = malloc(sizeof(OutBuf));
+        if (w->ob == NULL) {
+            printf("内存分配失败！\n");
+            fclose(w->fp);
+            return -1;
+        }
+        out_init(w->ob, w->fp);
+        out_puts(w->ob, "id,name,age,score\n");
+    }
+    return 0;
+}
+
+/* 写快照文件头（记录数在第一阶段结束时已知） */
+static int ext_write_header(ExtWriter *w, uint64_t count, int32_t next_id) {
+    if (w->run || w->format != EXT_SNAPSHOT) {
+        return 0;
+    }
+    int n = (int)count;
+    if (fwrite(EXT_MAGIC, 1, EXT_MAGIC_LEN, w->fp) != EXT_MAGIC_LEN ||
+        fwrite(&n, sizeof(int), 1, w->fp) != 1 ||
+        fwrite(&next_id, sizeof(int), 1, w->fp) != 1) {
+        return -1;
+    }
+    w->bytes += EXT_MAGIC_LEN + 2 * sizeof(int);
+    return 0;
+}
+
+static int ext_write(ExtWriter *w, const ExtRecord *rec) {
+    if (w->ob != NULL) {
+        out_int(w->ob, rec->id);
+        out_char(w->ob, ',');
+        out_write(w->ob, rec->name, rec->name_len);
+        out_char(w->ob, ',');
+        out_int(w->ob, rec->age);
+        out_char(w->ob, ',');
+        out_fixed2(w->ob, rec->score);
+        out_char(w->ob, '\n');
+        return 0;
+    }
+    unsigned char buf[EXT_REC_MAX];
+    size_t n = ext_encode(rec, buf);
+    if (fwrite(buf, 1, n, w->fp) != n) {
+        return -1;
+    }
+    w->bytes += n;
+    return 0;
+}
+
+/* 写出编码区中的一条记录（第一阶段，直接复制编码） */
+static int ext_write_encoded(ExtWriter *w, const unsigned char *enc) {
+    if (w->ob != NULL) {
+        ExtRecord rec;
+        memcpy(&rec.id, enc, 4);
+        memcpy(&rec.score, enc + 4, 8);
+        rec.age = enc[12];
+        rec.flags = enc[13];
+        rec.name_len = enc[14];
+        memcpy(rec.name, enc + EXT_REC_FIXED, rec.name_len);
+        return ext_write(w, &rec);
+    }
+    size_t n = EXT_REC_FIXED + enc[14];
+    if (fwrite(enc, 1, n, w->fp) != n) {
+        return -1;
+    }
+    w->bytes += n;
+    return 0;
+}
+
+static int ext_close_writer(ExtWriter *w) {
+    if (w->ob != NULL) {
+        out_flush(w->ob);
+        free(w->ob);
+        w->ob = NULL;
+    }
+    bool failed = ferror(w->fp) != 0;
+    if (fclose(w->fp) != 0 || failed) {
+        fprintf(stderr, "错误：写入文件失败！\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * ==================== 顺串文件列表 ====================
+ */
+
+typedef struct ExtRunList {
+    char **paths;
+    int n;
+    int cap;
+    int next_seq;               // 下一个顺串文件的序号
+    unsigned long tag;          // 本次排序的临时文件标记
+    const char *dir;
+} ExtRunList;
+
+/* 生成新的顺串文件名并加入列表 */
+static char *ext_new_run(ExtRunList *list) {
+    if (list->n == list->cap) {
+        int cap = list->cap > 0 ? list->cap * 2 : 16;
+        char **paths = realloc(list->paths, sizeof(char *) * cap);
+        if (paths == NULL) {
+            return NULL;
+        }
+        list->paths = paths;
+        list->cap = cap;
+    }
+    size_t len = strlen(list->dir) + 48;
+    char *path = malloc(len);
+    if (path == NULL) {
+        return NULL;
+    }
+    snprintf(path, len, "%s/minidb-sort-%lx-%d.run", list->dir, list->tag, list->next_seq++);
+    list->paths[list->n++] = path;
+    return path;
+}
+
+/* 删除列表中前 k 个顺串文件 */
+static void ext_drop_runs(ExtRunList *list, int k) {
+    for (int i = 0; i < k; i++) {
+        remove(list->paths[i]);
+        free(list->paths[i]);
+    }
+    if (list->n > k) {
+        memmove(list->paths, list->paths + k, sizeof(char *) * (list->n - k));
+    }
+    list->n -= k;
+}
+
+/*
+ * ==================== 败者树归并 ====================
+ */
+
+/* 顺串 a 的当前记录是否排在 b 之前（读完的顺串视为无穷大） */
+static bool ext_run_less(const ExtRun *runs, int a, int b) {
+    if (runs[a].done || runs[b].done) {
+        return !runs[a].done;
+    }
+    return ext_compare(&runs[a].rec, &runs[b].rec) < 0;
+}
+
+/*
+ * ext_merge - 败者树 k 路归并
+ * tree[1..k-1] 为内部结点，保存比赛的败者；tree[0] 为总冠军。
+ * 取出冠军后只需沿其叶子到根的一条路径重赛，每条记录 log2(k) 次比较
+ */
+static int ext_merge(ExtRunList *list, int k, ExtWriter *w, size_t buf_size) {
+    ExtRun *runs = calloc(k, sizeof(ExtRun));
+    int *tree = malloc(sizeof(int) * k);
+    int ret = -1;
+    int opened = 0;
+    if (runs == NULL || tree == NULL) {
+        printf("内存分配失败！\n");
+        goto out;
+    }
+
+    for (int i = 0; i < k; i++) {
+        runs[i].path = list->paths[i];
+        runs[i].fp = fopen(runs[i].path, "rb");
+        runs[i].buf = malloc(buf_size);
+        if (runs[i].fp == NULL || runs[i].buf == NULL) {
+            fprintf(stderr, "错误：无法打开临时文件 '%s'！\n", runs[i].path);
+            if (runs[i].fp != NULL) {
+                fclose(runs[i].fp);
+            }
+            free(runs[i].buf);
+            goto out;
+        }
+        opened++;
+        setvbuf(runs[i].fp, runs[i].buf, _IOFBF, buf_size);
+        int r = ext_read_encoded(runs[i].fp, &runs[i].rec);
+        if (r < 0) {
+            fprintf(stderr, "错误：临时文件 '%s' 已损坏！\n", runs[i].path);
+            goto out;
+        }
+        runs[i].done = r == 0;
+    }
+
+    /* 自底向上建树：win[k + i] 为叶子 i，win[node] 为子树冠军 */
+    if (k == 1) {
+        tree[0] = 0;
+    } else {
+        int *win = malloc(sizeof(int) * 2 * k);
+        if (win == NULL) {
+            printf("内存分配失败！\n");
+            goto out;
+        }
+        for (int i = 0; i < k; i++) {
+            win[k + i] = i;
+        }
+        for (int node = k - 1; node >= 1; node--) {
+            int a = win[2 * node], b = win[2 * node + 1];
+            if (ext_run_less(runs, a, b)) {
+                win[node] = a;
+                tree[node] = b;
+            } else {
+                win[node] = b;
+                tree[node] = a;
+            }
+        }
+        tree[0] = win[1];
+        free(win);
+    }
+
+    for (;;) {
+        int champ = tree[0];
+        if (runs[champ].done) {
+            break;  /* 冠军也已读完：全部归并完毕 */
+        }
+        if (ext_write(w, &runs[champ].rec) != 0) {
+            fprintf(stderr, "错误：写入文件失败！\n");
+            goto out;
+        }
+        int r = ext_read_encoded(runs[champ].fp, &runs[champ].rec);
+        if (r < 0) {
+            fprintf(stderr, "错误：临时文件 '%s' 已损坏！\n", runs[champ].path);
+            goto out;
+        }
+        runs[champ].done = r == 0;
+
+        /* 沿叶子到根重赛：败者留在结点上，胜者继续向上 */
+        int winner = champ;
+        for (int node = (k + champ) / 2; node >= 1; node /= 2) {
+            if (ext_run_less(runs, tree[node], winner)) {
+                int t = tree[node];
+                tree[node] = winner;
+                winner = t;
+            }
+        }
+        tree[0] = winner;
+    }
+    ret = 0;
+
+out:
+    for (int i = 0; i < opened; i++) {
+        fclose(runs[i].fp);
+        free(runs[i].buf);
+    }
+    free(runs);
+    free(tree);
+    return ret;
+}
+
+/*
+ * ==================== 主流程 ====================
+ */
+
+void extsort_options_init(ExtSortOptions *opt, int field) {
+    opt->field = field;
+    opt->memory = EXTSORT_DEFAULT_MEMORY;
+    opt->temp_dir = NULL;
+}
+
+/*
+ * ext_sort_block - 排序编码区中的记录并写出（顺串或最终结果）
+ */
+static int ext_sort_block(unsigned char *block, ExtEntry *entries, size_t n, ExtWriter *w) {
+    ext_arena = block;
+    qsort(entries, n, sizeof(ExtEntry), compare_entry);
+    ext_arena = NULL;
+    for (size_t i = 0; i < n; i++) {
+        if (ext_write_encoded(w, block + entries[i].off) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * extsort_file - 对 input 排序，结果写入 output（格式与 input 相同）
+ * 返回值：0 表示成功，-1 表示失败（临时文件总会被删除）
+ */
+int extsort_file(const char *input, const char *output,
+                 const ExtSortOptions *opt, ExtSortStats *stats) {
+    if (input == NULL || output == NULL || opt == NULL || stats == NULL) {
+        fprintf(stderr, "错误：参数为空！\n");
+        return -1;
+    }
+    if (strcmp(input, output) == 0) {
+        fprintf(stderr, "错误：输出文件不能与输入文件相同！\n");
+        return -1;
+    }
+    if (opt->field < SORT_BY_ID || opt->field > SORT_BY_SCORE) {
+        printf("错误：未知的排序字段！\n");
+        return -1;
+    }
+    memset(stats, 0, sizeof(*stats));
+    clock_t start = clock();
+    ext_field = opt->field;
+
+    /* 内存划分：输入、输出各一个缓冲区，其余为编码区 + 排序项 */
+    size_t memory = opt->memory < EXTSORT_MIN_MEMORY ? EXTSORT_MIN_MEMORY : opt->memory;
+    size_t io_size = memory / 16 > EXTSORT_MIN_BUFFER ? memory / 16 : EXTSORT_MIN_BUFFER;
+    size_t block_size = (memory - 2 * io_size) & ~(size_t)15;
+    char *in_buf = malloc(io_size);
+    char *out_buf = malloc(io_size);
+    unsigned char *block = malloc(block_size);
+    ExtRunList list = {NULL, 0, 0, 0, 0, opt->temp_dir != NULL ? opt->temp_dir : "."};
+    list.tag = ((unsigned long)time(NULL) << 8) ^ (unsigned long)clock();
+    ExtReader in;
+    ExtWriter w;
+    int ret = -1;
+    bool in_open = false;
+
+    if (in_buf == NULL || out_buf == NULL || block == NULL) {
+        printf("内存分配失败！\n");
+        goto out;
+    }
+    if (ext_open_input(&in, input, in_buf, io_size) != 0) {
+        goto out;
+    }
+    in_open = true;
+
+    /* 第一阶段：生成顺串 */
+    ExtRecord rec;
+    bool eof = false;
+    while (!eof) {
+        size_t used = 0, n = 0;
+        ExtEntry *top = (ExtEntry *)(block + block_size);
+        int r;
+        while ((r = ext_read_input(&in, &rec, stats)) == 1) {
+            size_t len = EXT_REC_FIXED + rec.name_len;
+            ExtEntry *e = top - (n + 1);
+            ext_encode(&rec, block + used);
+            e->key = rec.key;
+            e->off = used;
+            used += len;
+            n++;
+            stats->records++;
+            /* 编码区和排序项相向增长，留出一条最长记录的余量；
+             * qsort 归并时另需一份排序项大小的临时空间，也从块中预留（预留部分从不写入） */
+            if (used + EXT_REC_MAX + (n + 1) * 2 * sizeof(ExtEntry) > block_size) {
+                break;
+            }
+        }
+        if (r < 0) {
+            goto out;
+        }
+        eof = r == 0;
+        ExtEntry *entries = top - n;
+
+        if (eof && stats->runs == 0) {
+            /* 一块就装下了全部输入：直接写出最终结果 */
+            if (ext_open_writer(&w, output, in.format, false, out_buf, io_size) != 0) {
+                goto out;
+            }
+            if (ext_write_header(&w, stats->records, in.next_id) != 0 ||
+                ext_sort_block(block, entries, n, &w) != 0) {
+                ext_close_writer(&w);
+                goto out;
+            }
+            stats->passes = 1;
+            ret = ext_close_writer(&w);
+            goto out;
+        }
+        if (n == 0) {
+            break;
+        }
+        char *path = ext_new_run(&list);
+        if (path == NULL || ext_open_writer(&w, path, in.format, true, out_buf, io_size) != 0) {
+            goto out;
+        }
+        if (ext_sort_block(block, entries, n, &w) != 0) {
+            ext_close_writer(&w);
+            goto out;
+        }
+        stats->temp_bytes += w.bytes;
+        stats->runs++;
+        if (ext_close_writer(&w) != 0) {
+            goto out;
+        }
+    }
+    fclose(in.fp);
+    free(in.map);
+    in_open = false;
+    free(block);
+    block = NULL;
+    free(in_buf);
+    in_buf = NULL;
+
+    if (in.format == EXT_SNAPSHOT && stats->records > 0x7FFFFFFF) {
+        fprintf(stderr, "错误：记录数超出快照格式的上限！\n");
+        goto out;
+    }
+
+    /* 第二阶段：多趟归并，每趟最多 fan_in 路，每个文件一块缓冲区 */
+    int fan_in = (int)(memory / EXTSORT_MIN_BUFFER) - 1;
+    if (fan_in < 2) {
+        fan_in = 2;
+    }
+    free(out_buf);
+    out_buf = NULL;
+    while (list.n > fan_in) {
+        int k = fan_in;
+        size_t buf_size = memory / (k + 1);
+        char *merge_out = malloc(buf_size);
+        char *path = ext_new_run(&list);
+        if (merge_out == NULL || path == NULL ||
+            ext_open_writer(&w, path, in.format, true, merge_out, buf_size) != 0) {
+            free(merge_out);
+            goto out;
+        }
+        int m = ext_merge(&list, k, &w, buf_size);
+        stats->temp_bytes += w.bytes;
+        int c = ext_close_writer(&w);
+        free(merge_out);
+        if (m != 0 || c != 0) {
+            goto out;
+        }
+        ext_drop_runs(&list, k);
+        stats->passes++;
+    }
+
+    int k = list.n;
+    size_t buf_size = memory / (k + 1);
+    out_buf = malloc(buf_size);
+    if (out_buf == NULL || ext_open_writer(&w, output, in.format, false, out_buf, buf_size) != 0) {
+        goto out;
+    }
+    if (ext_write_header(&w, stats->records, in.next_id) != 0 || ext_merge(&list, k, &w, buf_size) != 0) {
+        ext_close_writer(&w);
+        goto out;
+    }
+    stats->passes++;
+    ret = ext_close_writer(&w);
+
+out:
+    if (in_open) {
+        fclose(in.fp);
+        free(in.map);
+    }
+    ext_drop_runs(&list, list.n);
+    free(list.paths);
+    free(block);
+    free(in_buf);
+    free(out_buf);
+    stats->seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    return ret;
+}
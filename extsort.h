@@ -0,0 +1,42 @@
+/*
+ * extsort.h - MiniDB 外部排序头文件
+ * 对快照（.dat，第 2、3 版）或 CSV 文件排序，输出同类的新文件（快照写成第 2 版），数据不必全部装入内存：
+ * 按内存上限分批读入、排序后写成有序的临时顺串，再用败者树多路归并；
+ * 顺串过多时分多趟归并，每个文件都配大块缓冲区，顺序读写
+ */
+
+#ifndef EXTSORT_H
+#define EXTSORT_H
+
+#include "db.h"
+
+#define EXTSORT_DEFAULT_MEMORY  (64u << 20)   // 默认内存上限：64 MB
+#define EXTSORT_MIN_MEMORY      (1u << 20)    // 内存上限的最小值：1 MB
+#define EXTSORT_MIN_BUFFER      (64u << 10)   // 归并时每个文件至少分到的缓冲区
+
+/*
+ * 外部排序选项
+ */
+typedef struct ExtSortOptions {
+    int field;              // 排序字段（SortField），键相同时按 ID 升序
+    size_t memory;          // 内存上限（字节），包括读写缓冲区
+    const char *temp_dir;   // 临时顺串所在目录，NULL 表示当前目录
+} ExtSortOptions;
+
+/*
+ * 排序过程统计
+ */
+typedef struct ExtSortStats {
+    uint64_t records;       // 记录数
+    uint64_t skipped;       // 跳过的格式错误行（仅 CSV）
+    int runs;               // 初始顺串数
+    int passes;             // 归并趟数（包括写出结果的最后一趟）
+    uint64_t temp_bytes;    // 写入临时文件的总字节数
+    double seconds;         // 用时
+} ExtSortStats;
+
+void extsort_options_init(ExtSortOptions *opt, int field);   // 默认选项：64 MB、当前目录
+int extsort_file(const char *input, const char *output,
+                 const ExtSortOptions *opt, ExtSortStats *stats);  // 排序文件，0 成功 / -1 失败
+
+#endif /* EXTSORT_H */
@@ -0,0 +1,154 @@
+/*
+ * filter.c - MiniDB 批量谓词过滤实现
+ * 行存储是 16 字节的行（成绩 8 字节 | ID 4 字节 | 年龄、标志、保留 4 字节），
+ * 一次读入 4 行（4 个 128 位寄存器），用解包指令转置出
+ * 4 个 ID、4 个"年龄 | 标志 << 8"和 2 × 2 个成绩，所有数值谓词各做一次
+ * 向量比较后按位与成 4 位掩码，再无分支地写入选择向量
+ */
+
+#include "filter.h"
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FILTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* 转置依赖 Record 的字段偏移，布局变化时在这里编译失败 */
+typedef char filter_record_layout_check[
+    (sizeof(Record) == 16 && offsetof(Record, score) == 0 && offsetof(Record, id) == 8 &&
+     offsetof(Record, age) == 12 && offsetof(Record, flags) == 13) ? 1 : -1];
+
+/*
+ * 数值谓词的归一化形式：不限的条件换成恒真的范围，
+ * 墓碑标志总是放进"必须关闭"
+ */
+typedef struct FilterBounds {
+    int age_lo, age_hi;     // 年龄范围（含）
+    uint32_t set, clear;    // 标志位掩码（已左移 8 位，对齐"年龄 | 标志 << 8"）
+    int check_id;           // 是否比较 ID（0 或 1）
+    int32_t id;
+    int check_score;        // 是否比较成绩（0 或 1）
+    double score_min, score_max;
+} FilterBounds;
+
+static void filter_bounds(const Query *q, FilterBounds *b) {
+    b->age_lo = q->age_min > 0 ? q->age_min : 0;
+    b->age_hi = q->age_max > 0 && q->age_max < 255 ? q->age_max : 255;
+    b->set = (uint32_t)q->flags_set << 8;
+    b->clear = (uint32_t)(q->flags_clear | FLAG_DELETED) << 8;
+    b->check_id = q->id > 0 ? 1 : 0;
+    b->id = q->id;
+    b->check_score = q->has_score ? 1 : 0;
+    b->score_min = q->score_min;
+    b->score_max = q->score_max;
+}
+
+/* 标量版本：比较结果直接加到写指针上，不因行是否满足条件而分支 */
+static size_t filter_scalar(const Record *rows, const FilterBounds *b, uint32_t base,
+                            uint32_t from, uint32_t to, uint32_t *sel, size_t k) {
+    for (uint32_t i = from; i < to; i++) {
+        const Record *r = &rows[i];
+        uint32_t w = r->age | (uint32_t)r->flags << 8;
+        int m = (r->age >= b->age_lo) & (r->age <= b->age_hi) &
+                ((w & b->set) == b->set) & ((w & b->clear) == 0) &
+                ((b->check_id ^ 1) | (r->id == b->id)) &
+                ((b->check_score ^ 1) | ((r->score >= b->score_min) & (r->score <= b->score_max)));
+        sel[k] = base + i;
+        k += m;
+    }
+    return k;
+}
+
+#ifdef FILTER_SSE2
+/* SSE2 版本：每次 4 行，尾部不足 4 行交给标量版本 */
+static size_t filter_sse2(const Record *rows, const FilterBounds *b, uint32_t base,
+                          uint32_t n, uint32_t *sel) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i age_mask = _mm_set1_epi32(0xFF);
+    const __m128i age_lo = _mm_set1_epi32(b->age_lo - 1);
+    const __m128i age_hi = _mm_set1_epi32(b->age_hi + 1);
+    const __m128i set = _mm_set1_epi32((int)b->set);
+    const __m128i clear = _mm_set1_epi32((int)b->clear);
+    const __m128i id = _mm_set1_epi32(b->id);
+    const __m128d score_min = _mm_set1_pd(b->score_min);
+    const __m128d score_max = _mm_set1_pd(b->score_max);
+    size_t k = 0;
+    uint32_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        const __m128i *p = (const __m128i *)(rows + i);
+        __m128i r0 = _mm_loadu_si128(p);
+        __m128i r1 = _mm_loadu_si128(p + 1);
+        __m128i r2 = _mm_loadu_si128(p + 2);
+        __m128i r3 = _mm_loadu_si128(p + 3);
+        __m128i t0 = _mm_unpackhi_epi32(r0, r1);        // id0 id1 w0 w1
+        __m128i t1 = _mm_unpackhi_epi32(r2, r3);        // id2 id3 w2 w3
+        __m128i w = _mm_unpackhi_epi64(t0, t1);         // 年龄 | 标志 << 8 | 保留 << 16
+        __m128i age = _mm_and_si128(w, age_mask);
+
+        __m128i m = _mm_and_si128(_mm_cmpgt_epi32(age, age_lo), _mm_cmplt_epi32(age, age_hi));
+        m = _mm_and_si128(m, _mm_cmpeq_epi32(_mm_and_si128(w, set), set));
+        m = _mm_and_si128(m, _mm_cmpeq_epi32(_mm_and_si128(w, clear), zero));
+        if (b->check_id) {
+            m = _mm_and_si128(m, _mm_cmpeq_epi32(_mm_unpacklo_epi64(t0, t1), id));
+        }
+        if (b->check_score) {
+            __m128d s01 = _mm_castsi128_pd(_mm_unpacklo_epi64(r0, r1));
+            __m128d s23 = _mm_castsi128_pd(_mm_unpacklo_epi64(r2, r3));
+            __m128d m01 = _mm_and_pd(_mm_cmpge_pd(s01, score_min), _mm_cmple_pd(s01, score_max));
+            __m128d m23 = _mm_and_pd(_mm_cmpge_pd(s23, score_min), _mm_cmple_pd(s23, score_max));
+            /* 两个 64 位掩码各取低 32 位，拼成 4 个 32 位掩码 */
+            __m128 ms = _mm_shuffle_ps(_mm_castpd_ps(m01), _mm_castpd_ps(m23), _MM_SHUFFLE(2, 0, 2, 0));
+            m = _mm_and_si128(m, _mm_castps_si128(ms));
+        }
+
+        int bits = _mm_movemask_ps(_mm_castsi128_ps(m));
+        sel[k] = base + i;
+        k += bits & 1;
+        sel[k] = base + i + 1;
+        k += (bits >> 1) & 1;
+        sel[k] = base + i + 2;
+        k += (bits >> 2) & 1;
+        sel[k] = base + i + 3;
+        k += (bits >> 3) & 1;
+    }
+    return filter_scalar(rows, b, base, i, n, sel, k);
+}
+#endif
+
+/*
+ * filter_batch - 过滤行区间 [from, from + n)，n 不超过 FILTER_BATCH
+ * 先用数值谓词得到选择向量，姓名子串只在幸存行上检查
+ * 返回值：满足全部条件的行数，行下标按升序写入 sel
+ */
+size_t filter_batch(const Database *db, const Query *q, uint32_t from, uint32_t n, uint32_t *sel) {
+    FilterBounds b;
+    filter_bounds(q, &b);
+    const Record *rows = db->rows + from;
+#ifdef FILTER_SSE2
+    size_t k = filter_sse2(rows, &b, from, n, sel);
+#else
+    size_t k = filter_scalar(rows, &b, from, 0, n, sel, 0);
+#endif
+
+    if (q->name_like != NULL) {
+        size_t m = 0;
+        for (size_t j = 0; j < k; j++) {
+            if (strstr(db_name(db, &db->rows[sel[j]]), q->name_like) != NULL) {
+                sel[m++] = sel[j];
+            }
+        }
+        k = m;
+    }
+    return k;
+}
+
+const char *filter_isa(void) {
+#ifdef FILTER_SSE2
+    return "SSE2";
+#else
+    return "标量";
+#endif
+}
@@ -0,0 +1,18 @@
+/*
+ * filter.h - MiniDB 批量谓词过滤头文件
+ * 全表扫描时按批（FILTER_BATCH 行）求值：数值谓词（ID、年龄、成绩、标志）
+ * 用 SIMD 比较一次算出整批的选择掩码，再把幸存行压成选择向量，
+ * 姓名子串只在选择向量上检查；不支持 SSE2 的平台退回无分支的标量循环
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "query.h"
+
+#define FILTER_BATCH 1024  // 每批的行数（选择向量 4 KB，留在 L1 缓存内）
+
+size_t filter_batch(const Database *db, const Query *q, uint32_t from, uint32_t n, uint32_t *sel);  // 过滤 [from, from + n)，幸存行下标写入 sel，返回个数
+const char *filter_isa(void);  // 当前使用的指令集（用于输出）
+
+#endif /* FILTER_H */
@@ -0,0 +1,677 @@
+/*
+ * fuzzy.c - MiniDB 模糊姓名查找实现
+ * 筛选：姓名按码点取二元组，首尾各加一个边界符，长 n 的姓名有 n + 1 个二元组；
+ *   每次编辑最多破坏关键字的 q 个二元组（替换、插入、删除 q = 2，相邻交换 q = 3），
+ *   距离不超过 k 的姓名至少包含关键字 m + 1 个二元组中的 T = m + 1 - q * k 个（按重数计）。
+ *   T > 0 时，按倒排表从短到长取关键字的二元组，凑够 q * k + 1 个（按重数计），
+ *   满足条件的姓名必然出现在这几张倒排表中的某一张里，其余倒排表不必读取；
+ *   T <= 0（关键字太短）时筛选无效，改为扫描长度在 [m - k, m + k] 内的姓名
+ * 验证：关键字不超过 64 个码点，用一个 64 位字的位并行算法逐码点计算整体编辑距离，
+ *   当前距离减去剩余码点数已超过 k 时提前结束
+ * 索引建在字符串堆中去重后的姓名上，与查询索引一样按行存储版本失效，
+ * 之后追加的尾部行逐行验证，尾部过长时重建
+ */
+
+#include "fuzzy.h"
+#include "query.h"
+#include "output.h"
+#include "utils.h"
+#include "namesort.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FUZZY_BEGIN 0x110000u   // 姓名开头的边界符（大于任何码点）
+#define FUZZY_END   0x110001u   // 姓名结尾的边界符
+
+/* 姓名模糊查找索引 */
+struct FuzzyIndex {
+    uint32_t version;           // 对应的行存储版本
+    uint32_t built;             // 建索引时的行数，之后追加的行在查找时逐行验证
+    uint32_t nnames;            // 不同姓名的个数
+    uint32_t *name_offs;        // 第 i 个姓名在字符串堆中的偏移
+    uint8_t *name_cps;          // 第 i 个姓名的码点数
+    uint32_t *name_row_start;   // 第 i 个姓名的行位于 name_rows[name_row_start[i], name_row_start[i + 1])
+    uint32_t *name_rows;        // 按姓名分组的行下标（组内按行下标升序）
+    uint32_t len_start[FUZZY_MAX_CPS + 2];  // 码点数为 n 的姓名位于 len_names[len_start[n], len_start[n + 1])
+    uint32_t *len_names;        // 按码点数分组的姓名编号
+    uint32_t ngrams;            // 不同二元组（散列值）的个数
+    uint32_t *gram_codes;       // 二元组散列值（升序）
+    uint32_t *gram_start;       // 第 i 个二元组的姓名位于 gram_names[gram_start[i], gram_start[i + 1])
+    uint32_t *gram_names;       // 倒排表：包含该二元组的姓名编号（升序，不重复）
+};
+
+/*
+ * 关键字：码点序列与位并行算法的匹配位向量
+ * peq(c) 的第 i 位表示关键字第 i 个码点等于 c
+ */
+typedef struct FuzzyPattern {
+    uint32_t cps[FUZZY_MAX_CPS];
+    int m;
+    uint64_t ascii[128];        // ASCII 码点直接查表
+    uint32_t keys[128];         // 其他码点：开放寻址表（0 表示空槽）
+    uint64_t masks[128];
+} FuzzyPattern;
+
+/* 一个匹配的姓名（或尾部的一行） */
+typedef struct FuzzyHit {
+    uint32_t off;               // 姓名在字符串堆中的偏移
+    uint32_t ref;               // 姓名编号（tail 为 false）或行下标（tail 为 true）
+    uint8_t dist;
+    bool tail;
+} FuzzyHit;
+
+/* 二元组散列：只用于筛选，冲突只会多出候选，不会漏掉结果 */
+static uint32_t gram_code(uint32_t a, uint32_t b) {
+    uint32_t h = a * 0x9E3779B1u + b;
+    h ^= h >> 15;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    return h;
+}
+
+/* 姓名的码点数 */
+static int count_cps(const char *s, size_t len) {
+    const char *end = s + len;
+    int n = 0;
+    while (s < end) {
+        utf8_next(&s, end);
+        n++;
+    }
+    return n;
+}
+
+void fuzzy_index_free(struct FuzzyIndex *index) {
+    if (index == NULL) {
+        return;
+    }
+    free(index->name_offs);
+    free(index->name_cps);
+    free(index->name_row_start);
+    free(index->name_rows);
+    free(index->len_names);
+    free(index->gram_codes);
+    free(index->gram_start);
+    free(index->gram_names);
+    free(index);
+}
+
+/*
+ * sort_pairs - 按高 32 位的二元组散列值排序 (散列值, 姓名编号) 对
+ * 两趟 16 位 LSD 基数排序，稳定：输入按姓名编号升序，输出同一散列值内仍然升序
+ */
+static bool sort_pairs(uint64_t *pairs, size_t n) {
+    uint64_t *tmp = malloc(sizeof(uint64_t) * (n > 0 ? n : 1));
+    size_t *pos = malloc(sizeof(size_t) * 65536);
+    if (tmp == NULL || pos == NULL) {
+        free(tmp);
+        free(pos);
+        return false;
+    }
+    uint64_t *src = pairs, *dst = tmp;
+    for (int shift = 32; shift < 64; shift += 16) {
+        memset(pos, 0, sizeof(size_t) * 65536);
+        for (size_t i = 0; i < n; i++) {
+            pos[(src[i] >> shift) & 0xFFFF]++;
+        }
+        size_t sum = 0;
+        for (int b = 0; b < 65536; b++) {
+            size_t c = pos[b];
+            pos[b] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            dst[pos[(src[i] >> shift) & 0xFFFF]++] = src[i];
+        }
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    /* 两趟之后结果回到 pairs */
+    free(tmp);
+    free(pos);
+    return true;
+}
+
+/*
+ * fuzzy_build - 建立索引
+ *   1. 顺序遍历字符串堆，给每个姓名编号并记下码点数，取出全部二元组；
+ *   2. 按姓名编号对行下标计数排序，按码点数对姓名编号计数排序；
+ *   3. (散列值, 姓名编号) 排序后去重，压成倒排表
+ */
+static struct FuzzyIndex *fuzzy_build(const Database *db) {
+    const StrHeap *heap = &db->name_heap;
+    uint32_t n = (uint32_t)db->count;
+    uint32_t nnames = 0;
+    size_t npairs = 0;
+    for (size_t off = 0; off < heap->used; off += strlen(heap->data + off) + 1) {
+        const char *s = heap->data + off;
+        npairs += (size_t)count_cps(s, strlen(s)) + 1;
+        nnames++;
+    }
+
+    struct FuzzyIndex *index = calloc(1, sizeof(*index));
+    uint32_t *id_of = malloc(sizeof(uint32_t) * heap->used);  /* 堆偏移 -> 姓名编号 */
+    uint64_t *pairs = malloc(sizeof(uint64_t) * npairs);
+    if (index == NULL || id_of == NULL || pairs == NULL ||
+        (index->name_offs = malloc(sizeof(uint32_t) * nnames)) == NULL ||
+        (index->name_cps = malloc(nnames)) == NULL ||
+        (index->name_row_start = calloc(nnames + 2, sizeof(uint32_t))) == NULL ||
+        (index->name_rows = malloc(sizeof(uint32_t) * (n > 0 ? n : 1))) == NULL ||
+        (index->len_names = malloc(sizeof(uint32_t) * nnames)) == NULL) {
+        free(id_of);
+        free(pairs);
+        fuzzy_index_free(index);
+        return NULL;
+    }
+
+    uint32_t id = 0;
+    npairs = 0;
+    for (size_t off = 0; off < heap->used; id++) {
+        const char *s = heap->data + off;
+        const char *end = s + strlen(s);
+        index->name_offs[id] = (uint32_t)off;
+        id_of[off] = id;
+        uint32_t prev = FUZZY_BEGIN;
+        int cps = 0;
+        while (s < end) {
+            uint32_t c = utf8_next(&s, end);
+            pairs[npairs++] = ((uint64_t)gram_code(prev, c) << 32) | id;
+            prev = c;
+            cps++;
+        }
+        pairs[npairs++] = ((uint64_t)gram_code(prev, FUZZY_END) << 32) | id;
+        index->name_cps[id] = (uint8_t)cps;
+        index->len_start[cps + 1]++;
+        off = (size_t)(end - heap->data) + 1;
+    }
+    index->nnames = nnames;
+
+    /* 按姓名编号计数排序行下标 */
+    uint32_t *row_start = index->name_row_start;
+    for (uint32_t i = 0; i < n; i++) {
+        row_start[id_of[db->names[i].off] + 2]++;
+    }
+    for (uint32_t i = 0; i < nnames; i++) {
+        row_start[i + 2] += row_start[i + 1];
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        index->name_rows[row_start[id_of[db->names[i].off] + 1]++] = i;
+    }
+    free(id_of);
+
+    /* 按码点数计数排序姓名编号 */
+    uint32_t fill[FUZZY_MAX_CPS + 1];
+    for (int len = 0; len <= FUZZY_MAX_CPS; len++) {
+        index->len_start[len + 1] += index->len_start[len];
+        fill[len] = index->len_start[len];
+    }
+    for (uint32_t i = 0; i < nnames; i++) {
+        index->len_names[fill[index->name_cps[i]]++] = i;
+    }
+
+    /* 倒排表：同一姓名内重复的二元组排序后相邻，只保留一次 */
+    if (!sort_pairs(pairs, npairs)) {
+        free(pairs);
+        fuzzy_index_free(index);
+        return NULL;
+    }
+    uint32_t ngrams = 0;
+    size_t nposts = 0;
+    for (size_t i = 0; i < npairs; i++) {
+        if (i == 0 || pairs[i] != pairs[i - 1]) {
+            nposts++;
+            if (i == 0 || (pairs[i] >> 32) != (pairs[i - 1] >> 32)) {
+                ngrams++;
+            }
+        }
+    }
+    index->gram_codes = malloc(sizeof(uint32_t) * (ngrams + 1));
+    index->gram_start = malloc(sizeof(uint32_t) * (ngrams + 1));
+    index->gram_names = malloc(sizeof(uint32_t) * (nposts + 1));
+    if (index->gram_codes == NULL || index->gram_start == NULL || index->gram_names == NULL) {
+        free(pairs);
+        fuzzy_index_free(index);
+        return NULL;
+    }
+    uint32_t g = 0;
+    size_t w = 0;
+    for (size_t i = 0; i < npairs; i++) {
+        if (i > 0 && pairs[i] == pairs[i - 1]) {
+            continue;
+        }
+        uint32_t code = (uint32_t)(pairs[i] >> 32);
+        if (g == 0 || code != index->gram_codes[g - 1]) {
+            index->gram_codes[g] = code;
+            index->gram_start[g] = (uint32_t)w;
+            g++;
+        }
+        index->gram_names[w++] = (uint32_t)pairs[i];
+    }
+    index->gram_start[ngrams] = (uint32_t)w;
+    index->ngrams = ngrams;
+    free(pairs);
+
+    index->built = n;
+    index->version = db->row_version;
+    return index;
+}
+
+/* 取可用的索引：行下标未变，且建索引之后追加的尾部行不超过 1/QUERY_INDEX_REUSE，否则重建 */
+static const struct FuzzyIndex *fuzzy_index(Database *db, bool *built) {
+    struct FuzzyIndex *index = db->fuzzy;
+    uint32_t count = (uint32_t)db->count;
+    *built = false;
+    if (index != NULL && index->version == db->row_version && index->built <= count &&
+        (uint64_t)(count - index->built) * QUERY_INDEX_REUSE <= index->built) {
+        return index;
+    }
+    fuzzy_index_free(db->fuzzy);
+    db->fuzzy = fuzzy_build(db);
+    *built = db->fuzzy != NULL;
+    return db->fuzzy;
+}
+
+/*
+ * ==================== 位并行编辑距离 ====================
+ */
+
+static void pattern_init(FuzzyPattern *p) {
+    memset(p->ascii, 0, sizeof(p->ascii));
+    memset(p->keys, 0, sizeof(p->keys));
+    memset(p->masks, 0, sizeof(p->masks));
+    for (int i = 0; i < p->m; i++) {
+        uint32_t c = p->cps[i];
+        if (c < 128) {
+            p->ascii[c] |= 1ull << i;
+            continue;
+        }
+        uint32_t h = (c * 0x9E3779B1u) >> 25;
+        while (p->keys[h] != 0 && p->keys[h] != c) {
+            h = (h + 1) & 127;
+        }
+        p->keys[h] = c;
+        p->masks[h] |= 1ull << i;
+    }
+}
+
+static uint64_t pattern_peq(const FuzzyPattern *p, uint32_t c) {
+    if (c < 128) {
+        return p->ascii[c];
+    }
+    uint32_t h = (c * 0x9E3779B1u) >> 25;
+    while (p->keys[h] != 0) {
+        if (p->keys[h] == c) {
+            return p->masks[h];
+        }
+        h = (h + 1) & 127;
+    }
+    return 0;
+}
+
+/*
+ * fuzzy_verify - 关键字与姓名 s（n 个码点）的编辑距离，超过 k 时返回 k + 1
+ * Myers 位并行算法的整体距离形式（Hyyrö 2003）：VP / VN 为当前列相邻格的正负差，
+ * 最后一行的值 score 随每个码点增减；damerau 时按 Hyyrö 2002 在 D0 中加入相邻交换项
+ */
+static int fuzzy_verify(const FuzzyPattern *p, const char *s, size_t len, int n, int k, bool damerau) {
+    const char *end = s + len;
+    uint64_t vp = ~0ull, vn = 0, d0 = 0, pm_prev = 0;
+    uint64_t last = 1ull << (p->m - 1);
+    int score = p->m;
+    int left = n;
+    while (s < end) {
+        uint64_t pm = pattern_peq(p, utf8_next(&s, end));
+        uint64_t x = pm | vn;
+        if (damerau) {
+            x |= ((~d0 & pm) << 1) & pm_prev;
+        }
+        d0 = (((pm & vp) + vp) ^ vp) | x;
+        uint64_t hp = vn | ~(d0 | vp);
+        uint64_t hn = vp & d0;
+        if (hp & last) {
+            score++;
+        } else if (hn & last) {
+            score--;
+        }
+        hp = (hp << 1) | 1;
+        hn <<= 1;
+        vp = hn | ~(d0 | hp);
+        vn = hp & d0;
+        pm_prev = pm;
+        /* 之后每个码点最多使距离减 1 */
+        if (score - --left > k) {
+            return k + 1;
+        }
+    }
+    return score;
+}
+
+/*
+ * ==================== 查找 ====================
+ */
+
+/* 关键字的一个二元组：散列值、在关键字中的重数、倒排表位置 */
+typedef struct PatternGram {
+    uint32_t code;
+    int mult;
+    uint32_t start, len;
+} PatternGram;
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_gram_len(const void *a, const void *b) {
+    const PatternGram *x = a;
+    const PatternGram *y = b;
+    return (x->len > y->len) - (x->len < y->len);
+}
+
+/*
+ * sort_hits - 把 hits 的下标按距离、姓名排序写入 order
+ * 先按距离计数排序（稳定），每个距离内再按姓名排序（见 namesort.h），字符串堆显式传入；
+ * 姓名相同时按下标：索引中每个姓名只有一项且先于尾部行加入，尾部行按行下标升序加入
+ * 返回值：false 表示内存不足
+ */
+static bool sort_hits(const StrHeap *heap, const FuzzyHit *hits, size_t n, int k, uint32_t *order) {
+    size_t start[FUZZY_MAX_K + 2] = {0};
+    for (size_t i = 0; i < n; i++) {
+        start[hits[i].dist + 1]++;
+    }
+    for (int d = 0; d <= k; d++) {
+        start[d + 1] += start[d];
+    }
+    size_t fill[FUZZY_MAX_K + 1];
+    memcpy(fill, start, sizeof(fill));
+    for (size_t i = 0; i < n; i++) {
+        order[fill[hits[i].dist]++] = (uint32_t)i;
+    }
+    for (int d = 0; d <= k; d++) {
+        if (!name_sort(heap->data, &hits[0].off, sizeof(FuzzyHit), NULL, 0,
+                       order + start[d], start[d + 1] - start[d])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 在升序的散列值数组中二分查找，未找到返回 count */
+static uint32_t find_gram(const struct FuzzyIndex *index, uint32_t code) {
+    uint32_t lo = 0, hi = index->ngrams;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (index->gram_codes[mid] < code) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < index->ngrams && index->gram_codes[lo] == code ? lo : index->ngrams;
+}
+
+/*
+ * fuzzy_candidates - 用二元组倒排表筛选候选姓名
+ * 返回值：候选姓名编号个数（升序、不重复，存入 *out，调用者 free）；
+ *         *out 为 NULL 且返回 0 表示内存不足；筛选无效时返回 SIZE_MAX
+ */
+static size_t fuzzy_candidates(const struct FuzzyIndex *index, const FuzzyPattern *p,
+                               int k, bool damerau, uint32_t **out) {
+    int q = damerau ? 3 : 2;
+    int need = q * k + 1;   /* 要凑够的二元组个数（按重数计） */
+    *out = NULL;
+    if (p->m + 1 - q * k <= 0) {
+        return SIZE_MAX;
+    }
+
+    /* 关键字的 m + 1 个二元组，按散列值合并重复的 */
+    PatternGram grams[FUZZY_MAX_CPS + 1];
+    uint32_t codes[FUZZY_MAX_CPS + 1];
+    uint32_t prev = FUZZY_BEGIN;
+    for (int i = 0; i <= p->m; i++) {
+        uint32_t c = i < p->m ? p->cps[i] : FUZZY_END;
+        codes[i] = gram_code(prev, c);
+        prev = c;
+    }
+    qsort(codes, (size_t)p->m + 1, sizeof(uint32_t), compare_u32);
+    int ng = 0;
+    for (int i = 0; i <= p->m; i++) {
+        if (ng > 0 && grams[ng - 1].code == codes[i]) {
+            grams[ng - 1].mult++;
+            continue;
+        }
+        uint32_t g = find_gram(index, codes[i]);
+        grams[ng].code = codes[i];
+        grams[ng].mult = 1;
+        grams[ng].start = g < index->ngrams ? index->gram_start[g] : 0;
+        grams[ng].len = g < index->ngrams ? index->gram_start[g + 1] - index->gram_start[g] : 0;
+        ng++;
+    }
+
+    /* 从最短的倒排表开始取，凑够 need 个 */
+    qsort(grams, (size_t)ng, sizeof(PatternGram), compare_gram_len);
+    size_t total = 0;
+    int used = 0;
+    for (int covered = 0; covered < need; used++) {
+        covered += grams[used].mult;
+        total += grams[used].len;
+    }
+    uint32_t *cand = malloc(sizeof(uint32_t) * (total > 0 ? total : 1));
+    if (cand == NULL) {
+        return 0;
+    }
+    size_t n = 0;
+    for (int i = 0; i < used; i++) {
+        memcpy(cand + n, index->gram_names + grams[i].start, sizeof(uint32_t) * grams[i].len);
+        n += grams[i].len;
+    }
+    if (used > 1) {
+        qsort(cand, n, sizeof(uint32_t), compare_u32);
+        size_t w = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (w == 0 || cand[w - 1] != cand[i]) {
+                cand[w++] = cand[i];
+            }
+        }
+        n = w;
+    }
+    *out = cand;
+    return n;
+}
+
+/* 追加一个匹配 */
+static bool push_hit(FuzzyHit **hits, size_t *n, size_t *cap, FuzzyHit hit) {
+    if (*n == *cap) {
+        size_t grown = *cap > 0 ? *cap * 2 : 64;
+        FuzzyHit *p = realloc(*hits, sizeof(FuzzyHit) * grown);
+        if (p == NULL) {
+            return false;
+        }
+        *hits = p;
+        *cap = grown;
+    }
+    (*hits)[(*n)++] = hit;
+    return true;
+}
+
+/*
+ * fuzzy_search - 按编辑距离查找姓名
+ * 返回值：false 表示关键字无效或内存不足（已输出错误信息）
+ */
+bool fuzzy_search(Database *db, const FuzzyOptions *opt, FuzzyResult *result) {
+    memset(result, 0, sizeof(*result));
+    FuzzyPattern p;
+    const char *s = opt->pattern;
+    const char *end = s + strlen(s);
+    p.m = 0;
+    while (s < end && p.m < FUZZY_MAX_CPS) {
+        p.cps[p.m++] = utf8_next(&s, end);
+    }
+    if (p.m == 0 || s < end) {
+        printf("错误：关键字必须为 1-%d 个字符！\n", FUZZY_MAX_CPS);
+        return false;
+    }
+    if (opt->k < 0 || opt->k > FUZZY_MAX_K) {
+        printf("错误：编辑距离必须在 0-%d 之间！\n", FUZZY_MAX_K);
+        return false;
+    }
+    int k = opt->k;
+    pattern_init(&p);
+
+    const struct FuzzyIndex *index = fuzzy_index(db, &result->built);
+    if (index == NULL) {
+        printf("内存分配失败！\n");
+        return false;
+    }
+    result->names = index->nnames;
+
+    /* 候选姓名：倒排表筛选，筛选无效时取长度相近的全部姓名 */
+    uint32_t *cand = NULL;
+    size_t ncand = fuzzy_candidates(index, &p, k, opt->damerau, &cand);
+    if (ncand == SIZE_MAX) {
+        int lo = p.m - k > 0 ? p.m - k : 0;
+        int hi = p.m + k < FUZZY_MAX_CPS ? p.m + k : FUZZY_MAX_CPS;
+        cand = (uint32_t *)index->len_names + index->len_start[lo];
+        ncand = index->len_start[hi + 1] - index->len_start[lo];
+        result->scanned = true;
+    } else if (cand == NULL) {
+        printf("内存分配失败！\n");
+        return false;
+    }
+
+    FuzzyHit *hits = NULL;
+    size_t nhits = 0, cap = 0;
+    bool ok = true;
+    for (size_t i = 0; i < ncand && ok; i++) {
+        uint32_t id = cand[i];
+        int n = index->name_cps[id];
+        if (n < p.m - k || n > p.m + k) {
+            continue;
+        }
+        result->verified++;
+        const char *name = db->name_heap.data + index->name_offs[id];
+        int d = fuzzy_verify(&p, name, strlen(name), n, k, opt->damerau);
+        if (d > k) {
+            continue;
+        }
+        size_t live = 0;
+        for (uint32_t r = index->name_row_start[id]; r < index->name_row_start[id + 1]; r++) {
+            live += !db_is_dead(&db->rows[index->name_rows[r]]);
+        }
+        if (live > 0) {
+            FuzzyHit hit = { index->name_offs[id], id, (uint8_t)d, false };
+            ok = push_hit(&hits, &nhits, &cap, hit);
+            result->total += live;
+        }
+    }
+    if (!result->scanned) {
+        free(cand);
+    }
+
+    /* 建索引之后追加的行逐行验证 */
+    for (uint32_t row = index->built; row < (uint32_t)db->count && ok; row++) {
+        const Record *r = &db->rows[row];
+        if (db_is_dead(r)) {
+            continue;
+        }
+        const char *name = db_name(db, r);
+        size_t len = db_name_len(db, r);
+        int n = count_cps(name, len);
+        if (n < p.m - k || n > p.m + k) {
+            continue;
+        }
+        result->verified++;
+        int d = fuzzy_verify(&p, name, len, n, k, opt->damerau);
+        if (d <= k) {
+            FuzzyHit hit = { db->names[row].off, row, (uint8_t)d, true };
+            ok = push_hit(&hits, &nhits, &cap, hit);
+            result->total++;
+        }
+    }
+
+    /* 按距离、姓名排序，依次展开成行，取前 limit 条 */
+    size_t limit = opt->limit < result->total ? opt->limit : result->total;
+    result->rows = malloc(sizeof(uint32_t) * (limit > 0 ? limit : 1));
+    result->dists = malloc(limit > 0 ? limit : 1);
+    uint32_t *order = malloc(sizeof(uint32_t) * (nhits > 0 ? nhits : 1));
+    if (!ok || result->rows == NULL || result->dists == NULL || order == NULL ||
+        (nhits > 0 && !sort_hits(&db->name_heap, hits, nhits, k, order))) {
+        free(hits);
+        free(order);
+        fuzzy_result_free(result);
+        printf("内存分配失败！\n");
+        return false;
+    }
+    for (size_t i = 0; i < nhits && result->n < limit; i++) {
+        const FuzzyHit *h = &hits[order[i]];
+        if (h->tail) {
+            result->rows[result->n] = h->ref;
+            result->dists[result->n++] = h->dist;
+            continue;
+        }
+        for (uint32_t r = index->name_row_start[h->ref];
+             r < index->name_row_start[h->ref + 1] && result->n < limit; r++) {
+            uint32_t row = index->name_rows[r];
+            if (!db_is_dead(&db->rows[row])) {
+                result->rows[result->n] = row;
+                result->dists[result->n++] = h->dist;
+            }
+        }
+    }
+    free(hits);
+    free(order);
+    return true;
+}
+
+void fuzzy_result_free(FuzzyResult *result) {
+    free(result->rows);
+    free(result->dists);
+    result->rows = NULL;
+    result->dists = NULL;
+    result->n = 0;
+}
+
+/*
+ * db_print_fuzzy - 执行模糊查找并按距离分组输出
+ */
+void db_print_fuzzy(Database *db, const FuzzyOptions *opt) {
+    if (db == NULL || db_live_count(db) == 0) {
+        printf("暂无学生记录。\n");
+        return;
+    }
+
+    FuzzyResult result;
+    clock_t start = clock();
+    if (!fuzzy_search(db, opt, &result)) {
+        return;
+    }
+    double ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    if (result.n == 0) {
+        printf("未找到与\"%s\"相近（编辑距离不超过 %d）的姓名。\n", opt->pattern, opt->k);
+    } else {
+        OutBuf ob;
+        out_init(&ob, stdout);
+        for (size_t i = 0; i < result.n; i++) {
+            if (out_get_mode() == OUTPUT_PRETTY && (i == 0 || result.dists[i] != result.dists[i - 1])) {
+                out_puts(&ob, "=== 编辑距离 ");
+                out_int(&ob, result.dists[i]);
+                out_puts(&ob, " ===\n");
+            }
+            out_record(&ob, db, &db->rows[result.rows[i]]);
+        }
+        out_flush(&ob);
+        printf("共 %zu 条记录", result.total);
+        if (result.n < result.total) {
+            printf("，显示前 %zu 条", result.n);
+        }
+        printf("\n");
+    }
+    printf("%s：验证 %zu / %zu 个姓名，用时 %.3f 毫秒%s\n",
+           result.scanned ? "关键字太短，按长度扫描" : "二元组筛选",
+           result.verified, result.names, ms, result.built ? "（已建立索引）" : "");
+    fuzzy_result_free(&result);
+}
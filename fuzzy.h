@@ -0,0 +1,49 @@
+/*
+ * fuzzy.h - MiniDB 模糊姓名查找头文件
+ * 按编辑距离查找与关键字相近的姓名（拼错、漏字、多字、相邻两字颠倒），结果按距离排序：
+ * - 距离按 UTF-8 码点计算，一个汉字算一个字符；可选 Damerau 距离（相邻交换算一次编辑）
+ * - 索引建在去重后的姓名上：码点二元组（首尾加边界）倒排表 + 按长度分组的姓名
+ * - 候选姓名用 q-gram 计数下界筛选，再用位并行（Myers / Hyyrö）算法逐个验证
+ */
+
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include "db.h"
+
+#define FUZZY_MAX_K      3      // 最大编辑距离
+#define FUZZY_MAX_CPS    64     // 姓名的最大码点数（位向量为一个 64 位字）
+#define FUZZY_SHOW_LIMIT 50     // 交互查找最多显示的记录数
+
+/*
+ * 模糊查找选项
+ */
+typedef struct FuzzyOptions {
+    const char *pattern;    // 关键字（完整姓名，不是子串）
+    int k;                  // 最大编辑距离（0..FUZZY_MAX_K）
+    bool damerau;           // true 表示相邻两字交换算一次编辑
+    size_t limit;           // 最多返回的记录数
+} FuzzyOptions;
+
+/*
+ * 模糊查找结果：按距离、姓名排序的前 limit 条（同名的记录按加入的先后）
+ */
+typedef struct FuzzyResult {
+    uint32_t *rows;         // 行下标
+    uint8_t *dists;         // 对应的编辑距离
+    size_t n;               // 返回的条数
+    size_t total;           // 满足距离条件的有效记录总数
+    size_t names;           // 参与查找的不同姓名数
+    size_t verified;        // 经过筛选、逐个计算距离的姓名数
+    bool scanned;           // true 表示关键字太短，筛选无效，按长度分组扫描
+    bool built;             // 本次查找（重新）建立了索引
+} FuzzyResult;
+
+struct FuzzyIndex;  // 姓名模糊查找索引（见 fuzzy.c）
+
+bool fuzzy_search(Database *db, const FuzzyOptions *opt, FuzzyResult *result);  // 查找
+void fuzzy_result_free(FuzzyResult *result);                                   // 释放结果
+void fuzzy_index_free(struct FuzzyIndex *index);                               // 释放索引
+void db_print_fuzzy(Database *db, const FuzzyOptions *opt);                    // 执行查找并输出结果
+
+#endif /* FUZZY_H */
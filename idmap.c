@@ -0,0 +1,201 @@
+/*
+ * idmap.c - MiniDB ID 索引实现
+ * 线性探测哈希表，装载因子超过 1/2 时扩容为两倍；
+ * 删除时后移填补空洞，不使用墓碑标记
+ */
+
+#include "idmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IDMAP_INIT_CAP 64
+
+/* 乘法散列，再混合高位，使连续 ID 均匀分布 */
+static size_t idmap_hash(int id, size_t mask) {
+    uint32_t h = (uint32_t)id * 0x9E3779B1u;
+    h ^= h >> 16;
+    return (size_t)h & mask;
+}
+
+static bool idmap_alloc(IdMap *map, size_t cap) {
+    map->keys = calloc(cap, sizeof(int));
+    map->vals = malloc(cap * sizeof(uint32_t));
+    if (map->keys == NULL || map->vals == NULL) {
+        free(map->keys);
+        free(map->vals);
+        map->keys = NULL;
+        map->vals = NULL;
+        return false;
+    }
+    map->cap = cap;
+    map->size = 0;
+    return true;
+}
+
+bool idmap_init(IdMap *map) {
+    return idmap_alloc(map, IDMAP_INIT_CAP);
+}
+
+void idmap_free(IdMap *map) {
+    free(map->keys);
+    free(map->vals);
+    map->keys = NULL;
+    map->vals = NULL;
+    map->cap = 0;
+    map->size = 0;
+}
+
+void idmap_clear(IdMap *map) {
+    memset(map->keys, 0, map->cap * sizeof(int));
+    map->size = 0;
+}
+
+/* 不检查容量的插入，扩容与 idmap_put 共用 */
+static void idmap_insert(IdMap *map, int id, uint32_t row) {
+    size_t mask = map->cap - 1;
+    size_t i = idmap_hash(id, mask);
+    while (map->keys[i] != 0 && map->keys[i] != id) {
+        i = (i + 1) & mask;
+    }
+    if (map->keys[i] == 0) {
+        map->keys[i] = id;
+        map->size++;
+    }
+    map->vals[i] = row;
+}
+
+/* 重新散列到 cap 个槽位 */
+static bool idmap_rehash(IdMap *map, size_t cap) {
+    IdMap bigger;
+    if (!idmap_alloc(&bigger, cap)) {
+        return false;
+    }
+    for (size_t i = 0; i < map->cap; i++) {
+        if (map->keys[i] != 0) {
+            idmap_insert(&bigger, map->keys[i], map->vals[i]);
+        }
+    }
+    idmap_free(map);
+    *map = bigger;
+    return true;
+}
+
+/*
+ * idmap_reserve - 预留容量，索引中共有 n 个 ID 之前不再扩容
+ * 批量加载时先调用，避免逐次翻倍时反复重新散列
+ */
+bool idmap_reserve(IdMap *map, size_t n) {
+    size_t cap = map->cap > 0 ? map->cap : IDMAP_INIT_CAP;
+    while (n * 2 > cap) {
+        cap *= 2;
+    }
+    return cap == map->cap || idmap_rehash(map, cap);
+}
+
+/*
+ * idmap_fill_segment - 并行建立空索引时的一段
+ * 槽位空间平均分成 nsegs 段，只插入起始槽位落在第 seg 段的 ID；各段写入的槽位互不重叠，
+ * 可由不同线程同时调用（调用前先 idmap_reserve）。探测会越过段尾的 ID 不插入，
+ * 其行下标依次记入 spill，由调用者在各段完成后用 idmap_put 串行补插
+ * 第 r 个 ID 位于 (const char *)ids + r * stride，对应行下标 r
+ * 返回值：本段新增的 ID 数（由调用者汇总后计入 size）；
+ *         遇到非正数 ID 或 spill 放不下时返回 SIZE_MAX
+ */
+size_t idmap_fill_segment(IdMap *map, const void *ids, size_t stride, uint32_t n,
+                          int seg, int nsegs, uint32_t *spill, uint32_t spill_cap, uint32_t *nspill) {
+    size_t mask = map->cap - 1;
+    size_t lo = map->cap / nsegs * seg;
+    size_t hi = seg == nsegs - 1 ? map->cap : lo + map->cap / nsegs;
+    size_t added = 0;
+    const char *p = ids;
+    *nspill = 0;
+    for (uint32_t r = 0; r < n; r++, p += stride) {
+        int id;
+        memcpy(&id, p, sizeof(int));
+        if (id <= 0) {
+            return SIZE_MAX;
+        }
+        size_t i = idmap_hash(id, mask);
+        if (i < lo || i >= hi) {
+            continue;
+        }
+        while (i < hi && map->keys[i] != 0 && map->keys[i] != id) {
+            i++;
+        }
+        if (i == hi) {
+            if (*nspill == spill_cap) {
+                return SIZE_MAX;
+            }
+            spill[(*nspill)++] = r;
+            continue;
+        }
+        if (map->keys[i] == 0) {
+            map->keys[i] = id;
+            added++;
+        }
+        map->vals[i] = r;
+    }
+    return added;
+}
+
+bool idmap_put(IdMap *map, int id, uint32_t row) {
+    if (id <= 0) {
+        return false;
+    }
+    if ((map->size + 1) * 2 > map->cap && !idmap_rehash(map, map->cap * 2)) {
+        return false;
+    }
+    idmap_insert(map, id, row);
+    return true;
+}
+
+uint32_t idmap_get(const IdMap *map, int id) {
+    if (id <= 0 || map->cap == 0) {
+        return IDMAP_NONE;
+    }
+    size_t mask = map->cap - 1;
+    size_t i = idmap_hash(id, mask);
+    while (map->keys[i] != 0) {
+        if (map->keys[i] == id) {
+            return map->vals[i];
+        }
+        i = (i + 1) & mask;
+    }
+    return IDMAP_NONE;
+}
+
+bool idmap_remove(IdMap *map, int id) {
+    if (id <= 0 || map->cap == 0) {
+        return false;
+    }
+    size_t mask = map->cap - 1;
+    size_t i = idmap_hash(id, mask);
+    while (map->keys[i] != id) {
+        if (map->keys[i] == 0) {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+
+    /* 后移删除：把后续同一探测链上的元素前移填补空洞 */
+    size_t hole = i;
+    size_t j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (map->keys[j] == 0) {
+            break;
+        }
+        size_t home = idmap_hash(map->keys[j], mask);
+        /* home 不在 (hole, j] 区间内时，元素可以移到空洞处 */
+        bool movable = (hole <= j) ? (home <= hole || home > j)
+                                   : (home <= hole && home > j);
+        if (movable) {
+            map->keys[hole] = map->keys[j];
+            map->vals[hole] = map->vals[j];
+            hole = j;
+        }
+    }
+    map->keys[hole] = 0;
+    map->size--;
+    return true;
+}
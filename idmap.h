@@ -0,0 +1,37 @@
+/*
+ * idmap.h - MiniDB ID 索引头文件
+ * 开放寻址哈希表（线性探测），把记录 ID 映射到行下标，
+ * 使按 ID 查找、续读令牌定位不必遍历整张表
+ */
+
+#ifndef IDMAP_H
+#define IDMAP_H
+
+#include "config.h"
+#include <stddef.h>
+
+#define IDMAP_NONE UINT32_MAX  // 查找失败时的返回值
+
+/*
+ * ID 索引
+ * keys[i] == 0 表示空槽（合法 ID 均为正数）
+ */
+typedef struct IdMap {
+    int *keys;              // 记录 ID
+    uint32_t *vals;         // 对应的行下标
+    size_t cap;             // 槽位数（2 的幂）
+    size_t size;            // 已用槽位数
+} IdMap;
+
+bool idmap_init(IdMap *map);                                   // 初始化空索引
+void idmap_free(IdMap *map);                                   // 释放索引内存
+void idmap_clear(IdMap *map);                                  // 清空索引（保留容量）
+bool idmap_reserve(IdMap *map, size_t n);                      // 预留容量，容纳 n 个 ID 前不再扩容
+bool idmap_put(IdMap *map, int id, uint32_t row);              // 插入或覆盖
+size_t idmap_fill_segment(IdMap *map, const void *ids, size_t stride, uint32_t n,
+                          int seg, int nsegs, uint32_t *spill, uint32_t spill_cap,
+                          uint32_t *nspill);                   // 并行建索引：只填第 seg 段槽位
+uint32_t idmap_get(const IdMap *map, int id);                  // 查找，未找到返回 IDMAP_NONE
+bool idmap_remove(IdMap *map, int id);                         // 删除，未找到返回 false
+
+#endif /* IDMAP_H */
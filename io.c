@@ -5,71 +5,835 @@
 
 #include "io.h"
 #include "config.h"
+#include "output.h"
+#include "cursor.h"
+#include "aio.h"
+#include "utils.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
 
-/* 用于自动保存的全局指针 */
-static Database *auto_save_db = NULL;
+/*
+ * io_encode_record - 把一条记录编码为第 2 版格式，返回字节数
+ * buf 至少 SNAPSHOT_REC_MAX 字节
+ */
+size_t io_encode_record(const Database *db, const Record *record, unsigned char *buf) {
+    uint8_t name_len = (uint8_t)db_name_len(db, record);
+    memcpy(buf, &record->id, 4);
+    memcpy(buf + 4, &record->score, 8);
+    buf[12] = record->age;
+    buf[13] = record->flags;
+    buf[14] = name_len;
+    memcpy(buf + SNAPSHOT_REC_FIXED, db_name(db, record), name_len);
+    return SNAPSHOT_REC_FIXED + name_len;
+}
+
+/*
+ * io_decode_records - 从内存中解码 n 条连续的第 2 版记录
+ * names[i] 指向第 i 条记录的姓名长度字节（其后紧跟姓名），供 db_append_batch 使用
+ * 返回值：false 表示数据不足或姓名过长；成功时 *used 为消耗的字节数
+ */
+bool io_decode_records(const unsigned char *data, size_t size, uint32_t n,
+                       Record *rows, const unsigned char **names, size_t *used) {
+    size_t off = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        const unsigned char *b = data + off;
+        if (size - off < SNAPSHOT_REC_FIXED || b[14] >= MAX_NAME_LEN ||
+            size - off - SNAPSHOT_REC_FIXED < b[14]) {
+            return false;
+        }
+        memcpy(&rows[i].id, b, 4);
+        memcpy(&rows[i].score, b + 4, 8);
+        rows[i].age = b[12];
+        rows[i].flags = b[13];
+        rows[i].reserved = 0;
+        names[i] = b + 14;
+        off += SNAPSHOT_REC_FIXED + b[14];
+    }
+    *used = off;
+    return true;
+}
+
+/*
+ * count_records - 数出 data 开头完整的第 2 版记录（至多 max 条），与 io_decode_records 做同样的检查
+ * *n 为条数，*used 为它们占用的字节数；其后剩下的是一条不完整的记录
+ * 返回值：false 表示遇到姓名过长的记录（文件已损坏）
+ */
+static bool count_records(const unsigned char *data, size_t size, uint32_t max,
+                          uint32_t *n, size_t *used) {
+    size_t off = 0;
+    uint32_t i = 0;
+    while (i < max && size - off >= SNAPSHOT_REC_FIXED) {
+        uint8_t name_len = data[off + 14];
+        if (name_len >= MAX_NAME_LEN) {
+            return false;
+        }
+        if (size - off - SNAPSHOT_REC_FIXED < name_len) {
+            break;
+        }
+        off += SNAPSHOT_REC_FIXED + name_len;
+        i++;
+    }
+    *n = i;
+    *used = off;
+    return true;
+}
+
+/*
+ * ==================== 第 3 版快照（分块，增量保存） ====================
+ * 文件格式：[文件头 64 字节][块]...[块][块映射]
+ * 文件头：["MDB3"][count(4)][live(4)][next_id(4)][nblocks(4)][保留(4)]
+ *         [map_off(8)][tag(8)][gen(8)][lsn(8)][保留(8)]
+ * 第 b 块依次存放第 b * DB_BLOCK_ROWS 行起的 DB_BLOCK_ROWS 行（含墓碑行，最后一块可以不满），
+ * 每行按第 2 版记录编码；块映射每块 16 字节：[off(8)][len(4)][rows(4)]
+ *
+ * 增量保存只把有修改的块和新的块映射追加到文件末尾，最后改写文件头指向新的映射，
+ * 文件头写入之前崩溃时旧的文件头仍指向完整的旧快照；被替换的旧块留作空洞，
+ * 空洞超过文件的一半或多数块有修改时整体重写（写临时文件后改名）
+ * tag 在整体重写时随机生成，gen 每次保存加一，用来确认文件自上次保存以来没有被别人替换
+ */
+
+/* 上次保存或加载的第 3 版快照的块布局 */
+struct SnapLayout {
+    char *path;
+    SnapHeader h;           // 文件中当前的文件头
+    SnapBlock *map;         // h.nblocks 块
+    uint64_t end;           // 文件长度
+    uint64_t garbage;       // 被替换的旧块和旧块映射占用的字节
+};
+
+/* 一次保存要写入的内容（编码时持锁，写文件时不需要） */
+struct SnapshotPlan {
+    char *path;
+    bool full;              // 整体重写：buf 为整个文件，写临时文件后改名
+    unsigned char *buf;     // 增量：追加的块和块映射，写在 append_off 处
+    size_t size;
+    uint64_t append_off;
+    unsigned char header[SNAPSHOT3_HEADER];  // 增量：最后写入的新文件头
+    struct SnapLayout *layout;               // 写成功后的块布局
+    uint32_t rewritten;     // 写入的块数
+};
+
+static void snap_put_header(unsigned char *b, const SnapHeader *h) {
+    memset(b, 0, SNAPSHOT3_HEADER);
+    memcpy(b, SNAPSHOT3_MAGIC, SNAPSHOT_MAGIC_LEN);
+    memcpy(b + 4, &h->count, 4);
+    memcpy(b + 8, &h->live, 4);
+    memcpy(b + 12, &h->next_id, 4);
+    memcpy(b + 16, &h->nblocks, 4);
+    memcpy(b + 24, &h->map_off, 8);
+    memcpy(b + 32, &h->tag, 8);
+    memcpy(b + 40, &h->gen, 8);
+    memcpy(b + 48, &h->lsn, 8);
+}
+
+static void snap_get_header(const unsigned char *b, SnapHeader *h) {
+    memcpy(&h->count, b + 4, 4);
+    memcpy(&h->live, b + 8, 4);
+    memcpy(&h->next_id, b + 12, 4);
+    memcpy(&h->nblocks, b + 16, 4);
+    memcpy(&h->map_off, b + 24, 8);
+    memcpy(&h->tag, b + 32, 8);
+    memcpy(&h->gen, b + 40, 8);
+    memcpy(&h->lsn, b + 48, 8);
+}
+
+static void snap_put_entry(unsigned char *b, const SnapBlock *blk) {
+    memcpy(b, &blk->off, 8);
+    memcpy(b + 8, &blk->len, 4);
+    memcpy(b + 12, &blk->rows, 4);
+}
+
+static uint32_t snap_block_count(int rows) {
+    return (uint32_t)(((size_t)rows + DB_BLOCK_ROWS - 1) >> DB_BLOCK_SHIFT);
+}
+
+/* 第 b 块的行数与编码后的字节数 */
+static uint32_t snap_block_size(const Database *db, uint32_t b, uint32_t *len) {
+    uint32_t lo = b << DB_BLOCK_SHIFT;
+    uint32_t hi = lo + DB_BLOCK_ROWS < (uint32_t)db->count ? lo + DB_BLOCK_ROWS : (uint32_t)db->count;
+    uint32_t bytes = 0;
+    for (uint32_t r = lo; r < hi; r++) {
+        bytes += SNAPSHOT_REC_FIXED + db->names[r].len;
+    }
+    *len = bytes;
+    return hi - lo;
+}
+
+static size_t snap_encode_block(const Database *db, uint32_t b, uint32_t rows, unsigned char *buf) {
+    size_t used = 0;
+    for (uint32_t r = b << DB_BLOCK_SHIFT, i = 0; i < rows; r++, i++) {
+        used += io_encode_record(db, &db->rows[r], buf + used);
+    }
+    return used;
+}
+
+/* 文件标识：整体重写时生成，不要求不可预测，只要不同次重写几乎不会相同 */
+static uint64_t snap_new_tag(void) {
+    static uint64_t counter = 0;
+    uint64_t t = (uint64_t)time(NULL) * 0x9E3779B97F4A7C15ull;
+    t ^= (uint64_t)clock() << 20;
+    t ^= (uint64_t)(uintptr_t)&counter;
+    return t ^ ++counter;
+}
+
+static struct SnapLayout *snap_layout_new(const char *path, uint32_t nblocks) {
+    struct SnapLayout *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return NULL;
+    }
+    s->path = malloc(strlen(path) + 1);
+    s->map = malloc(sizeof(SnapBlock) * (nblocks > 0 ? nblocks : 1));
+    if (s->path == NULL || s->map == NULL) {
+        io_snap_free(s);
+        return NULL;
+    }
+    strcpy(s->path, path);
+    return s;
+}
+
+void io_snap_free(struct SnapLayout *snap) {
+    if (snap != NULL) {
+        free(snap->path);
+        free(snap->map);
+        free(snap);
+    }
+}
+
+static void snap_plan_free(SnapshotPlan *plan) {
+    if (plan != NULL) {
+        free(plan->path);
+        free(plan->buf);
+        io_snap_free(plan->layout);
+        free(plan);
+    }
+}
+
+/*
+ * snap_can_append - 能否增量保存到 path
+ * 要求：上次保存或加载的正是这个文件、文件头仍是当时写下的、
+ * 行只增不减、空洞不超过文件的一半、有修改的块不超过一半
+ */
+static bool snap_can_append(const Database *db, const char *path) {
+    const struct SnapLayout *s = db->snap;
+    if (s == NULL || strcmp(s->path, path) != 0 || db->count < s->h.count || s->garbage * 2 > s->end) {
+        return false;
+    }
+    uint32_t nb = snap_block_count(db->count);
+    uint32_t rewrite = 0;
+    for (uint32_t b = 0; b < nb; b++) {
+        rewrite += b >= s->h.nblocks || db->dirty[b] != 0;
+    }
+    if (rewrite * 2 > nb) {
+        return false;
+    }
+
+    unsigned char head[SNAPSHOT3_HEADER];
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    bool ok = fread(head, 1, SNAPSHOT3_HEADER, fp) == SNAPSHOT3_HEADER;
+    fclose(fp);
+    SnapHeader h;
+    snap_get_header(head, &h);
+    return ok && memcmp(head, SNAPSHOT3_MAGIC, SNAPSHOT_MAGIC_LEN) == 0 &&
+           h.tag == s->h.tag && h.gen == s->h.gen;
+}
+
+/* 增量保存：只编码有修改的块和新增的块，连同新的块映射追加到文件末尾 */
+static SnapshotPlan *snap_plan_append(const Database *db, const char *path) {
+    const struct SnapLayout *s = db->snap;
+    uint32_t nb = snap_block_count(db->count);
+    SnapshotPlan *plan = calloc(1, sizeof(*plan));
+    if (plan == NULL || (plan->layout = snap_layout_new(path, nb)) == NULL ||
+        (plan->path = malloc(strlen(path) + 1)) == NULL) {
+        snap_plan_free(plan);
+        return NULL;
+    }
+    strcpy(plan->path, path);
+    struct SnapLayout *n = plan->layout;
+
+    /* 先算出追加的字节数，一次分配 */
+    size_t bytes = (size_t)nb * SNAPSHOT3_MAP_ENTRY;
+    for (uint32_t b = 0; b < nb; b++) {
+        if (b >= s->h.nblocks || db->dirty[b] != 0) {
+            n->map[b].rows = snap_block_size(db, b, &n->map[b].len);
+            bytes += n->map[b].len;
+        } else {
+            n->map[b] = s->map[b];
+        }
+    }
+    plan->buf = malloc(bytes > 0 ? bytes : 1);
+    if (plan->buf == NULL) {
+        snap_plan_free(plan);
+        return NULL;
+    }
+
+    uint64_t garbage = s->garbage + (uint64_t)s->h.nblocks * SNAPSHOT3_MAP_ENTRY;
+    size_t used = 0;
+    for (uint32_t b = 0; b < nb; b++) {
+        if (b >= s->h.nblocks || db->dirty[b] != 0) {
+            if (b < s->h.nblocks) {
+                garbage += s->map[b].len;
+            }
+            n->map[b].off = s->end + used;
+            used += snap_encode_block(db, b, n->map[b].rows, plan->buf + used);
+            plan->rewritten++;
+        }
+    }
+    for (uint32_t b = 0; b < nb; b++) {
+        snap_put_entry(plan->buf + used + (size_t)b * SNAPSHOT3_MAP_ENTRY, &n->map[b]);
+    }
+
+    n->h.count = db->count;
+    n->h.live = db_live_count(db);
+    n->h.next_id = db->next_id;
+    n->h.nblocks = nb;
+    n->h.map_off = s->end + used;
+    n->h.tag = s->h.tag;
+    n->h.gen = s->h.gen + 1;
+    n->h.lsn = db->lsn;
+    n->end = s->end + bytes;
+    n->garbage = garbage;
+    snap_put_header(plan->header, &n->h);
+    plan->size = bytes;
+    plan->append_off = s->end;
+    return plan;
+}
+
+/* 整体重写：新的文件标识，块紧接文件头依次存放，块映射在最后 */
+static struct SnapLayout *snap_plan_layout(const Database *db, const char *path) {
+    uint32_t nb = snap_block_count(db->count);
+    struct SnapLayout *n = snap_layout_new(path, nb);
+    if (n == NULL) {
+        return NULL;
+    }
+    uint64_t off = SNAPSHOT3_HEADER;
+    for (uint32_t b = 0; b < nb; b++) {
+        n->map[b].rows = snap_block_size(db, b, &n->map[b].len);
+        n->map[b].off = off;
+        off += n->map[b].len;
+    }
+    n->h.count = db->count;
+    n->h.live = db_live_count(db);
+    n->h.next_id = db->next_id;
+    n->h.nblocks = nb;
+    n->h.map_off = off;
+    n->h.tag = snap_new_tag();
+    n->h.gen = 1;
+    n->h.lsn = db->lsn;
+    n->end = off + (uint64_t)nb * SNAPSHOT3_MAP_ENTRY;
+    n->garbage = 0;
+    return n;
+}
+
+/* 整体重写编码到内存（后台保存用，编码完即可释放锁） */
+static SnapshotPlan *snap_plan_full(const Database *db, const char *path) {
+    SnapshotPlan *plan = calloc(1, sizeof(*plan));
+    if (plan == NULL || (plan->layout = snap_plan_layout(db, path)) == NULL ||
+        (plan->path = malloc(strlen(path) + 1)) == NULL ||
+        (plan->buf = malloc(plan->layout->end)) == NULL) {
+        snap_plan_free(plan);
+        return NULL;
+    }
+    strcpy(plan->path, path);
+    const struct SnapLayout *n = plan->layout;
+    snap_put_header(plan->buf, &n->h);
+    for (uint32_t b = 0; b < n->h.nblocks; b++) {
+        snap_encode_block(db, b, n->map[b].rows, plan->buf + n->map[b].off);
+        snap_put_entry(plan->buf + n->h.map_off + (size_t)b * SNAPSHOT3_MAP_ENTRY, &n->map[b]);
+    }
+    plan->full = true;
+    plan->size = n->end;
+    plan->rewritten = n->h.nblocks;
+    return plan;
+}
+
+/* 用写好的临时文件替换 path；Windows 下 rename 不能覆盖已有文件，先删除旧文件再改名 */
+static bool snap_replace(const char *tmp, const char *path) {
+    if (rename(tmp, path) != 0) {
+        remove(path);
+        if (rename(tmp, path) != 0) {
+            remove(tmp);
+            return false;
+        }
+    }
+    return true;
+}
 
 /*
- * io_save_binary - 保存数据库到二进制文件
+ * io_snapshot_prepare - 编码一次保存要写入的内容（调用者须保证期间数据库不被修改）
+ * 能增量保存时只编码有修改的块，否则编码整个文件
+ * 返回值：写入计划，内存不足返回 NULL
+ */
+SnapshotPlan *io_snapshot_prepare(const Database *db, const char *filename) {
+    return snap_can_append(db, filename) ? snap_plan_append(db, filename)
+                                         : snap_plan_full(db, filename);
+}
+
+/*
+ * io_snapshot_write - 把编码好的内容写入文件（不访问数据库，可以不持锁）
+ * 增量：先追加块和块映射，再改写文件头；整体：写临时文件后改名
+ */
+bool io_snapshot_write(SnapshotPlan *plan) {
+    char tmp[512];
+    bool ok;
+    if (plan->full) {
+        snprintf(tmp, sizeof(tmp), "%s.tmp", plan->path);
+        FILE *fp = fopen(tmp, "wb");
+        if (fp == NULL) {
+            return false;
+        }
+        ok = fwrite(plan->buf, 1, plan->size, fp) == plan->size;
+        ok = fclose(fp) == 0 && ok;
+        if (!ok) {
+            remove(tmp);
+            return false;
+        }
+        return snap_replace(tmp, plan->path);
+    }
+
+    FILE *fp = fopen(plan->path, "r+b");
+    if (fp == NULL) {
+        return false;
+    }
+    ok = file_seek(fp, plan->append_off) == 0 &&
+         fwrite(plan->buf, 1, plan->size, fp) == plan->size &&
+         fflush(fp) == 0 &&
+         fseek(fp, 0, SEEK_SET) == 0 &&
+         fwrite(plan->header, 1, SNAPSHOT3_HEADER, fp) == SNAPSHOT3_HEADER;
+    return fclose(fp) == 0 && ok;
+}
+
+/*
+ * io_snapshot_finish - 写入成功时记下新的块布局（下次据此增量保存），释放 plan
+ * 写入失败时丢弃块布局，下次整体重写
+ */
+void io_snapshot_finish(Database *db, SnapshotPlan *plan, bool ok) {
+    io_snap_free(db->snap);
+    db->snap = NULL;
+    if (ok) {
+        db->snap = plan->layout;
+        plan->layout = NULL;
+    }
+    snap_plan_free(plan);
+}
+
+uint64_t io_snapshot_size(const SnapshotPlan *plan) {
+    return plan->size;
+}
+
+uint32_t io_snapshot_blocks(const SnapshotPlan *plan) {
+    return plan->rewritten;
+}
+
+/* 写入流：数据按块提交给 aio，跨块的数据拆开 */
+typedef struct SnapWriter {
+    AioFile *f;
+    unsigned char *blk;
+    size_t used;
+    bool ok;
+} SnapWriter;
+
+static void snap_emit(SnapWriter *w, const unsigned char *data, size_t n) {
+    while (n > 0 && w->ok) {
+        size_t take = n < AIO_BLOCK_SIZE - w->used ? n : AIO_BLOCK_SIZE - w->used;
+        memcpy(w->blk + w->used, data, take);
+        w->used += take;
+        data += take;
+        n -= take;
+        if (w->used == AIO_BLOCK_SIZE) {
+            w->ok = aio_submit(w->f, w->used);
+            w->blk = aio_block(w->f);
+            w->used = 0;
+        }
+    }
+}
+
+/*
+ * snap_save_stream - 整体重写，边编码边写（不把整个文件放进内存）
+ * 先按姓名长度算出各块的大小和位置，文件头就能先写；写到临时文件后改名
+ */
+static int snap_save_stream(Database *db, const char *filename) {
+    struct SnapLayout *n = snap_plan_layout(db, filename);
+    if (n == NULL) {
+        fprintf(stderr, "错误：内存不足！\n");
+        return -1;
+    }
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    SnapWriter w;
+    w.f = aio_open(tmp, AIO_WRITE | (SNAPSHOT_DIRECT_IO ? AIO_DIRECT : 0));
+    if (w.f == NULL) {
+        fprintf(stderr, "错误：无法打开文件 '%s' 进行写入！\n", tmp);
+        perror("open");
+        io_snap_free(n);
+        return -1;
+    }
+    w.blk = aio_block(w.f);
+    w.used = 0;
+    w.ok = true;
+
+    unsigned char rec[SNAPSHOT_REC_MAX > SNAPSHOT3_HEADER ? SNAPSHOT_REC_MAX : SNAPSHOT3_HEADER];
+    snap_put_header(rec, &n->h);
+    snap_emit(&w, rec, SNAPSHOT3_HEADER);
+
+    /* 按行下标顺序编码（含墓碑行），块满后提交写请求并接着编码下一块，编码与写盘重叠 */
+    for (int i = 0; i < db->count && w.ok; i++) {
+        if (AIO_BLOCK_SIZE - w.used >= SNAPSHOT_REC_MAX) {
+            w.used += io_encode_record(db, &db->rows[i], w.blk + w.used);
+        } else {
+            snap_emit(&w, rec, io_encode_record(db, &db->rows[i], rec));
+        }
+    }
+    for (uint32_t b = 0; b < n->h.nblocks; b++) {
+        snap_put_entry(rec, &n->map[b]);
+        snap_emit(&w, rec, SNAPSHOT3_MAP_ENTRY);
+    }
+    if (w.ok && w.used > 0) {
+        w.ok = aio_submit(w.f, w.used);
+    }
+    if (!aio_close(w.f) || !w.ok || !snap_replace(tmp, filename)) {
+        fprintf(stderr, "错误：写入文件 '%s' 失败！\n", filename);
+        remove(tmp);
+        io_snap_free(n);
+        return -1;
+    }
+    io_snap_free(db->snap);
+    db->snap = n;
+    printf("成功保存 %d 条记录到 '%s'\n", n->h.live, filename);
+    return 0;
+}
+
+/*
+ * io_save_binary - 保存数据库到二进制文件（第 3 版）
  * 参数：db - 数据库指针
  *       filename - 文件名
  * 返回值：0 表示成功，-1 表示失败
  *
- * 文件格式：
- * [count(4 字节)][next_id(4 字节)][记录 1][记录 2]...
- * 每条记录：[id(4 字节)][name(64 字节)][age(4 字节)][score(8 字节)]
+ * 上次保存或加载的正是这个文件时只追加有修改的块（见上方格式说明），
+ * 否则整体重写；成功后由调用者 db_mark_clean
  */
-int io_save_binary(const Database *db, const char *filename) {
+int io_save_binary(Database *db, const char *filename) {
     if (db == NULL || filename == NULL) {
         fprintf(stderr, "错误：参数为空！\n");
         return -1;
     }
+    if (!snap_can_append(db, filename)) {
+        return snap_save_stream(db, filename);
+    }
 
-    /* 检查数据库是否有效 */
-    if (db->head == NULL) {
-        fprintf(stderr, "错误：数据库未初始化！\n");
+    SnapshotPlan *plan = snap_plan_append(db, filename);
+    if (plan == NULL) {
+        fprintf(stderr, "错误：内存不足！\n");
         return -1;
     }
+    bool ok = io_snapshot_write(plan);
+    if (ok) {
+        printf("成功保存 %d 条记录到 '%s'（增量：写入 %u / %u 块，%.1f KB）\n",
+               plan->layout->h.live, filename, plan->rewritten, plan->layout->h.nblocks,
+               plan->size / 1024.0);
+    } else {
+        fprintf(stderr, "错误：写入文件 '%s' 失败！\n", filename);
+    }
+    io_snapshot_finish(db, plan, ok);
+    return ok ? 0 : -1;
+}
+
+/* 第 3 版文件头的范围检查，size 为文件大小 */
+static bool snap_check_header(const SnapHeader *h, uint64_t size) {
+    return h->count >= 0 && h->live >= 0 && h->live <= h->count && h->nblocks == snap_block_count(h->count) &&
+           h->map_off >= SNAPSHOT3_HEADER && h->map_off <= size &&
+           (size - h->map_off) / SNAPSHOT3_MAP_ENTRY >= h->nblocks;
+}
+
+/* 解码并校验块映射，entries 为文件中 map_off 处的 h->nblocks 项（长度由 snap_check_header 保证） */
+static bool snap_parse_map(const SnapHeader *h, const unsigned char *entries, uint64_t size, SnapBlock **map) {
+    SnapBlock *m = malloc(sizeof(SnapBlock) * (h->nblocks > 0 ? h->nblocks : 1));
+    if (m == NULL) {
+        return false;
+    }
+    for (uint32_t b = 0; b < h->nblocks; b++) {
+        const unsigned char *e = entries + (size_t)b * SNAPSHOT3_MAP_ENTRY;
+        memcpy(&m[b].off, e, 8);
+        memcpy(&m[b].len, e + 8, 4);
+        memcpy(&m[b].rows, e + 12, 4);
+        uint32_t rows = b + 1 < h->nblocks ? DB_BLOCK_ROWS : (uint32_t)h->count - (b << DB_BLOCK_SHIFT);
+        if (m[b].rows != rows || m[b].off < SNAPSHOT3_HEADER || m[b].off > size || size - m[b].off < m[b].len) {
+            free(m);
+            return false;
+        }
+    }
+    *map = m;
+    return true;
+}
+
+/*
+ * io_parse_snapshot3 - 校验整个第 3 版快照文件的文件头与块映射
+ * 返回值：false 表示文件已损坏；成功时 *map 为 h->nblocks 块的映射（调用者 free）
+ */
+bool io_parse_snapshot3(const unsigned char *buf, size_t size, SnapHeader *h, SnapBlock **map) {
+    *map = NULL;
+    if (size < SNAPSHOT3_HEADER || memcmp(buf, SNAPSHOT3_MAGIC, SNAPSHOT_MAGIC_LEN) != 0) {
+        return false;
+    }
+    snap_get_header(buf, h);
+    return snap_check_header(h, size) && snap_parse_map(h, buf + h->map_off, size, map);
+}
+
+/*
+ * io_read_snapshot3 - 只从打开的第 3 版快照读取并校验文件头与块映射，不读入记录
+ * 供逐块流式读取记录的调用者使用（外部排序）；文件位置随后不确定
+ * 返回值：false 表示读取失败或文件已损坏；成功时 *map 由调用者 free
+ */
+bool io_read_snapshot3(FILE *fp, SnapHeader *h, SnapBlock **map) {
+    *map = NULL;
+    unsigned char head[SNAPSHOT3_HEADER];
+    uint64_t size;
+    if (file_size(fp, &size) != 0 || file_seek(fp, 0) != 0 ||
+        fread(head, 1, sizeof(head), fp) != sizeof(head) ||
+        memcmp(head, SNAPSHOT3_MAGIC, SNAPSHOT_MAGIC_LEN) != 0) {
+        return false;
+    }
+    snap_get_header(head, h);
+    if (!snap_check_header(h, size)) {
+        return false;
+    }
+    size_t bytes = (size_t)h->nblocks * SNAPSHOT3_MAP_ENTRY;
+    unsigned char *entries = malloc(bytes > 0 ? bytes : 1);
+    if (entries == NULL) {
+        return false;
+    }
+    bool ok = file_seek(fp, h->map_off) == 0 && fread(entries, 1, bytes, fp) == bytes &&
+              snap_parse_map(h, entries, size, map);
+    free(entries);
+    return ok;
+}
 
-    FILE *fp = fopen(filename, "wb");
+/*
+ * io_snap_adopt - 加载第 3 版快照后记下其块布局，之后保存到同一文件时可以增量保存
+ * 没有在记录操作日志时，数据库的日志序号取快照中的序号（主库启动、副本加载快照）；
+ * 调用者随后 db_mark_clean
+ */
+void io_snap_adopt(Database *db, const char *filename, const SnapHeader *h, const SnapBlock *map, uint64_t size) {
+    if (db->log == NULL) {
+        db->lsn = h->lsn;
+    }
+    struct SnapLayout *n = snap_layout_new(filename, h->nblocks);
+    if (n == NULL) {
+        return;  /* 只是下次保存不能增量 */
+    }
+    n->h = *h;
+    memcpy(n->map, map, sizeof(SnapBlock) * h->nblocks);
+    n->end = size;
+    n->garbage = size - SNAPSHOT3_HEADER - (uint64_t)h->nblocks * SNAPSHOT3_MAP_ENTRY;
+    for (uint32_t b = 0; b < h->nblocks; b++) {
+        n->garbage -= map[b].len;
+    }
+    io_snap_free(db->snap);
+    db->snap = n;
+}
+
+/*
+ * io_snapshot_lsn - 只读取快照文件头中的日志序号（副本判断快照能否接上操作日志）
+ * 第 3 版之前的快照没有序号，视为 0
+ * 返回值：false 表示文件不存在或文件头不完整
+ */
+bool io_snapshot_lsn(const char *filename, uint64_t *lsn) {
+    FILE *fp = fopen(filename, "rb");
     if (fp == NULL) {
-        fprintf(stderr, "错误：无法打开文件 '%s' 进行写入！\n", filename);
-        perror("fopen");
-        return -1;
+        return false;
+    }
+    unsigned char head[SNAPSHOT3_HEADER];
+    size_t n = fread(head, 1, sizeof(head), fp);
+    fclose(fp);
+    if (n < SNAPSHOT_MAGIC_LEN) {
+        return false;
     }
+    *lsn = 0;
+    if (memcmp(head, SNAPSHOT3_MAGIC, SNAPSHOT_MAGIC_LEN) == 0) {
+        if (n < SNAPSHOT3_HEADER) {
+            return false;
+        }
+        SnapHeader h;
+        snap_get_header(head, &h);
+        *lsn = h.lsn;
+    }
+    return true;
+}
 
-    /* 写入数据库元数据 */
-    if (fwrite(&db->count, sizeof(int), 1, fp) != 1) {
-        fprintf(stderr, "错误：写入 count 失败！\n");
-        fclose(fp);
+/*
+ * load_binary_v3 - 逐块加载第 3 版快照（整个文件读入内存，按块映射解码、批量追加）
+ * 返回值：0 表示成功，-1 表示失败
+ */
+static int load_binary_v3(Database *db, const char *filename) {
+    size_t size;
+    unsigned char *buf = aio_read_file(filename, &size, SNAPSHOT_DIRECT_IO ? AIO_DIRECT : 0);
+    if (buf == NULL) {
+        fprintf(stderr, "错误：无法读取文件 '%s'！\n", filename);
         return -1;
     }
-    if (fwrite(&db->next_id, sizeof(int), 1, fp) != 1) {
-        fprintf(stderr, "错误：写入 next_id 失败！\n");
-        fclose(fp);
+    SnapHeader h;
+    SnapBlock *map;
+    if (!io_parse_snapshot3(buf, size, &h, &map)) {
+        fprintf(stderr, "错误：读取文件头失败！文件可能已损坏。\n");
+        free(buf);
         return -1;
     }
+    Record *rows = malloc(sizeof(Record) * DB_BLOCK_ROWS);
+    const unsigned char **names = malloc(sizeof(unsigned char *) * DB_BLOCK_ROWS);
+    bool ok = rows != NULL && names != NULL;
+    if (!ok) {
+        fprintf(stderr, "错误：内存不足！\n");
+    } else {
+        db_clear(db);
+        db->next_id = h.next_id;
+    }
+    uint32_t b = 0;
+    for (; ok && b < h.nblocks; b++) {
+        size_t used;
+        ok = io_decode_records(buf + map[b].off, map[b].len, map[b].rows, rows, names, &used) &&
+             used == map[b].len && db_append_batch(db, rows, names, map[b].rows, NULL, NULL);
+    }
+    if (ok) {
+        io_snap_adopt(db, filename, &h, map, size);
+        printf("成功加载 %d 条记录 from '%s'\n", db_live_count(db), filename);
+    } else if (rows != NULL && names != NULL) {
+        fprintf(stderr, "错误：读取第%u块失败！\n", b);
+    }
+    free(rows);
+    free(names);
+    free(map);
+    free(buf);
+    return ok ? 0 : -1;
+}
 
-    /* 遍历链表，写入每条记录 */
-    Record *p = db->head->next;
-    while (p != NULL) {
-        /* 写入记录数据（不保存 next 指针） */
-        if (fwrite(&p->id, sizeof(int), 1, fp) != 1 ||
-            fwrite(p->name, sizeof(char), MAX_NAME_LEN, fp) != (size_t)MAX_NAME_LEN ||
-            fwrite(&p->age, sizeof(int), 1, fp) != 1 ||
-            fwrite(&p->score, sizeof(double), 1, fp) != 1) {
-            fprintf(stderr, "错误：写入记录失败！\n");
-            fclose(fp);
-            return -1;
+/* 一块中最多能容纳的记录数 */
+#define LOAD_BATCH  (AIO_BLOCK_SIZE / SNAPSHOT_REC_FIXED + 1)
+
+/*
+ * load_binary_v2 - 流式加载第 2 版快照
+ * 文件按块异步读取（后面几块的读请求已在途），每块中完整的记录一次解码、批量追加；
+ * 跨块的记录先拼到 carry 中，凑齐后单独追加
+ * 返回值：0 表示成功，-1 表示失败
+ */
+static int load_binary_v2(Database *db, const char *filename) {
+    AioFile *f = aio_open(filename, SNAPSHOT_DIRECT_IO ? AIO_DIRECT : 0);
+    if (f == NULL) {
+        fprintf(stderr, "错误：无法打开文件 '%s' 进行读取！\n", filename);
+        perror("open");
+        return -1;
+    }
+    Record *rows = malloc(sizeof(Record) * LOAD_BATCH);
+    const unsigned char **names = malloc(sizeof(unsigned char *) * LOAD_BATCH);
+    size_t len;
+    const unsigned char *blk = aio_next(f, &len);
+    int count = -1, next_id;
+    uint32_t loaded = 0;
+    if (blk != NULL && len >= SNAPSHOT_HEADER) {
+        memcpy(&count, blk + SNAPSHOT_MAGIC_LEN, sizeof(int));
+        memcpy(&next_id, blk + SNAPSHOT_MAGIC_LEN + sizeof(int), sizeof(int));
+    }
+    bool ok = rows != NULL && names != NULL && count >= 0;
+    if (rows == NULL || names == NULL) {
+        fprintf(stderr, "错误：内存不足！\n");
+    } else if (count < 0) {
+        fprintf(stderr, "错误：读取文件头失败！文件可能已损坏。\n");
+    } else {
+        db_clear(db);
+        db->next_id = next_id;
+        blk += SNAPSHOT_HEADER;
+        len -= SNAPSHOT_HEADER;
+    }
+    bool started = ok;
+
+    unsigned char carry[SNAPSHOT_REC_MAX];
+    size_t carried = 0;
+    while (ok && blk != NULL && loaded < (uint32_t)count) {
+        size_t off = 0, used;
+        /* 先补齐上一块末尾不完整的记录 */
+        if (carried > 0) {
+            size_t need = carried < SNAPSHOT_REC_FIXED ? SNAPSHOT_REC_FIXED - carried : 0;
+            size_t take = need < len ? need : len;
+            memcpy(carry + carried, blk, take);
+            carried += take;
+            off = take;
+            if (carried >= SNAPSHOT_REC_FIXED) {
+                if (carry[14] >= MAX_NAME_LEN) {
+                    ok = false;
+                    break;
+                }
+                size_t rest = SNAPSHOT_REC_FIXED + carry[14] - carried;
+                take = rest < len - off ? rest : len - off;
+                memcpy(carry + carried, blk + off, take);
+                carried += take;
+                off += take;
+                if (carried == SNAPSHOT_REC_FIXED + (size_t)carry[14]) {
+                    ok = io_decode_records(carry, carried, 1, rows, names, &used) &&
+                         db_append_batch(db, rows, names, 1, NULL, NULL);
+                    loaded += ok ? 1 : 0;
+                    carried = 0;
+                }
+            }
+        }
+
+        /* 数出本块中完整的记录，一次解码、追加 */
+        const unsigned char *p = blk + off;
+        size_t avail = len - off, end = 0;
+        uint32_t n = 0;
+        if (ok && !count_records(p, avail, (uint32_t)count - loaded, &n, &end)) {
+            ok = false;
+            break;
+        }
+        if (ok && n > 0) {
+            ok = io_decode_records(p, end, n, rows, names, &used) &&
+                 db_append_batch(db, rows, names, n, NULL, NULL);
+            loaded += ok ? n : 0;
+        }
+        if (ok && loaded < (uint32_t)count && carried == 0) {
+            carried = avail - end;
+            if (carried > SNAPSHOT_REC_MAX) {
+                ok = false;  /* 剩下的不是一条不完整的记录 */
+                break;
+            }
+            memcpy(carry, p + end, carried);
         }
-        p = p->next;
+        blk = aio_next(f, &len);
+    }
+    free(rows);
+    free(names);
+    bool read_ok = aio_close(f);
+    if (!started) {
+        return -1;
     }
+    if (!ok || !read_ok || loaded < (uint32_t)count) {
+        fprintf(stderr, "错误：读取第%u条记录失败！文件可能已损坏。\n", loaded + 1);
+        return -1;
+    }
+    printf("成功加载 %d 条记录 from '%s'\n", count, filename);
+    return 0;
+}
 
-    fclose(fp);
-    printf("成功保存 %d 条记录到 '%s'\n", db->count, filename);
+/*
+ * load_record_v1 - 读取一条旧版（定长 64 字节姓名）格式的记录
+ * 返回值：0 表示成功，-1 表示失败
+ */
+static int load_record_v1(FILE *fp, Record *record, char *name) {
+    int id, age;
+    if (fread(&id, sizeof(int), 1, fp) != 1 ||
+        fread(name, sizeof(char), MAX_NAME_LEN, fp) != (size_t)MAX_NAME_LEN ||
+        fread(&age, sizeof(int), 1, fp) != 1 ||
+        fread(&record->score, sizeof(double), 1, fp) != 1) {
+        return -1;
+    }
+    name[MAX_NAME_LEN - 1] = '\0';
+    record->id = id;
+    record->age = (uint8_t)age;
+    record->flags = 0;  /* 旧版格式不保存状态标志 */
     return 0;
 }
 
@@ -78,6 +842,8 @@ int io_save_binary(const Database *db, const char *filename) {
  * 参数：db - 数据库指针
  *       filename - 文件名
  * 返回值：0 表示成功，-1 表示失败
+ *
+ * 同时支持第 3 版、第 2 版格式和不带文件标识的旧版格式
  */
 int io_load_binary(Database *db, const char *filename) {
     if (db == NULL || filename == NULL) {
@@ -92,50 +858,53 @@ int io_load_binary(Database *db, const char *filename) {
         return -1;
     }
 
-    /* 读取数据库元数据 */
+    /* 读取文件标识：第 3 版按块映射加载，第 2 版按块流式加载，旧版文件开头直接是 count */
+    char magic[SNAPSHOT_MAGIC_LEN];
     int count, next_id;
-    if (fread(&count, sizeof(int), 1, fp) != 1 ||
-        fread(&next_id, sizeof(int), 1, fp) != 1) {
+    if (fread(magic, 1, SNAPSHOT_MAGIC_LEN, fp) != SNAPSHOT_MAGIC_LEN) {
+        fprintf(stderr, "错误：读取文件头失败！文件可能已损坏。\n");
+        fclose(fp);
+        return -1;
+    }
+    if (memcmp(magic, SNAPSHOT3_MAGIC, SNAPSHOT_MAGIC_LEN) == 0) {
+        fclose(fp);
+        return load_binary_v3(db, filename);
+    }
+    if (memcmp(magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) == 0) {
+        fclose(fp);
+        return load_binary_v2(db, filename);
+    }
+    memcpy(&count, magic, sizeof(int));
+
+    /* 读取数据库元数据 */
+    if (fread(&next_id, sizeof(int), 1, fp) != 1) {
         fprintf(stderr, "错误：读取文件头失败！文件可能已损坏。\n");
         fclose(fp);
         return -1;
     }
 
     /* 清空现有数据（如果有） */
-    Record *p = db->head->next;
-    while (p != NULL) {
-        Record *q = p;
-        p = p->next;
-        free(q);
-    }
-    db->head->next = NULL;
-    db->count = 0;
+    db_clear(db);
     db->next_id = next_id;
 
-    /* 逐条读取记录 */
+    /* 逐条读取记录，按文件顺序追加 */
     for (int i = 0; i < count; i++) {
-        Record *new_record = malloc(sizeof(Record));
-        if (new_record == NULL) {
-            fprintf(stderr, "错误：内存不足！\n");
-            fclose(fp);
-            return -1;
-        }
+        Record new_record;
+        char name[MAX_NAME_LEN];
 
         /* 读取记录数据 */
-        if (fread(&new_record->id, sizeof(int), 1, fp) != 1 ||
-            fread(new_record->name, sizeof(char), MAX_NAME_LEN, fp) != (size_t)MAX_NAME_LEN ||
-            fread(&new_record->age, sizeof(int), 1, fp) != 1 ||
-            fread(&new_record->score, sizeof(double), 1, fp) != 1) {
+        if (load_record_v1(fp, &new_record, name) != 0) {
             fprintf(stderr, "错误：读取第%d条记录失败！\n", i + 1);
-            free(new_record);
             fclose(fp);
             return -1;
         }
 
-        /* 头插法插入链表 */
-        new_record->next = db->head->next;
-        db->head->next = new_record;
-        db->count++;
+        /* 追加到行存储，同时建立 ID 索引 */
+        if (!db_insert_record(db, &new_record, name)) {
+            fprintf(stderr, "错误：内存不足！\n");
+            fclose(fp);
+            return -1;
+        }
     }
 
     fclose(fp);
@@ -154,6 +923,17 @@ int io_load_binary(Database *db, const char *filename) {
  * 1，张三，20,95.5
  */
 int io_export_csv(const Database *db, const char *filename) {
+    return io_export_csv_where(db, filename, 0, 0);
+}
+
+/*
+ * io_export_csv_where - 只导出标志满足条件的记录
+ * 参数：must_set - 必须全部开启的标志位
+ *       must_clear - 必须全部关闭的标志位
+ * 返回值：0 表示成功，-1 表示失败
+ */
+int io_export_csv_where(const Database *db, const char *filename,
+                        uint8_t must_set, uint8_t must_clear) {
     if (db == NULL || filename == NULL) {
         fprintf(stderr, "错误：参数为空！\n");
         return -1;
@@ -166,28 +946,114 @@ int io_export_csv(const Database *db, const char *filename) {
         return -1;
     }
 
-    /* 写入 CSV 表头 */
-    fprintf(fp, "id,name,age,score\n");
+    /* 写入 CSV 表头，记录先格式化到输出缓冲区再整块写出 */
+    OutBuf ob;
+    out_init(&ob, fp);
+    out_puts(&ob, "id,name,age,score\n");
 
-    /* 遍历链表，写入每条记录 */
-    Record *p = db->head->next;
-    while (p != NULL) {
-        fprintf(fp, "%d,%s,%d,%.2f\n", p->id, p->name, p->age, p->score);
-        p = p->next;
+    /* 通过游标按批遍历，写入每条记录 */
+    CursorOptions opt;
+    cursor_options_init(&opt);
+    opt.flags_set = must_set;
+    opt.flags_clear = must_clear;
+    Cursor *cursor = cursor_open(db, &opt);
+    if (cursor == NULL) {
+        fclose(fp);
+        return -1;
+    }
+    const Record *batch[CURSOR_BATCH];
+    int exported = 0;
+    int n;
+    while ((n = cursor_next(cursor, batch, CURSOR_BATCH)) > 0) {
+        exported += n;
+        for (int i = 0; i < n; i++) {
+            const Record *p = batch[i];
+            out_int(&ob, p->id);
+            out_char(&ob, ',');
+            out_write(&ob, db_name(db, p), db_name_len(db, p));
+            out_char(&ob, ',');
+            out_int(&ob, p->age);
+            out_char(&ob, ',');
+            out_fixed2(&ob, p->score);
+            out_char(&ob, '\n');
+        }
     }
+    cursor_close(cursor);
+    out_flush(&ob);
 
+    if (ferror(fp)) {
+        fprintf(stderr, "错误：写入 CSV 文件失败！\n");
+        fclose(fp);
+        return -1;
+    }
     fclose(fp);
-    printf("成功导出 %d 条记录到 CSV 文件 '%s'\n", db->count, filename);
+    printf("成功导出 %d 条记录到 CSV 文件 '%s'\n", exported, filename);
     return 0;
 }
 
 /*
- * io_import_csv - 从 CSV 文件导入数据
+ * io_import_csv - 从 CSV 文件导入数据（全部追加，分配新 ID）
  * 参数：db - 数据库指针
  *       filename - 文件名
  * 返回值：0 表示成功，-1 表示失败
  */
 int io_import_csv(Database *db, const char *filename) {
+    return io_import_csv_keyed(db, filename, IMPORT_APPEND, NULL);
+}
+
+/*
+ * import_name_key - 姓名键：姓名在字符串堆中的偏移 + 1（堆去重，同名必同偏移），
+ * 借用 ID 索引的哈希表做 姓名 -> 行下标 的映射；偏移超出 int 范围时返回 0
+ */
+static int import_name_key(NameRef ref) {
+    return ref.off < (uint32_t)INT_MAX ? (int)ref.off + 1 : 0;
+}
+
+/* 按姓名合并前建立 姓名 -> 最早的有效行 的映射 */
+static bool import_build_names(const Database *db, IdMap *names) {
+    if (!idmap_init(names) || !idmap_reserve(names, (size_t)db_live_count(db))) {
+        return false;
+    }
+    for (int i = 0; i < db->count; i++) {
+        int key = import_name_key(db->names[i]);
+        if (db_is_dead(&db->rows[i]) || idmap_get(names, key) != IDMAP_NONE) {
+            continue;
+        }
+        if (key == 0 || !idmap_put(names, key, (uint32_t)i)) {
+            idmap_free(names);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * import_find - 查找与文件中的行对应的已有记录
+ * 返回值：行下标，不存在时返回 IDMAP_NONE
+ */
+static uint32_t import_find(const Database *db, const IdMap *names, ImportKey key,
+                            int file_id, const char *name) {
+    if (key == IMPORT_BY_ID) {
+        return idmap_get(&db->ids, file_id);
+    }
+    NameRef ref;
+    if (key == IMPORT_BY_NAME && strheap_find(&db->name_heap, name, strlen(name), &ref)) {
+        return idmap_get(names, import_name_key(ref));
+    }
+    return IDMAP_NONE;
+}
+
+/*
+ * io_import_csv_keyed - 从 CSV 文件导入数据，按键合并
+ * 每行用哈希表（ID 索引，或临时的姓名映射）查找已有记录，O(1) 决定改写还是插入：
+ * - 已存在且姓名、年龄、成绩都相同：跳过，不产生修改（CSV 中成绩只有两位小数，差值小于 0.005 视为相同）
+ * - 已存在但内容不同：改写姓名、年龄、成绩，标志不变
+ * - 按 ID 找到的是已删除的记录：改写后清除软删除标志（恢复）
+ * - 不存在：插入，按 ID 合并时使用文件中的 ID，否则分配新 ID
+ * 参数：stats - 导入统计，可以为 NULL
+ * 返回值：0 表示成功，-1 表示失败（失败前已导入的行保留）
+ */
+int io_import_csv_keyed(Database *db, const char *filename, ImportKey key, ImportStats *stats) {
     if (db == NULL || filename == NULL) {
         fprintf(stderr, "错误：参数为空！\n");
         return -1;
@@ -200,9 +1066,18 @@ int io_import_csv(Database *db, const char *filename) {
         return -1;
     }
 
+    IdMap names = {0};
+    if (key == IMPORT_BY_NAME && !import_build_names(db, &names)) {
+        fprintf(stderr, "错误：内存不足！\n");
+        fclose(fp);
+        return -1;
+    }
+
+    ImportStats st = {0};
     char line[256];
-    int imported = 0;
     int line_num = 0;
+    int ret = 0;
+    clock_t t0 = clock();
 
     /* 逐行读取 CSV 文件 */
     while (fgets(line, sizeof(line), fp) != NULL) {
@@ -213,52 +1088,97 @@ int io_import_csv(Database *db, const char *filename) {
             continue;
         }
 
-        /* 解析 CSV 行 */
-        Record *new_record = malloc(sizeof(Record));
-        if (new_record == NULL) {
-            fprintf(stderr, "错误：内存不足！\n");
-            fclose(fp);
-            return -1;
-        }
-
         /* 使用 sscanf 解析 CSV 格式 */
-        int parsed = sscanf(line, "%d,%63[^,],%d,%lf",
-                           &new_record->id, new_record->name,
-                           &new_record->age, &new_record->score);
+        Record new_record;
+        char name[MAX_NAME_LEN];
+        long long file_id;  /* 按 long long 读入，超出 int 的 ID 也能识别为无效 */
+        int age;
+        int parsed = sscanf(line, "%lld,%63[^,],%d,%lf",
+                           &file_id, name, &age, &new_record.score);
 
         if (parsed != 4) {
             fprintf(stderr, "警告：第%d行格式错误，跳过。\n", line_num);
-            free(new_record);
+            st.bad++;
+            continue;
+        }
+
+        /* 年龄按 1 字节存储，超出范围的行跳过 */
+        if (age < 1 || age > 150) {
+            fprintf(stderr, "警告：第%d行年龄超出范围，跳过。\n", line_num);
+            st.bad++;
+            continue;
+        }
+        /* 沿用文件中的 ID 后 next_id 为 ID + 1，ID 达到 INT_MAX 会溢出 */
+        if (key == IMPORT_BY_ID && (file_id <= 0 || file_id >= INT_MAX)) {
+            fprintf(stderr, "警告：第%d行 ID 无效，跳过。\n", line_num);
+            st.bad++;
             continue;
         }
 
-        /* 生成新 ID（使用数据库的 next_id） */
-        new_record->id = db->next_id++;
+        /* 已存在：内容相同则跳过，否则改写 */
+        uint32_t row = import_find(db, &names, key, (int)file_id, name);
+        if (row != IDMAP_NONE) {
+            const Record *p = &db->rows[row];
+            bool dead = db_is_dead(p);
+            if (!dead && p->age == age && fabs(p->score - new_record.score) < 0.005 &&
+                strcmp(db_name(db, p), name) == 0) {
+                st.skipped++;
+                continue;
+            }
+            if (!db_update_record(db, p->id, name, (uint8_t)age, new_record.score) ||
+                (dead && !db_set_flags(db, p->id, p->flags & ~FLAG_DELETED))) {
+                fprintf(stderr, "错误：内存不足！\n");
+                ret = -1;
+                break;
+            }
+            if (dead) {
+                st.inserted++;
+            } else {
+                st.updated++;
+            }
+            continue;
+        }
 
-        /* 头插法插入链表 */
-        new_record->next = db->head->next;
-        db->head->next = new_record;
-        db->count++;
-        imported++;
+        /* 不存在：按 ID 合并时沿用文件中的 ID，否则生成新 ID（使用数据库的 next_id） */
+        if (key == IMPORT_BY_ID) {
+            new_record.id = (int)file_id;
+            if (new_record.id >= db->next_id) {
+                db->next_id = new_record.id + 1;
+            }
+        } else if (db->next_id == INT_MAX) {
+            fprintf(stderr, "警告：第%d行无可用 ID，跳过。\n", line_num);
+            st.bad++;
+            continue;
+        } else {
+            new_record.id = db->next_id++;
+        }
+        new_record.age = (uint8_t)age;
+        new_record.flags = 0;
+
+        /* 追加到行存储，同时建立 ID 索引；按姓名合并时同名的后续行改写这一条 */
+        uint32_t new_row = (uint32_t)db->count;
+        if (!db_insert_record(db, &new_record, name) ||
+            (key == IMPORT_BY_NAME && !idmap_put(&names, import_name_key(db->names[new_row]), new_row))) {
+            fprintf(stderr, "错误：内存不足！\n");
+            ret = -1;
+            break;
+        }
+        st.inserted++;
     }
 
     fclose(fp);
-    printf("成功从 CSV 文件 '%s' 导入 %d 条记录\n", filename, imported);
-    return 0;
-}
-
-/*
- * io_set_auto_save_db - 设置自动保存的数据库指针
- */
-void io_set_auto_save_db(Database *db) {
-    auto_save_db = db;
-}
-
-/*
- * io_auto_save - 自动保存函数（用于 atexit 注册）
- */
-void io_auto_save(void) {
-    if (auto_save_db != NULL && auto_save_db->head != NULL) {
-        io_save_binary(auto_save_db, DB_FILENAME);
+    idmap_free(&names);
+    if (stats != NULL) {
+        *stats = st;
+    }
+    if (key == IMPORT_APPEND) {
+        printf("成功从 CSV 文件 '%s' 导入 %llu 条记录\n", filename, (unsigned long long)st.inserted);
+    } else {
+        printf("从 CSV 文件 '%s' 合并导入（按%s）：插入 %llu 条，改写 %llu 条，相同跳过 %llu 条，错误 %llu 行，用时 %.3f 秒\n",
+               filename, key == IMPORT_BY_ID ? " ID" : "姓名",
+               (unsigned long long)st.inserted, (unsigned long long)st.updated,
+               (unsigned long long)st.skipped, (unsigned long long)st.bad,
+               (double)(clock() - t0) / CLOCKS_PER_SEC);
     }
+    return ret;
 }
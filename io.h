@@ -6,8 +6,57 @@
 #ifndef IO_H
 #define IO_H
 
+#include <stdio.h>
 #include "db.h"
 
+/* 二进制文件格式（第 2 版：变长姓名，保存状态标志） */
+#define SNAPSHOT_MAGIC      "MDB2"  // 文件标识
+#define SNAPSHOT_MAGIC_LEN  4
+#define SNAPSHOT_HEADER     12      // 文件头：标识 + count(4) + next_id(4)
+#define SNAPSHOT_REC_FIXED  15      // 每条记录的定长部分：id(4) + score(8) + age(1) + flags(1) + name_len(1)
+#define SNAPSHOT_REC_MAX    (SNAPSHOT_REC_FIXED + MAX_NAME_LEN)
+
+/* 第 3 版：按 DB_BLOCK_ROWS 行分块，记录编码同第 2 版，可只重写有修改的块（格式见 io.c） */
+#define SNAPSHOT3_MAGIC     "MDB3"
+#define SNAPSHOT3_HEADER    64      // 文件头定长部分
+#define SNAPSHOT3_MAP_ENTRY 16      // 块映射每块：off(8) + len(4) + rows(4)
+
+/* 第 3 版文件头 */
+typedef struct SnapHeader {
+    int count;          // 行数（含墓碑行）
+    int live;           // 有效记录数
+    int next_id;
+    uint32_t nblocks;   // 块数
+    uint64_t map_off;   // 块映射的偏移
+    uint64_t tag;       // 文件标识（整体重写时生成）
+    uint64_t gen;       // 保存次数（每次保存加一）
+    uint64_t lsn;       // 快照包含的最后一项操作日志的序号（见 repl.h）
+} SnapHeader;
+
+/* CSV 导入时判断记录是否已存在的键 */
+typedef enum ImportKey {
+    IMPORT_APPEND,      // 不判断，全部追加并分配新 ID
+    IMPORT_BY_ID,       // 按文件中的 ID：已存在则改写，否则以该 ID 插入
+    IMPORT_BY_NAME      // 按姓名：已有同名的有效记录则改写（同名多条时取最早的一条），否则分配新 ID 插入
+} ImportKey;
+
+/* CSV 导入统计 */
+typedef struct ImportStats {
+    uint64_t inserted;  // 插入（含按 ID 恢复已删除的记录）
+    uint64_t updated;   // 改写了姓名、年龄或成绩
+    uint64_t skipped;   // 已存在且内容相同，未修改
+    uint64_t bad;       // 格式错误或字段超出范围的行
+} ImportStats;
+
+/* 块映射中的一项 */
+typedef struct SnapBlock {
+    uint64_t off;       // 块在文件中的偏移
+    uint32_t len;       // 块的字节数
+    uint32_t rows;      // 块中的行数（含墓碑行）
+} SnapBlock;
+
+typedef struct SnapshotPlan SnapshotPlan;  // 一次保存要写入的内容（见 io_snapshot_prepare）
+
 /*
  * ==================== 文件 I/O 接口 ====================
  */
@@ -16,24 +65,36 @@
  * 二进制文件操作
  * 用于快速保存和加载整个数据库
  */
-int io_save_binary(const Database *db, const char *filename);   // 保存数据库到二进制文件
+int io_save_binary(Database *db, const char *filename);         // 保存数据库到二进制文件（能增量时只写有修改的块）
 int io_load_binary(Database *db, const char *filename);         // 从二进制文件加载数据库
+size_t io_encode_record(const Database *db, const Record *record, unsigned char *buf);  // 编码一条第 2 版记录，返回字节数
+bool io_decode_records(const unsigned char *data, size_t size, uint32_t n,
+                       Record *rows, const unsigned char **names, size_t *used);  // 解码 n 条连续的第 2 版记录
+
+/*
+ * 第 3 版快照的分步保存（后台保存用：编码时持锁，写文件时不持锁）与块布局
+ */
+SnapshotPlan *io_snapshot_prepare(const Database *db, const char *filename);  // 编码有修改的块（或整个文件）
+bool io_snapshot_write(SnapshotPlan *plan);                                 // 写入文件
+void io_snapshot_finish(Database *db, SnapshotPlan *plan, bool ok);         // 记下新的块布局并释放 plan
+uint64_t io_snapshot_size(const SnapshotPlan *plan);                        // 要写入的字节数
+uint32_t io_snapshot_blocks(const SnapshotPlan *plan);                      // 要写入的块数
+bool io_parse_snapshot3(const unsigned char *buf, size_t size, SnapHeader *h, SnapBlock **map);  // 校验文件头与块映射
+bool io_read_snapshot3(FILE *fp, SnapHeader *h, SnapBlock **map);          // 只读取并校验文件头与块映射（流式读取记录用）
+void io_snap_adopt(Database *db, const char *filename, const SnapHeader *h,
+                   const SnapBlock *map, uint64_t size);                    // 加载后记下块布局
+void io_snap_free(struct SnapLayout *snap);                                 // 释放块布局
+bool io_snapshot_lsn(const char *filename, uint64_t *lsn);                  // 只读取快照中的日志序号
 
 /*
  * CSV 文件操作
  * 用于与其他程序交换数据
  */
 int io_export_csv(const Database *db, const char *filename);    // 导出为 CSV 格式
+int io_export_csv_where(const Database *db, const char *filename,
+                        uint8_t must_set, uint8_t must_clear);  // 只导出标志满足条件的记录
 int io_import_csv(Database *db, const char *filename);          // 从 CSV 导入数据
-
-/*
- * 自动保存（用于 atexit 注册）
- */
-void io_auto_save(void);        // 注册自动保存，退出时调用
-
-/*
- * 设置自动保存的数据库指针
- */
-void io_set_auto_save_db(Database *db);
+int io_import_csv_keyed(Database *db, const char *filename,
+                        ImportKey key, ImportStats *stats);     // 按 ID 或姓名合并导入（更新或插入）
 
 #endif /* IO_H */
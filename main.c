@@ -9,10 +9,36 @@
 #include "db.h"
 #include "io.h"
 #include "utils.h"
+#include "output.h"
+#include "cursor.h"
+#include "topk.h"
+#include "agg.h"
+#include "query.h"
+#include "fuzzy.h"
+#include "prefix.h"
+#include "arrow.h"
+#include "extsort.h"
+#include "pager.h"
+#include "partition.h"
+#include "autosave.h"
+#include "repl.h"
 
 /* 全局数据库指针，用于自动保存 */
 static Database *g_db = NULL;
 
+/*
+ * 访问数据库前加锁，访问结束后写出本次修改的操作日志再解锁
+ * 命令的输入都在加锁前读完：等待用户输入时后台保存和副本的应用线程不会被挡住
+ */
+static void lock_db(void) {
+    autosave_begin();
+}
+
+static void unlock_db(void) {
+    repl_flush();  /* 本次修改写入操作日志，副本随即应用 */
+    autosave_end();
+}
+
 /*
  * 显示排序子菜单
  */
@@ -32,7 +58,9 @@ static void show_sort_menu(void) {
  * 显示统计信息（直接调用 db_stats）
  */
 static void show_stats(void) {
+    lock_db();
     db_stats(g_db);
+    unlock_db();
 }
 
 /*
@@ -47,6 +75,8 @@ static void show_flag_menu(void) {
     printf("3. 切换 VIP 标志\n");
     printf("4. 切换软删除标志\n");
     printf("5. 查看所有记录状态\n");
+    printf("6. 按状态组合查询\n");
+    printf("7. 按状态组合统计\n");
     printf("0. 返回主菜单\n");
     printf("---------------\n");
 }
@@ -62,10 +92,357 @@ static void show_file_menu(void) {
     printf("2. 从二进制文件加载 (load)\n");
     printf("3. 导出为 CSV (export)\n");
     printf("4. 从 CSV 导入 (import)\n");
+    printf("5. 按状态组合导出 CSV\n");
+    printf("6. 外部排序（文件 → 文件）\n");
+    printf("7. 分区保存\n");
+    printf("8. 分区加载（并行）\n");
+    printf("9. 按 ID 范围查询分区文件\n");
+    printf("10. 自动保存状态\n");
+    printf("11. 复制状态\n");
+    printf("12. 从 CSV 合并导入（按 ID 或姓名更新已有记录）\n");
+    printf("13. 导出为 Arrow 文件（列式，供分析工具读取）\n");
+    printf("0. 返回主菜单\n");
+    printf("---------------\n");
+}
+
+/*
+ * 显示页式存储子菜单
+ */
+static void show_paged_menu(void) {
+    printf("\n---------------\n");
+    printf("   页式存储菜单\n");
+    printf("---------------\n");
+    printf("1. 由当前数据库生成页式文件\n");
+    printf("2. 按 ID 查找\n");
+    printf("3. 组合条件查询\n");
+    printf("4. 修改成绩\n");
+    printf("5. 切换记录标志\n");
+    printf("6. 追加记录\n");
+    printf("7. 缓冲池统计\n");
+    printf("0. 关闭文件并返回主菜单\n");
+    printf("---------------\n");
+}
+
+/*
+ * 显示高级查询子菜单
+ */
+static void show_query_menu(void) {
+    printf("\n---------------\n");
+    printf("   高级查询菜单\n");
+    printf("---------------\n");
+    printf("1. 按页码分页浏览（当前顺序）\n");
+    printf("2. 按续读令牌浏览（ID 顺序）\n");
+    printf("3. 成绩最高的 K 条记录\n");
+    printf("4. 成绩最低的 K 条记录\n");
+    printf("5. 成绩与年龄分位数\n");
+    printf("6. 分组统计 (GROUP BY)\n");
+    printf("7. 组合条件查询（显示执行计划）\n");
+    printf("8. 模糊姓名查找（编辑距离）\n");
+    printf("9. 姓名前缀查找（自动补全）\n");
     printf("0. 返回主菜单\n");
     printf("---------------\n");
 }
 
+/*
+ * 读取新记录的姓名、年龄和成绩，无效时提示重新输入
+ * name 至少 MAX_NAME_LEN 字节；返回值：1 表示成功，0 表示输入结束或不是数字
+ */
+static int read_new_record(char *name, int *age, double *score) {
+    while (1) {
+        printf("请输入学生姓名：\n");
+        if (scanf("%63s", name) != 1) {  // 注意：假设输入不包含空格
+            clear_input_buffer();
+            return 0;
+        }
+        if (validate_name(name)) {
+            break;
+        }
+        printf("请重新输入。\n");
+    }
+    while (1) {
+        if (!read_int("请输入学生年龄：\n", age)) {
+            return 0;
+        }
+        if (validate_age(*age)) {
+            break;
+        }
+        printf("请重新输入。\n");
+    }
+    while (1) {
+        if (!read_double("请输入学生成绩：\n", score)) {
+            return 0;
+        }
+        if (validate_score(*score)) {
+            break;
+        }
+        printf("请重新输入。\n");
+    }
+    return 1;
+}
+
+/*
+ * 读取一个标志组合
+ * 输入由 R（只读）、A（归档）、V（VIP）组成，不区分大小写；
+ * 输入 - 表示不限。已删除的记录总是被排除，不能作为条件
+ * 返回值：1 表示成功，0 表示输入无效
+ */
+static int read_flag_mask(const char *prompt, uint8_t *mask) {
+    char text[16];
+    printf("%s", prompt);
+    if (scanf("%15s", text) != 1) {
+        clear_input_buffer();
+        return 0;
+    }
+    *mask = 0;
+    if (strcmp(text, "-") == 0) {
+        return 1;
+    }
+    for (const char *c = text; *c != '\0'; c++) {
+        switch (*c) {
+            case 'R': case 'r': *mask |= FLAG_READONLY; break;
+            case 'A': case 'a': *mask |= FLAG_ARCHIVED; break;
+            case 'V': case 'v': *mask |= FLAG_VIP; break;
+            default:
+                printf("错误：无效的标志 '%c'！\n", *c);
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * 读取"必须开启"和"必须关闭"两组标志
+ */
+static int read_flag_filter(uint8_t *must_set, uint8_t *must_clear) {
+    printf("标志代码：R 只读  A 归档  V VIP（可组合，- 表示不限）\n");
+    if (!read_flag_mask("必须开启的标志: ", must_set) ||
+        !read_flag_mask("必须关闭的标志: ", must_clear)) {
+        return 0;
+    }
+    if (*must_set & *must_clear) {
+        printf("错误：同一标志不能既要求开启又要求关闭！\n");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * 读取 Top-K 查询的条数和筛选条件
+ */
+static int read_top_k_options(TopKOptions *opt, bool lowest) {
+    int k, age_min, age_max, filter;
+    if (!read_int("请输入 K: ", &k)) {
+        return 0;
+    }
+    if (k < 1) {
+        printf("错误：K 必须为正整数！\n");
+        return 0;
+    }
+    topk_options_init(opt, k);
+    opt->lowest = lowest;
+
+    if (!read_int("是否按年龄和状态筛选（1 是 / 0 否）: ", &filter)) {
+        return 0;
+    }
+    if (filter == 1) {
+        if (!read_int("请输入年龄下限（0 表示不限）: ", &age_min) ||
+            !read_int("请输入年龄上限（0 表示不限）: ", &age_max) ||
+            !read_flag_filter(&opt->flags_set, &opt->flags_clear)) {
+            return 0;
+        }
+        opt->age_min = age_min;
+        opt->age_max = age_max;
+    }
+    return 1;
+}
+
+/*
+ * 读取分组统计的分组键和筛选条件
+ */
+static int read_group_options(AggOptions *opt) {
+    int key, filter;
+    printf("分组方式：1 年龄  2 年龄段  3 状态组合  4 年龄+状态  5 姓名  6 成绩段\n");
+    if (!read_int("请选择分组方式: ", &key)) {
+        return 0;
+    }
+    if (key < GROUP_BY_AGE || key > GROUP_BY_SCORE_BUCKET) {
+        printf("错误：无效的选择！\n");
+        return 0;
+    }
+    agg_options_init(opt, (GroupKey)key);
+    if ((key == GROUP_BY_AGE_BUCKET || key == GROUP_BY_SCORE_BUCKET) &&
+        !read_int("请输入分段宽度: ", &opt->bucket)) {
+        return 0;
+    }
+    if (!read_int("是否按状态筛选（1 是 / 0 否）: ", &filter)) {
+        return 0;
+    }
+    if (filter == 1 && !read_flag_filter(&opt->flags_set, &opt->flags_clear)) {
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * 读取组合条件查询的各项条件，不需要的条件输入 0 或 -
+ * keyword 为姓名关键字的缓冲区（至少 MAX_NAME_LEN + 1 字节）
+ */
+static int read_query_options(Query *q, char *keyword) {
+    int id, age_min, age_max, has_score;
+    query_init(q);
+    if (!read_int("请输入学生 ID（0 表示不限）: ", &id)) {
+        return 0;
+    }
+    printf("请输入姓名关键字（- 表示不限）: ");
+    if (scanf("%64s", keyword) != 1) {
+        clear_input_buffer();
+        return 0;
+    }
+    if (!read_int("请输入年龄下限（0 表示不限）: ", &age_min) ||
+        !read_int("请输入年龄上限（0 表示不限）: ", &age_max) ||
+        !read_int("是否限制成绩范围（1 是 / 0 否）: ", &has_score)) {
+        return 0;
+    }
+    if (has_score == 1 &&
+        (!read_double("请输入成绩下限: ", &q->score_min) ||
+         !read_double("请输入成绩上限: ", &q->score_max))) {
+        return 0;
+    }
+    if (!read_flag_filter(&q->flags_set, &q->flags_clear)) {
+        return 0;
+    }
+    q->id = id > 0 ? id : 0;
+    q->name_like = strcmp(keyword, "-") == 0 ? NULL : keyword;
+    q->age_min = age_min > 0 ? age_min : 0;
+    q->age_max = age_max > 0 ? age_max : 0;
+    q->has_score = has_score == 1;
+    return 1;
+}
+
+/*
+ * 读取模糊姓名查找的关键字、最大编辑距离和是否允许相邻交换
+ * pattern 为关键字的缓冲区（至少 MAX_NAME_LEN 字节）
+ */
+static int read_fuzzy_options(FuzzyOptions *opt, char *pattern) {
+    int damerau;
+    printf("请输入姓名: ");
+    if (scanf("%63s", pattern) != 1) {
+        clear_input_buffer();
+        return 0;
+    }
+    if (!read_int("请输入最大编辑距离（0-3）: ", &opt->k) ||
+        !read_int("相邻两字颠倒是否算一次编辑（1 是 / 0 否）: ", &damerau)) {
+        return 0;
+    }
+    opt->pattern = pattern;
+    opt->damerau = damerau == 1;
+    opt->limit = FUZZY_SHOW_LIMIT;
+    return 1;
+}
+
+/*
+ * 读取外部排序参数并执行（快照或 CSV 文件，输出同格式）
+ */
+static void run_external_sort(void) {
+    char input[256], output[256], temp_dir[256];
+    int field, memory_mb;
+    printf("请输入待排序的文件名: ");
+    if (scanf("%255s", input) != 1) {
+        clear_input_buffer();
+        return;
+    }
+    printf("请输入输出文件名: ");
+    if (scanf("%255s", output) != 1) {
+        clear_input_buffer();
+        return;
+    }
+    if (!read_int("排序字段（1 ID / 2 姓名 / 3 年龄 / 4 成绩）: ", &field) ||
+        !read_int("内存上限（MB，0 表示默认 64）: ", &memory_mb)) {
+        return;
+    }
+    printf("请输入临时文件目录（- 表示当前目录）: ");
+    if (scanf("%255s", temp_dir) != 1) {
+        clear_input_buffer();
+        return;
+    }
+
+    ExtSortOptions opt;
+    ExtSortStats stats;
+    extsort_options_init(&opt, field);
+    if (memory_mb > 0) {
+        opt.memory = (size_t)memory_mb << 20;
+    }
+    opt.temp_dir = strcmp(temp_dir, "-") == 0 ? NULL : temp_dir;
+    if (extsort_file(input, output, &opt, &stats) != 0) {
+        printf("外部排序失败！\n");
+        return;
+    }
+    printf("排序完成：%llu 条记录写入 '%s'", (unsigned long long)stats.records, output);
+    if (stats.skipped > 0) {
+        printf("（跳过 %llu 行）", (unsigned long long)stats.skipped);
+    }
+    printf("\n初始顺串 %d 个，归并 %d 趟，临时文件 %.1f MB，用时 %.2f 秒\n",
+           stats.runs, stats.passes, stats.temp_bytes / 1048576.0, stats.seconds);
+}
+
+/*
+ * 读取分区文件名前缀，输入 - 时使用默认前缀
+ * base 至少 256 字节
+ */
+static int read_part_base(char *base) {
+    printf("请输入分区文件名前缀（- 表示 %s）: ", PART_BASENAME);
+    if (scanf("%255s", base) != 1) {
+        clear_input_buffer();
+        return 0;
+    }
+    if (strcmp(base, "-") == 0) {
+        strcpy(base, PART_BASENAME);
+    }
+    return 1;
+}
+
+/*
+ * 处理分区存储的三个选项（7 保存、8 加载、9 按 ID 范围查询）
+ */
+static void handle_partition(int choice) {
+    char base[256];
+    if (!read_part_base(base)) {
+        return;
+    }
+    int nparts, scheme, threads, id_min, id_max;
+    switch (choice) {
+        case 7:
+            if (!read_int("分区数: ", &nparts) ||
+                !read_int("分区方式（1 按 ID 范围 / 2 按 ID 散列）: ", &scheme) ||
+                !read_int("线程数（0 表示按 CPU 核数）: ", &threads)) {
+                return;
+            }
+            if (scheme != PART_BY_RANGE && scheme != PART_BY_HASH) {
+                printf("错误：无效的分区方式！\n");
+                return;
+            }
+            lock_db();
+            part_save(g_db, base, nparts, (PartScheme)scheme, threads);
+            unlock_db();
+            break;
+        case 8:
+            if (read_int("线程数（0 表示按 CPU 核数）: ", &threads)) {
+                lock_db();
+                autosave_sync();  /* 加载会清空数据库，先等后台写完，免得它把旧的块布局放回来 */
+                part_load(g_db, base, threads);
+                unlock_db();
+            }
+            break;
+        case 9:
+            if (read_int("ID 下限: ", &id_min) && read_int("ID 上限: ", &id_max)) {
+                part_print_id_range(base, id_min, id_max);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
 /*
  * 处理排序子菜单
  */
@@ -79,7 +456,9 @@ static void handle_sort_menu(void) {
     }
 
     if (sort_choice >= 1 && sort_choice <= 4) {
+        lock_db();
         db_sort(g_db, sort_choice);  /* 直接使用 1-based 索引 */
+        unlock_db();
     } else if (sort_choice == 0) {
         /* 返回主菜单 */
     } else {
@@ -116,9 +495,40 @@ static void handle_flag_menu(void) {
             case 4: flag = FLAG_DELETED; break;
             default: return;
         }
+        if (repl_is_replica()) {
+            printf("错误：只读副本不能修改记录状态！\n");
+            return;
+        }
+        lock_db();
         db_toggle_flag(g_db, id, flag);
+        unlock_db();
     } else if (flag_choice == 5) {
+        lock_db();
         db_show_flags(g_db);
+        unlock_db();
+    } else if (flag_choice == 6) {
+        uint8_t must_set, must_clear;
+        if (!read_flag_filter(&must_set, &must_clear)) {
+            return;
+        }
+        CursorOptions opt;
+        cursor_options_init(&opt);
+        opt.flags_set = must_set;
+        opt.flags_clear = must_clear;
+        lock_db();
+        if (cursor_print_page(g_db, &opt) > 0) {
+            printf("满足条件的记录共 %llu 条。\n",
+                   (unsigned long long)db_flag_count(g_db, must_set, must_clear));
+        }
+        unlock_db();
+    } else if (flag_choice == 7) {
+        uint8_t must_set, must_clear;
+        if (!read_flag_filter(&must_set, &must_clear)) {
+            return;
+        }
+        lock_db();
+        db_stats_where(g_db, must_set, must_clear);
+        unlock_db();
     } else if (flag_choice == 0) {
         /* 返回主菜单 */
     } else {
@@ -138,18 +548,84 @@ static void handle_file_menu(void) {
         return;
     }
 
+    /* 只读副本的数据只来自主库，不能加载、导入，也不能覆盖主库的快照 */
+    if (repl_is_replica() &&
+        (file_choice == 1 || file_choice == 2 || file_choice == 4 || file_choice == 8 || file_choice == 12)) {
+        printf("错误：只读副本不能执行该操作！\n");
+        return;
+    }
+
     switch (file_choice) {
         case 1:
-            io_save_binary(g_db, DB_FILENAME);
+            lock_db();
+            autosave_sync();
+            if (io_save_binary(g_db, DB_FILENAME) == 0) {
+                db_mark_clean(g_db);
+            }
+            unlock_db();
             break;
         case 2:
-            io_load_binary(g_db, DB_FILENAME);
+            lock_db();
+            autosave_sync();
+            if (part_load_snapshot(g_db, DB_FILENAME, 0) == 0) {  /* 多线程加载，旧版格式自动退回 io_load_binary */
+                db_mark_clean(g_db);
+            }
+            unlock_db();
             break;
         case 3:
+            lock_db();
             io_export_csv(g_db, CSV_FILENAME);
+            unlock_db();
             break;
         case 4:
+            lock_db();
             io_import_csv(g_db, CSV_FILENAME);
+            unlock_db();
+            break;
+        case 5: {
+            uint8_t must_set, must_clear;
+            if (read_flag_filter(&must_set, &must_clear)) {
+                lock_db();
+                io_export_csv_where(g_db, CSV_FILENAME, must_set, must_clear);
+                unlock_db();
+            }
+            break;
+        }
+        case 6:
+            run_external_sort();
+            break;
+        case 7:
+        case 8:
+        case 9:
+            handle_partition(file_choice);
+            break;
+        case 10:
+            lock_db();
+            autosave_print_status();
+            unlock_db();
+            break;
+        case 11:
+            lock_db();
+            repl_print_status();
+            unlock_db();
+            break;
+        case 12: {
+            int key;
+            printf("合并的键（1. ID  2. 姓名）: ");
+            if (scanf("%d", &key) != 1 || (key != 1 && key != 2)) {
+                printf("错误：无效的选择！\n");
+                clear_input_buffer();
+                break;
+            }
+            lock_db();
+            io_import_csv_keyed(g_db, CSV_FILENAME, key == 1 ? IMPORT_BY_ID : IMPORT_BY_NAME, NULL);
+            unlock_db();
+            break;
+        }
+        case 13:
+            lock_db();
+            arrow_export(g_db, ARROW_FILENAME);
+            unlock_db();
             break;
         case 0:
             /* 返回主菜单 */
@@ -160,7 +636,312 @@ static void handle_file_menu(void) {
     }
 }
 
-int main(void) {
+/*
+ * 处理高级查询子菜单
+ */
+static void handle_query_menu(void) {
+    show_query_menu();
+    int query_choice;
+    if (scanf("%d", &query_choice) != 1) {
+        printf("错误：请输入有效的数字！\n");
+        clear_input_buffer();
+        return;
+    }
+
+    CursorOptions opt;
+    cursor_options_init(&opt);
+
+    switch (query_choice) {
+        case 1: {
+            int page_size, page;
+            if (!read_int("请输入每页条数: ", &page_size) ||
+                !read_int("请输入页码（从 1 开始）: ", &page)) {
+                return;
+            }
+            if (page_size < 1 || page < 1) {
+                printf("错误：每页条数和页码必须为正整数！\n");
+                return;
+            }
+            opt.limit = page_size;
+            opt.offset = (page - 1) * page_size;
+            lock_db();
+            cursor_print_page(g_db, &opt);
+            unlock_db();
+            break;
+        }
+        case 2: {
+            int page_size, token;
+            if (!read_int("请输入每页条数: ", &page_size) ||
+                !read_int("请输入续读令牌（0 表示从头开始）: ", &token)) {
+                return;
+            }
+            if (page_size < 1 || token < 0) {
+                printf("错误：每页条数必须为正整数，令牌不能为负！\n");
+                return;
+            }
+            opt.order = CURSOR_ORDER_ID;
+            opt.limit = page_size;
+            opt.after_id = token;
+            lock_db();
+            db_sort_cache(g_db, SORT_BY_ID);  /* 失败时游标自行排序未覆盖的行 */
+            cursor_print_page(g_db, &opt);
+            unlock_db();
+            break;
+        }
+        case 3:
+        case 4: {
+            TopKOptions top;
+            if (read_top_k_options(&top, query_choice == 4)) {
+                lock_db();
+                db_print_top_k(g_db, &top);
+                unlock_db();
+            }
+            break;
+        }
+        case 5:
+            lock_db();
+            db_quantiles(g_db);
+            unlock_db();
+            break;
+        case 6: {
+            AggOptions agg;
+            if (read_group_options(&agg)) {
+                lock_db();
+                db_print_group_by(g_db, &agg);
+                unlock_db();
+            }
+            break;
+        }
+        case 7: {
+            Query q;
+            char keyword[MAX_NAME_LEN + 1];
+            if (read_query_options(&q, keyword)) {
+                lock_db();
+                db_print_query(g_db, &q, true);
+                unlock_db();
+            }
+            break;
+        }
+        case 8: {
+            FuzzyOptions fz;
+            char pattern[MAX_NAME_LEN];
+            if (read_fuzzy_options(&fz, pattern)) {
+                lock_db();
+                db_print_fuzzy(g_db, &fz);
+                unlock_db();
+            }
+            break;
+        }
+        case 9: {
+            char prefix[MAX_NAME_LEN];
+            int limit;
+            printf("请输入姓名前缀: ");
+            if (scanf("%63s", prefix) != 1) {
+                clear_input_buffer();
+                return;
+            }
+            if (!read_int("请输入最多显示的条数: ", &limit)) {
+                return;
+            }
+            if (limit < 1) {
+                printf("错误：条数必须为正整数！\n");
+                return;
+            }
+            lock_db();
+            db_print_prefix(g_db, prefix, (size_t)limit);
+            unlock_db();
+            break;
+        }
+        case 0:
+            /* 返回主菜单 */
+            break;
+        default:
+            printf("错误：无效的选择！\n");
+            break;
+    }
+}
+
+/*
+ * 处理页式存储子菜单
+ * 进入时打开页式文件（不存在时由当前数据库生成），退出时刷新并关闭
+ */
+static void handle_paged_menu(void) {
+    char path[256];
+    int memory_mb;
+    printf("请输入页式文件名（- 表示 %s）: ", PAGED_FILENAME);
+    if (scanf("%255s", path) != 1) {
+        clear_input_buffer();
+        return;
+    }
+    if (strcmp(path, "-") == 0) {
+        strcpy(path, PAGED_FILENAME);
+    }
+    if (!read_int("缓冲池大小（MB，0 表示默认 4）: ", &memory_mb)) {
+        return;
+    }
+    size_t memory = memory_mb > 0 ? (size_t)memory_mb << 20 : PAGER_DEFAULT_MEMORY;
+
+    FILE *test = fopen(path, "rb");
+    if (test != NULL) {
+        fclose(test);
+    } else {
+        lock_db();
+        int built = pager_build(g_db, path);
+        unlock_db();
+        if (built != 0) {
+            return;
+        }
+    }
+    Pager *pager = pager_open(path, memory);
+    if (pager == NULL) {
+        return;
+    }
+
+    int choice = -1;
+    while (choice != 0) {
+        show_paged_menu();
+        int ret = scanf("%d", &choice);
+        if (ret == EOF) {
+            break;
+        }
+        if (ret != 1) {
+            printf("错误：请输入有效的数字！\n");
+            clear_input_buffer();
+            choice = -1;
+            continue;
+        }
+
+        int id;
+        Record rec;
+        char name[MAX_NAME_LEN];
+        switch (choice) {
+            case 1: {
+                /* 先关闭再重写，避免缓冲池中的旧页写回新文件 */
+                pager_close(pager);
+                pager = NULL;
+                lock_db();
+                int built = pager_build(g_db, path);
+                unlock_db();
+                if (built == 0) {
+                    pager = pager_open(path, memory);
+                }
+                if (pager == NULL) {
+                    return;
+                }
+                break;
+            }
+            case 2:
+                if (!read_int("请输入学生 ID: ", &id)) {
+                    break;
+                }
+                if (pager_get(pager, id, &rec, name) && !db_is_dead(&rec)) {
+                    OutBuf ob;
+                    out_init(&ob, stdout);
+                    out_record_named(&ob, &rec, name, strlen(name));
+                    out_flush(&ob);
+                } else {
+                    printf("未找到 ID 为 %d 的记录！\n", id);
+                }
+                break;
+            case 3: {
+                Query q;
+                char keyword[MAX_NAME_LEN + 1];
+                if (read_query_options(&q, keyword)) {
+                    pager_print_query(pager, &q);
+                }
+                break;
+            }
+            case 4: {
+                double score;
+                if (!read_int("请输入学生 ID: ", &id) || !read_double("请输入新成绩: ", &score) ||
+                    !validate_score(score)) {
+                    break;
+                }
+                if (pager_set_score(pager, id, score)) {
+                    printf("成绩已更新。\n");
+                } else {
+                    printf("未找到 ID 为 %d 的记录！\n", id);
+                }
+                break;
+            }
+            case 5: {
+                int which;
+                if (!read_int("请输入学生 ID: ", &id) ||
+                    !read_int("标志（1 只读 / 2 归档 / 3 VIP / 4 删除）: ", &which)) {
+                    break;
+                }
+                if (which < 1 || which > FLAG_COUNT) {
+                    printf("错误：无效的标志！\n");
+                    break;
+                }
+                if (pager_toggle_flag(pager, id, (uint8_t)(1 << (which - 1)))) {
+                    printf("ID %d 的标志已切换。\n", id);
+                } else {
+                    printf("未找到 ID 为 %d 的记录！\n", id);
+                }
+                break;
+            }
+            case 6: {
+                int age;
+                memset(&rec, 0, sizeof(rec));
+                printf("请输入学生姓名: ");
+                if (scanf("%63s", name) != 1) {
+                    clear_input_buffer();
+                    break;
+                }
+                if (!validate_name(name) || !read_int("请输入学生年龄: ", &age) || !validate_age(age) ||
+                    !read_double("请输入学生成绩: ", &rec.score) || !validate_score(rec.score)) {
+                    break;
+                }
+                rec.age = (uint8_t)age;
+                id = pager_append(pager, &rec, name);
+                if (id > 0) {
+                    printf("记录完成！学生 ID：%d\n", id);
+                }
+                break;
+            }
+            case 7:
+                pager_print_stats(pager);
+                break;
+            case 0:
+                /* 返回主菜单 */
+                break;
+            default:
+                printf("错误：无效的选择！\n");
+                break;
+        }
+    }
+    pager_flush(pager);
+    pager_print_stats(pager);
+    pager_close(pager);
+}
+
+int main(int argc, char *argv[]) {
+    int autosave_interval = AUTOSAVE_INTERVAL;
+    unsigned long long autosave_changes = AUTOSAVE_CHANGES;
+    bool primary = false;
+    bool replica = false;
+
+    /* 输出模式：重定向到文件或管道时默认紧凑格式，可用参数覆盖 */
+    out_auto_mode();
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--compact") == 0) {
+            out_set_mode(OUTPUT_COMPACT);
+        } else if (strcmp(argv[i], "--pretty") == 0) {
+            out_set_mode(OUTPUT_PRETTY);
+        } else if (sscanf(argv[i], "--autosave=%d", &autosave_interval) == 1) {
+            /* 自动保存间隔（秒），0 表示不按时间保存 */
+        } else if (sscanf(argv[i], "--autosave-changes=%llu", &autosave_changes) == 1) {
+            /* 修改达到该次数时提前保存，0 表示不按次数保存 */
+        } else if (strcmp(argv[i], "--primary") == 0) {
+            primary = true;   /* 复制主库：把修改写入操作日志 */
+        } else if (strcmp(argv[i], "--replica") == 0) {
+            replica = true;   /* 只读副本：加载主库的快照，持续应用其操作日志 */
+        } else {
+            fprintf(stderr, "警告：未知参数 '%s'，已忽略。\n", argv[i]);
+        }
+    }
+
     /* 创建数据库 */
     g_db = db_create();
     if (g_db == NULL) {
@@ -168,59 +949,115 @@ int main(void) {
         return 1;
     }
 
-    /* 注册自动保存函数 */
-    io_set_auto_save_db(g_db);
-    if (atexit(io_auto_save) != 0) {
-        fprintf(stderr, "警告：无法注册自动保存函数！\n");
-    }
-
     /* 尝试自动加载上次保存的数据 */
     FILE *test = fopen(DB_FILENAME, "rb");
     if (test != NULL) {
         fclose(test);
         printf("发现已保存的数据文件，正在加载...\n");
-        io_load_binary(g_db, DB_FILENAME);
+        if (part_load_snapshot(g_db, DB_FILENAME, 0) == 0) {
+            db_mark_clean(g_db);
+        }
         printf("\n");
     }
 
+    if (replica) {
+        /* 副本不保存（快照文件属于主库），退出时由 atexit 停止应用线程 */
+        if (repl_replica_start(g_db, DB_FILENAME, LOG_FILENAME) && atexit(repl_stop) != 0) {
+            fprintf(stderr, "警告：无法注册复制停止函数！\n");
+        }
+    } else {
+        /* 启动后台自动保存，退出时（含输入结束）由 atexit 保存剩余的修改 */
+        autosave_start(g_db, DB_FILENAME, autosave_interval, (uint64_t)autosave_changes);
+        if (atexit(autosave_stop) != 0) {
+            fprintf(stderr, "警告：无法注册自动保存函数！\n");
+        }
+        /* atexit 后注册的先执行：先写出剩余的日志，再由自动保存把同一序号写入快照 */
+        if (primary && repl_primary_start(g_db, LOG_FILENAME) && atexit(repl_stop) != 0) {
+            fprintf(stderr, "警告：无法注册复制停止函数！\n");
+        }
+    }
+
     /* 主循环 */
     while (1) {
         int choice;
 
         /* 显示主菜单 */
         printf("\n=========== MiniDB 学生记录管理系统 ===========\n");
-        printf("当前记录数：%d\n", g_db->count);
+        lock_db();  /* 副本的应用线程可能正在追加记录 */
+        if (replica) {
+            printf("当前记录数：%d（只读副本，已应用到序号 %llu）\n",
+                   db_live_count(g_db), (unsigned long long)g_db->lsn);
+        } else {
+            printf("当前记录数：%d\n", db_live_count(g_db));
+        }
+        unlock_db();
         printf("-------------------------------------------------\n");
         printf("1. 添加记录    2. 查看全部    3. 按 ID 查找\n");
         printf("4. 按姓名查找  5. 按 ID 删除  6. 排序记录\n");
         printf("7. 文件操作    8. 统计信息    9. 记录状态\n");
-        printf("0. 退出系统\n");
+        printf("11. 高级查询  12. 页式存储  0. 退出系统\n");
         printf("-------------------------------------------------\n");
-        printf("请输入你的选择 (0-9): ");
+        printf("请输入你的选择 (0-12): ");
 
         /* 带错误处理的输入 */
-        if (scanf("%d", &choice) != 1) {
+        int ret = scanf("%d", &choice);
+        if (ret == EOF) {
+            /* 输入结束（如管道输入已读完）：退出主循环，由 atexit 自动保存 */
+            break;
+        }
+        if (ret != 1) {
             printf("错误：请输入有效的数字！\n");
             clear_input_buffer();
             continue;
         }
 
+        /* 各命令先读完输入，只在访问数据库期间持有数据库锁（lock_db / unlock_db），
+           后台自动保存不会看到修改到一半的数据，用户停在提示符前也不会挡住副本应用日志 */
+        if (replica && (choice == CMD_ADD || choice == CMD_DELETE)) {
+            printf("错误：只读副本不能添加或删除记录！\n");
+            continue;
+        }
         switch ((Command)choice) {
-            case CMD_ADD:
-                db_add(g_db);
+            case CMD_ADD: {
+                char name[MAX_NAME_LEN];
+                int age;
+                double score;
+                if (read_new_record(name, &age, &score)) {
+                    lock_db();
+                    db_add(g_db, name, (uint8_t)age, score);
+                    unlock_db();
+                }
                 break;
+            }
 
             case CMD_LIST:
+                lock_db();
                 db_list_all(g_db);
+                unlock_db();
                 break;
 
-            case CMD_FIND_ID:
-                db_find_by_id(g_db);
+            case CMD_FIND_ID: {
+                int id;
+                if (read_int("请输入你要查找的学生 ID：\n", &id)) {
+                    lock_db();
+                    db_find_by_id(g_db, id);
+                    unlock_db();
+                }
                 break;
+            }
 
-            case CMD_FIND_NAME:
-                db_find_by_name(g_db);
+            case CMD_FIND_NAME: {
+                char keyword[MAX_NAME_LEN + 1];
+                printf("请输入要查找的姓名或部分姓名：\n");
+                if (scanf("%64s", keyword) != 1) {
+                    clear_input_buffer();
+                    break;
+                }
+                lock_db();
+                db_find_by_name(g_db, keyword);
+                unlock_db();
                 break;
+            }
 
             case CMD_DELETE: {
                 int id;
@@ -229,7 +1066,9 @@ int main(void) {
                     printf("错误：请输入有效的数字！\n");
                     clear_input_buffer();
                 } else {
+                    lock_db();
                     db_delete(g_db, id);
+                    unlock_db();
                 }
                 break;
             }
@@ -250,15 +1089,27 @@ int main(void) {
                 handle_flag_menu();
                 break;
 
+            case CMD_QUERY:
+                handle_query_menu();
+                break;
+
+            case CMD_PAGED:
+                handle_paged_menu();
+                break;
+
             case CMD_QUIT: {
                 printf("感谢使用 MiniDB，再见！\n");
+                /* 先写出剩余的操作日志（或停止副本的应用线程）、停止自动保存（保存剩余的修改）再释放，
+                   atexit 中再次调用时直接返回 */
+                repl_stop();
+                autosave_stop();
                 db_destroy(g_db);
-                g_db = NULL;  /* 防止 atexit 再次访问已释放的内存 */
+                g_db = NULL;
                 return 0;
             }
 
             default:
-                printf("错误：请输入 0-9 之间的数字！\n");
+                printf("错误：请输入 0-12 之间的数字！\n");
                 break;
         }
     }
@@ -0,0 +1,192 @@
+/*
+ * namesort.c - MiniDB 姓名排序实现
+ * qsort + strcmp 每次比较都经函数指针跳到字符串堆中的两个随机位置，缓存缺失占主要时间；
+ * 这里每项只在组键时读一次姓名，排序过程只读写连续的 16 字节排序项。
+ * 排序项按当前 8 字节键的第 b 个字节分成 256 桶（原地交换），逐桶递归到下一个字节：
+ * - 第 b 个字节为 0 的桶：姓名已在此前结束，整个桶姓名相同，直接按次序键排序
+ * - 8 个字节都相同且未结束：取姓名的下一个 8 字节重新组键，从第 0 个字节继续
+ * - 不超过 NAMESORT_SMALL 项：插入排序，键相同时比较姓名剩余部分
+ */
+
+#include "namesort.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NAMESORT_SMALL 32   // 不超过此项数的区间改用插入排序
+
+/* 排序项：当前 8 字节键、下标、次序键 */
+typedef struct SortKey {
+    uint64_t key;
+    uint32_t item;
+    int32_t tie;
+} SortKey;
+
+/* 取姓名用的参数 */
+typedef struct SortCtx {
+    const char *heap;
+    const unsigned char *offs;
+    size_t off_stride;
+} SortCtx;
+
+static const char *item_name(const SortCtx *ctx, uint32_t item) {
+    uint32_t off;
+    memcpy(&off, ctx->offs + (size_t)item * ctx->off_stride, sizeof(off));
+    return ctx->heap + off;
+}
+
+/* s 的前 8 字节组成大端键，姓名结束后补 0（姓名中没有 0 字节，补 0 与 strcmp 的顺序一致） */
+static uint64_t chunk_key(const char *s) {
+    uint64_t key = 0;
+    int i = 0;
+    while (i < 8 && s[i] != '\0') {
+        key = (key << 8) | (unsigned char)s[i];
+        i++;
+    }
+    return i == 0 ? 0 : key << (8 * (8 - i));
+}
+
+static int compare_tie(const void *a, const void *b) {
+    const SortKey *x = a;
+    const SortKey *y = b;
+    if (x->tie != y->tie) {
+        return x->tie < y->tie ? -1 : 1;
+    }
+    return (x->item > y->item) - (x->item < y->item);
+}
+
+/* 完整比较：depth 为当前键在姓名中的起始字节 */
+static int compare_full(const SortCtx *ctx, const SortKey *x, const SortKey *y, size_t depth) {
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    if ((x->key & 0xFF) != 0) {
+        /* 8 个字节都相同且未结束，比较剩余部分 */
+        int c = strcmp(item_name(ctx, x->item) + depth + 8, item_name(ctx, y->item) + depth + 8);
+        if (c != 0) {
+            return c;
+        }
+    }
+    return compare_tie(x, y);
+}
+
+static void insertion_sort(const SortCtx *ctx, SortKey *a, size_t n, size_t depth) {
+    for (size_t i = 1; i < n; i++) {
+        SortKey x = a[i];
+        size_t j = i;
+        while (j > 0 && compare_full(ctx, &a[j - 1], &x, depth) > 0) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = x;
+    }
+}
+
+/* 姓名完全相同的一组，按次序键排序 */
+static void sort_ties(SortKey *a, size_t n) {
+    if (n > 1) {
+        qsort(a, n, sizeof(SortKey), compare_tie);
+    }
+}
+
+/*
+ * msd_sort - 区间内各项姓名的前 depth + b 个字节都相同，从当前键的第 b 个字节起排序
+ * 只有一个非空桶的字节直接跳过，不做分桶
+ */
+static void msd_sort(const SortCtx *ctx, SortKey *a, size_t n, size_t depth, int b) {
+    for (;;) {
+        if (n <= NAMESORT_SMALL) {
+            insertion_sort(ctx, a, n, depth);
+            return;
+        }
+        if (b == 8) {
+            if ((a[0].key & 0xFF) == 0) {
+                sort_ties(a, n);
+                return;
+            }
+            depth += 8;
+            for (size_t i = 0; i < n; i++) {
+                a[i].key = chunk_key(item_name(ctx, a[i].item) + depth);
+            }
+            b = 0;
+            continue;
+        }
+
+        int shift = 56 - 8 * b;
+        size_t end[256], next[256];
+        memset(end, 0, sizeof(end));
+        for (size_t i = 0; i < n; i++) {
+            end[(a[i].key >> shift) & 0xFF]++;
+        }
+        if (end[(a[0].key >> shift) & 0xFF] == n) {
+            if (((a[0].key >> shift) & 0xFF) == 0) {
+                sort_ties(a, n);
+                return;
+            }
+            b++;
+            continue;
+        }
+        size_t sum = 0;
+        for (int c = 0; c < 256; c++) {
+            next[c] = sum;
+            sum += end[c];
+            end[c] = sum;
+        }
+
+        /* American flag：把每个位置上的项换到它所属的桶，直到该位置放入本桶的项 */
+        for (int c = 0; c < 256; c++) {
+            while (next[c] < end[c]) {
+                SortKey x = a[next[c]];
+                int d = (int)((x.key >> shift) & 0xFF);
+                while (d != c) {
+                    SortKey t = a[next[d]];
+                    a[next[d]++] = x;
+                    x = t;
+                    d = (int)((x.key >> shift) & 0xFF);
+                }
+                a[next[c]++] = x;
+            }
+        }
+
+        size_t lo = 0;
+        for (int c = 0; c < 256; c++) {
+            size_t cnt = end[c] - lo;
+            if (cnt > 1) {
+                if (c == 0) {
+                    sort_ties(a + lo, cnt);
+                } else {
+                    msd_sort(ctx, a + lo, cnt, depth, b + 1);
+                }
+            }
+            lo = end[c];
+        }
+        return;
+    }
+}
+
+bool name_sort(const char *heap, const void *offs, size_t off_stride,
+               const void *ties, size_t tie_stride, uint32_t *items, size_t n) {
+    if (n < 2) {
+        return true;
+    }
+    SortKey *keys = malloc(sizeof(SortKey) * n);
+    if (keys == NULL) {
+        return false;
+    }
+    SortCtx ctx = { heap, offs, off_stride };
+    const unsigned char *tie_base = ties;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t item = items[i];
+        keys[i].item = item;
+        keys[i].tie = 0;
+        if (tie_base != NULL) {
+            memcpy(&keys[i].tie, tie_base + (size_t)item * tie_stride, sizeof(int32_t));
+        }
+        keys[i].key = chunk_key(item_name(&ctx, item));
+    }
+    msd_sort(&ctx, keys, n, 0, 0);
+    for (size_t i = 0; i < n; i++) {
+        items[i] = keys[i].item;
+    }
+    free(keys);
+    return true;
+}
@@ -0,0 +1,25 @@
+/*
+ * namesort.h - MiniDB 姓名排序头文件
+ * 按姓名字节序（UTF-8 下即 Unicode 码点序，与 strcmp 一致）排序下标数组：
+ * - 每项预先取姓名的 8 字节前缀组成大端 64 位键，与下标、次序键放在一起连续存放
+ * - 按键逐字节做 MSD 基数排序（原地，American flag），小区间改用插入排序
+ * - 前 8 字节相同且都未结束的一组取下一个 8 字节重新组键继续排序（多键），
+ *   只在小区间内前缀相同时才比较完整姓名；姓名完全相同时按次序键
+ */
+
+#ifndef NAMESORT_H
+#define NAMESORT_H
+
+#include "config.h"
+#include <stddef.h>
+
+/*
+ * name_sort - 排序 items[0, n)
+ * 第 i 项的姓名为 heap + *(uint32_t *)(offs + items[i] * off_stride)，
+ * 姓名相同时按 *(int32_t *)(ties + items[i] * tie_stride) 升序（ties 为 NULL 时省略），最后按下标
+ * 返回值：false 表示内存不足（items 保持原样）
+ */
+bool name_sort(const char *heap, const void *offs, size_t off_stride,
+               const void *ties, size_t tie_stride, uint32_t *items, size_t n);
+
+#endif /* NAMESORT_H */
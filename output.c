@@ -0,0 +1,250 @@
+/*
+ * output.c - MiniDB 缓冲输出实现
+ * 记录先格式化到 OutBuf，缓冲区满或调用 out_flush 时用一次 fwrite 写出
+ */
+
+#include "output.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>  // isatty
+
+/* 当前记录输出模式 */
+static OutputMode g_mode = OUTPUT_PRETTY;
+
+/* 两位十进制数字表："00" "01" ... "99"，整数格式化时每次处理两位 */
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+void out_set_mode(OutputMode mode) {
+    g_mode = mode;
+}
+
+OutputMode out_get_mode(void) {
+    return g_mode;
+}
+
+/*
+ * out_auto_mode - 根据 stdout 类型选择输出模式
+ * 输出被重定向到文件或管道时使用紧凑模式
+ */
+void out_auto_mode(void) {
+    if (!isatty(fileno(stdout))) {
+        g_mode = OUTPUT_COMPACT;
+    }
+}
+
+void out_init(OutBuf *ob, FILE *fp) {
+    ob->fp = fp;
+    ob->len = 0;
+}
+
+void out_flush(OutBuf *ob) {
+    if (ob->len > 0) {
+        if (fwrite(ob->data, 1, ob->len, ob->fp) != ob->len) {
+            fprintf(stderr, "错误：写出输出缓冲区失败！\n");
+        }
+        ob->len = 0;
+    }
+}
+
+void out_write(OutBuf *ob, const char *s, size_t n) {
+    if (ob->len + n > sizeof(ob->data)) {
+        out_flush(ob);
+        /* 超过整个缓冲区的大块数据直接写出 */
+        if (n > sizeof(ob->data)) {
+            fwrite(s, 1, n, ob->fp);
+            return;
+        }
+    }
+    memcpy(ob->data + ob->len, s, n);
+    ob->len += n;
+}
+
+void out_puts(OutBuf *ob, const char *s) {
+    out_write(ob, s, strlen(s));
+}
+
+void out_char(OutBuf *ob, char c) {
+    if (ob->len == sizeof(ob->data)) {
+        out_flush(ob);
+    }
+    ob->data[ob->len++] = c;
+}
+
+/*
+ * format_uint - 将无符号整数格式化到 end 之前，返回起始位置
+ * 从低位向高位每次写两位数字
+ */
+static char *format_uint(char *end, unsigned long long v) {
+    char *p = end;
+    while (v >= 100) {
+        unsigned idx = (unsigned)(v % 100) * 2;
+        v /= 100;
+        *--p = digit_pairs[idx + 1];
+        *--p = digit_pairs[idx];
+    }
+    if (v >= 10) {
+        unsigned idx = (unsigned)v * 2;
+        *--p = digit_pairs[idx + 1];
+        *--p = digit_pairs[idx];
+    } else {
+        *--p = (char)('0' + v);
+    }
+    return p;
+}
+
+void out_int(OutBuf *ob, int value) {
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    /* 先转为无符号再取负，避免 INT_MIN 溢出 */
+    unsigned long long mag = value < 0 ? 0ULL - (unsigned long long)(long long)value
+                                       : (unsigned long long)value;
+    char *p = format_uint(end, mag);
+    if (value < 0) {
+        *--p = '-';
+    }
+    out_write(ob, p, (size_t)(end - p));
+}
+
+/*
+ * out_fixed2 - 输出两位小数，结果与 printf("%.2f") 相同
+ * 常规值用整数运算完成；非有限值、超大值以及恰好落在舍入中点的值
+ * 交给 snprintf，保证舍入规则一致
+ */
+void out_fixed2(OutBuf *ob, double value) {
+    double scaled = value * 100.0;
+    bool neg = value < 0.0 || (value == 0.0 && 1.0 / value < 0.0);
+    double mag = neg ? -scaled : scaled;
+
+    if (!(mag < 9.0e15)) {  /* 同时排除 NaN */
+        char tmp[400];
+        int n = snprintf(tmp, sizeof(tmp), "%.2f", value);
+        out_write(ob, tmp, (size_t)n);
+        return;
+    }
+
+    unsigned long long cents = (unsigned long long)mag;
+    double frac = mag - (double)cents;  /* mag < 2^53，减法是精确的 */
+    if (frac == 0.5) {
+        char tmp[64];
+        int n = snprintf(tmp, sizeof(tmp), "%.2f", value);
+        out_write(ob, tmp, (size_t)n);
+        return;
+    }
+    if (frac > 0.5) {
+        cents++;
+    }
+
+    char buf[32];
+    char *end = buf + sizeof(buf);
+    unsigned idx = (unsigned)(cents % 100) * 2;
+    char *p = end;
+    *--p = digit_pairs[idx + 1];
+    *--p = digit_pairs[idx];
+    *--p = '.';
+    p = format_uint(p, cents / 100);
+    if (neg) {
+        *--p = '-';
+    }
+    out_write(ob, p, (size_t)(end - p));
+}
+
+/* 紧凑格式：id<TAB>name<TAB>age<TAB>score<TAB>flags */
+static void out_record_compact(OutBuf *ob, const Record *record, const char *name, size_t name_len) {
+    out_int(ob, record->id);
+    out_char(ob, '\t');
+    out_write(ob, name, name_len);
+    out_char(ob, '\t');
+    out_int(ob, record->age);
+    out_char(ob, '\t');
+    out_fixed2(ob, record->score);
+    out_char(ob, '\t');
+    out_int(ob, record->flags);
+    out_char(ob, '\n');
+}
+
+/* 状态标志的中文描述，多个标志用 ", " 分隔 */
+void out_flag_names(OutBuf *ob, uint8_t flags) {
+    if (flags == 0) {
+        out_puts(ob, "正常");
+        return;
+    }
+    int first = 1;
+    if (flags & FLAG_READONLY) {
+        out_puts(ob, "只读");
+        first = 0;
+    }
+    if (flags & FLAG_ARCHIVED) {
+        if (!first) out_puts(ob, ", ");
+        out_puts(ob, "已归档");
+        first = 0;
+    }
+    if (flags & FLAG_VIP) {
+        if (!first) out_puts(ob, ", ");
+        out_puts(ob, "VIP");
+        first = 0;
+    }
+    if (flags & FLAG_DELETED) {
+        if (!first) out_puts(ob, ", ");
+        out_puts(ob, "软删除");
+    }
+}
+
+/* 多行格式：ID、姓名、年龄、成绩 */
+static void out_record_pretty(OutBuf *ob, const Record *record, const char *name, size_t name_len) {
+    out_puts(ob, "-----------------\n学生 ID：");
+    out_int(ob, record->id);
+    out_puts(ob, "\n姓名：");
+    out_write(ob, name, name_len);
+    out_puts(ob, "\n年龄：");
+    out_int(ob, record->age);
+    out_puts(ob, " 岁\n成绩：");
+    out_fixed2(ob, record->score);
+    out_puts(ob, " 分\n");
+}
+
+void out_record(OutBuf *ob, const Database *db, const Record *record) {
+    if (g_mode == OUTPUT_COMPACT) {
+        out_record_compact(ob, record, db_name(db, record), db_name_len(db, record));
+        return;
+    }
+    out_record_pretty(ob, record, db_name(db, record), db_name_len(db, record));
+}
+
+void out_record_verbose(OutBuf *ob, const Database *db, const Record *record) {
+    out_record_named(ob, record, db_name(db, record), db_name_len(db, record));
+}
+
+void out_record_named(OutBuf *ob, const Record *record, const char *name, size_t name_len) {
+    if (g_mode == OUTPUT_COMPACT) {
+        out_record_compact(ob, record, name, name_len);
+        return;
+    }
+    out_record_pretty(ob, record, name, name_len);
+    out_puts(ob, "状态：");
+    out_flag_names(ob, record->flags);
+    out_char(ob, '\n');
+}
+
+void out_record_flags(OutBuf *ob, const Database *db, const Record *record) {
+    if (g_mode == OUTPUT_COMPACT) {
+        out_record_compact(ob, record, db_name(db, record), db_name_len(db, record));
+        return;
+    }
+    out_puts(ob, "ID: ");
+    out_int(ob, record->id);
+    out_puts(ob, ", 姓名：");
+    out_write(ob, db_name(db, record), db_name_len(db, record));
+    out_puts(ob, ", 状态：");
+    out_flag_names(ob, record->flags);
+    out_char(ob, '\n');
+}
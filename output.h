@@ -0,0 +1,58 @@
+/*
+ * output.h - MiniDB 缓冲输出头文件
+ * 将记录渲染到大块输出缓冲区，缓冲区满时一次性写出，
+ * 替代逐字段 printf，加快大量记录输出到文件或管道的速度
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "db.h"
+
+/*
+ * 输出模式枚举
+ * PRETTY 为交互式多行格式；COMPACT 为每条记录一行，供脚本等非交互程序读取
+ */
+typedef enum OutputMode {
+    OUTPUT_PRETTY = 1,  // 多行格式（默认）
+    OUTPUT_COMPACT      // 紧凑格式：id<TAB>name<TAB>age<TAB>score<TAB>flags
+} OutputMode;
+
+/*
+ * 输出缓冲区
+ * 可直接在栈上声明，使用前调用 out_init，结束时调用 out_flush
+ */
+typedef struct OutBuf {
+    FILE *fp;                   // 目标文件（通常为 stdout）
+    size_t len;                 // 缓冲区中已有的字节数
+    char data[OUT_BUF_SIZE];    // 缓冲区
+} OutBuf;
+
+/*
+ * 输出模式设置
+ */
+void out_set_mode(OutputMode mode);  // 设置记录输出模式
+OutputMode out_get_mode(void);       // 获取当前记录输出模式
+void out_auto_mode(void);            // stdout 不是终端时自动切换为紧凑模式
+
+/*
+ * 缓冲区基本操作
+ */
+void out_init(OutBuf *ob, FILE *fp);                     // 初始化缓冲区
+void out_flush(OutBuf *ob);                              // 写出缓冲区内容
+void out_write(OutBuf *ob, const char *s, size_t n);     // 追加 n 个字节
+void out_puts(OutBuf *ob, const char *s);                // 追加字符串
+void out_char(OutBuf *ob, char c);                       // 追加单个字符
+void out_int(OutBuf *ob, int value);                     // 追加十进制整数
+void out_fixed2(OutBuf *ob, double value);               // 追加两位小数（等价于 %.2f）
+void out_flag_names(OutBuf *ob, uint8_t flags);          // 追加状态标志的中文描述
+
+/*
+ * 记录渲染（按当前输出模式）
+ */
+void out_record(OutBuf *ob, const Database *db, const Record *record);          // 对应 print_record
+void out_record_verbose(OutBuf *ob, const Database *db, const Record *record);  // 对应 print_record_verbose
+void out_record_flags(OutBuf *ob, const Database *db, const Record *record);    // 对应 db_show_flags 的单行
+void out_record_named(OutBuf *ob, const Record *record, const char *name, size_t name_len);  // 同 out_record_verbose，姓名由调用者给出（页式存储）
+
+#endif /* OUTPUT_H */
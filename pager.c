@@ -0,0 +1,771 @@
+/*
+ * pager.c - MiniDB 页式存储实现
+ * 文件布局：第 0 页为文件头，第 1..N 页为数据页，关闭时在数据页之后写入页首 ID 表
+ * （打开时直接读入，不必扫描全部数据页；追加新页前先把文件头中的表位置清零）。
+ * 数据页布局：
+ *   [0, 2)  槽数   [2, 4)  空闲区起点   [4, ...) 记录（与快照第 2 版相同的编码）
+ *   页尾向前为槽数组，第 i 个槽保存第 i 条记录的页内偏移；记录按 ID 递增
+ * 点查：页首 ID 表上二分找到页，再在槽数组上二分，只访问一个数据页
+ * 数据页从文件读入缓冲池时校验槽数、空闲区起点、各槽偏移和姓名长度，损坏的页不解码
+ */
+
+#include "pager.h"
+#include "output.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PAGER_MAGIC       "MDBP"
+#define PAGER_VERSION     1
+#define PAGE_NSLOTS       0     // 页内偏移：槽数
+#define PAGE_FREE         2     // 页内偏移：空闲区起点
+#define PAGE_HEADER       4     // 页头大小
+#define PAGE_REC_FIXED    15    // id(4) + score(8) + age(1) + flags(1) + name_len(1)
+
+/* 页头与槽都是 16 位偏移 */
+typedef char pager_page_size_check[PAGER_PAGE_SIZE <= 65536 ? 1 : -1];
+
+/*
+ * ==================== 页与文件 I/O ====================
+ */
+
+static uint16_t page_u16(const unsigned char *page, size_t off) {
+    uint16_t v;
+    memcpy(&v, page + off, sizeof(v));
+    return v;
+}
+
+static void page_set_u16(unsigned char *page, size_t off, uint16_t v) {
+    memcpy(page + off, &v, sizeof(v));
+}
+
+/* 第 i 条记录的页内偏移 */
+static uint16_t page_slot(const unsigned char *page, uint32_t i) {
+    return page_u16(page, PAGER_PAGE_SIZE - 2 * (i + 1));
+}
+
+static int32_t page_id(const unsigned char *page, uint32_t i) {
+    int32_t id;
+    memcpy(&id, page + page_slot(page, i), sizeof(id));
+    return id;
+}
+
+/* 页内剩余空间（字节） */
+static size_t page_free_space(const unsigned char *page) {
+    return PAGER_PAGE_SIZE - 2 * (size_t)page_u16(page, PAGE_NSLOTS) - page_u16(page, PAGE_FREE);
+}
+
+/* 解码一条记录，name 以 '\0' 结尾 */
+static void page_decode(const unsigned char *rec, Record *out, char *name) {
+    memset(out, 0, sizeof(*out));
+    memcpy(&out->id, rec, 4);
+    memcpy(&out->score, rec + 4, 8);
+    out->age = rec[12];
+    out->flags = rec[13];
+    memcpy(name, rec + PAGE_REC_FIXED, rec[14]);
+    name[rec[14]] = '\0';
+}
+
+/*
+ * page_valid - 检查从文件读入的数据页：槽数组与空闲区起点不重叠，
+ * 每个槽指向页头与空闲区起点之间的一条完整记录，且姓名长度小于 MAX_NAME_LEN
+ * 之后的解码与二分查找直接使用这些偏移，不再逐次检查
+ */
+static bool page_valid(const unsigned char *page) {
+    size_t nslots = page_u16(page, PAGE_NSLOTS);
+    size_t free_off = page_u16(page, PAGE_FREE);
+    if (free_off < PAGE_HEADER || free_off > PAGER_PAGE_SIZE ||
+        2 * nslots > PAGER_PAGE_SIZE - free_off) {
+        return false;
+    }
+    for (uint32_t i = 0; i < nslots; i++) {
+        size_t off = page_slot(page, i);
+        if (off < PAGE_HEADER || off > free_off || free_off - off < PAGE_REC_FIXED ||
+            page[off + 14] >= MAX_NAME_LEN || free_off - off - PAGE_REC_FIXED < page[off + 14]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int pager_read_page(Pager *p, uint32_t page_no, unsigned char *buf) {
+    if (file_seek(p->fp, (uint64_t)page_no * PAGER_PAGE_SIZE) != 0 ||
+        fread(buf, PAGER_PAGE_SIZE, 1, p->fp) != 1) {
+        fprintf(stderr, "错误：读取第 %u 页失败！文件可能已损坏。\n", page_no);
+        return -1;
+    }
+    p->stats.reads++;
+    if (page_no != 0 && !page_valid(buf)) {
+        fprintf(stderr, "错误：第 %u 页的内容无效！文件可能已损坏。\n", page_no);
+        return -1;
+    }
+    return 0;
+}
+
+static int pager_write_page(Pager *p, uint32_t page_no, const unsigned char *buf) {
+    if (file_seek(p->fp, (uint64_t)page_no * PAGER_PAGE_SIZE) != 0 ||
+        fwrite(buf, PAGER_PAGE_SIZE, 1, p->fp) != 1) {
+        fprintf(stderr, "错误：写入第 %u 页失败！\n", page_no);
+        return -1;
+    }
+    p->stats.writes++;
+    return 0;
+}
+
+/* 写文件头；fence_page 为页首 ID 表的起始页，0 表示文件中没有有效的表 */
+static int pager_write_header(Pager *p, uint32_t fence_page) {
+    unsigned char page[PAGER_PAGE_SIZE];
+    uint32_t fields[8] = {
+        PAGER_VERSION, PAGER_PAGE_SIZE, p->page_count, p->record_count, p->dead,
+        (uint32_t)p->next_id, (uint32_t)p->last_id, fence_page
+    };
+    memset(page, 0, sizeof(page));
+    memcpy(page, PAGER_MAGIC, 4);
+    memcpy(page + 4, fields, sizeof(fields));
+    return pager_write_page(p, 0, page);
+}
+
+/*
+ * ==================== 缓冲池 ====================
+ */
+
+static unsigned char *frame_data(const Pager *p, int32_t f) {
+    return p->pool + (size_t)f * PAGER_PAGE_SIZE;
+}
+
+static uint32_t pool_hash(const Pager *p, uint32_t page_no) {
+    return (page_no * 2654435761u) & p->table_mask;
+}
+
+static int32_t pool_find(const Pager *p, uint32_t page_no) {
+    for (uint32_t i = pool_hash(p, page_no);; i = (i + 1) & p->table_mask) {
+        int32_t f = p->table[i];
+        if (f < 0 || p->frames[f].page_no == page_no) {
+            return f;
+        }
+    }
+}
+
+static void pool_insert(Pager *p, uint32_t page_no, int32_t f) {
+    uint32_t i = pool_hash(p, page_no);
+    while (p->table[i] >= 0) {
+        i = (i + 1) & p->table_mask;
+    }
+    p->table[i] = f;
+}
+
+/* 删除页号对应的表项，并把后续探测链上的项前移（不留删除标记） */
+static void pool_erase(Pager *p, uint32_t page_no) {
+    uint32_t i = pool_hash(p, page_no);
+    while (p->table[i] >= 0 && p->frames[p->table[i]].page_no != page_no) {
+        i = (i + 1) & p->table_mask;
+    }
+    if (p->table[i] < 0) {
+        return;
+    }
+    uint32_t j = i;
+    for (;;) {
+        j = (j + 1) & p->table_mask;
+        if (p->table[j] < 0) {
+            break;
+        }
+        uint32_t home = pool_hash(p, p->frames[p->table[j]].page_no);
+        /* home 不在 (i, j] 之间时，j 上的项可以移到 i */
+        if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+            p->table[i] = p->table[j];
+            i = j;
+        }
+    }
+    p->table[i] = -1;
+}
+
+/* 换出一帧：脏页先写回 */
+static int pool_evict(Pager *p, int32_t f) {
+    PageFrame *fr = &p->frames[f];
+    if (fr->page_no == 0) {
+        return 0;
+    }
+    if (fr->dirty && pager_write_page(p, fr->page_no, frame_data(p, f)) != 0) {
+        return -1;
+    }
+    pool_erase(p, fr->page_no);
+    fr->page_no = 0;
+    fr->dirty = 0;
+    fr->ref = 0;
+    fr->scan = 0;
+    p->stats.evictions++;
+    return 0;
+}
+
+/* CLOCK：跳过被固定的帧，引用位为 1 的帧清零后给第二次机会 */
+static int32_t pool_victim(Pager *p) {
+    if (p->used < p->nframes) {
+        return (int32_t)p->used++;
+    }
+    for (uint32_t step = 0; step < 2 * p->nframes; step++) {
+        int32_t f = (int32_t)p->hand;
+        PageFrame *fr = &p->frames[f];
+        if (++p->hand == p->nframes) {
+            p->hand = 0;
+        }
+        if (fr->pins > 0) {
+            continue;
+        }
+        if (fr->ref) {
+            fr->ref = 0;
+            continue;
+        }
+        return pool_evict(p, f) == 0 ? f : -1;
+    }
+    printf("错误：缓冲池中的页全部被固定！\n");
+    return -1;
+}
+
+/*
+ * pool_fetch - 把页装入缓冲池并固定，返回帧号（失败返回 -1）
+ * sequential 为真时是全表扫描：命中不设引用位，未命中优先复用扫描环中的帧
+ */
+static int32_t pool_fetch(Pager *p, uint32_t page_no, bool sequential) {
+    int32_t f = pool_find(p, page_no);
+    if (f >= 0) {
+        PageFrame *fr = &p->frames[f];
+        p->stats.hits++;
+        if (!sequential) {
+            fr->ref = 1;
+            fr->scan = 0;
+        }
+        fr->pins++;
+        return f;
+    }
+
+    p->stats.misses++;
+    if (sequential) {
+        int32_t r = p->ring[p->ring_pos];
+        if (r >= 0 && p->frames[r].scan && p->frames[r].pins == 0) {
+            if (pool_evict(p, r) != 0) {
+                return -1;
+            }
+            f = r;
+        }
+    }
+    if (f < 0 && (f = pool_victim(p)) < 0) {
+        return -1;
+    }
+    if (pager_read_page(p, page_no, frame_data(p, f)) != 0) {
+        return -1;
+    }
+    PageFrame *fr = &p->frames[f];
+    fr->page_no = page_no;
+    fr->pins = 1;
+    fr->ref = sequential ? 0 : 1;
+    fr->scan = sequential ? 1 : 0;
+    fr->dirty = 0;
+    pool_insert(p, page_no, f);
+    if (sequential) {
+        p->ring[p->ring_pos] = f;
+        p->ring_pos = (p->ring_pos + 1) % PAGER_SCAN_RING;
+    }
+    return f;
+}
+
+static void pool_unpin(Pager *p, int32_t f, bool dirty) {
+    p->frames[f].pins--;
+    if (dirty) {
+        p->frames[f].dirty = 1;
+    }
+}
+
+/* 在文件末尾分配一个新数据页（只在缓冲池中初始化，换出或刷新时才写盘） */
+static int32_t pool_new_page(Pager *p) {
+    int32_t f = pool_victim(p);
+    if (f < 0) {
+        return -1;
+    }
+    unsigned char *page = frame_data(p, f);
+    memset(page, 0, PAGER_PAGE_SIZE);
+    page_set_u16(page, PAGE_FREE, PAGE_HEADER);
+    PageFrame *fr = &p->frames[f];
+    fr->page_no = ++p->page_count;
+    fr->pins = 1;
+    fr->ref = 1;
+    fr->scan = 0;
+    fr->dirty = 1;
+    pool_insert(p, fr->page_no, f);
+    return f;
+}
+
+/*
+ * ==================== 打开与关闭 ====================
+ */
+
+static Pager *pager_alloc(FILE *fp, size_t memory) {
+    Pager *p = calloc(1, sizeof(Pager));
+    if (p == NULL) {
+        return NULL;
+    }
+    p->fp = fp;
+    p->next_id = 1;
+    p->nframes = (uint32_t)(memory / PAGER_PAGE_SIZE);
+    if (p->nframes < PAGER_MIN_FRAMES) {
+        p->nframes = PAGER_MIN_FRAMES;
+    }
+    uint32_t table_size = 1;
+    while (table_size < 2 * p->nframes) {
+        table_size <<= 1;
+    }
+    p->table_mask = table_size - 1;
+    p->pool = malloc((size_t)p->nframes * PAGER_PAGE_SIZE);
+    p->frames = calloc(p->nframes, sizeof(PageFrame));
+    p->table = malloc(sizeof(int32_t) * table_size);
+    if (p->pool == NULL || p->frames == NULL || p->table == NULL) {
+        free(p->pool);
+        free(p->frames);
+        free(p->table);
+        free(p);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < table_size; i++) {
+        p->table[i] = -1;
+    }
+    for (int i = 0; i < PAGER_SCAN_RING; i++) {
+        p->ring[i] = -1;
+    }
+    return p;
+}
+
+static void pager_free(Pager *p) {
+    fclose(p->fp);
+    free(p->pool);
+    free(p->frames);
+    free(p->table);
+    free(p->fence);
+    free(p);
+}
+
+/* 保证页首 ID 表能再容纳一页 */
+static bool fence_reserve(Pager *p, uint32_t pages) {
+    if (pages <= p->fence_cap) {
+        return true;
+    }
+    uint32_t cap = p->fence_cap > 0 ? p->fence_cap : 64;
+    while (cap < pages) {
+        cap *= 2;
+    }
+    int32_t *fence = realloc(p->fence, sizeof(int32_t) * cap);
+    if (fence == NULL) {
+        return false;
+    }
+    p->fence = fence;
+    p->fence_cap = cap;
+    return true;
+}
+
+/*
+ * pager_open - 打开页式文件
+ * 文件头记录了页首 ID 表的位置时直接读入，否则顺序扫描各页的第一条记录重建
+ */
+Pager *pager_open(const char *path, size_t memory) {
+    FILE *fp = fopen(path, "r+b");
+    if (fp == NULL) {
+        fprintf(stderr, "错误：无法打开文件 '%s'！\n", path);
+        perror("fopen");
+        return NULL;
+    }
+    setvbuf(fp, NULL, _IONBF, 0);  /* 缓冲池就是缓存，不再经过 stdio 缓冲 */
+    Pager *p = pager_alloc(fp, memory);
+    if (p == NULL) {
+        printf("内存分配失败！\n");
+        fclose(fp);
+        return NULL;
+    }
+
+    unsigned char *page = frame_data(p, 0);
+    uint32_t fields[8];
+    if (pager_read_page(p, 0, page) != 0) {
+        pager_free(p);
+        return NULL;
+    }
+    memcpy(fields, page + 4, sizeof(fields));
+    if (memcmp(page, PAGER_MAGIC, 4) != 0 || fields[0] != PAGER_VERSION || fields[1] != PAGER_PAGE_SIZE) {
+        fprintf(stderr, "错误：'%s' 不是页式存储文件，或页大小不符！\n", path);
+        pager_free(p);
+        return NULL;
+    }
+    p->page_count = fields[2];
+    p->record_count = fields[3];
+    p->dead = fields[4];
+    p->next_id = (int32_t)fields[5];
+    p->last_id = (int32_t)fields[6];
+    uint32_t fence_page = fields[7];
+
+    if (!fence_reserve(p, p->page_count)) {
+        printf("内存分配失败！\n");
+        pager_free(p);
+        return NULL;
+    }
+    if (p->page_count > 0 && fence_page == p->page_count + 1) {
+        if (file_seek(fp, (uint64_t)fence_page * PAGER_PAGE_SIZE) != 0 ||
+            fread(p->fence, sizeof(int32_t), p->page_count, fp) != p->page_count) {
+            fprintf(stderr, "错误：读取页首 ID 表失败！文件可能已损坏。\n");
+            pager_free(p);
+            return NULL;
+        }
+        p->stats.reads += ((uint64_t)p->page_count * sizeof(int32_t) + PAGER_PAGE_SIZE - 1) / PAGER_PAGE_SIZE;
+        p->fence_on_disk = true;
+    } else {
+        for (uint32_t i = 0; i < p->page_count; i++) {
+            int32_t f = pool_fetch(p, i + 1, true);
+            if (f < 0) {
+                pager_free(p);
+                return NULL;
+            }
+            p->fence[i] = page_id(frame_data(p, f), 0);
+            pool_unpin(p, f, false);
+        }
+    }
+    return p;
+}
+
+/*
+ * pager_flush - 写回全部脏页，再写页首 ID 表和文件头
+ */
+int pager_flush(Pager *p) {
+    for (uint32_t f = 0; f < p->used; f++) {
+        PageFrame *fr = &p->frames[f];
+        if (fr->page_no != 0 && fr->dirty) {
+            if (pager_write_page(p, fr->page_no, frame_data(p, (int32_t)f)) != 0) {
+                return -1;
+            }
+            fr->dirty = 0;
+        }
+    }
+    if (!p->header_dirty && p->fence_on_disk) {
+        return fflush(p->fp) == 0 ? 0 : -1;
+    }
+
+    uint32_t fence_page = p->page_count + 1;
+    if (p->page_count > 0) {
+        size_t bytes = sizeof(int32_t) * p->page_count;
+        if (file_seek(p->fp, (uint64_t)fence_page * PAGER_PAGE_SIZE) != 0 ||
+            fwrite(p->fence, sizeof(int32_t), p->page_count, p->fp) != p->page_count) {
+            fprintf(stderr, "错误：写入页首 ID 表失败！\n");
+            return -1;
+        }
+        p->stats.writes += (bytes + PAGER_PAGE_SIZE - 1) / PAGER_PAGE_SIZE;
+    }
+    if (pager_write_header(p, p->page_count > 0 ? fence_page : 0) != 0 || fflush(p->fp) != 0) {
+        return -1;
+    }
+    p->fence_on_disk = p->page_count > 0;
+    p->header_dirty = false;
+    return 0;
+}
+
+void pager_close(Pager *p) {
+    if (p == NULL) {
+        return;
+    }
+    if (pager_flush(p) != 0) {
+        fprintf(stderr, "警告：页式文件刷新失败，最近的修改可能丢失！\n");
+    }
+    pager_free(p);
+}
+
+/*
+ * ==================== 记录操作 ====================
+ */
+
+/*
+ * pager_find - 定位 ID 所在的页并固定
+ * 返回帧号，*slot 为页内槽号；未找到返回 -1（页已释放固定）
+ */
+static int32_t pager_find(Pager *p, int id, uint32_t *slot) {
+    if (id <= 0 || p->page_count == 0 || id > p->last_id || id < p->fence[0]) {
+        return -1;
+    }
+    /* 第一个页首 ID 大于 id 的页之前的那一页 */
+    uint32_t lo = 0, hi = p->page_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (p->fence[mid] <= id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    int32_t f = pool_fetch(p, lo, false);
+    if (f < 0) {
+        return -1;
+    }
+    const unsigned char *page = frame_data(p, f);
+    uint32_t l = 0, h = page_u16(page, PAGE_NSLOTS);
+    while (l < h) {
+        uint32_t mid = l + (h - l) / 2;
+        int32_t mid_id = page_id(page, mid);
+        if (mid_id == id) {
+            *slot = mid;
+            return f;
+        }
+        if (mid_id < id) {
+            l = mid + 1;
+        } else {
+            h = mid;
+        }
+    }
+    pool_unpin(p, f, false);
+    return -1;
+}
+
+bool pager_get(Pager *p, int id, Record *out, char *name) {
+    uint32_t slot;
+    int32_t f = pager_find(p, id, &slot);
+    if (f < 0) {
+        return false;
+    }
+    const unsigned char *page = frame_data(p, f);
+    page_decode(page + page_slot(page, slot), out, name);
+    pool_unpin(p, f, false);
+    return true;
+}
+
+/* 已删除的记录只能切换软删除标志（即恢复），与 db_toggle_flag 一致 */
+bool pager_toggle_flag(Pager *p, int id, uint8_t flag) {
+    uint32_t slot;
+    int32_t f = pager_find(p, id, &slot);
+    if (f < 0) {
+        return false;
+    }
+    unsigned char *page = frame_data(p, f);
+    unsigned char *flags = page + page_slot(page, slot) + 13;
+    if ((*flags & FLAG_DELETED) && flag != FLAG_DELETED) {
+        pool_unpin(p, f, false);
+        return false;
+    }
+    *flags ^= flag;
+    if (flag & FLAG_DELETED) {
+        if (*flags & FLAG_DELETED) {
+            p->dead++;
+        } else {
+            p->dead--;
+        }
+        p->header_dirty = true;
+    }
+    pool_unpin(p, f, true);
+    return true;
+}
+
+bool pager_set_score(Pager *p, int id, double score) {
+    uint32_t slot;
+    int32_t f = pager_find(p, id, &slot);
+    if (f < 0) {
+        return false;
+    }
+    unsigned char *rec = frame_data(p, f) + page_slot(frame_data(p, f), slot);
+    if (rec[13] & FLAG_DELETED) {
+        pool_unpin(p, f, false);
+        return false;
+    }
+    memcpy(rec + 4, &score, sizeof(score));
+    pool_unpin(p, f, true);
+    return true;
+}
+
+/*
+ * pager_append - 追加到最后一页，放不下时分配新页
+ * 记录按 ID 递增存放，所以 ID 必须大于已有的最大 ID
+ */
+int pager_append(Pager *p, const Record *rec, const char *name) {
+    size_t name_len = strlen(name);
+    int32_t id = rec->id > 0 ? rec->id : p->next_id;
+    if (name_len >= MAX_NAME_LEN) {
+        printf("错误：姓名过长！\n");
+        return -1;
+    }
+    if (id <= p->last_id) {
+        printf("错误：追加记录的 ID 必须大于 %d！\n", p->last_id);
+        return -1;
+    }
+    size_t len = PAGE_REC_FIXED + name_len;
+
+    int32_t f = -1;
+    if (p->page_count > 0) {
+        f = pool_fetch(p, p->page_count, false);
+        if (f < 0) {
+            return -1;
+        }
+        if (page_free_space(frame_data(p, f)) < len + 2) {
+            pool_unpin(p, f, false);
+            f = -1;
+        }
+    }
+    if (f < 0) {
+        /* 新页会覆盖文件中的页首 ID 表，先让文件头中的表失效 */
+        if (p->fence_on_disk) {
+            if (pager_write_header(p, 0) != 0) {
+                return -1;
+            }
+            p->fence_on_disk = false;
+        }
+        if (!fence_reserve(p, p->page_count + 1)) {
+            printf("内存分配失败！\n");
+            return -1;
+        }
+        if ((f = pool_new_page(p)) < 0) {
+            return -1;
+        }
+        p->fence[p->page_count - 1] = id;
+    }
+
+    unsigned char *page = frame_data(p, f);
+    uint16_t nslots = page_u16(page, PAGE_NSLOTS);
+    uint16_t off = page_u16(page, PAGE_FREE);
+    unsigned char *dst = page + off;
+    memcpy(dst, &id, 4);
+    memcpy(dst + 4, &rec->score, 8);
+    dst[12] = rec->age;
+    dst[13] = rec->flags;
+    dst[14] = (unsigned char)name_len;
+    memcpy(dst + PAGE_REC_FIXED, name, name_len);
+    page_set_u16(page, PAGER_PAGE_SIZE - 2 * ((size_t)nslots + 1), off);
+    page_set_u16(page, PAGE_NSLOTS, (uint16_t)(nslots + 1));
+    page_set_u16(page, PAGE_FREE, (uint16_t)(off + len));
+    pool_unpin(p, f, true);
+
+    p->record_count++;
+    if (rec->flags & FLAG_DELETED) {
+        p->dead++;
+    }
+    p->last_id = id;
+    if (id >= p->next_id) {
+        p->next_id = id + 1;
+    }
+    p->header_dirty = true;
+    return id;
+}
+
+/* 比较函数：按 ID 排序的（ID << 32 | 行下标）键 */
+static int compare_key(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * pager_build - 把数据库中的有效记录按 ID 顺序写成页式文件（覆盖已有文件）
+ */
+int pager_build(const Database *db, const char *path) {
+    uint64_t *keys = malloc(sizeof(uint64_t) * (db->count > 0 ? db->count : 1));
+    if (keys == NULL) {
+        printf("内存分配失败！\n");
+        return -1;
+    }
+    size_t n = 0;
+    for (int i = 0; i < db->count; i++) {
+        if (!db_is_dead(&db->rows[i])) {
+            keys[n++] = (uint64_t)(uint32_t)db->rows[i].id << 32 | (uint32_t)i;
+        }
+    }
+    qsort(keys, n, sizeof(uint64_t), compare_key);
+
+    FILE *fp = fopen(path, "w+b");
+    if (fp == NULL) {
+        fprintf(stderr, "错误：无法打开文件 '%s' 进行写入！\n", path);
+        perror("fopen");
+        free(keys);
+        return -1;
+    }
+    setvbuf(fp, NULL, _IONBF, 0);
+    Pager *p = pager_alloc(fp, PAGER_DEFAULT_MEMORY);
+    if (p == NULL) {
+        printf("内存分配失败！\n");
+        fclose(fp);
+        free(keys);
+        return -1;
+    }
+    p->next_id = db->next_id;
+    int ret = pager_write_header(p, 0);
+    for (size_t i = 0; i < n && ret == 0; i++) {
+        const Record *r = &db->rows[(uint32_t)keys[i]];
+        if (pager_append(p, r, db_name(db, r)) < 0) {
+            ret = -1;
+        }
+    }
+    free(keys);
+    if (ret == 0) {
+        ret = pager_flush(p);
+    }
+    if (ret == 0) {
+        printf("成功写入 %zu 条记录到 '%s'（%u 页）\n", n, path, p->page_count);
+    }
+    pager_free(p);
+    return ret;
+}
+
+/*
+ * pager_print_query - 输出满足条件的记录
+ * 指定 ID 时走页首 ID 表点查，否则按页号顺序扫描（使用扫描环，不污染缓冲池）
+ */
+uint64_t pager_print_query(Pager *p, const Query *q) {
+    clock_t start = clock();
+    uint64_t matched = 0;
+    uint32_t pages = 0;
+    Record rec;
+    char name[MAX_NAME_LEN];
+    OutBuf ob;
+    out_init(&ob, stdout);
+
+    if (q->id > 0) {
+        uint32_t slot;
+        int32_t f = pager_find(p, q->id, &slot);
+        if (f >= 0) {
+            const unsigned char *page = frame_data(p, f);
+            page_decode(page + page_slot(page, slot), &rec, name);
+            pool_unpin(p, f, false);
+            pages = 1;
+            if (query_match_record(q, &rec, name)) {
+                out_record_named(&ob, &rec, name, strlen(name));
+                matched++;
+            }
+        }
+    } else {
+        for (uint32_t page_no = 1; page_no <= p->page_count; page_no++) {
+            int32_t f = pool_fetch(p, page_no, true);
+            if (f < 0) {
+                break;
+            }
+            const unsigned char *page = frame_data(p, f);
+            uint32_t n = page_u16(page, PAGE_NSLOTS);
+            for (uint32_t i = 0; i < n; i++) {
+                page_decode(page + page_slot(page, i), &rec, name);
+                if (query_match_record(q, &rec, name)) {
+                    out_record_named(&ob, &rec, name, strlen(name));
+                    matched++;
+                }
+            }
+            pool_unpin(p, f, false);
+            pages++;
+        }
+    }
+    out_flush(&ob);
+    double ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+    printf("共 %llu 条记录（访问 %u 页），用时 %.3f 毫秒\n", (unsigned long long)matched, pages, ms);
+    return matched;
+}
+
+void pager_print_stats(const Pager *p) {
+    uint64_t lookups = p->stats.hits + p->stats.misses;
+    printf("\n========== 缓冲池统计 ==========\n");
+    printf("缓冲池：%u 帧 × %d 字节（%.1f MB），已用 %u 帧\n",
+           p->nframes, PAGER_PAGE_SIZE, (double)p->nframes * PAGER_PAGE_SIZE / 1048576.0, p->used);
+    printf("文件：%u 个数据页，%u 条记录（已删除 %u 条），页首 ID 表 %.1f KB\n",
+           p->page_count, p->record_count, p->dead, p->page_count * sizeof(int32_t) / 1024.0);
+    printf("命中 %llu 次，未命中 %llu 次，命中率 %.1f%%\n",
+           (unsigned long long)p->stats.hits, (unsigned long long)p->stats.misses,
+           lookups > 0 ? 100.0 * (double)p->stats.hits / (double)lookups : 0.0);
+    printf("读入 %llu 页，写出 %llu 页，换出 %llu 次\n",
+           (unsigned long long)p->stats.reads, (unsigned long long)p->stats.writes,
+           (unsigned long long)p->stats.evictions);
+    printf("================================\n");
+}
@@ -0,0 +1,82 @@
+/*
+ * pager.h - MiniDB 页式存储头文件
+ * 记录按 ID 递增存放在磁盘文件的定长页中，通过固定大小的缓冲池访问，
+ * 内存占用只取决于缓冲池大小（外加每页 4 字节的页首 ID 表），与表大小无关：
+ * - 页内为槽式布局：记录从页头向后追加，槽数组（记录偏移）从页尾向前增长
+ * - 缓冲池用 CLOCK 置换，脏页在换出或刷新时写回
+ * - 全表扫描只在一个小的环形帧集合中轮换，不会把点查的热页挤出缓冲池
+ */
+
+#ifndef PAGER_H
+#define PAGER_H
+
+#include "db.h"
+#include "query.h"
+
+#define PAGER_PAGE_SIZE       4096          // 页大小（字节）
+#define PAGER_DEFAULT_MEMORY  (4u << 20)    // 默认缓冲池大小：4 MB
+#define PAGER_MIN_FRAMES      16            // 缓冲池的最少帧数
+#define PAGER_SCAN_RING       8             // 全表扫描使用的环形帧数
+
+/*
+ * 缓冲池中的一帧
+ */
+typedef struct PageFrame {
+    uint32_t page_no;       // 所装的页号，0 表示空闲
+    uint16_t pins;          // 固定计数，大于 0 时不能换出
+    uint8_t ref;            // CLOCK 引用位
+    uint8_t dirty;          // 是否被修改过
+    uint8_t scan;           // 是否由全表扫描装入（尚未被点查访问过）
+} PageFrame;
+
+/*
+ * 缓冲池与页 I/O 统计
+ */
+typedef struct PagerStats {
+    uint64_t hits;          // 命中次数
+    uint64_t misses;        // 未命中次数
+    uint64_t reads;         // 读入的页数
+    uint64_t writes;        // 写出的页数（含文件头与页首 ID 表）
+    uint64_t evictions;     // 换出次数
+} PagerStats;
+
+/*
+ * 页式表
+ */
+typedef struct Pager {
+    FILE *fp;
+    uint32_t page_count;        // 数据页数（页号 1..page_count，第 0 页为文件头）
+    uint32_t record_count;      // 记录数（含已删除）
+    uint32_t dead;              // 已删除的记录数
+    int32_t next_id;            // 下一个可用的 ID
+    int32_t last_id;            // 最后一条记录的 ID（追加的 ID 必须更大）
+    int32_t *fence;             // fence[i] 为第 i + 1 页第一条记录的 ID
+    uint32_t fence_cap;
+    bool fence_on_disk;         // 文件中的页首 ID 表是否仍然有效
+    bool header_dirty;
+
+    unsigned char *pool;        // 帧数据：nframes × PAGER_PAGE_SIZE
+    PageFrame *frames;
+    uint32_t nframes;
+    uint32_t used;              // 已用过的帧数（之后才开始换出）
+    uint32_t hand;              // CLOCK 指针
+    int32_t *table;             // 页号 → 帧号（开放寻址哈希表），-1 表示空
+    uint32_t table_mask;
+    int32_t ring[PAGER_SCAN_RING];  // 全表扫描最近使用的帧
+    uint32_t ring_pos;
+
+    PagerStats stats;
+} Pager;
+
+Pager *pager_open(const char *path, size_t memory);             // 打开页式文件，memory 为缓冲池大小
+int pager_build(const Database *db, const char *path);          // 把数据库中的有效记录写成页式文件
+int pager_flush(Pager *p);                                      // 写回脏页、页首 ID 表和文件头
+void pager_close(Pager *p);                                     // 刷新并关闭
+bool pager_get(Pager *p, int id, Record *out, char *name);      // 按 ID 读取，name 至少 MAX_NAME_LEN 字节
+bool pager_toggle_flag(Pager *p, int id, uint8_t flag);         // 切换标志（FLAG_DELETED 即删除 / 恢复）
+bool pager_set_score(Pager *p, int id, double score);           // 修改成绩
+int pager_append(Pager *p, const Record *rec, const char *name); // 追加记录（ID 为 0 时自动分配），返回 ID，失败返回 -1
+uint64_t pager_print_query(Pager *p, const Query *q);           // 全表扫描并输出满足条件的记录
+void pager_print_stats(const Pager *p);                         // 输出缓冲池命中率与页 I/O
+
+#endif /* PAGER_H */
@@ -0,0 +1,804 @@
+/*
+ * partition.c - MiniDB 分区存储实现
+ * 保存：一次扫描求出每行所属分区，按分区计数排序得到各分区的行下标（保持行顺序），
+ *   再由各线程分别写自己负责的分区文件，最后写清单
+ * 加载：各线程把分区文件整块读入内存、解码成行并建立各自的成绩草图，
+ *   主线程按分区顺序用 db_append_batch 汇合（姓名驻留、ID 索引、位图只能串行建立）
+ * 单个快照：按记录切段并行解码，ID 索引按槽位分段并行建立，姓名与位图仍串行汇合
+ */
+
+#include "partition.h"
+#include "io.h"
+#include "aio.h"
+#include "output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>  // sysconf
+
+#define PART_MANIFEST_MAGIC  "MDBPARTS"
+#define PART_MANIFEST_VER    1
+#define PART_IO_BUFFER       (1u << 20)   // 每个分区文件的写缓冲区
+
+/* 墙钟时间（秒）：并行阶段不能用 clock()，它累计所有线程的 CPU 时间 */
+static double part_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void part_file_name(const char *base, int part, char *out, size_t size) {
+    snprintf(out, size, "%s.%d.dat", base, part);
+}
+
+static void part_manifest_name(const char *base, char *out, size_t size) {
+    snprintf(out, size, "%s.parts", base);
+}
+
+static int part_thread_count(int threads, int nparts) {
+    if (threads <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+#else
+        threads = 1;
+#endif
+    }
+    if (threads > PART_MAX_THREADS) {
+        threads = PART_MAX_THREADS;
+    }
+    if (threads > nparts) {
+        threads = nparts;
+    }
+    return threads < 1 ? 1 : threads;
+}
+
+/*
+ * part_run - 启动 threads 个任务，任务 0 在当前线程执行，
+ * 线程创建失败时在当前线程补做（与 agg.c 相同）
+ */
+static void part_run(void *(*worker)(void *), void *tasks, size_t task_size, int threads) {
+    pthread_t tids[PART_MAX_THREADS];
+    bool started[PART_MAX_THREADS];
+    for (int t = 1; t < threads; t++) {
+        started[t] = pthread_create(&tids[t], NULL, worker, (char *)tasks + t * task_size) == 0;
+    }
+    worker(tasks);
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(tids[t], NULL);
+        } else {
+            worker((char *)tasks + t * task_size);
+        }
+    }
+}
+
+/*
+ * ==================== 清单 ====================
+ * 文本格式，每行一个字段：
+ *   MDBPARTS 1
+ *   scheme range|hash
+ *   parts N
+ *   next_id X
+ *   <编号> <最小 ID> <最大 ID> <记录数>    （共 N 行）
+ */
+
+static bool part_write_manifest(const char *base, const PartManifest *m) {
+    char path[512];
+    part_manifest_name(base, path, sizeof(path));
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "错误：无法打开文件 '%s' 进行写入！\n", path);
+        perror("fopen");
+        return false;
+    }
+    fprintf(fp, "%s %d\n", PART_MANIFEST_MAGIC, PART_MANIFEST_VER);
+    fprintf(fp, "scheme %s\n", m->scheme == PART_BY_HASH ? "hash" : "range");
+    fprintf(fp, "parts %d\n", m->nparts);
+    fprintf(fp, "next_id %d\n", m->next_id);
+    for (int p = 0; p < m->nparts; p++) {
+        fprintf(fp, "%d %d %d %u\n", p, m->parts[p].id_min, m->parts[p].id_max, m->parts[p].records);
+    }
+    bool ok = !ferror(fp);
+    if (fclose(fp) != 0 || !ok) {
+        fprintf(stderr, "错误：写入清单 '%s' 失败！\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool part_read_manifest(const char *base, PartManifest *m) {
+    char path[512];
+    part_manifest_name(base, path, sizeof(path));
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "错误：无法打开分区清单 '%s'！\n", path);
+        return false;
+    }
+    char magic[16], scheme[16];
+    int version;
+    bool ok = fscanf(fp, "%15s %d", magic, &version) == 2 &&
+              strcmp(magic, PART_MANIFEST_MAGIC) == 0 && version == PART_MANIFEST_VER &&
+              fscanf(fp, " scheme %15s", scheme) == 1 &&
+              fscanf(fp, " parts %d", &m->nparts) == 1 &&
+              fscanf(fp, " next_id %d", &m->next_id) == 1 &&
+              m->nparts >= 1 && m->nparts <= PART_MAX;
+    if (ok) {
+        m->scheme = strcmp(scheme, "hash") == 0 ? PART_BY_HASH : PART_BY_RANGE;
+        for (int p = 0; p < m->nparts && ok; p++) {
+            int no;
+            ok = fscanf(fp, "%d %d %d %u", &no, &m->parts[p].id_min, &m->parts[p].id_max,
+                        &m->parts[p].records) == 4 && no == p;
+        }
+    }
+    fclose(fp);
+    if (!ok) {
+        fprintf(stderr, "错误：分区清单 '%s' 格式错误！\n", path);
+    }
+    return ok;
+}
+
+/*
+ * ==================== 保存 ====================
+ */
+
+/* 线程任务：写第 first、first + step、... 个分区 */
+typedef struct PartSaveTask {
+    const Database *db;
+    const char *base;
+    const uint32_t *rows;       // 按分区排列的行下标
+    const uint32_t *start;      // 分区 p 的行下标为 rows[start[p], start[p + 1])
+    int nparts;
+    int first;
+    int step;
+    bool ok;
+} PartSaveTask;
+
+static bool part_write_file(const Database *db, const char *path, const uint32_t *rows, uint32_t n) {
+    FILE *fp = fopen(path, "wb");
+    char *iobuf = malloc(PART_IO_BUFFER);
+    if (fp == NULL || iobuf == NULL) {
+        fprintf(stderr, "错误：无法打开文件 '%s' 进行写入！\n", path);
+        if (fp != NULL) {
+            fclose(fp);
+        }
+        free(iobuf);
+        return false;
+    }
+    setvbuf(fp, iobuf, _IOFBF, PART_IO_BUFFER);
+    int count = (int)n;
+    bool ok = fwrite(SNAPSHOT_MAGIC, 1, SNAPSHOT_MAGIC_LEN, fp) == SNAPSHOT_MAGIC_LEN &&
+              fwrite(&count, sizeof(int), 1, fp) == 1 &&
+              fwrite(&db->next_id, sizeof(int), 1, fp) == 1;
+    unsigned char buf[SNAPSHOT_REC_MAX];
+    for (uint32_t i = 0; i < n && ok; i++) {
+        size_t len = io_encode_record(db, &db->rows[rows[i]], buf);
+        ok = fwrite(buf, 1, len, fp) == len;
+    }
+    ok = fclose(fp) == 0 && ok;
+    free(iobuf);
+    if (!ok) {
+        fprintf(stderr, "错误：写入分区文件 '%s' 失败！\n", path);
+    }
+    return ok;
+}
+
+static void *part_save_worker(void *arg) {
+    PartSaveTask *task = arg;
+    task->ok = true;
+    for (int p = task->first; p < task->nparts; p += task->step) {
+        char path[512];
+        part_file_name(task->base, p, path, sizeof(path));
+        if (!part_write_file(task->db, path, task->rows + task->start[p], task->start[p + 1] - task->start[p])) {
+            task->ok = false;
+        }
+    }
+    return NULL;
+}
+
+static int compare_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/* 与 ID 索引相同的乘法散列 */
+static int part_hash(int id, int nparts) {
+    uint32_t h = (uint32_t)id * 0x9E3779B1u;
+    h ^= h >> 16;
+    return (int)(h % (uint32_t)nparts);
+}
+
+/*
+ * part_assign - 求每个有效行所属的分区（墓碑行为 -1），并填写清单中的 ID 范围
+ * 按范围分区时，边界取有效 ID 的等分位点，使各分区记录数大致相等
+ */
+static bool part_assign(const Database *db, PartManifest *m, int8_t *assign) {
+    int live = db_live_count(db);
+    int bounds[PART_MAX];       // bounds[p] 为分区 p 的最小 ID（p >= 1）
+    if (m->scheme == PART_BY_RANGE && live > 0) {
+        int *ids = malloc(sizeof(int) * live);
+        if (ids == NULL) {
+            return false;
+        }
+        int n = 0;
+        bool sorted = true;
+        for (int i = 0; i < db->count; i++) {
+            if (!db_is_dead(&db->rows[i])) {
+                ids[n] = db->rows[i].id;
+                sorted = sorted && (n == 0 || ids[n - 1] < ids[n]);
+                n++;
+            }
+        }
+        if (!sorted) {
+            qsort(ids, n, sizeof(int), compare_int);
+        }
+        for (int p = 1; p < m->nparts; p++) {
+            bounds[p] = ids[(long long)n * p / m->nparts];
+        }
+        free(ids);
+    }
+
+    for (int p = 0; p < m->nparts; p++) {
+        m->parts[p].id_min = 0;
+        m->parts[p].id_max = -1;
+        m->parts[p].records = 0;
+    }
+    for (int i = 0; i < db->count; i++) {
+        const Record *r = &db->rows[i];
+        if (db_is_dead(r)) {
+            assign[i] = -1;
+            continue;
+        }
+        int p;
+        if (m->scheme == PART_BY_HASH) {
+            p = part_hash(r->id, m->nparts);
+        } else {
+            /* 最后一个 bounds[p] <= id 的分区 */
+            int lo = 1, hi = m->nparts;
+            while (lo < hi) {
+                int mid = (lo + hi) / 2;
+                if (bounds[mid] <= r->id) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            p = lo - 1;
+        }
+        assign[i] = (int8_t)p;
+        PartInfo *info = &m->parts[p];
+        if (info->records == 0 || r->id < info->id_min) {
+            info->id_min = r->id;
+        }
+        if (info->records == 0 || r->id > info->id_max) {
+            info->id_max = r->id;
+        }
+        info->records++;
+    }
+    return true;
+}
+
+/*
+ * part_save - 把有效记录分到 nparts 个分区文件，并行写出
+ * 返回值：0 表示成功，-1 表示失败
+ */
+int part_save(const Database *db, const char *base, int nparts, PartScheme scheme, int threads) {
+    if (nparts < 1 || nparts > PART_MAX) {
+        printf("错误：分区数必须在 1-%d 之间！\n", PART_MAX);
+        return -1;
+    }
+    double start_time = part_now();
+    PartManifest m;
+    m.scheme = scheme;
+    m.nparts = nparts;
+    m.next_id = db->next_id;
+
+    int8_t *assign = malloc(db->count > 0 ? (size_t)db->count : 1);
+    uint32_t *rows = malloc(sizeof(uint32_t) * (db->count > 0 ? db->count : 1));
+    uint32_t start[PART_MAX + 1];
+    int ret = -1;
+    if (assign == NULL || rows == NULL || !part_assign(db, &m, assign)) {
+        printf("内存分配失败！\n");
+        goto out;
+    }
+
+    /* 按分区计数排序，各分区内保持行顺序 */
+    start[0] = 0;
+    for (int p = 0; p < nparts; p++) {
+        start[p + 1] = start[p] + m.parts[p].records;
+    }
+    uint32_t fill[PART_MAX];
+    memcpy(fill, start, sizeof(uint32_t) * nparts);
+    for (int i = 0; i < db->count; i++) {
+        if (assign[i] >= 0) {
+            rows[fill[assign[i]]++] = (uint32_t)i;
+        }
+    }
+
+    threads = part_thread_count(threads, nparts);
+    PartSaveTask tasks[PART_MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        tasks[t].db = db;
+        tasks[t].base = base;
+        tasks[t].rows = rows;
+        tasks[t].start = start;
+        tasks[t].nparts = nparts;
+        tasks[t].first = t;
+        tasks[t].step = threads;
+    }
+    part_run(part_save_worker, tasks, sizeof(PartSaveTask), threads);
+    bool ok = true;
+    for (int t = 0; t < threads; t++) {
+        ok = ok && tasks[t].ok;
+    }
+    /* 分区文件全部写完后再写清单 */
+    if (ok && part_write_manifest(base, &m)) {
+        printf("成功保存 %u 条记录到 %d 个分区（%s，%d 个线程），用时 %.3f 秒\n",
+               start[nparts], nparts, scheme == PART_BY_HASH ? "按 ID 散列" : "按 ID 范围",
+               threads, part_now() - start_time);
+        ret = 0;
+    }
+
+out:
+    free(assign);
+    free(rows);
+    return ret;
+}
+
+/*
+ * ==================== 加载 ====================
+ */
+
+/* 一个分区解码后的结果 */
+typedef struct PartData {
+    unsigned char *buf;             // 整个分区文件
+    Record *rows;
+    const unsigned char **names;    // 指向 buf 中的姓名长度字节
+    uint32_t n;
+    KllSketch sketch;               // 本分区的成绩草图
+} PartData;
+
+/* 线程任务：读取并解码第 first、first + step、... 个分区 */
+typedef struct PartLoadTask {
+    const char *base;
+    const PartManifest *m;
+    PartData *data;
+    int first;
+    int step;
+    bool ok;
+} PartLoadTask;
+
+/* 把整个文件读入内存（多个大块读请求同时在途） */
+static unsigned char *part_slurp(const char *path, size_t *size) {
+    unsigned char *buf = aio_read_file(path, size, SNAPSHOT_DIRECT_IO ? AIO_DIRECT : 0);
+    if (buf == NULL) {
+        fprintf(stderr, "错误：读取文件 '%s' 失败！\n", path);
+    }
+    return buf;
+}
+
+static bool part_read_file(const char *path, uint32_t expect, PartData *d) {
+    size_t size, used;
+    int count;
+    d->buf = part_slurp(path, &size);
+    if (d->buf == NULL) {
+        return false;
+    }
+    if (size < SNAPSHOT_HEADER || memcmp(d->buf, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) != 0) {
+        fprintf(stderr, "错误：'%s' 不是第 2 版快照文件！\n", path);
+        return false;
+    }
+    memcpy(&count, d->buf + SNAPSHOT_MAGIC_LEN, sizeof(int));
+    if (count < 0 || (uint32_t)count != expect) {
+        fprintf(stderr, "错误：'%s' 的记录数与清单不符！\n", path);
+        return false;
+    }
+    d->n = expect;
+    d->rows = malloc(sizeof(Record) * (expect > 0 ? expect : 1));
+    d->names = malloc(sizeof(unsigned char *) * (expect > 0 ? expect : 1));
+    if (d->rows == NULL || d->names == NULL) {
+        printf("内存分配失败！\n");
+        return false;
+    }
+    if (!io_decode_records(d->buf + SNAPSHOT_HEADER, size - SNAPSHOT_HEADER, expect, d->rows, d->names, &used)) {
+        fprintf(stderr, "错误：'%s' 中的记录已损坏！\n", path);
+        return false;
+    }
+    for (uint32_t i = 0; i < expect; i++) {
+        kll_update(&d->sketch, d->rows[i].score);
+    }
+    return true;
+}
+
+static void *part_load_worker(void *arg) {
+    PartLoadTask *task = arg;
+    task->ok = true;
+    for (int p = task->first; p < task->m->nparts && task->ok; p += task->step) {
+        char path[512];
+        part_file_name(task->base, p, path, sizeof(path));
+        task->ok = part_read_file(path, task->m->parts[p].records, &task->data[p]);
+    }
+    return NULL;
+}
+
+/*
+ * part_load - 并行读取、解码全部分区，再按分区顺序汇合进数据库
+ * 返回值：0 表示成功，-1 表示失败（失败时数据库保持原样）
+ */
+int part_load(Database *db, const char *base, int threads) {
+    PartManifest m;
+    if (!part_read_manifest(base, &m)) {
+        return -1;
+    }
+    double start_time = part_now();
+    PartData data[PART_MAX];
+    memset(data, 0, sizeof(data));
+    for (int p = 0; p < m.nparts; p++) {
+        kll_init(&data[p].sketch);
+    }
+
+    threads = part_thread_count(threads, m.nparts);
+    PartLoadTask tasks[PART_MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        tasks[t].base = base;
+        tasks[t].m = &m;
+        tasks[t].data = data;
+        tasks[t].first = t;
+        tasks[t].step = threads;
+    }
+    part_run(part_load_worker, tasks, sizeof(PartLoadTask), threads);
+    bool ok = true;
+    for (int t = 0; t < threads; t++) {
+        ok = ok && tasks[t].ok;
+    }
+    double decoded_time = part_now();
+
+    uint64_t total = 0;
+    if (ok) {
+        db_clear(db);
+        db->next_id = m.next_id;
+        for (int p = 0; p < m.nparts && ok; p++) {
+            ok = db_append_batch(db, data[p].rows, data[p].names, data[p].n, &data[p].sketch, NULL);
+            total += data[p].n;
+        }
+        if (!ok) {
+            fprintf(stderr, "错误：内存不足！\n");
+        }
+    }
+    for (int p = 0; p < m.nparts; p++) {
+        free(data[p].buf);
+        free(data[p].rows);
+        free(data[p].names);
+        kll_free(&data[p].sketch);
+    }
+    if (!ok) {
+        return -1;
+    }
+    double end_time = part_now();
+    printf("成功从 %d 个分区加载 %llu 条记录（%d 个线程），用时 %.3f 秒（读取解码 %.3f，建立索引 %.3f）\n",
+           m.nparts, (unsigned long long)total, threads, end_time - start_time,
+           decoded_time - start_time, end_time - decoded_time);
+    return 0;
+}
+
+/*
+ * ==================== 单个快照的并行加载 ====================
+ * 快照中的记录是变长的，没有同步标记，不能按字节直接切分：
+ * 先跳读一遍只看姓名长度，找出把记录均分成若干段的字节偏移，
+ * 再由各线程分别解码自己的一段、建立成绩草图，然后按槽位分段并行建立 ID 索引，
+ * 最后主线程按文件顺序驻留姓名、建立位图
+ * 第 3 版快照自带块映射，不需要跳读：各线程分别解码连续的若干块
+ */
+
+#define PART_SPILL_MAX  4096    // 每段 ID 索引允许越过段尾、留给主线程补插的 ID 数
+
+/* 线程任务：解码第 first 到 first + n - 1 条记录 */
+typedef struct SnapDecodeTask {
+    const unsigned char *data;      // 本段第一条记录；第 3 版为整个文件
+    size_t size;                    // 本段字节数
+    const SnapBlock *blocks;        // 第 3 版：本段的块，NULL 表示第 2 版
+    uint32_t nblocks;
+    uint32_t first;
+    uint32_t n;
+    Record *rows;                   // 整个文件的行（各段写入互不重叠）
+    const unsigned char **names;
+    KllSketch sketch;
+    bool ok;
+} SnapDecodeTask;
+
+/* 线程任务：建立 ID 索引的第 seg 段槽位 */
+typedef struct SnapIndexTask {
+    IdMap *ids;
+    const Record *rows;
+    uint32_t n;
+    int seg;
+    int nsegs;
+    uint32_t *spill;
+    uint32_t nspill;
+    size_t added;
+} SnapIndexTask;
+
+static void *snap_decode_worker(void *arg) {
+    SnapDecodeTask *task = arg;
+    size_t used;
+    if (task->blocks == NULL) {
+        task->ok = io_decode_records(task->data, task->size, task->n, task->rows + task->first,
+                                     task->names + task->first, &used) && used == task->size;
+    } else {
+        uint32_t row = task->first;
+        task->ok = true;
+        for (uint32_t b = 0; b < task->nblocks && task->ok; b++) {
+            const SnapBlock *blk = &task->blocks[b];
+            task->ok = io_decode_records(task->data + blk->off, blk->len, blk->rows, task->rows + row,
+                                         task->names + row, &used) && used == blk->len;
+            row += blk->rows;
+        }
+    }
+    for (uint32_t i = 0; i < task->n && task->ok; i++) {
+        task->ok = kll_update(&task->sketch, task->rows[task->first + i].score);
+    }
+    return NULL;
+}
+
+static void *snap_index_worker(void *arg) {
+    SnapIndexTask *task = arg;
+    task->added = task->spill == NULL ? SIZE_MAX :
+                  idmap_fill_segment(task->ids, &task->rows[0].id, sizeof(Record), task->n,
+                                     task->seg, task->nsegs, task->spill, PART_SPILL_MAX, &task->nspill);
+    return NULL;
+}
+
+/*
+ * snap_split - 跳读记录，求出把 n 条记录均分成 parts 段时各段的起始偏移
+ * offs[t] 为第 t 段首条记录（第 n * t / parts 条）的偏移，offs[parts] 为末尾
+ */
+static bool snap_split(const unsigned char *data, size_t size, uint32_t n, int parts, size_t *offs) {
+    size_t off = 0;
+    int t = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        while (t < parts && i == (uint32_t)((uint64_t)n * t / parts)) {
+            offs[t++] = off;
+        }
+        if (size - off < SNAPSHOT_REC_FIXED) {
+            return false;
+        }
+        off += SNAPSHOT_REC_FIXED + data[off + 14];
+        if (off > size) {
+            return false;
+        }
+    }
+    while (t <= parts) {
+        offs[t++] = off;
+    }
+    return true;
+}
+
+/* 按槽位分段并行建立 ID 索引；某段越界的 ID 太多时退回由 db_append_batch 逐条插入 */
+static bool snap_build_ids(IdMap *ids, const Record *rows, uint32_t n, int threads) {
+    if (!idmap_init(ids) || !idmap_reserve(ids, n)) {
+        return false;
+    }
+    SnapIndexTask tasks[PART_MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        tasks[t].ids = ids;
+        tasks[t].rows = rows;
+        tasks[t].n = n;
+        tasks[t].seg = t;
+        tasks[t].nsegs = threads;
+        tasks[t].spill = malloc(sizeof(uint32_t) * PART_SPILL_MAX);
+    }
+    part_run(snap_index_worker, tasks, sizeof(SnapIndexTask), threads);
+    bool ok = true;
+    for (int t = 0; t < threads; t++) {
+        ok = ok && tasks[t].added != SIZE_MAX;
+        if (ok) {
+            ids->size += tasks[t].added;
+        }
+    }
+    /* 越过段尾的 ID 按行顺序补插，同一 ID 仍以后出现的行为准 */
+    for (int t = 0; t < threads && ok; t++) {
+        for (uint32_t i = 0; i < tasks[t].nspill && ok; i++) {
+            uint32_t row = tasks[t].spill[i];
+            ok = idmap_put(ids, rows[row].id, row);
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        free(tasks[t].spill);
+    }
+    if (!ok) {
+        idmap_free(ids);
+    }
+    return ok;
+}
+
+/*
+ * part_load_snapshot - 多线程加载一个第 2 版或第 3 版快照文件
+ * 整个文件一次读入内存，按记录（第 3 版按块）切成 threads 段并行解码，
+ * ID 索引按槽位分段并行建立，再按文件顺序汇合进数据库；旧版格式交给 io_load_binary
+ * 返回值：0 表示成功，-1 表示失败（读取或解码失败时数据库保持原样）
+ */
+int part_load_snapshot(Database *db, const char *filename, int threads) {
+    double start_time = part_now();
+    size_t size;
+    unsigned char *buf = part_slurp(filename, &size);
+    if (buf == NULL) {
+        return -1;
+    }
+    bool v3 = size >= SNAPSHOT_MAGIC_LEN && memcmp(buf, SNAPSHOT3_MAGIC, SNAPSHOT_MAGIC_LEN) == 0;
+    if (!v3 && (size < SNAPSHOT_MAGIC_LEN || memcmp(buf, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) != 0)) {
+        free(buf);
+        return io_load_binary(db, filename);
+    }
+    double read_time = part_now();
+
+    int count, next_id;
+    Record *rows = NULL;
+    const unsigned char **names = NULL;
+    size_t offs[PART_MAX_THREADS + 1];
+    SnapHeader h;
+    SnapBlock *map = NULL;
+    SnapDecodeTask tasks[PART_MAX_THREADS];
+    IdMap ids;
+    int ret = -1;
+    memset(&ids, 0, sizeof(ids));
+    threads = part_thread_count(threads, PART_MAX_THREADS);
+    for (int t = 0; t < threads; t++) {
+        kll_init(&tasks[t].sketch);
+    }
+
+    if (v3) {
+        if (!io_parse_snapshot3(buf, size, &h, &map)) {
+            fprintf(stderr, "错误：'%s' 的文件头或块映射已损坏！\n", filename);
+            goto out;
+        }
+        count = h.count;
+        next_id = h.next_id;
+    } else {
+        if (size < SNAPSHOT_HEADER) {
+            fprintf(stderr, "错误：读取文件头失败！文件可能已损坏。\n");
+            goto out;
+        }
+        memcpy(&count, buf + SNAPSHOT_MAGIC_LEN, sizeof(int));
+        memcpy(&next_id, buf + SNAPSHOT_MAGIC_LEN + sizeof(int), sizeof(int));
+        if (count < 0 || !snap_split(buf + SNAPSHOT_HEADER, size - SNAPSHOT_HEADER, (uint32_t)count, threads, offs)) {
+            fprintf(stderr, "错误：'%s' 中的记录已损坏！\n", filename);
+            goto out;
+        }
+    }
+    rows = malloc(sizeof(Record) * (count > 0 ? count : 1));
+    names = malloc(sizeof(unsigned char *) * (count > 0 ? count : 1));
+    if (rows == NULL || names == NULL) {
+        printf("内存分配失败！\n");
+        goto out;
+    }
+
+    /* 各线程解码自己的一段：第 2 版按跳读得到的偏移，第 3 版取连续的若干块 */
+    for (int t = 0; t < threads; t++) {
+        if (v3) {
+            uint32_t b0 = (uint32_t)((uint64_t)h.nblocks * t / threads);
+            uint32_t b1 = (uint32_t)((uint64_t)h.nblocks * (t + 1) / threads);
+            tasks[t].data = buf;
+            tasks[t].blocks = map + b0;
+            tasks[t].nblocks = b1 - b0;
+            tasks[t].first = b0 << DB_BLOCK_SHIFT;
+            tasks[t].n = 0;
+            for (uint32_t b = b0; b < b1; b++) {
+                tasks[t].n += map[b].rows;
+            }
+        } else {
+            tasks[t].data = buf + SNAPSHOT_HEADER + offs[t];
+            tasks[t].size = offs[t + 1] - offs[t];
+            tasks[t].blocks = NULL;
+            tasks[t].first = (uint32_t)((uint64_t)count * t / threads);
+            tasks[t].n = (uint32_t)((uint64_t)count * (t + 1) / threads) - tasks[t].first;
+        }
+        tasks[t].rows = rows;
+        tasks[t].names = names;
+    }
+    part_run(snap_decode_worker, tasks, sizeof(SnapDecodeTask), threads);
+    bool ok = true;
+    for (int t = 0; t < threads; t++) {
+        ok = ok && tasks[t].ok;
+    }
+    if (!ok) {
+        fprintf(stderr, "错误：'%s' 中的记录已损坏！\n", filename);
+        goto out;
+    }
+    for (int t = 1; t < threads; t++) {
+        kll_merge(&tasks[0].sketch, &tasks[t].sketch);
+    }
+    double decoded_time = part_now();
+
+    /* ID 索引并行建立，失败时交给 db_append_batch 逐条插入 */
+    bool have_ids = snap_build_ids(&ids, rows, (uint32_t)count, threads);
+    db_clear(db);
+    db->next_id = next_id;
+    if (!db_append_batch(db, rows, names, (uint32_t)count, &tasks[0].sketch, have_ids ? &ids : NULL)) {
+        fprintf(stderr, "错误：内存不足！\n");
+        db_clear(db);
+        goto out;
+    }
+    if (v3) {
+        io_snap_adopt(db, filename, &h, map, size);
+    }
+    double end_time = part_now();
+    printf("成功加载 %d 条记录 from '%s'（%d 个线程），用时 %.3f 秒（读取 %.3f，解码 %.3f，建立索引 %.3f）\n",
+           db_live_count(db), filename, threads, end_time - start_time, read_time - start_time,
+           decoded_time - read_time, end_time - decoded_time);
+    ret = 0;
+
+out:
+    for (int t = 0; t < threads; t++) {
+        kll_free(&tasks[t].sketch);
+    }
+    idmap_free(&ids);
+    free(map);
+    free(rows);
+    free(names);
+    free(buf);
+    return ret;
+}
+
+/*
+ * ==================== 分区裁剪 ====================
+ */
+
+/*
+ * part_print_id_range - 输出 ID 在 [id_min, id_max] 内的有效记录
+ * 只打开 ID 范围与查询相交的分区文件，不加载到数据库
+ * 返回值：0 表示成功，-1 表示失败
+ */
+int part_print_id_range(const char *base, int id_min, int id_max) {
+    PartManifest m;
+    if (!part_read_manifest(base, &m)) {
+        return -1;
+    }
+    clock_t start = clock();
+    int scanned = 0;
+    uint64_t matched = 0;
+    OutBuf ob;
+    out_init(&ob, stdout);
+    for (int p = 0; p < m.nparts; p++) {
+        const PartInfo *info = &m.parts[p];
+        if (info->records == 0 || info->id_max < id_min || info->id_min > id_max) {
+            continue;  /* 裁剪：与查询范围不相交 */
+        }
+        char path[512];
+        size_t size, used;
+        part_file_name(base, p, path, sizeof(path));
+        PartData d;
+        memset(&d, 0, sizeof(d));
+        d.buf = part_slurp(path, &size);
+        d.rows = malloc(sizeof(Record) * (info->records > 0 ? info->records : 1));
+        d.names = malloc(sizeof(unsigned char *) * (info->records > 0 ? info->records : 1));
+        bool ok = d.buf != NULL && d.rows != NULL && d.names != NULL && size >= SNAPSHOT_HEADER &&
+                  io_decode_records(d.buf + SNAPSHOT_HEADER, size - SNAPSHOT_HEADER, info->records,
+                                    d.rows, d.names, &used);
+        if (ok) {
+            for (uint32_t i = 0; i < info->records; i++) {
+                const Record *r = &d.rows[i];
+                if (!db_is_dead(r) && r->id >= id_min && r->id <= id_max) {
+                    out_record_named(&ob, r, (const char *)d.names[i] + 1, d.names[i][0]);
+                    matched++;
+                }
+            }
+        } else {
+            fprintf(stderr, "错误：读取分区文件 '%s' 失败！\n", path);
+        }
+        free(d.buf);
+        free(d.rows);
+        free(d.names);
+        if (!ok) {
+            out_flush(&ob);
+            return -1;
+        }
+        scanned++;
+    }
+    out_flush(&ob);
+    double ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+    printf("共 %llu 条记录，扫描 %d / %d 个分区，用时 %.3f 毫秒\n",
+           (unsigned long long)matched, scanned, m.nparts, ms);
+    return 0;
+}
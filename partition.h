@@ -0,0 +1,53 @@
+/*
+ * partition.h - MiniDB 分区存储头文件
+ * 把数据库按 ID 范围（或 ID 散列）拆分成 N 个分区文件，另有一个文本清单：
+ * - 每个分区文件都是普通的第 2 版快照，也可以单独用 io_load_binary 加载
+ * - 保存、加载时各分区由不同线程并行读写和解码，最后按分区顺序汇合进数据库
+ * - 清单记录每个分区实际的 ID 范围，按 ID 范围查询时跳过不相交的分区
+ * 单个快照文件也可以按记录切段后用同样的线程并行加载（part_load_snapshot）
+ */
+
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include "db.h"
+
+#define PART_MAX          64        // 最多分区数
+#define PART_MAX_THREADS  8         // 最多使用的线程数
+#define PART_BASENAME     "minidb"  // 默认文件名前缀：minidb.parts、minidb.0.dat ...
+
+/*
+ * 分区方式
+ */
+typedef enum PartScheme {
+    PART_BY_RANGE = 1,      // 按 ID 范围（各分区记录数大致相等）
+    PART_BY_HASH            // 按 ID 散列
+} PartScheme;
+
+/*
+ * 清单中的一个分区
+ */
+typedef struct PartInfo {
+    int id_min;             // 分区内最小 ID（空分区为 0）
+    int id_max;             // 分区内最大 ID（空分区为 -1）
+    uint32_t records;       // 记录数
+} PartInfo;
+
+/*
+ * 分区清单（<前缀>.parts）
+ */
+typedef struct PartManifest {
+    PartScheme scheme;
+    int nparts;
+    int next_id;
+    PartInfo parts[PART_MAX];
+} PartManifest;
+
+int part_save(const Database *db, const char *base, int nparts, PartScheme scheme, int threads);  // 分区保存，threads 为 0 时按 CPU 核数
+int part_load(Database *db, const char *base, int threads);                  // 并行加载全部分区
+int part_load_snapshot(Database *db, const char *filename, int threads);   // 多线程加载单个快照文件
+int part_print_id_range(const char *base, int id_min, int id_max);           // 只扫描与 ID 范围相交的分区并输出
+bool part_read_manifest(const char *base, PartManifest *m);                  // 读取清单
+void part_file_name(const char *base, int part, char *out, size_t size);     // 分区文件名：<前缀>.<编号>.dat
+
+#endif /* PARTITION_H */
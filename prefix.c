@@ -0,0 +1,428 @@
+/*
+ * prefix.c - MiniDB 姓名前缀索引实现
+ * 姓名编号按第一次出现的先后分配，字符串堆偏移 + 1 通过哈希表映射到姓名编号；
+ * 有序数组只保存姓名编号，比较时取字符串堆中的姓名。
+ * 新姓名插入增量数组（二分定位后移动，至多 PREFIX_DELTA_MAX 个），满后一次归并进主数组，
+ * 均摊到每个新姓名的代价为 O(n / PREFIX_DELTA_MAX)。
+ * 同名的行用 next 数组串成链表，按行下标升序，即按加入的先后
+ */
+
+#include "prefix.h"
+#include "output.h"
+#include "namesort.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* 一个不同的姓名 */
+typedef struct PrefixName {
+    uint32_t off;           // 姓名在字符串堆中的偏移
+    uint32_t head;          // 第一行（IDMAP_NONE 表示没有行，改名后可能出现）
+    uint32_t tail;          // 最后一行
+    uint32_t live;          // 有效（未删除）行数
+} PrefixName;
+
+/* 姓名前缀索引 */
+struct PrefixIndex {
+    PrefixName *names;      // 按编号存放的姓名
+    uint32_t nnames;
+    uint32_t names_cap;
+    IdMap by_off;           // 字符串堆偏移 + 1 -> 姓名编号
+    uint32_t *sorted;       // 主数组：按姓名排序的姓名编号
+    uint32_t nsorted;
+    uint32_t delta[PREFIX_DELTA_MAX];  // 增量数组：之后新出现的姓名，按姓名排序
+    uint32_t ndelta;
+    uint32_t *next;         // next[row] 为与第 row 行同名的下一行（IDMAP_NONE 表示链尾）
+    uint32_t next_cap;
+    uint32_t rows;          // 已建立索引的行数（与 db->count 相同）
+};
+
+void prefix_index_free(struct PrefixIndex *index) {
+    if (index == NULL) {
+        return;
+    }
+    free(index->names);
+    idmap_free(&index->by_off);
+    free(index->sorted);
+    free(index->next);
+    free(index);
+}
+
+/* 内存不足时丢弃索引，下次查找时重建 */
+static void prefix_drop(Database *db) {
+    prefix_index_free(db->prefix);
+    db->prefix = NULL;
+}
+
+/* 确保 next 数组能容纳第 row 行 */
+static bool reserve_rows(struct PrefixIndex *index, uint32_t row) {
+    if (row < index->next_cap) {
+        return true;
+    }
+    uint32_t cap = index->next_cap > 0 ? index->next_cap : 1024;
+    while (cap <= row) {
+        cap *= 2;
+    }
+    uint32_t *next = realloc(index->next, sizeof(uint32_t) * cap);
+    if (next == NULL) {
+        return false;
+    }
+    index->next = next;
+    index->next_cap = cap;
+    return true;
+}
+
+/*
+ * name_id - 取字符串堆偏移 off 处姓名的编号
+ * create 为 true 时不存在则新建（*created 置真），新姓名尚未放入任何有序数组
+ * 返回值：IDMAP_NONE 表示不存在或内存不足
+ */
+static uint32_t name_id(struct PrefixIndex *index, uint32_t off, bool create, bool *created) {
+    uint32_t id = idmap_get(&index->by_off, (int)off + 1);
+    if (id != IDMAP_NONE || !create) {
+        return id;
+    }
+    if (index->nnames == index->names_cap) {
+        uint32_t cap = index->names_cap > 0 ? index->names_cap * 2 : 1024;
+        PrefixName *names = realloc(index->names, sizeof(PrefixName) * cap);
+        if (names == NULL) {
+            return IDMAP_NONE;
+        }
+        index->names = names;
+        index->names_cap = cap;
+    }
+    id = index->nnames;
+    if (!idmap_put(&index->by_off, (int)off + 1, id)) {
+        return IDMAP_NONE;
+    }
+    PrefixName *name = &index->names[id];
+    name->off = off;
+    name->head = IDMAP_NONE;
+    name->tail = IDMAP_NONE;
+    name->live = 0;
+    index->nnames++;
+    *created = true;
+    return id;
+}
+
+/* 把第 row 行挂到姓名 id 的链表上（保持行下标升序） */
+static void link_row(const Database *db, struct PrefixIndex *index, uint32_t id, uint32_t row) {
+    PrefixName *name = &index->names[id];
+    if (name->head == IDMAP_NONE || row < name->head) {
+        index->next[row] = name->head;
+        name->head = row;
+        if (name->tail == IDMAP_NONE) {
+            name->tail = row;
+        }
+    } else if (row > name->tail) {
+        index->next[row] = IDMAP_NONE;
+        index->next[name->tail] = row;
+        name->tail = row;
+    } else {
+        uint32_t prev = name->head;
+        while (index->next[prev] < row) {
+            prev = index->next[prev];
+        }
+        index->next[row] = index->next[prev];
+        index->next[prev] = row;
+    }
+    name->live += !db_is_dead(&db->rows[row]);
+}
+
+/* 把第 row 行从姓名 id 的链表上摘下 */
+static void unlink_row(const Database *db, struct PrefixIndex *index, uint32_t id, uint32_t row) {
+    PrefixName *name = &index->names[id];
+    uint32_t prev = IDMAP_NONE;
+    uint32_t cur = name->head;
+    while (cur != row) {
+        prev = cur;
+        cur = index->next[cur];
+    }
+    if (prev == IDMAP_NONE) {
+        name->head = index->next[row];
+    } else {
+        index->next[prev] = index->next[row];
+    }
+    if (name->tail == row) {
+        name->tail = prev;
+    }
+    name->live -= !db_is_dead(&db->rows[row]);
+}
+
+/* 在按姓名排序的 ids[lo, hi) 中找第一个不小于 s 的位置 */
+static uint32_t name_bound(const char *heap, const PrefixName *names, const uint32_t *ids,
+                           uint32_t lo, uint32_t hi, const char *s) {
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (strcmp(heap + names[ids[mid]].off, s) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * merge_delta - 把增量数组归并进主数组
+ * 主数组远长于增量数组，逐个比较会读遍所有姓名；改为对每个新姓名在主数组中二分定位，
+ * 中间成段复制，只比较 O(PREFIX_DELTA_MAX log n) 次
+ */
+static bool merge_delta(const Database *db, struct PrefixIndex *index) {
+    uint32_t n = index->nsorted + index->ndelta;
+    uint32_t *sorted = malloc(sizeof(uint32_t) * (n > 0 ? n : 1));
+    if (sorted == NULL) {
+        return false;
+    }
+    const char *heap = db->name_heap.data;
+    uint32_t i = 0, k = 0;
+    for (uint32_t j = 0; j < index->ndelta; j++) {
+        uint32_t id = index->delta[j];
+        uint32_t pos = name_bound(heap, index->names, index->sorted, i, index->nsorted,
+                                  heap + index->names[id].off);
+        memcpy(sorted + k, index->sorted + i, sizeof(uint32_t) * (pos - i));
+        k += pos - i;
+        i = pos;
+        sorted[k++] = id;
+    }
+    memcpy(sorted + k, index->sorted + i, sizeof(uint32_t) * (index->nsorted - i));
+    free(index->sorted);
+    index->sorted = sorted;
+    index->nsorted = n;
+    index->ndelta = 0;
+    return true;
+}
+
+/* 把新姓名插入增量数组，满时先归并 */
+static bool insert_name(const Database *db, struct PrefixIndex *index, uint32_t id) {
+    if (index->ndelta == PREFIX_DELTA_MAX && !merge_delta(db, index)) {
+        return false;
+    }
+    const char *heap = db->name_heap.data;
+    uint32_t lo = name_bound(heap, index->names, index->delta, 0, index->ndelta,
+                             heap + index->names[id].off);
+    memmove(index->delta + lo + 1, index->delta + lo, sizeof(uint32_t) * (index->ndelta - lo));
+    index->delta[lo] = id;
+    index->ndelta++;
+    return true;
+}
+
+/*
+ * prefix_build - 按行存储整体建立索引
+ * 顺序遍历各行，按姓名串成链表，最后对姓名编号排序一次（基数排序，见 namesort.h）
+ */
+static struct PrefixIndex *prefix_build(const Database *db) {
+    struct PrefixIndex *index = calloc(1, sizeof(*index));
+    if (index == NULL) {
+        return NULL;
+    }
+    if (!idmap_init(&index->by_off) ||
+        (db->count > 0 && !reserve_rows(index, (uint32_t)db->count - 1))) {
+        prefix_index_free(index);
+        return NULL;
+    }
+    for (uint32_t row = 0; row < (uint32_t)db->count; row++) {
+        bool created = false;
+        uint32_t id = name_id(index, db->names[row].off, true, &created);
+        if (id == IDMAP_NONE) {
+            prefix_index_free(index);
+            return NULL;
+        }
+        link_row(db, index, id, row);  /* 行下标递增，总是挂在链尾 */
+    }
+    index->sorted = malloc(sizeof(uint32_t) * (index->nnames > 0 ? index->nnames : 1));
+    if (index->sorted == NULL) {
+        prefix_index_free(index);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < index->nnames; i++) {
+        index->sorted[i] = i;
+    }
+    if (!name_sort(db->name_heap.data, &index->names[0].off, sizeof(PrefixName), NULL, 0,
+                   index->sorted, index->nnames)) {
+        prefix_index_free(index);
+        return NULL;
+    }
+    index->nsorted = index->nnames;
+    index->rows = (uint32_t)db->count;
+    return index;
+}
+
+/*
+ * ==================== 增量维护 ====================
+ */
+
+void prefix_index_add(Database *db, uint32_t row) {
+    struct PrefixIndex *index = db->prefix;
+    if (index == NULL) {
+        return;
+    }
+    bool created = false;
+    uint32_t id;
+    if (row != index->rows || !reserve_rows(index, row) ||
+        (id = name_id(index, db->names[row].off, true, &created)) == IDMAP_NONE ||
+        (created && !insert_name(db, index, id))) {
+        prefix_drop(db);
+        return;
+    }
+    link_row(db, index, id, row);
+    index->rows++;
+}
+
+void prefix_index_set_dead(Database *db, uint32_t row, bool dead) {
+    struct PrefixIndex *index = db->prefix;
+    if (index == NULL) {
+        return;
+    }
+    uint32_t id = name_id(index, db->names[row].off, false, NULL);
+    if (id == IDMAP_NONE) {
+        prefix_drop(db);
+        return;
+    }
+    index->names[id].live += dead ? -1 : 1;
+}
+
+void prefix_index_rename(Database *db, uint32_t row, NameRef old_name) {
+    struct PrefixIndex *index = db->prefix;
+    if (index == NULL) {
+        return;
+    }
+    uint32_t old_id = name_id(index, old_name.off, false, NULL);
+    bool created = false;
+    uint32_t id;
+    if (old_id == IDMAP_NONE ||
+        (id = name_id(index, db->names[row].off, true, &created)) == IDMAP_NONE ||
+        (created && !insert_name(db, index, id))) {
+        prefix_drop(db);
+        return;
+    }
+    unlink_row(db, index, old_id, row);
+    link_row(db, index, id, row);
+}
+
+/*
+ * ==================== 查找 ====================
+ */
+
+/* 在按姓名排序的 ids 中找第一个前 len 字节不小于 prefix 的位置 */
+static uint32_t lower_bound(const char *heap, const PrefixName *names, const uint32_t *ids,
+                            uint32_t n, const char *prefix, size_t len) {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (strncmp(heap + names[ids[mid]].off, prefix, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * prefix_search - 查找以 prefix 开头的姓名，按姓名顺序返回前 limit 条有效记录
+ * 索引尚未建立时先整体建立
+ * 返回值：false 表示前缀为空或内存不足（已输出错误信息）
+ */
+bool prefix_search(Database *db, const char *prefix, size_t limit, PrefixResult *result) {
+    memset(result, 0, sizeof(*result));
+    size_t len = strlen(prefix);
+    if (len == 0) {
+        printf("错误：前缀不能为空！\n");
+        return false;
+    }
+    if (db->prefix == NULL) {
+        db->prefix = prefix_build(db);
+        result->built = db->prefix != NULL;
+    }
+    const struct PrefixIndex *index = db->prefix;
+    result->rows = malloc(sizeof(uint32_t) * (limit > 0 ? limit : 1));
+    if (index == NULL || result->rows == NULL) {
+        prefix_result_free(result);
+        printf("内存分配失败！\n");
+        return false;
+    }
+
+    /* 两个有序数组各自定位前缀区间的起点，按姓名归并 */
+    const char *heap = db->name_heap.data;
+    uint32_t i = lower_bound(heap, index->names, index->sorted, index->nsorted, prefix, len);
+    uint32_t j = lower_bound(heap, index->names, index->delta, index->ndelta, prefix, len);
+    for (;;) {
+        const char *a = i < index->nsorted ? heap + index->names[index->sorted[i]].off : NULL;
+        const char *b = j < index->ndelta ? heap + index->names[index->delta[j]].off : NULL;
+        if (a != NULL && strncmp(a, prefix, len) != 0) {
+            a = NULL;
+        }
+        if (b != NULL && strncmp(b, prefix, len) != 0) {
+            b = NULL;
+        }
+        if (a == NULL && b == NULL) {
+            break;
+        }
+        uint32_t id = (b == NULL || (a != NULL && strcmp(a, b) < 0)) ?
+                      index->sorted[i++] : index->delta[j++];
+        if (index->names[id].live == 0) {
+            continue;
+        }
+        if (result->n == limit) {
+            result->more = true;
+            break;
+        }
+        uint32_t taken = 0;
+        for (uint32_t row = index->names[id].head; row != IDMAP_NONE && result->n < limit;
+             row = index->next[row]) {
+            if (!db_is_dead(&db->rows[row])) {
+                result->rows[result->n++] = row;
+                taken++;
+            }
+        }
+        if (taken < index->names[id].live) {
+            result->more = true;  /* 同名的行没有取完 */
+            break;
+        }
+    }
+    return true;
+}
+
+void prefix_result_free(PrefixResult *result) {
+    free(result->rows);
+    result->rows = NULL;
+    result->n = 0;
+}
+
+/*
+ * db_print_prefix - 执行前缀查找并输出结果
+ */
+void db_print_prefix(Database *db, const char *prefix, size_t limit) {
+    if (db == NULL || db_live_count(db) == 0) {
+        printf("暂无学生记录。\n");
+        return;
+    }
+
+    PrefixResult result;
+    clock_t start = clock();
+    if (!prefix_search(db, prefix, limit, &result)) {
+        return;
+    }
+    double ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    if (result.n == 0) {
+        printf("未找到姓名以\"%s\"开头的记录。\n", prefix);
+    } else {
+        OutBuf ob;
+        out_init(&ob, stdout);
+        if (out_get_mode() == OUTPUT_PRETTY) {
+            out_puts(&ob, "=== 姓名以\"");
+            out_puts(&ob, prefix);
+            out_puts(&ob, "\"开头的记录 ===\n");
+        }
+        for (size_t i = 0; i < result.n; i++) {
+            out_record(&ob, db, &db->rows[result.rows[i]]);
+        }
+        out_flush(&ob);
+        printf("显示 %zu 条记录%s\n", result.n, result.more ? "，还有更多" : "");
+    }
+    printf("用时 %.3f 毫秒%s\n", ms, result.built ? "（已建立索引）" : "");
+    prefix_result_free(&result);
+}
@@ -0,0 +1,46 @@
+/*
+ * prefix.h - MiniDB 姓名前缀索引头文件
+ * 按姓名前缀查找（输入提示 / 自动补全），按姓名顺序返回前 N 条记录：
+ * - 不同姓名按字节序（即 UTF-8 码点序）排成有序数组，新出现的姓名先插入一个小的有序增量数组，
+ *   增量数组满后归并进主数组
+ * - 每个姓名的行按行下标串成链表，并记录有效行数，全部删除的姓名直接跳过
+ * - 添加、删除、恢复、改名时增量维护；清空、重新加载、回收后丢弃，下次查找时整体重建
+ * - 查找：两个有序数组上二分定位前缀区间，归并输出，代价 O(|前缀| log n + N)
+ */
+
+#ifndef PREFIX_H
+#define PREFIX_H
+
+#include "db.h"
+
+#define PREFIX_DELTA_MAX   4096   // 增量数组容纳的姓名数，满后归并进主数组
+#define PREFIX_SHOW_LIMIT  20     // 交互查找默认显示的记录数
+
+/*
+ * 前缀查找结果：按姓名排序的前 limit 条（同名的记录按加入的先后）
+ */
+typedef struct PrefixResult {
+    uint32_t *rows;         // 行下标
+    size_t n;               // 返回的条数
+    bool more;              // 是否还有更多匹配的记录
+    bool built;             // 本次查找（重新）建立了索引
+} PrefixResult;
+
+struct PrefixIndex;  // 姓名前缀索引（见 prefix.c）
+
+/*
+ * 查找
+ */
+bool prefix_search(Database *db, const char *prefix, size_t limit, PrefixResult *result);
+void prefix_result_free(PrefixResult *result);
+void db_print_prefix(Database *db, const char *prefix, size_t limit);  // 执行查找并输出结果
+
+/*
+ * 索引维护（由 db.c 在修改行存储时调用，索引尚未建立时不做任何事）
+ */
+void prefix_index_free(struct PrefixIndex *index);                      // 释放索引
+void prefix_index_add(Database *db, uint32_t row);                      // 追加了第 row 行
+void prefix_index_set_dead(Database *db, uint32_t row, bool dead);      // 第 row 行被删除或恢复
+void prefix_index_rename(Database *db, uint32_t row, NameRef old_name); // 第 row 行的姓名改变
+
+#endif /* PREFIX_H */
@@ -0,0 +1,450 @@
+/*
+ * quantile.c - MiniDB 分位数实现
+ * 分位数 q 取第 ceil(q * n) 小的值（最近秩法），q = 0 为最小值，q = 1 为最大值；
+ * 草图与精确计算使用同一定义，结果可直接对比
+ */
+
+#include "quantile.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define KLL_MIN_WIDTH 8  // 低层最小容量，避免每插入两三个值就排序压缩一次
+
+/* xorshift64：压缩时决定保留奇数位还是偶数位 */
+static uint64_t kll_random(KllSketch *sketch) {
+    uint64_t x = sketch->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    sketch->rng = x;
+    return x;
+}
+
+/* 第 h 层容量：最高层为 k，往下每层乘以 2/3，至少为 KLL_MIN_WIDTH */
+static uint32_t kll_capacity(const KllSketch *sketch, uint32_t h) {
+    double cap = KLL_K;
+    for (uint32_t depth = sketch->nlevels - h - 1; depth > 0; depth--) {
+        cap = cap * 2.0 / 3.0;
+    }
+    uint32_t c = (uint32_t)cap;
+    if ((double)c < cap) {
+        c++;
+    }
+    return c < KLL_MIN_WIDTH ? KLL_MIN_WIDTH : c;
+}
+
+static void kll_update_max_size(KllSketch *sketch) {
+    uint32_t total = 0;
+    for (uint32_t h = 0; h < sketch->nlevels; h++) {
+        total += kll_capacity(sketch, h);
+    }
+    sketch->max_size = total;
+}
+
+static bool kll_grow(KllSketch *sketch) {
+    if (sketch->nlevels == KLL_MAX_LEVELS) {
+        return false;
+    }
+    sketch->nlevels++;
+    kll_update_max_size(sketch);
+    return true;
+}
+
+static bool kll_push(KllLevel *level, double value) {
+    if (level->len == level->cap) {
+        uint32_t cap = level->cap > 0 ? level->cap * 2 : 16;
+        double *items = realloc(level->items, sizeof(double) * cap);
+        if (items == NULL) {
+            return false;
+        }
+        level->items = items;
+        level->cap = cap;
+    }
+    level->items[level->len++] = value;
+    return true;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* 小数组插入排序 */
+static void insertion_sort(double *a, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        double v = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] > v) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = v;
+    }
+}
+
+/* 升序排序 double 数组：快速排序（三数取中），只递归较小的一侧 */
+static void sort_doubles(double *a, size_t n) {
+    while (n > 16) {
+        double x = a[0], y = a[n / 2], z = a[n - 1];
+        double pivot = (x < y) ? ((y < z) ? y : (x < z ? z : x))
+                               : ((x < z) ? x : (y < z ? z : y));
+        size_t i = 0, j = n - 1;
+        while (1) {
+            while (a[i] < pivot) {
+                i++;
+            }
+            while (a[j] > pivot) {
+                j--;
+            }
+            if (i >= j) {
+                break;
+            }
+            double t = a[i];
+            a[i++] = a[j];
+            a[j--] = t;
+        }
+        /* [0, j] <= pivot <= [j + 1, n) */
+        if (j + 1 < n - j - 1) {
+            sort_doubles(a, j + 1);
+            a += j + 1;
+            n -= j + 1;
+        } else {
+            sort_doubles(a + j + 1, n - j - 1);
+            n = j + 1;
+        }
+    }
+    insertion_sort(a, n);
+}
+
+/* 把第 h 层压缩进第 h + 1 层：排序后随机保留一半，元素个数为奇数时留下一个 */
+static bool kll_compact(KllSketch *sketch, uint32_t h) {
+    KllLevel *level = &sketch->levels[h];
+    KllLevel *upper = &sketch->levels[h + 1];
+    sort_doubles(level->items, level->len);
+
+    uint32_t pairs = level->len / 2;
+    uint32_t offset = (uint32_t)(kll_random(sketch) & 1);
+    for (uint32_t i = 0; i < pairs; i++) {
+        if (!kll_push(upper, level->items[2 * i + offset])) {
+            return false;
+        }
+    }
+    if (level->len % 2) {
+        level->items[0] = level->items[level->len - 1];
+        level->len = 1;
+    } else {
+        level->len = 0;
+    }
+    sketch->size -= pairs;
+    return true;
+}
+
+/* 从低层开始压缩超出容量的层，直到总数回到容量之内 */
+static bool kll_compress(KllSketch *sketch) {
+    for (uint32_t h = 0; h < sketch->nlevels && sketch->size >= sketch->max_size; h++) {
+        if (sketch->levels[h].len < kll_capacity(sketch, h)) {
+            continue;
+        }
+        if (h + 1 == sketch->nlevels && !kll_grow(sketch)) {
+            return false;
+        }
+        if (!kll_compact(sketch, h)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void kll_init(KllSketch *sketch) {
+    memset(sketch, 0, sizeof(KllSketch));
+    sketch->nlevels = 1;
+    sketch->rng = 0x9E3779B97F4A7C15ULL;
+    kll_update_max_size(sketch);
+}
+
+void kll_free(KllSketch *sketch) {
+    for (uint32_t h = 0; h < KLL_MAX_LEVELS; h++) {
+        free(sketch->levels[h].items);
+    }
+    kll_init(sketch);
+}
+
+void kll_clear(KllSketch *sketch) {
+    for (uint32_t h = 0; h < KLL_MAX_LEVELS; h++) {
+        sketch->levels[h].len = 0;
+    }
+    sketch->nlevels = 1;
+    sketch->size = 0;
+    sketch->n = 0;
+    kll_update_max_size(sketch);
+}
+
+bool kll_update(KllSketch *sketch, double value) {
+    if (!kll_push(&sketch->levels[0], value)) {
+        return false;
+    }
+    if (sketch->n == 0 || value < sketch->min) {
+        sketch->min = value;
+    }
+    if (sketch->n == 0 || value > sketch->max) {
+        sketch->max = value;
+    }
+    sketch->n++;
+    sketch->size++;
+    return sketch->size < sketch->max_size || kll_compress(sketch);
+}
+
+/*
+ * kll_merge - 合并两个草图
+ * 同一层的元素权重相同，逐层拼接后再按容量压缩；
+ * 合并结果的误差界与直接插入全部数据相同
+ */
+bool kll_merge(KllSketch *dst, const KllSketch *src) {
+    if (src->n == 0) {
+        return true;
+    }
+    while (dst->nlevels < src->nlevels) {
+        if (!kll_grow(dst)) {
+            return false;
+        }
+    }
+    for (uint32_t h = 0; h < src->nlevels; h++) {
+        const KllLevel *level = &src->levels[h];
+        for (uint32_t i = 0; i < level->len; i++) {
+            if (!kll_push(&dst->levels[h], level->items[i])) {
+                return false;
+            }
+        }
+        dst->size += level->len;
+    }
+    if (dst->n == 0 || src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (dst->n == 0 || src->max > dst->max) {
+        dst->max = src->max;
+    }
+    dst->n += src->n;
+    while (dst->size >= dst->max_size) {
+        if (!kll_compress(dst)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 带权重的样本，用于查询 */
+typedef struct KllSample {
+    double value;
+    uint64_t weight;
+} KllSample;
+
+static int compare_sample(const void *a, const void *b) {
+    return compare_double(&((const KllSample *)a)->value, &((const KllSample *)b)->value);
+}
+
+/* 最近秩法的目标秩（从 1 开始） */
+static uint64_t quantile_rank(double q, uint64_t n) {
+    if (q <= 0.0) {
+        return 1;
+    }
+    double target = q * (double)n;
+    uint64_t rank = (uint64_t)target;
+    if ((double)rank < target) {
+        rank++;
+    }
+    if (rank < 1) {
+        rank = 1;
+    }
+    return rank > n ? n : rank;
+}
+
+/*
+ * kll_quantiles - 近似分位数
+ * 保留的元素按值排序并累加权重，取累计权重首次达到目标秩的值；
+ * q = 0 和 q = 1 返回精确的最小、最大值
+ * 返回值：false 表示草图为空或内存不足
+ */
+bool kll_quantiles(const KllSketch *sketch, const double *qs, int nq, double *out) {
+    if (sketch->n == 0) {
+        return false;
+    }
+    KllSample *samples = malloc(sizeof(KllSample) * sketch->size);
+    if (samples == NULL) {
+        return false;
+    }
+    uint32_t m = 0;
+    for (uint32_t h = 0; h < sketch->nlevels; h++) {
+        const KllLevel *level = &sketch->levels[h];
+        for (uint32_t i = 0; i < level->len; i++) {
+            samples[m].value = level->items[i];
+            samples[m].weight = 1ULL << h;
+            m++;
+        }
+    }
+    qsort(samples, m, sizeof(KllSample), compare_sample);
+
+    for (int j = 0; j < nq; j++) {
+        if (qs[j] <= 0.0) {
+            out[j] = sketch->min;
+            continue;
+        }
+        if (qs[j] >= 1.0) {
+            out[j] = sketch->max;
+            continue;
+        }
+        uint64_t rank = quantile_rank(qs[j], sketch->n);
+        uint64_t cumulative = 0;
+        out[j] = sketch->max;
+        for (uint32_t i = 0; i < m; i++) {
+            cumulative += samples[i].weight;
+            if (cumulative >= rank) {
+                out[j] = samples[i].value;
+                break;
+            }
+        }
+    }
+    free(samples);
+    return true;
+}
+
+/*
+ * kll_rank - 近似秩：估计不超过 value 的值所占的比例
+ * 不需要排序，直接累加各层中 <= value 的元素权重
+ * 返回值：[0, 1]，草图为空时返回 0
+ */
+double kll_rank(const KllSketch *sketch, double value) {
+    if (sketch->n == 0 || value < sketch->min) {
+        return 0.0;
+    }
+    if (value >= sketch->max) {
+        return 1.0;
+    }
+    uint64_t weight = 0;
+    for (uint32_t h = 0; h < sketch->nlevels; h++) {
+        const KllLevel *level = &sketch->levels[h];
+        for (uint32_t i = 0; i < level->len; i++) {
+            if (level->items[i] <= value) {
+                weight += 1ULL << h;
+            }
+        }
+    }
+    double rank = (double)weight / (double)sketch->n;
+    return rank > 1.0 ? 1.0 : rank;
+}
+
+size_t kll_memory(const KllSketch *sketch) {
+    size_t bytes = 0;
+    for (uint32_t h = 0; h < KLL_MAX_LEVELS; h++) {
+        bytes += sketch->levels[h].cap * sizeof(double);
+    }
+    return bytes;
+}
+
+static inline void swap_double(double *a, double *b) {
+    double t = *a;
+    *a = *b;
+    *b = t;
+}
+
+/*
+ * select_kth - 把第 k 小（从 0 开始）的值放到 values[k]
+ * 三数取中选枢轴，三路划分（成绩、年龄重复值很多），
+ * 只在包含 k 的一侧继续，期望 O(n)
+ */
+static void select_kth(double *values, size_t lo, size_t hi, size_t k) {
+    while (hi - lo > 16) {
+        size_t mid = lo + (hi - lo) / 2;
+        double a = values[lo], b = values[mid], c = values[hi - 1];
+        double pivot = (a < b) ? ((b < c) ? b : (a < c ? c : a))
+                               : ((a < c) ? a : (b < c ? c : b));
+
+        /* [lo, lt) < pivot，[lt, i) == pivot，[gt, hi) > pivot */
+        size_t lt = lo, i = lo, gt = hi;
+        while (i < gt) {
+            if (values[i] < pivot) {
+                swap_double(&values[lt++], &values[i++]);
+            } else if (values[i] > pivot) {
+                swap_double(&values[i], &values[--gt]);
+            } else {
+                i++;
+            }
+        }
+        if (k < lt) {
+            hi = lt;
+        } else if (k >= gt) {
+            lo = gt;
+        } else {
+            return;
+        }
+    }
+    /* 小区间直接插入排序 */
+    for (size_t i = lo + 1; i < hi; i++) {
+        double v = values[i];
+        size_t j = i;
+        while (j > lo && values[j - 1] > v) {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = v;
+    }
+}
+
+/*
+ * quantile_exact - 精确分位数
+ * 按目标秩从小到大依次选择，每次只在上一个结果之后的区间内继续，
+ * 总时间期望 O(n)，不需要完整排序
+ */
+void quantile_exact(double *values, size_t n, const double *qs, int nq, double *out) {
+    if (n == 0 || nq <= 0) {
+        return;
+    }
+
+    /* 目标下标按大小排序（nq 很小，插入排序即可） */
+    int order[nq];
+    size_t index[nq];
+    for (int j = 0; j < nq; j++) {
+        index[j] = (size_t)quantile_rank(qs[j], n) - 1;
+        int pos = j;
+        while (pos > 0 && index[order[pos - 1]] > index[j]) {
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        order[pos] = j;
+    }
+
+    size_t lo = 0;
+    for (int t = 0; t < nq; t++) {
+        size_t k = index[order[t]];
+        if (k >= lo) {
+            select_kth(values, lo, n, k);
+            lo = k + 1;
+        }
+        out[order[t]] = values[k];
+    }
+}
+
+/*
+ * quantile_histogram - 由计数直方图求精确分位数
+ * hist[v] 为取值 v 的个数；直方图为空时结果为 0
+ */
+void quantile_histogram(const uint32_t *hist, int nbins, const double *qs, int nq, int *out) {
+    uint64_t total = 0;
+    for (int v = 0; v < nbins; v++) {
+        total += hist[v];
+    }
+    for (int j = 0; j < nq; j++) {
+        out[j] = 0;
+        if (total == 0) {
+            continue;
+        }
+        uint64_t rank = quantile_rank(qs[j], total);
+        uint64_t cumulative = 0;
+        for (int v = 0; v < nbins; v++) {
+            cumulative += hist[v];
+            if (cumulative >= rank) {
+                out[j] = v;
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ * quantile.h - MiniDB 分位数头文件
+ * 近似：KLL 分位数草图，插入时增量维护，内存 O(k)，可合并；
+ * 精确：线性时间选择（快速选择），按需对数值副本计算；
+ * 取值范围很小的整数（年龄）直接用计数直方图，精确且支持删除
+ */
+
+#ifndef QUANTILE_H
+#define QUANTILE_H
+
+#include "config.h"
+#include <stddef.h>
+
+#define KLL_K           200     // 草图精度参数：最高层压缩器容量
+#define KLL_MAX_LEVELS  40      // 最多层数（第 h 层每个元素代表 2^h 个原始值）
+#define KLL_RANK_ERROR  0.0133  // k=200 时单个分位数的归一化排名误差（99% 置信度）
+
+/*
+ * 压缩器：同一层的元素，权重相同
+ */
+typedef struct KllLevel {
+    double *items;
+    uint32_t len;
+    uint32_t cap;
+} KllLevel;
+
+/*
+ * KLL 草图
+ * 第 0 层接收新值；某层超过容量时排序后随机保留奇数位或偶数位元素，
+ * 升入上一层（权重翻倍）。越低的层容量越小（按 2/3 递减），
+ * 总保留元素数约为 3k，与数据量无关
+ */
+typedef struct KllSketch {
+    KllLevel levels[KLL_MAX_LEVELS];
+    uint32_t nlevels;       // 当前层数
+    uint32_t size;          // 所有层的元素总数
+    uint32_t max_size;      // 所有层的容量之和，超过时压缩
+    uint64_t n;             // 已插入的值个数
+    double min;             // 精确最小值
+    double max;             // 精确最大值
+    uint64_t rng;           // 压缩时使用的随机数状态
+} KllSketch;
+
+void kll_init(KllSketch *sketch);                                  // 初始化空草图
+void kll_free(KllSketch *sketch);                                  // 释放内存
+void kll_clear(KllSketch *sketch);                                 // 清空（保留已分配内存）
+bool kll_update(KllSketch *sketch, double value);                  // 插入一个值，内存不足返回 false
+bool kll_merge(KllSketch *dst, const KllSketch *src);              // 把 src 合并进 dst
+bool kll_quantiles(const KllSketch *sketch, const double *qs, int nq, double *out);  // 近似分位数，qs 取值 [0, 1]
+double kll_rank(const KllSketch *sketch, double value);            // 近似秩：<= value 的值所占比例
+size_t kll_memory(const KllSketch *sketch);                        // 草图保留元素占用的字节数
+
+void quantile_exact(double *values, size_t n, const double *qs, int nq, double *out);  // 精确分位数（会重排 values）
+void quantile_histogram(const uint32_t *hist, int nbins, const double *qs, int nq, int *out);  // 直方图精确分位数
+
+#endif /* QUANTILE_H */
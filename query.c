@@ -0,0 +1,837 @@
+/*
+ * query.c - MiniDB 组合条件查询实现
+ * 规划：为每条可用的访问路径估计候选行数和代价（约等于要检查的行数），
+ *   年龄用直方图精确计数，成绩用 KLL 草图估计秩，标志用位图计数，
+ *   姓名在 n-gram 索引已建立时直接数出匹配姓名的行数；
+ *   尚未建立的索引把建索引的代价按 QUERY_INDEX_REUSE 次查询分摊；
+ * 执行：从选中的路径取候选行，逐行检查全部谓词，最后按 ID 排序
+ */
+
+#include "query.h"
+#include "filter.h"
+#include "output.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <time.h>
+
+/*
+ * 代价常数：以"按下标检查一个候选行"为 1（实测 10M 行时约 35 ns，主要是缓存缺失），
+ * 其余按 x86-64、-O2 下的实测时间折算
+ */
+#define QUERY_SCAN_COST         0.1    // 全表扫描每行（批量过滤，约 3 ns）
+#define QUERY_NAME_CHECK_COST   1.0    // 对一行做姓名子串匹配
+#define QUERY_BITMAP_COST       0.03   // 位图运算每行
+#define QUERY_AGE_BUILD_COST    0.2    // 建年龄索引每行（计数排序）
+#define QUERY_SCORE_BUILD_COST  0.3    // 建成绩索引每行（查网格定位桶、分散写入）
+#define QUERY_NAME_BUILD_COST   1.3    // 建姓名索引每行（拆 n-gram、排序倒排表）
+#define QUERY_NAME_SELECTIVITY  0.05   // 姓名索引未建立时假设的匹配比例
+
+/*
+ * 行下标数组（按需扩容）
+ */
+typedef struct RowVec {
+    uint32_t *rows;
+    size_t n;
+    size_t cap;
+} RowVec;
+
+static bool rowvec_push(RowVec *vec, uint32_t row) {
+    if (vec->n == vec->cap) {
+        size_t cap = vec->cap > 0 ? vec->cap * 2 : 256;
+        uint32_t *rows = realloc(vec->rows, sizeof(uint32_t) * cap);
+        if (rows == NULL) {
+            return false;
+        }
+        vec->rows = rows;
+        vec->cap = cap;
+    }
+    vec->rows[vec->n++] = row;
+    return true;
+}
+
+static bool rowvec_append(RowVec *vec, const uint32_t *rows, size_t n) {
+    if (n == 0) {
+        return true;
+    }
+    if (vec->n + n > vec->cap) {
+        size_t cap = vec->cap > 0 ? vec->cap : 256;
+        while (cap < vec->n + n) {
+            cap *= 2;
+        }
+        uint32_t *grown = realloc(vec->rows, sizeof(uint32_t) * cap);
+        if (grown == NULL) {
+            return false;
+        }
+        vec->rows = grown;
+        vec->cap = cap;
+    }
+    memcpy(vec->rows + vec->n, rows, sizeof(uint32_t) * n);
+    vec->n += n;
+    return true;
+}
+
+void query_init(Query *q) {
+    q->id = 0;
+    q->name_like = NULL;
+    q->age_min = 0;
+    q->age_max = 0;
+    q->has_score = false;
+    q->score_min = 0.0;
+    q->score_max = 0.0;
+    q->flags_set = 0;
+    q->flags_clear = 0;
+}
+
+const char *query_path_name(AccessPath path) {
+    switch (path) {
+        case PATH_ID:          return "ID 索引";
+        case PATH_AGE_RANGE:   return "年龄范围索引";
+        case PATH_SCORE_RANGE: return "成绩范围索引";
+        case PATH_NAME_GRAM:   return "姓名 n-gram 索引";
+        case PATH_FLAGS:       return "标志位图";
+        case PATH_SCAN:        return "全表扫描";
+    }
+    return "未知";
+}
+
+/*
+ * query_match - 检查一行是否满足全部谓词（墓碑行总是不满足）
+ * 便宜的数值比较在前，姓名子串匹配放在最后
+ */
+bool query_match(const Database *db, const Query *q, uint32_t row) {
+    const Record *r = &db->rows[row];
+    return query_match_record(q, r, db_name(db, r));
+}
+
+bool query_match_record(const Query *q, const Record *r, const char *name) {
+    if (db_is_dead(r)) {
+        return false;
+    }
+    if (q->id > 0 && r->id != q->id) {
+        return false;
+    }
+    if ((q->age_min > 0 && r->age < q->age_min) || (q->age_max > 0 && r->age > q->age_max)) {
+        return false;
+    }
+    if (q->has_score && !(r->score >= q->score_min && r->score <= q->score_max)) {
+        return false;
+    }
+    if ((r->flags & q->flags_set) != q->flags_set || (r->flags & q->flags_clear) != 0) {
+        return false;
+    }
+    return q->name_like == NULL || strstr(name, q->name_like) != NULL;
+}
+
+/*
+ * ==================== 索引缓存 ====================
+ */
+
+void query_cache_free(QueryCache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    free(cache->age_rows);
+    free(cache->score_rows);
+    free(cache->name_offs);
+    free(cache->name_row_start);
+    free(cache->name_rows);
+    free(cache->gram_codes);
+    free(cache->gram_start);
+    free(cache->gram_names);
+    free(cache);
+}
+
+/* 取数据库的索引缓存，第一次使用时分配 */
+static QueryCache *query_cache(Database *db) {
+    if (db->qcache == NULL) {
+        db->qcache = calloc(1, sizeof(QueryCache));
+    }
+    return db->qcache;
+}
+
+/* 索引是否可用：行下标未变，且建索引之后追加的尾部行不超过 1/QUERY_INDEX_REUSE */
+static bool index_fresh(const Database *db, uint32_t version, uint32_t built) {
+    uint32_t count = (uint32_t)db->count;
+    return version == db->row_version && built <= count &&
+           (uint64_t)(count - built) * QUERY_INDEX_REUSE <= built;
+}
+
+/*
+ * build_age_index - 按年龄计数排序行下标，O(n)
+ * 桶边界由一次计数得出，每个桶内行下标保持升序
+ */
+static bool build_age_index(Database *db, QueryCache *cache) {
+    uint32_t n = (uint32_t)db->count;
+    uint32_t *rows = malloc(sizeof(uint32_t) * (n > 0 ? n : 1));
+    if (rows == NULL) {
+        return false;
+    }
+    uint32_t pos[257] = {0};
+    for (uint32_t i = 0; i < n; i++) {
+        pos[db->rows[i].age + 1]++;
+    }
+    for (int a = 0; a < 256; a++) {
+        pos[a + 1] += pos[a];
+    }
+    memcpy(cache->age_start, pos, sizeof(pos));
+    for (uint32_t i = 0; i < n; i++) {
+        rows[pos[db->rows[i].age]++] = i;
+    }
+    free(cache->age_rows);
+    cache->age_rows = rows;
+    cache->age_built = n;
+    cache->age_version = db->row_version;
+    return true;
+}
+
+/* 分界点中小于 score 的个数：二分查找，只在建网格时使用 */
+static uint32_t score_bucket_search(const QueryCache *cache, double score) {
+    uint32_t lo = 0, hi = QUERY_SCORE_BUCKETS - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (cache->score_bounds[mid] < score) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * score_bucket - 行的成绩落在哪个桶：分界点中小于 score 的个数
+ * 先按 [最小值, 最大值] 的等宽网格查表得到附近的桶，再向前后各至多挪几步；
+ * 逐行二分查找是一串相互依赖的访存，10M 行要多花约 1 秒
+ */
+static inline uint32_t score_bucket(const QueryCache *cache, double score) {
+    if (!(score > cache->score_lo)) {
+        return 0;  /* 分界点都不小于最小值 */
+    }
+    double cell = (score - cache->score_lo) * cache->score_scale;
+    uint32_t b = cache->score_grid[cell < QUERY_SCORE_GRID - 1 ? (uint32_t)cell : QUERY_SCORE_GRID - 1];
+    while (b < QUERY_SCORE_BUCKETS - 1 && cache->score_bounds[b] < score) {
+        b++;
+    }
+    while (b > 0 && !(cache->score_bounds[b - 1] < score)) {
+        b--;
+    }
+    return b;
+}
+
+/*
+ * build_score_index - 按成绩分桶的行下标，O(n log B)
+ * 分界点取 KLL 草图的等分位数，每桶约 n/B 行（等深直方图），
+ * n 较小时草图保留全部值，分界点即精确分位数；
+ * 桶内不排序；范围查询只需检查区间两端各一个桶内的多余行
+ */
+static bool build_score_index(Database *db, QueryCache *cache) {
+    uint32_t n = (uint32_t)db->count;
+    double qs[QUERY_SCORE_BUCKETS - 1];
+    for (int i = 0; i < QUERY_SCORE_BUCKETS - 1; i++) {
+        qs[i] = (double)(i + 1) / QUERY_SCORE_BUCKETS;
+    }
+    uint32_t *rows = malloc(sizeof(uint32_t) * (n > 0 ? n : 1));
+    uint32_t *buckets = malloc(sizeof(uint32_t) * (n > 0 ? n : 1));
+    if (rows == NULL || buckets == NULL ||
+        (n > 0 && !kll_quantiles(&db->score_sketch, qs, QUERY_SCORE_BUCKETS - 1, cache->score_bounds))) {
+        free(rows);
+        free(buckets);
+        return false;
+    }
+
+    /* 网格第 c 格记录其左端点所在的桶 */
+    double lo = db->score_sketch.min, hi = db->score_sketch.max;
+    cache->score_lo = lo;
+    cache->score_scale = hi > lo ? QUERY_SCORE_GRID / (hi - lo) : 0.0;
+    for (uint32_t c = 0; c < QUERY_SCORE_GRID; c++) {
+        double edge = lo + (hi - lo) * c / QUERY_SCORE_GRID;
+        cache->score_grid[c] = (uint16_t)score_bucket_search(cache, edge);
+    }
+
+    uint32_t pos[QUERY_SCORE_BUCKETS + 1] = {0};
+    for (uint32_t i = 0; i < n; i++) {
+        buckets[i] = score_bucket(cache, db->rows[i].score);
+        pos[buckets[i] + 1]++;
+    }
+    for (int b = 0; b < QUERY_SCORE_BUCKETS; b++) {
+        pos[b + 1] += pos[b];
+    }
+    memcpy(cache->score_start, pos, sizeof(pos));
+    for (uint32_t i = 0; i < n; i++) {
+        rows[pos[buckets[i]]++] = i;
+    }
+    free(buckets);
+    free(cache->score_rows);
+    cache->score_rows = rows;
+    cache->score_built = n;
+    cache->score_version = db->row_version;
+    return true;
+}
+
+/* n-gram 编码：QUERY_GRAM_LEN 个字节拼成一个整数 */
+static inline uint32_t gram_code(const char *s) {
+    uint32_t code = 0;
+    for (int i = 0; i < QUERY_GRAM_LEN; i++) {
+        code = (code << 8) | (unsigned char)s[i];
+    }
+    return code;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* 在升序数组中二分查找，未找到返回 count */
+static uint32_t find_u32(const uint32_t *a, uint32_t count, uint32_t value) {
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (a[mid] < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < count && a[lo] == value ? lo : count;
+}
+
+/*
+ * radix_sort_pairs - 按高 32 位的 n-gram 编码排序 (编码, 姓名编号) 对
+ * 编码只有 8 * QUERY_GRAM_LEN 位，按 12 位一趟做两趟 LSD 基数排序；
+ * 基数排序是稳定的，输入已按姓名编号升序，输出同一编码内仍然升序
+ */
+static bool radix_sort_pairs(uint64_t *pairs, size_t n) {
+    uint64_t *tmp = malloc(sizeof(uint64_t) * (n > 0 ? n : 1));
+    if (tmp == NULL) {
+        return false;
+    }
+    uint64_t *src = pairs, *dst = tmp;
+    for (int shift = 32; shift < 32 + 8 * QUERY_GRAM_LEN; shift += 12) {
+        size_t pos[4096] = {0};
+        for (size_t i = 0; i < n; i++) {
+            pos[(src[i] >> shift) & 4095]++;
+        }
+        size_t sum = 0;
+        for (int b = 0; b < 4096; b++) {
+            size_t c = pos[b];
+            pos[b] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            dst[pos[(src[i] >> shift) & 4095]++] = src[i];
+        }
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != pairs) {
+        memcpy(pairs, src, sizeof(uint64_t) * n);
+    }
+    free(tmp);
+    return true;
+}
+
+/*
+ * build_gram_index - 建立姓名 n-gram 倒排索引
+ * 姓名已在字符串堆中去重，索引建在不同的姓名上而不是每一行上：
+ *   1. 顺序遍历字符串堆，给每个姓名编号（偏移 0 的空字符串为 0 号）；
+ *   2. 按姓名编号对行下标计数排序（name_rows）；
+ *   3. 每个姓名取出全部 n-gram，(编码, 姓名编号) 排序后压成倒排表
+ */
+static bool build_gram_index(Database *db, QueryCache *cache) {
+    const StrHeap *heap = &db->name_heap;
+    uint32_t n = (uint32_t)db->count;
+    uint32_t nnames = 0;
+    size_t npairs = 0;
+    for (size_t off = 0; off < heap->used; off += strlen(heap->data + off) + 1) {
+        size_t len = strlen(heap->data + off);
+        nnames++;
+        if (len >= QUERY_GRAM_LEN) {
+            npairs += len - QUERY_GRAM_LEN + 1;
+        }
+    }
+
+    uint32_t *name_offs = malloc(sizeof(uint32_t) * (nnames + 1));
+    uint32_t *id_of = malloc(sizeof(uint32_t) * heap->used);  /* 堆偏移 -> 姓名编号 */
+    uint32_t *row_start = calloc(nnames + 2, sizeof(uint32_t));
+    uint32_t *name_rows = malloc(sizeof(uint32_t) * (n > 0 ? n : 1));
+    uint64_t *pairs = malloc(sizeof(uint64_t) * (npairs + 1));
+    if (name_offs == NULL || id_of == NULL || row_start == NULL || name_rows == NULL || pairs == NULL) {
+        free(name_offs);
+        free(id_of);
+        free(row_start);
+        free(name_rows);
+        free(pairs);
+        return false;
+    }
+
+    uint32_t id = 0;
+    npairs = 0;
+    for (size_t off = 0; off < heap->used; ) {
+        const char *s = heap->data + off;
+        size_t len = strlen(s);
+        name_offs[id] = (uint32_t)off;
+        id_of[off] = id;
+        size_t first = npairs;
+        for (size_t i = 0; i + QUERY_GRAM_LEN <= len; i++) {
+            /* 同一姓名内重复的 n-gram 只记一次 */
+            uint32_t code = gram_code(s + i);
+            size_t k = first;
+            while (k < npairs && (uint32_t)(pairs[k] >> 32) != code) {
+                k++;
+            }
+            if (k == npairs) {
+                pairs[npairs++] = ((uint64_t)code << 32) | id;
+            }
+        }
+        id++;
+        off += len + 1;
+    }
+
+    /* 按姓名编号计数排序行下标 */
+    for (uint32_t i = 0; i < n; i++) {
+        row_start[id_of[db->names[i].off] + 2]++;
+    }
+    for (uint32_t i = 0; i < nnames; i++) {
+        row_start[i + 2] += row_start[i + 1];
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        name_rows[row_start[id_of[db->names[i].off] + 1]++] = i;
+    }
+    free(id_of);
+
+    /* (编码, 姓名编号) 升序，同一编码的姓名编号连续且升序 */
+    if (!radix_sort_pairs(pairs, npairs)) {
+        free(name_offs);
+        free(row_start);
+        free(name_rows);
+        free(pairs);
+        return false;
+    }
+    uint32_t ngrams = 0;
+    for (size_t i = 0; i < npairs; i++) {
+        if (i == 0 || (pairs[i] >> 32) != (pairs[i - 1] >> 32)) {
+            ngrams++;
+        }
+    }
+    uint32_t *codes = malloc(sizeof(uint32_t) * (ngrams + 1));
+    uint32_t *gram_start = malloc(sizeof(uint32_t) * (ngrams + 1));
+    uint32_t *gram_names = malloc(sizeof(uint32_t) * (npairs + 1));
+    if (codes == NULL || gram_start == NULL || gram_names == NULL) {
+        free(codes);
+        free(gram_start);
+        free(gram_names);
+        free(name_offs);
+        free(row_start);
+        free(name_rows);
+        free(pairs);
+        return false;
+    }
+    uint32_t g = 0;
+    for (size_t i = 0; i < npairs; i++) {
+        uint32_t code = (uint32_t)(pairs[i] >> 32);
+        if (i == 0 || code != codes[g - 1]) {
+            codes[g] = code;
+            gram_start[g] = (uint32_t)i;
+            g++;
+        }
+        gram_names[i] = (uint32_t)pairs[i];
+    }
+    gram_start[ngrams] = (uint32_t)npairs;
+    free(pairs);
+
+    free(cache->name_offs);
+    free(cache->name_row_start);
+    free(cache->name_rows);
+    free(cache->gram_codes);
+    free(cache->gram_start);
+    free(cache->gram_names);
+    cache->nnames = nnames;
+    cache->name_offs = name_offs;
+    cache->name_row_start = row_start;  /* 计数排序后 row_start[i] 为第 i 个姓名的起点 */
+    cache->name_rows = name_rows;
+    cache->ngrams = ngrams;
+    cache->gram_codes = codes;
+    cache->gram_start = gram_start;
+    cache->gram_names = gram_names;
+    cache->gram_built = n;
+    cache->gram_version = db->row_version;
+    return true;
+}
+
+/*
+ * gram_candidates - 用 n-gram 倒排表缩小候选姓名范围
+ * 关键字的每个 n-gram 都必须出现在姓名中，取其中最短的倒排表；
+ * 关键字短于 n 时所有姓名都是候选
+ * 返回值：候选姓名个数；*names 为 NULL 表示候选为全部姓名
+ */
+static uint32_t gram_candidates(const QueryCache *cache, const char *keyword, const uint32_t **names) {
+    size_t len = strlen(keyword);
+    *names = NULL;
+    if (len < QUERY_GRAM_LEN) {
+        return cache->nnames;
+    }
+    uint32_t best = UINT32_MAX;
+    for (size_t i = 0; i + QUERY_GRAM_LEN <= len; i++) {
+        uint32_t g = find_u32(cache->gram_codes, cache->ngrams, gram_code(keyword + i));
+        if (g == cache->ngrams) {
+            return 0;  /* 某个 n-gram 在任何姓名中都没有出现 */
+        }
+        uint32_t postings = cache->gram_start[g + 1] - cache->gram_start[g];
+        if (postings < best) {
+            best = postings;
+            *names = cache->gram_names + cache->gram_start[g];
+        }
+    }
+    return best;
+}
+
+/* 候选姓名中第 i 个的编号 */
+static inline uint32_t candidate_name(const uint32_t *names, uint32_t i) {
+    return names != NULL ? names[i] : i;
+}
+
+/* 候选姓名是否真正包含关键字 */
+static inline bool name_contains(const Database *db, const QueryCache *cache, uint32_t name, const char *keyword) {
+    return strstr(db->name_heap.data + cache->name_offs[name], keyword) != NULL;
+}
+
+/*
+ * ==================== 规划 ====================
+ */
+
+/* 用候选路径更新当前最优计划 */
+static void plan_consider(QueryPlan *best, AccessPath path, double est_rows, double cost, bool build) {
+    if (cost < best->cost) {
+        best->path = path;
+        best->est_rows = est_rows;
+        best->cost = cost;
+        best->build_index = build;
+    }
+}
+
+/*
+ * query_plan - 为查询选出代价最小的访问路径
+ * 代价 = 候选行数 + 定位开销 + 未建索引时分摊的建索引开销，
+ * 索引尾部（建索引后追加的行）要批量过滤，也计入代价；
+ * 全表扫描的代价最后计算：数值谓词的最小估计行数还要做姓名匹配
+ * 返回值：false 表示参数无效
+ */
+bool query_plan(Database *db, const Query *q, QueryPlan *plan) {
+    if (db == NULL || q == NULL || plan == NULL) {
+        return false;
+    }
+    double count = (double)db->count;
+    double live = (double)db_live_count(db);
+    const QueryCache *cache = db->qcache;
+
+    double survivors = live;  /* 批量过滤后仍需做姓名匹配的行数 */
+
+    plan->path = PATH_SCAN;
+    plan->est_rows = count;
+    plan->cost = DBL_MAX;
+    plan->build_index = false;
+
+    if (q->id > 0) {
+        plan_consider(plan, PATH_ID, 1.0, 1.0, false);
+        return true;
+    }
+
+    if (q->age_min > 0 || q->age_max > 0) {
+        int lo = q->age_min > 0 ? q->age_min : 0;
+        int hi = q->age_max > 0 && q->age_max < 255 ? q->age_max : 255;
+        double est = 0.0;
+        for (int a = lo; a <= hi; a++) {
+            est += db->age_hist[a];
+        }
+        /* 直方图只统计有效记录，索引中还有墓碑行，按比例放大 */
+        if (live > 0) {
+            est *= count / live;
+        }
+        survivors = est < survivors ? est : survivors;
+        bool fresh = cache != NULL && index_fresh(db, cache->age_version, cache->age_built);
+        double tail = fresh ? (count - cache->age_built) * QUERY_SCAN_COST : 0.0;
+        double build = fresh ? 0.0 : QUERY_AGE_BUILD_COST * count / QUERY_INDEX_REUSE;
+        plan_consider(plan, PATH_AGE_RANGE, est, est + tail + build, !fresh);
+    }
+
+    if (q->has_score) {
+        double est = 0.0;
+        if (db->score_sketch.n > 0 && q->score_min <= q->score_max) {
+            double frac = kll_rank(&db->score_sketch, q->score_max) - kll_rank(&db->score_sketch, q->score_min);
+            est = (frac > 0.0 ? frac : 0.0) * count + 1.0;
+        }
+        survivors = est < survivors ? est : survivors;
+        bool fresh = cache != NULL && index_fresh(db, cache->score_version, cache->score_built);
+        if (fresh) {
+            /* 索引已建立：候选行数就是覆盖区间的各桶行数之和 */
+            uint32_t lo = score_bucket(cache, q->score_min);
+            uint32_t hi = score_bucket(cache, q->score_max);
+            double rows = lo <= hi ? cache->score_start[hi + 1] - cache->score_start[lo] : 0.0;
+            double tail = (count - cache->score_built) * QUERY_SCAN_COST;
+            plan_consider(plan, PATH_SCORE_RANGE, est, rows + tail, false);
+        } else {
+            double build = QUERY_SCORE_BUILD_COST * count / QUERY_INDEX_REUSE;
+            plan_consider(plan, PATH_SCORE_RANGE, est, est + build, true);
+        }
+    }
+
+    if (q->name_like != NULL) {
+        bool fresh = cache != NULL && index_fresh(db, cache->gram_version, cache->gram_built);
+        if (fresh) {
+            /* 索引已建立：候选姓名很少，直接数出匹配姓名的行数 */
+            const uint32_t *names;
+            uint32_t ncand = gram_candidates(cache, q->name_like, &names);
+            double est = 0.0;
+            for (uint32_t i = 0; i < ncand; i++) {
+                uint32_t name = candidate_name(names, i);
+                if (name_contains(db, cache, name, q->name_like)) {
+                    est += cache->name_row_start[name + 1] - cache->name_row_start[name];
+                }
+            }
+            double tail = (count - cache->gram_built) * QUERY_SCAN_COST;
+            plan_consider(plan, PATH_NAME_GRAM, est, est + ncand * QUERY_NAME_CHECK_COST + tail, false);
+        } else {
+            double est = count * QUERY_NAME_SELECTIVITY;
+            double build = QUERY_NAME_BUILD_COST * count / QUERY_INDEX_REUSE;
+            plan_consider(plan, PATH_NAME_GRAM, est, est + build, true);
+        }
+    }
+
+    if (q->flags_set != 0 || q->flags_clear != 0) {
+        double est = (double)db_flag_count(db, q->flags_set, q->flags_clear);
+        survivors = est < survivors ? est : survivors;
+        plan_consider(plan, PATH_FLAGS, est, est + count * QUERY_BITMAP_COST, false);
+    }
+
+    double scan = count * QUERY_SCAN_COST;
+    if (q->name_like != NULL) {
+        scan += survivors * QUERY_NAME_CHECK_COST;
+    }
+    plan_consider(plan, PATH_SCAN, count, scan, false);
+    return true;
+}
+
+/*
+ * ==================== 执行 ====================
+ */
+
+/* 检查一批行下标，满足条件的追加到结果 */
+static bool collect_rows(const Database *db, const Query *q, const uint32_t *rows, size_t n, RowVec *out) {
+    for (size_t i = 0; i < n; i++) {
+        if (query_match(db, q, rows[i]) && !rowvec_push(out, rows[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 检查行区间 [from, to)：按批过滤，整批追加幸存行 */
+static bool collect_range(const Database *db, const Query *q, uint32_t from, uint32_t to, RowVec *out) {
+    uint32_t sel[FILTER_BATCH];
+    for (uint32_t row = from; row < to; row += FILTER_BATCH) {
+        uint32_t n = to - row < FILTER_BATCH ? to - row : FILTER_BATCH;
+        size_t k = filter_batch(db, q, row, n, sel);
+        if (!rowvec_append(out, sel, k)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 按选中的访问路径取候选行并过滤 */
+static bool execute_plan(Database *db, const Query *q, const QueryPlan *plan, RowVec *out) {
+    QueryCache *cache = db->qcache;
+    uint32_t count = (uint32_t)db->count;
+
+    switch (plan->path) {
+        case PATH_ID: {
+            uint32_t row = idmap_get(&db->ids, q->id);
+            return row == IDMAP_NONE || collect_rows(db, q, &row, 1, out);
+        }
+        case PATH_AGE_RANGE: {
+            int lo = q->age_min > 0 ? q->age_min : 0;
+            int hi = q->age_max > 0 && q->age_max < 255 ? q->age_max : 255;
+            if (lo <= hi) {
+                uint32_t from = cache->age_start[lo];
+                uint32_t to = cache->age_start[hi + 1];
+                if (!collect_rows(db, q, cache->age_rows + from, to - from, out)) {
+                    return false;
+                }
+            }
+            return collect_range(db, q, cache->age_built, count, out);
+        }
+        case PATH_SCORE_RANGE: {
+            uint32_t lo = score_bucket(cache, q->score_min);
+            uint32_t hi = score_bucket(cache, q->score_max);
+            if (lo <= hi) {
+                uint32_t from = cache->score_start[lo];
+                uint32_t to = cache->score_start[hi + 1];
+                if (!collect_rows(db, q, cache->score_rows + from, to - from, out)) {
+                    return false;
+                }
+            }
+            return collect_range(db, q, cache->score_built, count, out);
+        }
+        case PATH_NAME_GRAM: {
+            const uint32_t *names;
+            uint32_t ncand = gram_candidates(cache, q->name_like, &names);
+            for (uint32_t i = 0; i < ncand; i++) {
+                uint32_t name = candidate_name(names, i);
+                if (!name_contains(db, cache, name, q->name_like)) {
+                    continue;
+                }
+                uint32_t from = cache->name_row_start[name];
+                uint32_t to = cache->name_row_start[name + 1];
+                if (!collect_rows(db, q, cache->name_rows + from, to - from, out)) {
+                    return false;
+                }
+            }
+            return collect_range(db, q, cache->gram_built, count, out);
+        }
+        case PATH_FLAGS: {
+            Bitmap bm;
+            bitmap_init(&bm);
+            if (!db_flag_select(db, q->flags_set, q->flags_clear, &bm)) {
+                bitmap_free(&bm);
+                return false;
+            }
+            BitmapIter it;
+            uint32_t row;
+            bool ok = true;
+            bitmap_iter_init(&it, &bm);
+            while (ok && bitmap_iter_next(&it, &row)) {
+                ok = collect_rows(db, q, &row, 1, out);
+            }
+            bitmap_free(&bm);
+            return ok;
+        }
+        case PATH_SCAN:
+            return collect_range(db, q, 0, count, out);
+    }
+    return false;
+}
+
+/* 按需建立计划所需的索引，失败时退回全表扫描 */
+static void prepare_index(Database *db, QueryPlan *plan) {
+    if (!plan->build_index) {
+        return;
+    }
+    QueryCache *cache = query_cache(db);
+    bool ok = cache != NULL;
+    if (ok && plan->path == PATH_AGE_RANGE) {
+        ok = build_age_index(db, cache);
+    } else if (ok && plan->path == PATH_SCORE_RANGE) {
+        ok = build_score_index(db, cache);
+    } else if (ok && plan->path == PATH_NAME_GRAM) {
+        ok = build_gram_index(db, cache);
+    }
+    if (!ok) {
+        printf("内存分配失败！改用全表扫描。\n");
+        plan->path = PATH_SCAN;
+        plan->est_rows = (double)db->count;
+        plan->cost = (double)db->count * QUERY_SCAN_COST;
+        plan->build_index = false;
+    }
+}
+
+/*
+ * 结果排序用：ID 在高 32 位，行下标在低 32 位
+ * （ID 为正数，按无符号比较顺序不变）
+ */
+static bool sort_by_id(const Database *db, RowVec *vec) {
+    bool sorted = true;
+    for (size_t i = 1; i < vec->n && sorted; i++) {
+        sorted = db->rows[vec->rows[i - 1]].id < db->rows[vec->rows[i]].id;
+    }
+    if (sorted) {
+        return true;  /* 扫描、位图路径按行下标输出，通常已经是 ID 顺序 */
+    }
+    uint64_t *keys = malloc(sizeof(uint64_t) * vec->n);
+    if (keys == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < vec->n; i++) {
+        keys[i] = ((uint64_t)(uint32_t)db->rows[vec->rows[i]].id << 32) | vec->rows[i];
+    }
+    qsort(keys, vec->n, sizeof(uint64_t), compare_u64);
+    for (size_t i = 0; i < vec->n; i++) {
+        vec->rows[i] = (uint32_t)keys[i];
+    }
+    free(keys);
+    return true;
+}
+
+/*
+ * query_run - 规划并执行查询
+ * 返回值：false 表示参数无效或内存不足（result 为空）
+ */
+bool query_run(Database *db, const Query *q, QueryResult *result) {
+    result->rows = NULL;
+    result->n = 0;
+    if (!query_plan(db, q, &result->plan)) {
+        return false;
+    }
+    prepare_index(db, &result->plan);
+
+    RowVec vec = {NULL, 0, 0};
+    if (!execute_plan(db, q, &result->plan, &vec) || !sort_by_id(db, &vec)) {
+        printf("内存分配失败！\n");
+        free(vec.rows);
+        return false;
+    }
+    result->rows = vec.rows;
+    result->n = vec.n;
+    return true;
+}
+
+void query_result_free(QueryResult *result) {
+    free(result->rows);
+    result->rows = NULL;
+    result->n = 0;
+}
+
+/*
+ * db_print_query - 执行查询并输出匹配的记录
+ * explain 为真时另外输出执行计划、估计行数、实际行数和用时
+ */
+void db_print_query(Database *db, const Query *q, bool explain) {
+    if (db == NULL || db_live_count(db) == 0) {
+        printf("暂无学生记录。\n");
+        return;
+    }
+
+    QueryResult result;
+    clock_t start = clock();
+    if (!query_run(db, q, &result)) {
+        return;
+    }
+    double ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    OutBuf ob;
+    out_init(&ob, stdout);
+    if (result.n > 0 && out_get_mode() == OUTPUT_PRETTY) {
+        out_puts(&ob, "=== 查询结果 ===\n");
+    }
+    for (size_t i = 0; i < result.n; i++) {
+        out_record(&ob, db, &db->rows[result.rows[i]]);
+    }
+    out_flush(&ob);
+
+    if (explain) {
+        char path[96];
+        if (result.plan.path == PATH_SCAN) {
+            snprintf(path, sizeof(path), "%s（%s 批量过滤）", query_path_name(PATH_SCAN), filter_isa());
+        } else {
+            snprintf(path, sizeof(path), "%s%s", query_path_name(result.plan.path),
+                     result.plan.build_index ? "（首次使用，已建立索引）" : "");
+        }
+        printf("执行计划：%s，估计 %.0f 行，代价 %.1f\n", path, result.plan.est_rows, result.plan.cost);
+        printf("共 %zu 条记录，用时 %.3f 毫秒\n", result.n, ms);
+    }
+    query_result_free(&result);
+}
@@ -0,0 +1,106 @@
+/*
+ * query.h - MiniDB 组合条件查询头文件
+ * 查询为若干谓词的合取（ID、姓名子串、年龄范围、成绩范围、状态标志），
+ * 规划器根据基数统计估算各访问路径的代价，选出最便宜的一条取候选行，
+ * 其余谓词在候选行上逐条检查
+ */
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "db.h"
+
+#define QUERY_INDEX_REUSE  8    // 建索引的代价按此次数的查询分摊
+#define QUERY_GRAM_LEN     3    // 姓名 n-gram 索引的 n（按字节，一个汉字正好 3 字节）
+#define QUERY_SCORE_BUCKETS 4096  // 成绩范围索引的桶数
+#define QUERY_SCORE_GRID   16384  // 成绩定位桶用的等宽网格格数
+
+/*
+ * 查询条件：未设置的条件不参与过滤
+ */
+typedef struct Query {
+    int id;                 // 精确 ID，0 表示不限
+    const char *name_like;  // 姓名子串，NULL 表示不限
+    int age_min;            // 年龄下限（含），0 表示不限
+    int age_max;            // 年龄上限（含），0 表示不限
+    bool has_score;         // 是否限制成绩范围
+    double score_min;       // 成绩下限（含）
+    double score_max;       // 成绩上限（含）
+    uint8_t flags_set;      // 必须全部开启的标志位
+    uint8_t flags_clear;    // 必须全部关闭的标志位
+} Query;
+
+/*
+ * 访问路径
+ */
+typedef enum AccessPath {
+    PATH_ID = 1,            // ID 索引直接定位
+    PATH_AGE_RANGE,         // 年龄范围索引（按年龄分桶的行下标）
+    PATH_SCORE_RANGE,       // 成绩范围索引（按成绩等深分桶的行下标）
+    PATH_NAME_GRAM,         // 姓名 n-gram 倒排索引
+    PATH_FLAGS,             // 标志位图
+    PATH_SCAN               // 全表扫描
+} AccessPath;
+
+/*
+ * 执行计划
+ */
+typedef struct QueryPlan {
+    AccessPath path;        // 选中的访问路径
+    double est_rows;        // 估计的候选行数
+    double cost;            // 估计代价（约等于要检查的行数）
+    bool build_index;       // 是否需要先建立（或重建）索引
+} QueryPlan;
+
+/*
+ * 查询结果：满足全部条件的行下标，按 ID 升序
+ * 结果与选中的访问路径无关
+ */
+typedef struct QueryResult {
+    uint32_t *rows;
+    size_t n;
+    QueryPlan plan;
+} QueryResult;
+
+/*
+ * 查询索引缓存
+ * 第一次被规划器选中时才建立；追加的新行不使索引失效，
+ * 查询时对 [built, count) 的尾部行顺序检查，尾部过长时重建；
+ * 回收或清空会改变行下标、改写会改变行内容，行存储版本（Database.row_version）随之递增，索引整体失效
+ */
+typedef struct QueryCache {
+    uint32_t age_version;       // 年龄索引对应的行存储版本（0 表示未建立）
+    uint32_t age_built;         // 建索引时的行数，之后追加的行在查询时顺序检查
+    uint32_t *age_rows;         // 按年龄分桶的行下标
+    uint32_t age_start[257];    // 年龄 a 的行位于 age_rows[age_start[a], age_start[a + 1])
+    uint32_t score_version;     // 成绩索引对应的行存储版本
+    uint32_t score_built;       // 建索引时的行数
+    uint32_t *score_rows;       // 按成绩分桶的行下标
+    uint32_t score_start[QUERY_SCORE_BUCKETS + 1];   // 第 b 桶的行位于 score_rows[score_start[b], score_start[b + 1])
+    double score_bounds[QUERY_SCORE_BUCKETS - 1];    // 桶分界点（升序）：第 b 桶的成绩在 (bounds[b - 1], bounds[b]] 内
+    double score_lo;                                 // 网格起点（建索引时的最低分）
+    double score_scale;                              // 网格每分的格数
+    uint16_t score_grid[QUERY_SCORE_GRID];           // 网格第 c 格左端点所在的桶
+    uint32_t gram_version;      // 姓名索引对应的行存储版本
+    uint32_t gram_built;        // 建索引时的行数
+    uint32_t nnames;            // 不同姓名的个数
+    uint32_t *name_offs;        // 第 i 个姓名在字符串堆中的偏移（升序）
+    uint32_t *name_row_start;   // 第 i 个姓名的行位于 name_rows[name_row_start[i], name_row_start[i + 1])
+    uint32_t *name_rows;        // 按姓名分组的行下标
+    uint32_t ngrams;            // 不同 n-gram 的个数
+    uint32_t *gram_codes;       // n-gram 编码（升序）
+    uint32_t *gram_start;       // 第 i 个 n-gram 的姓名位于 gram_names[gram_start[i], gram_start[i + 1])
+    uint32_t *gram_names;       // 倒排表：包含该 n-gram 的姓名编号（升序）
+} QueryCache;
+
+void query_init(Query *q);                                                   // 空查询（匹配全部有效记录）
+bool query_plan(Database *db, const Query *q, QueryPlan *plan);              // 只生成执行计划
+bool query_run(Database *db, const Query *q, QueryResult *result);           // 规划并执行
+void query_result_free(QueryResult *result);                                 // 释放结果
+bool query_match(const Database *db, const Query *q, uint32_t row);          // 单行是否满足全部条件
+bool query_match_record(const Query *q, const Record *r, const char *name);  // 同上，记录和姓名由调用者给出
+void query_cache_free(QueryCache *cache);                                    // 释放索引缓存
+const char *query_path_name(AccessPath path);                                // 访问路径的中文名称
+void db_print_query(Database *db, const Query *q, bool explain);             // 执行查询并输出结果（可附带执行计划）
+
+#endif /* QUERY_H */
@@ -0,0 +1,588 @@
+/*
+ * repl.c - MiniDB 复制（操作日志传送）实现
+ * 日志是按 ID 记录的逻辑操作（追加记录、改写记录、设置标志、清空），不依赖行下标，
+ * 主副本各自回收墓碑、各自排序都不影响应用。
+ *
+ * 日志文件格式：[文件头 24 字节][项]...
+ * 文件头：["MDBLOG1\0"][log_id(8)][start(8)]，log_id 在主库每次启动时随机生成，
+ *         start 为日志中第一项的序号（主库启动时数据库的序号 + 1）
+ * 每项：[lsn(8)][type(1)][len(1)][内容 len 字节]，序号连续递增
+ *
+ * 主库把日志项缓冲在内存中，每次访问数据库结束前（repl_flush）追加一个时间标记后写出；
+ * 副本线程从上次读到的位置继续读取，整块应用时持有数据库锁（与自动保存、前台命令共用），
+ * 读到不完整的项时留到下次；每次读取前后都检查文件头，主库重建日志时丢弃读到的内容
+ */
+
+#include "repl.h"
+#include "io.h"
+#include "autosave.h"
+#include "partition.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define REPL_MAGIC      "MDBLOG1"   // 含结尾的 '\0' 共 8 字节
+#define REPL_HEADER     24
+#define REPL_ENTRY_HEAD 10          // lsn(8) + type(1) + len(1)
+#define REPL_BUF_SIZE   (1u << 20)  // 主库写缓冲、副本每次读取的字节数
+#define REPL_BATCH      4096        // 副本连续追加的记录攒够这么多条调用一次 db_append_batch
+#define REPL_PATH_MAX   512
+
+/* 日志项类型 */
+enum {
+    REPL_INSERT = 1,    // 追加一条记录：第 2 版记录编码
+    REPL_FLAGS  = 2,    // 设置标志：id(4) + flags(1)
+    REPL_RESET  = 3,    // 清空数据库（加载快照前）
+    REPL_MARK   = 4,    // 时间标记：主库写出日志时的时间（double），副本据此计算延迟
+    REPL_UPDATE = 5,    // 按 ID 改写记录的姓名、年龄、成绩：第 2 版记录编码
+};
+
+/* 主库的操作日志，只在持有数据库锁时访问 */
+struct ReplLog {
+    Database *db;           // 记录日志的数据库，NULL 表示不是主库
+    FILE *fp;
+    char path[REPL_PATH_MAX];
+    unsigned char *buf;     // 尚未写出的日志项
+    size_t len;
+    uint64_t start;         // 第一项的序号
+    uint64_t entries;       // 写出的项数（不含时间标记）
+    uint64_t bytes;         // 写出的字节数
+    uint64_t flushes;       // 写出次数
+    bool failed;            // 写文件失败后不再写出
+};
+
+static struct ReplLog primary;
+
+/* 副本状态：stop 由 lock 保护，统计与 db 由数据库锁保护，其余只由应用线程访问 */
+static struct {
+    Database *db;                       // NULL 表示不是副本
+    char snapshot[REPL_PATH_MAX];       // 主库的快照文件
+    char path[REPL_PATH_MAX];           // 主库的日志文件
+    FILE *fp;
+    uint64_t log_id;                    // 正在应用的日志
+    uint64_t pos;                       // 下一次读取的位置
+    bool attached;                      // 已接上 log_id 对应的日志
+    bool fresh;                         // 数据库刚由快照加载，日志中序号不超过快照的项可以跳过
+    bool resync;                        // 应用出错，需要重新加载快照
+    bool warned;                        // 已提示过快照接不上日志
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+    bool running;
+    bool stop;
+    uint64_t applied;                   // 应用的项数（不含跳过的）
+    uint64_t bytes;                     // 读取的日志字节数
+    uint64_t inserts, updates, flag_sets, resets;
+    uint64_t resyncs;                   // 重新加载快照的次数
+    uint64_t lags;                      // 收到的时间标记数
+    double last_lag, max_lag;           // 复制延迟（毫秒），最大值只统计追上主库之后
+    double started;                     // 第一次接上日志的时间
+    double caught_up;                   // 第一次读到日志末尾的时间，0 表示还没有
+    uint64_t catchup_entries;           // 追上之前应用的项数
+    uint64_t catchup_bytes;
+} rp = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static double repl_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * ==================== 主库 ====================
+ */
+
+/* 写出缓冲区中的日志项 */
+static void repl_write(struct ReplLog *log) {
+    if (log->len == 0) {
+        return;
+    }
+    if (!log->failed && (fwrite(log->buf, 1, log->len, log->fp) != log->len || fflush(log->fp) != 0)) {
+        fprintf(stderr, "错误：写入操作日志 '%s' 失败，副本将不再更新！\n", log->path);
+        log->failed = true;
+    }
+    if (!log->failed) {
+        log->bytes += log->len;
+        log->flushes++;
+    }
+    log->len = 0;
+}
+
+/* 追加一项，缓冲区满时先写出 */
+static void repl_append(Database *db, uint8_t type, const void *data, uint8_t len) {
+    struct ReplLog *log = db->log;
+    if (log->len + REPL_ENTRY_HEAD + len > REPL_BUF_SIZE) {
+        repl_write(log);
+    }
+    unsigned char *b = log->buf + log->len;
+    uint64_t lsn = ++db->lsn;
+    memcpy(b, &lsn, 8);
+    b[8] = type;
+    b[9] = len;
+    if (len > 0) {
+        memcpy(b + REPL_ENTRY_HEAD, data, len);
+    }
+    log->len += REPL_ENTRY_HEAD + len;
+    if (type != REPL_MARK) {
+        log->entries++;
+    }
+}
+
+void repl_log_insert(Database *db, uint32_t row) {
+    unsigned char rec[SNAPSHOT_REC_MAX];
+    size_t n = io_encode_record(db, &db->rows[row], rec);
+    repl_append(db, REPL_INSERT, rec, (uint8_t)n);
+}
+
+void repl_log_update(Database *db, uint32_t row) {
+    unsigned char rec[SNAPSHOT_REC_MAX];
+    size_t n = io_encode_record(db, &db->rows[row], rec);
+    repl_append(db, REPL_UPDATE, rec, (uint8_t)n);
+}
+
+void repl_log_flags(Database *db, int id, uint8_t flags) {
+    unsigned char b[5];
+    memcpy(b, &id, 4);
+    b[4] = flags;
+    repl_append(db, REPL_FLAGS, b, sizeof(b));
+}
+
+void repl_log_reset(Database *db) {
+    repl_append(db, REPL_RESET, NULL, 0);
+}
+
+/*
+ * repl_primary_start - 作为主库开始记录操作日志
+ * 重建日志文件，第一项的序号接在数据库当前序号（启动时加载的快照中的序号）之后；
+ * 副本发现日志重建后，序号接得上就继续应用，否则重新加载快照
+ */
+bool repl_primary_start(Database *db, const char *log_path) {
+    struct ReplLog *log = &primary;
+    snprintf(log->path, sizeof(log->path), "%s", log_path);
+    log->buf = malloc(REPL_BUF_SIZE);
+    log->fp = fopen(log_path, "wb");
+    if (log->buf == NULL || log->fp == NULL) {
+        fprintf(stderr, "错误：无法创建操作日志 '%s'，不作为主库运行！\n", log_path);
+        if (log->fp != NULL) {
+            fclose(log->fp);
+            log->fp = NULL;
+        }
+        free(log->buf);
+        log->buf = NULL;
+        return false;
+    }
+
+    /* log_id 只用来区分每次启动的日志，纳秒时间与地址混合即可 */
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    uint64_t log_id = ((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec) * 0x9E3779B97F4A7C15ull ^
+                      (uint64_t)(uintptr_t)log->buf;
+    unsigned char head[REPL_HEADER];
+    memcpy(head, REPL_MAGIC, 8);
+    memcpy(head + 8, &log_id, 8);
+    log->start = db->lsn + 1;
+    memcpy(head + 16, &log->start, 8);
+    if (fwrite(head, 1, sizeof(head), log->fp) != sizeof(head) || fflush(log->fp) != 0) {
+        fprintf(stderr, "错误：写入操作日志 '%s' 失败，不作为主库运行！\n", log_path);
+        fclose(log->fp);
+        log->fp = NULL;
+        free(log->buf);
+        log->buf = NULL;
+        return false;
+    }
+    log->len = 0;
+    log->entries = log->bytes = log->flushes = 0;
+    log->failed = false;
+    log->db = db;
+    db->log = log;
+    printf("作为复制主库运行，操作日志：'%s'（从序号 %llu 开始）\n",
+           log_path, (unsigned long long)log->start);
+    return true;
+}
+
+/*
+ * repl_flush - 写出缓冲的日志项
+ * 本次有修改时先追加时间标记；前台每次访问数据库结束、释放数据库锁之前调用
+ */
+void repl_flush(void) {
+    struct ReplLog *log = &primary;
+    if (log->db == NULL || log->len == 0) {
+        return;
+    }
+    double now = repl_now();
+    repl_append(log->db, REPL_MARK, &now, sizeof(now));
+    repl_write(log);
+}
+
+/*
+ * ==================== 副本 ====================
+ */
+
+/* 读取日志文件头，文件还没写好（主库正在重建）时返回 false */
+static bool repl_read_header(uint64_t *log_id, uint64_t *start) {
+    unsigned char head[REPL_HEADER];
+    if (fseek(rp.fp, 0, SEEK_SET) != 0 || fread(head, 1, sizeof(head), rp.fp) != sizeof(head) ||
+        memcmp(head, REPL_MAGIC, 8) != 0) {
+        clearerr(rp.fp);
+        return false;
+    }
+    memcpy(log_id, head + 8, 8);
+    memcpy(start, head + 16, 8);
+    return true;
+}
+
+/*
+ * repl_reload - 重新加载主库的快照（调用时持有数据库锁）
+ * 快照中的序号接不上日志的第一项时不加载，等主库保存新的快照
+ */
+static bool repl_reload(uint64_t start) {
+    uint64_t lsn;
+    if (!io_snapshot_lsn(rp.snapshot, &lsn) || lsn + 1 < start) {
+        if (!rp.warned) {
+            fprintf(stderr, "警告：快照 '%s' 接不上主库的操作日志（从序号 %llu 开始），等待主库保存快照...\n",
+                    rp.snapshot, (unsigned long long)start);
+            rp.warned = true;
+        }
+        return false;
+    }
+    Database *db = rp.db;
+    db->lsn = 0;
+    if (part_load_snapshot(db, rp.snapshot, 0) != 0) {
+        return false;
+    }
+    db_mark_clean(db);
+    rp.resyncs++;
+    rp.fresh = true;
+    rp.resync = false;
+    rp.warned = false;
+    return true;
+}
+
+/*
+ * repl_attach - 接上（新的）日志（调用时持有数据库锁）
+ * 日志接在已应用的序号之后可以直接应用；数据库刚由快照加载时，
+ * 日志从快照之前开始也可以（跳过快照已包含的项）；否则重新加载快照
+ */
+static bool repl_attach(uint64_t log_id, uint64_t start) {
+    Database *db = rp.db;
+    bool ok = !rp.resync && (start == db->lsn + 1 || (rp.fresh && start <= db->lsn + 1));
+    if (!ok && (!repl_reload(start) || start > db->lsn + 1)) {
+        return false;
+    }
+    rp.log_id = log_id;
+    rp.pos = REPL_HEADER;
+    rp.attached = true;
+    rp.fresh = false;
+    if (rp.started == 0) {
+        rp.started = repl_now();
+    }
+    return true;
+}
+
+/* 追加攒下的记录（失败时数据库与日志已接不上，攒下的记录一并丢弃） */
+static bool repl_apply_batch(Record *rows, const unsigned char **names, uint32_t *n) {
+    Database *db = rp.db;
+    if (*n == 0) {
+        return true;
+    }
+    if (!db_append_batch(db, rows, names, *n, NULL, NULL)) {
+        *n = 0;
+        return false;
+    }
+    for (uint32_t i = 0; i < *n; i++) {
+        if (rows[i].id >= db->next_id) {
+            db->next_id = rows[i].id + 1;
+        }
+    }
+    db->lsn += *n;
+    rp.inserts += *n;
+    rp.applied += *n;
+    *n = 0;
+    return true;
+}
+
+/*
+ * repl_apply - 应用 buf 中完整的日志项（调用时持有数据库锁）
+ * 连续的追加记录攒成一批调用 db_append_batch；序号不超过已应用序号的项跳过
+ * 返回值：false 表示日志与数据库接不上（序号不连续、内容无效或应用失败），需要重新加载快照；
+ *         *used 为处理了的字节数，末尾不完整的项留到下次
+ */
+static bool repl_apply(const unsigned char *buf, size_t size, size_t *used,
+                       Record *rows, const unsigned char **names) {
+    Database *db = rp.db;
+    uint32_t n = 0;
+    size_t off = 0;
+    bool ok = true;
+    while (ok && size - off >= REPL_ENTRY_HEAD && size - off - REPL_ENTRY_HEAD >= buf[off + 9]) {
+        const unsigned char *e = buf + off;
+        const unsigned char *data = e + REPL_ENTRY_HEAD;
+        uint64_t lsn;
+        memcpy(&lsn, e, 8);
+        uint8_t type = e[8];
+        uint8_t len = e[9];
+        if (lsn <= db->lsn) {
+            off += REPL_ENTRY_HEAD + len;
+            continue;
+        }
+        if (lsn != db->lsn + n + 1) {
+            ok = false;
+            break;
+        }
+        if (type == REPL_INSERT) {
+            size_t rec_len;
+            if (!io_decode_records(data, len, 1, &rows[n], &names[n], &rec_len) || rec_len != len ||
+                idmap_get(&db->ids, rows[n].id) != IDMAP_NONE) {
+                ok = false;
+                break;
+            }
+            off += REPL_ENTRY_HEAD + len;
+            if (++n == REPL_BATCH) {
+                ok = repl_apply_batch(rows, names, &n);
+            }
+            continue;
+        }
+
+        ok = repl_apply_batch(rows, names, &n);
+        if (!ok) {
+            break;
+        }
+        if (type == REPL_FLAGS && len == 5) {
+            int id;
+            memcpy(&id, data, 4);
+            ok = db_set_flags(db, id, data[4]);
+            rp.flag_sets++;
+        } else if (type == REPL_UPDATE) {
+            Record rec;
+            const unsigned char *name;
+            size_t rec_len;
+            char name_str[MAX_NAME_LEN];
+            ok = io_decode_records(data, len, 1, &rec, &name, &rec_len) && rec_len == len;
+            if (ok) {
+                memcpy(name_str, name + 1, name[0]);
+                name_str[name[0]] = '\0';
+                ok = db_update_record(db, rec.id, name_str, rec.age, rec.score);
+            }
+            rp.updates++;
+        } else if (type == REPL_RESET && len == 0) {
+            db_clear(db);
+            rp.resets++;
+        } else if (type == REPL_MARK && len == sizeof(double)) {
+            double t;
+            memcpy(&t, data, sizeof(t));
+            rp.last_lag = (repl_now() - t) * 1000.0;
+            if (rp.caught_up > 0 && rp.last_lag > rp.max_lag) {  /* 追上之前的延迟取决于启动多晚，不计入 */
+                rp.max_lag = rp.last_lag;
+            }
+            rp.lags++;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            break;
+        }
+        db->lsn = lsn;
+        rp.applied++;
+        off += REPL_ENTRY_HEAD + len;
+    }
+    if (ok) {
+        ok = repl_apply_batch(rows, names, &n);
+    }
+    *used = off;
+    rp.bytes += off;
+    return ok;
+}
+
+/*
+ * repl_poll - 检查一次日志，应用读到的新项
+ * 返回值：true 表示有进展（应继续读取），false 表示没有新项或需要等待
+ */
+static bool repl_poll(unsigned char *buf, Record *rows, const unsigned char **names) {
+    if (rp.fp == NULL && (rp.fp = fopen(rp.path, "rb")) == NULL) {
+        return false;
+    }
+    uint64_t log_id, start;
+    if (!repl_read_header(&log_id, &start)) {
+        return false;
+    }
+    if (!rp.attached || rp.resync || log_id != rp.log_id) {
+        autosave_begin();
+        bool ok = repl_attach(log_id, start);
+        autosave_end();
+        if (!ok) {
+            return false;
+        }
+    }
+
+    size_t n = 0;
+    if (file_seek(rp.fp, rp.pos) == 0) {
+        n = fread(buf, 1, REPL_BUF_SIZE, rp.fp);
+    }
+    clearerr(rp.fp);
+    /* 读取期间主库重建了日志：读到的可能是新日志的内容，丢弃 */
+    uint64_t id2, start2;
+    if (!repl_read_header(&id2, &start2)) {
+        return false;
+    }
+    if (id2 != log_id) {
+        return true;
+    }
+
+    size_t used = 0;
+    autosave_begin();
+    if (n > 0 && !repl_apply(buf, n, &used, rows, names)) {
+        rp.resync = true;
+    }
+    rp.pos += used;
+    if (used == 0 && !rp.resync && rp.caught_up == 0) {
+        rp.caught_up = repl_now();
+        rp.catchup_entries = rp.applied;
+        rp.catchup_bytes = rp.bytes;
+    }
+    autosave_end();
+    return used > 0 || rp.resync;
+}
+
+/* 副本应用线程：有进展时连续读取，否则每 REPL_POLL_MS 毫秒检查一次 */
+static void *repl_thread(void *arg) {
+    unsigned char *buf = arg;
+    Record *rows = malloc(sizeof(Record) * REPL_BATCH);
+    const unsigned char **names = malloc(sizeof(*names) * REPL_BATCH);
+    if (rows == NULL || names == NULL) {
+        fprintf(stderr, "错误：复制线程内存分配失败！\n");
+        free(rows);
+        free(names);
+        free(buf);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&rp.lock);
+    while (!rp.stop) {
+        pthread_mutex_unlock(&rp.lock);
+        bool progress = repl_poll(buf, rows, names);
+        pthread_mutex_lock(&rp.lock);
+        if (!progress && !rp.stop) {
+            double due = repl_now() + REPL_POLL_MS / 1000.0;
+            struct timespec ts;
+            ts.tv_sec = (time_t)due;
+            ts.tv_nsec = (long)((due - (double)ts.tv_sec) * 1e9);
+            pthread_cond_timedwait(&rp.wake, &rp.lock, &ts);
+        }
+    }
+    pthread_mutex_unlock(&rp.lock);
+
+    free(rows);
+    free(names);
+    free(buf);
+    return NULL;
+}
+
+/*
+ * repl_replica_start - 作为只读副本启动应用线程
+ * 调用前已从 snapshot 加载数据（加载失败时数据库为空，线程在日志接不上时重新加载）
+ */
+bool repl_replica_start(Database *db, const char *snapshot, const char *log_path) {
+    unsigned char *buf = malloc(REPL_BUF_SIZE);
+    if (buf == NULL) {
+        fprintf(stderr, "错误：内存分配失败，无法启动复制！\n");
+        return false;
+    }
+    rp.db = db;
+    snprintf(rp.snapshot, sizeof(rp.snapshot), "%s", snapshot);
+    snprintf(rp.path, sizeof(rp.path), "%s", log_path);
+    rp.fresh = true;
+    rp.stop = false;
+    if (pthread_create(&rp.thread, NULL, repl_thread, buf) != 0) {
+        fprintf(stderr, "错误：无法启动复制线程！\n");
+        free(buf);
+        rp.db = NULL;
+        return false;
+    }
+    rp.running = true;
+    printf("作为只读副本运行，应用主库的操作日志 '%s'（已加载到序号 %llu）\n",
+           log_path, (unsigned long long)db->lsn);
+    return true;
+}
+
+bool repl_is_replica(void) {
+    return rp.db != NULL;
+}
+
+/*
+ * repl_stop - 停止复制，可重复调用（退出命令中调用一次，atexit 再调用一次）
+ * 主库写出剩余的日志项并关闭日志（持有数据库锁，调用时不能持锁）；副本停止应用线程
+ */
+void repl_stop(void) {
+    struct ReplLog *log = &primary;
+    if (log->db != NULL) {
+        autosave_begin();
+        repl_flush();
+        fclose(log->fp);
+        log->fp = NULL;
+        free(log->buf);
+        log->buf = NULL;
+        log->db->log = NULL;
+        log->db = NULL;
+        autosave_end();
+    }
+    if (rp.running) {
+        pthread_mutex_lock(&rp.lock);
+        rp.stop = true;
+        pthread_cond_signal(&rp.wake);
+        pthread_mutex_unlock(&rp.lock);
+        pthread_join(rp.thread, NULL);
+        rp.running = false;
+        if (rp.fp != NULL) {
+            fclose(rp.fp);
+            rp.fp = NULL;
+        }
+    }
+}
+
+void repl_print_status(void) {
+    struct ReplLog *log = &primary;
+    if (log->db != NULL) {
+        printf("复制主库：操作日志 '%s'，从序号 %llu 开始，当前序号 %llu\n",
+               log->path, (unsigned long long)log->start, (unsigned long long)log->db->lsn);
+        printf("已写出 %llu 项（%.1f KB），写出 %llu 次%s\n",
+               (unsigned long long)log->entries, log->bytes / 1024.0,
+               (unsigned long long)log->flushes, log->failed ? "，写文件失败，已停止写出" : "");
+        return;
+    }
+    if (rp.db == NULL) {
+        printf("复制未启用（启动参数 --primary 作为主库，--replica 作为只读副本）。\n");
+        return;
+    }
+
+    printf("只读副本：快照 '%s'，操作日志 '%s'\n", rp.snapshot, rp.path);
+    printf("已应用到序号 %llu：%llu 项（追加 %llu，改写 %llu，设置标志 %llu，清空 %llu），读取 %.1f KB\n",
+           (unsigned long long)rp.db->lsn, (unsigned long long)rp.applied,
+           (unsigned long long)rp.inserts, (unsigned long long)rp.updates, (unsigned long long)rp.flag_sets,
+           (unsigned long long)rp.resets, rp.bytes / 1024.0);
+    struct stat st;
+    if (rp.attached && stat(rp.path, &st) == 0 && (uint64_t)st.st_size > rp.pos) {
+        printf("尚未读取的日志：%.1f KB\n", ((uint64_t)st.st_size - rp.pos) / 1024.0);
+    } else if (!rp.attached) {
+        printf("尚未接上主库的操作日志\n");
+    }
+    if (rp.lags > 0) {
+        printf("复制延迟：最近 %.1f 毫秒，追上后最大 %.1f 毫秒（%llu 次提交）\n",
+               rp.last_lag, rp.max_lag, (unsigned long long)rp.lags);
+    }
+    if (rp.caught_up > 0) {
+        double secs = rp.caught_up - rp.started;
+        printf("接上日志后 %.3f 秒追上主库：应用 %llu 项（%.1f MB）",
+               secs, (unsigned long long)rp.catchup_entries, rp.catchup_bytes / 1048576.0);
+        if (secs > 0 && rp.catchup_entries > 0) {
+            printf("，%.0f 项/秒", rp.catchup_entries / secs);
+        }
+        printf("\n");
+    }
+    printf("重新加载快照 %llu 次\n", (unsigned long long)rp.resyncs);
+}
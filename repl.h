@@ -0,0 +1,34 @@
+/*
+ * repl.h - MiniDB 复制（操作日志传送）头文件
+ * 主库把每项修改追加到共享的操作日志文件，只读副本进程在后台线程中持续读取、应用到常驻内存的数据库：
+ * - 每项日志带递增的序号（LSN），快照文件头记录快照包含的最后一个序号，副本从快照之后接着应用
+ * - 主库每执行完一条命令写出一次日志，并附带时间标记，副本据此计算复制延迟
+ * - 主库重启时重建日志；副本发现日志被重建且接不上时重新加载快照
+ */
+
+#ifndef REPL_H
+#define REPL_H
+
+#include "db.h"
+
+/*
+ * 主库：db.c 在修改数据时调用（db->log 非 NULL 时）
+ */
+void repl_log_insert(Database *db, uint32_t row);           // 追加了第 row 行
+void repl_log_update(Database *db, uint32_t row);           // 改写了第 row 行的姓名、年龄、成绩
+void repl_log_flags(Database *db, int id, uint8_t flags);   // ID 对应行的标志改为 flags
+void repl_log_reset(Database *db);                          // 清空了数据库
+
+bool repl_primary_start(Database *db, const char *log_path);   // 作为主库开始记录操作日志
+void repl_flush(void);          // 主库：写出缓冲的日志（须在持有数据库锁时调用）
+
+/*
+ * 副本
+ */
+bool repl_replica_start(Database *db, const char *snapshot, const char *log_path);  // 启动应用线程（调用前已加载快照）
+bool repl_is_replica(void);     // 是否作为只读副本运行
+
+void repl_stop(void);           // 停止复制（主库写出并关闭日志，副本停止应用线程），可重复调用
+void repl_print_status(void);   // 输出复制状态（须在持有数据库锁时调用）
+
+#endif /* REPL_H */
@@ -0,0 +1,176 @@
+/*
+ * strheap.c - MiniDB 字符串堆实现
+ * 追加式存储 + 线性探测去重表；只增不删，
+ * 不再被引用的字符串在重新加载或压缩时回收
+ */
+
+#include "strheap.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define STRHEAP_INIT_BYTES 4096
+#define STRHEAP_INIT_SLOTS 256
+#define STRHEAP_MAX_BYTES  0xFFFFFFF0u  // 偏移使用 32 位
+
+/* FNV-1a 散列 */
+static uint32_t str_hash(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+bool strheap_init(StrHeap *heap) {
+    heap->data = malloc(STRHEAP_INIT_BYTES);
+    heap->slots = calloc(STRHEAP_INIT_SLOTS, sizeof(uint32_t));
+    heap->hashes = malloc(STRHEAP_INIT_SLOTS * sizeof(uint32_t));
+    if (heap->data == NULL || heap->slots == NULL || heap->hashes == NULL) {
+        free(heap->data);
+        free(heap->slots);
+        free(heap->hashes);
+        heap->data = NULL;
+        heap->slots = NULL;
+        heap->hashes = NULL;
+        return false;
+    }
+    heap->cap = STRHEAP_INIT_BYTES;
+    heap->nslots = STRHEAP_INIT_SLOTS;
+    strheap_clear(heap);
+    return true;
+}
+
+void strheap_free(StrHeap *heap) {
+    free(heap->data);
+    free(heap->slots);
+    free(heap->hashes);
+    heap->data = NULL;
+    heap->slots = NULL;
+    heap->hashes = NULL;
+    heap->used = heap->cap = 0;
+    heap->nslots = heap->nstrings = 0;
+}
+
+void strheap_clear(StrHeap *heap) {
+    heap->data[0] = '\0';   /* 偏移 0：空字符串 */
+    heap->used = 1;
+    memset(heap->slots, 0, heap->nslots * sizeof(uint32_t));
+    heap->nstrings = 0;
+}
+
+/* 在去重表中查找，返回槽位下标；未找到时返回应插入的空槽 */
+static size_t strheap_probe(const StrHeap *heap, const char *s, size_t len, uint32_t h) {
+    size_t mask = heap->nslots - 1;
+    size_t i = h & mask;
+    while (heap->slots[i] != 0) {
+        if (heap->hashes[i] == h) {
+            const char *cand = heap->data + heap->slots[i] - 1;
+            if (memcmp(cand, s, len) == 0 && cand[len] == '\0') {
+                return i;
+            }
+        }
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static bool strheap_grow_slots(StrHeap *heap) {
+    size_t nslots = heap->nslots * 2;
+    uint32_t *slots = calloc(nslots, sizeof(uint32_t));
+    uint32_t *hashes = malloc(nslots * sizeof(uint32_t));
+    if (slots == NULL || hashes == NULL) {
+        free(slots);
+        free(hashes);
+        return false;
+    }
+    size_t mask = nslots - 1;
+    for (size_t i = 0; i < heap->nslots; i++) {
+        if (heap->slots[i] != 0) {
+            size_t j = heap->hashes[i] & mask;
+            while (slots[j] != 0) {
+                j = (j + 1) & mask;
+            }
+            slots[j] = heap->slots[i];
+            hashes[j] = heap->hashes[i];
+        }
+    }
+    free(heap->slots);
+    free(heap->hashes);
+    heap->slots = slots;
+    heap->hashes = hashes;
+    heap->nslots = nslots;
+    return true;
+}
+
+bool strheap_find(const StrHeap *heap, const char *s, size_t len, NameRef *out) {
+    if (len == 0) {
+        out->off = 0;
+        out->len = 0;
+        return true;
+    }
+    uint32_t h = str_hash(s, len);
+    size_t i = strheap_probe(heap, s, len, h);
+    if (heap->slots[i] == 0) {
+        return false;
+    }
+    out->off = heap->slots[i] - 1;
+    out->len = (uint32_t)len;
+    return true;
+}
+
+bool strheap_intern(StrHeap *heap, const char *s, size_t len, NameRef *out) {
+    if (len == 0) {
+        out->off = 0;
+        out->len = 0;
+        return true;
+    }
+
+    uint32_t h = str_hash(s, len);
+    size_t i = strheap_probe(heap, s, len, h);
+    if (heap->slots[i] != 0) {
+        out->off = heap->slots[i] - 1;
+        out->len = (uint32_t)len;
+        return true;
+    }
+
+    /* 新字符串：追加到数据区 */
+    if (heap->used + len + 1 > STRHEAP_MAX_BYTES) {
+        return false;
+    }
+    if (heap->used + len + 1 > heap->cap) {
+        size_t cap = heap->cap * 2;
+        while (cap < heap->used + len + 1) {
+            cap *= 2;
+        }
+        if (cap > STRHEAP_MAX_BYTES) {
+            cap = STRHEAP_MAX_BYTES;
+        }
+        char *data = realloc(heap->data, cap);
+        if (data == NULL) {
+            return false;
+        }
+        heap->data = data;
+        heap->cap = cap;
+    }
+    uint32_t off = (uint32_t)heap->used;
+    memcpy(heap->data + off, s, len);
+    heap->data[off + len] = '\0';
+    heap->used += len + 1;
+
+    /* 装载因子超过 1/2 时扩容去重表，再重新探测 */
+    if ((heap->nstrings + 1) * 2 > heap->nslots) {
+        if (!strheap_grow_slots(heap)) {
+            heap->used -= len + 1;
+            return false;
+        }
+        i = strheap_probe(heap, s, len, h);
+    }
+    heap->slots[i] = off + 1;
+    heap->hashes[i] = h;
+    heap->nstrings++;
+
+    out->off = off;
+    out->len = (uint32_t)len;
+    return true;
+}
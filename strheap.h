@@ -0,0 +1,48 @@
+/*
+ * strheap.h - MiniDB 字符串堆头文件
+ * 姓名集中存放在一块连续内存中，记录只保存 (偏移, 长度)；
+ * 相同的姓名只存一份（驻留 / 去重）
+ */
+
+#ifndef STRHEAP_H
+#define STRHEAP_H
+
+#include "config.h"
+#include <stddef.h>
+
+/*
+ * 字符串引用：指向字符串堆中的一个以 '\0' 结尾的字符串
+ * {0, 0} 表示空字符串
+ */
+typedef struct NameRef {
+    uint32_t off;   // 在字符串堆中的偏移
+    uint32_t len;   // 字节长度（不含 '\0'）
+} NameRef;
+
+/*
+ * 字符串堆
+ * data 中依次存放以 '\0' 结尾的字符串，偏移 0 处固定为空字符串；
+ * slots 为去重用的开放寻址哈希表，保存 偏移 + 1（0 表示空槽）
+ */
+typedef struct StrHeap {
+    char *data;         // 字符串数据
+    size_t used;        // 已用字节数
+    size_t cap;         // 已分配字节数
+    uint32_t *slots;    // 去重哈希表
+    uint32_t *hashes;   // 与 slots 对应的散列值，减少字符串比较
+    size_t nslots;      // 槽位数（2 的幂）
+    size_t nstrings;    // 不同字符串的个数
+} StrHeap;
+
+bool strheap_init(StrHeap *heap);                                       // 初始化（只含空字符串）
+void strheap_free(StrHeap *heap);                                       // 释放内存
+void strheap_clear(StrHeap *heap);                                      // 清空（保留容量）
+bool strheap_intern(StrHeap *heap, const char *s, size_t len, NameRef *out);  // 驻留字符串，返回引用
+bool strheap_find(const StrHeap *heap, const char *s, size_t len, NameRef *out); // 仅查找，不插入
+
+/* 取引用对应的字符串（以 '\0' 结尾） */
+static inline const char *strheap_str(const StrHeap *heap, NameRef ref) {
+    return heap->data + ref.off;
+}
+
+#endif /* STRHEAP_H */
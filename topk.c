@@ -0,0 +1,149 @@
+/*
+ * topk.c - MiniDB Top-K 查询实现
+ * 堆顶保存已选出的 K 条中名次最差的一条，新记录只需与堆顶比较，
+ * 比堆顶好才替换并下沉；扫描结束后逐个弹出堆顶即得到倒序的名次
+ * 时间 O(n log K)，额外空间 O(K)
+ */
+
+#include "topk.h"
+#include "output.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void topk_options_init(TopKOptions *opt, int k) {
+    opt->k = k;
+    opt->lowest = false;
+    opt->flags_set = 0;
+    opt->flags_clear = 0;
+    opt->age_min = 0;
+    opt->age_max = 0;
+}
+
+/* 记录 a 的名次是否在 b 之前 */
+static inline bool topk_better(const Record *a, const Record *b, bool lowest) {
+    if (a->score != b->score) {
+        return lowest ? a->score < b->score : a->score > b->score;
+    }
+    return a->id < b->id;
+}
+
+/* 从 i 开始下沉，使堆顶保持为名次最差的记录 */
+static void topk_sift_down(const Record *rows, uint32_t *heap, int n, int i, bool lowest) {
+    uint32_t item = heap[i];
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && topk_better(&rows[heap[child]], &rows[heap[child + 1]], lowest)) {
+            child++;
+        }
+        if (!topk_better(&rows[item], &rows[heap[child]], lowest)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = item;
+}
+
+/* 在 i 处上浮 */
+static void topk_sift_up(const Record *rows, uint32_t *heap, int i, bool lowest) {
+    uint32_t item = heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!topk_better(&rows[heap[parent]], &rows[item], lowest)) {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = item;
+}
+
+/*
+ * db_top_k - 求满足条件的前 K 条记录
+ * 参数：rows - 输出数组，至少能容纳 opt->k 个元素
+ * 返回值：实际条数（满足条件的记录不足 K 条时小于 K）
+ */
+int db_top_k(const Database *db, const TopKOptions *opt, uint32_t *rows) {
+    if (db == NULL || opt->k <= 0) {
+        return 0;
+    }
+
+    const Record *data = db->rows;
+    bool lowest = opt->lowest;
+    uint8_t must = opt->flags_set;
+    uint8_t reject = opt->flags_clear | FLAG_DELETED;
+    int age_min = opt->age_min > 0 ? opt->age_min : 0;
+    int age_max = opt->age_max > 0 ? opt->age_max : 255;
+    int n = 0;
+
+    /* 按行存储顺序扫描热数据行，堆中只存 32 位行下标 */
+    for (int i = 0; i < db->count; i++) {
+        const Record *r = &data[i];
+        if ((r->flags & must) != must || (r->flags & reject) != 0 ||
+            r->age < age_min || r->age > age_max) {
+            continue;
+        }
+        if (n < opt->k) {
+            rows[n] = (uint32_t)i;
+            topk_sift_up(data, rows, n, lowest);
+            n++;
+        } else if (topk_better(r, &data[rows[0]], lowest)) {
+            rows[0] = (uint32_t)i;
+            topk_sift_down(data, rows, n, 0, lowest);
+        }
+    }
+
+    /* 依次把堆顶（当前最差）换到末尾，得到按名次排列的结果 */
+    for (int end = n - 1; end > 0; end--) {
+        uint32_t tmp = rows[0];
+        rows[0] = rows[end];
+        rows[end] = tmp;
+        topk_sift_down(data, rows, end, 0, lowest);
+    }
+    return n;
+}
+
+/*
+ * db_print_top_k - 输出 Top-K 查询结果
+ */
+void db_print_top_k(const Database *db, const TopKOptions *opt) {
+    if (db == NULL || db_live_count(db) == 0) {
+        printf("暂无学生记录。\n");
+        return;
+    }
+    if (opt->k <= 0) {
+        printf("错误：K 必须为正整数！\n");
+        return;
+    }
+
+    /* 结果不会超过有效记录数，按此限制缓冲区大小 */
+    TopKOptions bounded = *opt;
+    if (bounded.k > db_live_count(db)) {
+        bounded.k = db_live_count(db);
+    }
+    uint32_t *rows = malloc(sizeof(uint32_t) * (size_t)bounded.k);
+    if (rows == NULL) {
+        printf("内存分配失败！\n");
+        return;
+    }
+    int n = db_top_k(db, &bounded, rows);
+    if (n == 0) {
+        printf("没有满足条件的记录。\n");
+        free(rows);
+        return;
+    }
+
+    OutBuf ob;
+    out_init(&ob, stdout);
+    if (out_get_mode() == OUTPUT_PRETTY) {
+        out_puts(&ob, opt->lowest ? "=== 成绩最低的记录 ===\n" : "=== 成绩最高的记录 ===\n");
+    }
+    for (int i = 0; i < n; i++) {
+        out_record(&ob, db, &db->rows[rows[i]]);
+    }
+    out_flush(&ob);
+    free(rows);
+}
@@ -0,0 +1,29 @@
+/*
+ * topk.h - MiniDB Top-K 查询头文件
+ * 用大小为 K 的堆一次扫描求成绩最高（或最低）的 K 条记录，
+ * 不排序整张表，也不改变当前显示顺序
+ */
+
+#ifndef TOPK_H
+#define TOPK_H
+
+#include "db.h"
+
+/*
+ * Top-K 查询选项
+ * 成绩相同时 ID 小的排在前面
+ */
+typedef struct TopKOptions {
+    int k;                  // 取前 k 条
+    bool lowest;            // true 表示取成绩最低的 k 条
+    uint8_t flags_set;      // 必须全部开启的标志位，0 表示不过滤
+    uint8_t flags_clear;    // 必须全部关闭的标志位，0 表示不过滤
+    int age_min;            // 年龄下限（含），0 表示不限
+    int age_max;            // 年龄上限（含），0 表示不限
+} TopKOptions;
+
+void topk_options_init(TopKOptions *opt, int k);                         // 默认选项：成绩最高、无过滤
+int db_top_k(const Database *db, const TopKOptions *opt, uint32_t *rows); // 结果行下标按名次写入 rows，返回条数
+void db_print_top_k(const Database *db, const TopKOptions *opt);          // 输出 Top-K 结果
+
+#endif /* TOPK_H */
@@ -3,6 +3,8 @@
  * 阶段六：高级特性 — 位操作、国际化、数学支持
  */
 
+#define _FILE_OFFSET_BITS 64
+
 #include "utils.h"
 #include "config.h"
 #include <stdio.h>
@@ -101,3 +103,86 @@ void clear_input_buffer(void) {
     int c;
     while ((c = getchar()) != '\n' && c != EOF);
 }
+
+/*
+ * utf8_next - 从 *s 解码一个 UTF-8 码点，*s 前进到下一个码点（调用前 *s < end）
+ * 无效或截断的字节按单字节处理，返回 0xDC00 + 字节值（与任何有效码点都不相同），
+ * 因此任意字节串都能逐码点遍历，相同的字节串总得到相同的码点序列
+ */
+uint32_t utf8_next(const char **s, const char *end) {
+    const unsigned char *p = (const unsigned char *)*s;
+    size_t left = (size_t)(end - *s);
+    uint32_t c = p[0];
+    int n;
+    uint32_t min;
+    if (c < 0x80) {
+        *s += 1;
+        return c;
+    } else if ((c & 0xE0) == 0xC0) {
+        n = 2;
+        min = 0x80;
+        c &= 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        n = 3;
+        min = 0x800;
+        c &= 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        n = 4;
+        min = 0x10000;
+        c &= 0x07;
+    } else {
+        *s += 1;
+        return 0xDC00 + p[0];
+    }
+    if (left < (size_t)n) {
+        *s += 1;
+        return 0xDC00 + p[0];
+    }
+    for (int i = 1; i < n; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            *s += 1;
+            return 0xDC00 + p[0];
+        }
+        c = (c << 6) | (p[i] & 0x3F);
+    }
+    if (c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+        *s += 1;
+        return 0xDC00 + p[0];
+    }
+    *s += n;
+    return c;
+}
+
+/*
+ * file_seek - 定位到距文件开头 offset 字节处
+ * Windows 用 _fseeki64，其他平台用 fseeko（本文件以 64 位 off_t 编译）
+ */
+int file_seek(FILE *fp, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(fp, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(fp, (off_t)offset, SEEK_SET);
+#endif
+}
+
+/*
+ * file_size - 定位到文件末尾并取得文件长度
+ */
+int file_size(FILE *fp, uint64_t *size) {
+#ifdef _WIN32
+    if (_fseeki64(fp, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    __int64 end = _ftelli64(fp);
+#else
+    if (fseeko(fp, 0, SEEK_END) != 0) {
+        return -1;
+    }
+    off_t end = ftello(fp);
+#endif
+    if (end < 0) {
+        return -1;
+    }
+    *size = (uint64_t)end;
+    return 0;
+}
@@ -7,6 +7,8 @@
 #define UTILS_H
 
 #include <stdbool.h>  // 使用 bool 类型
+#include <stdint.h>
+#include <stdio.h>
 
 /* 输入验证函数原型 */
 bool validate_id_range(int id_num);      /* 检查 ID 是否为正数 */
@@ -19,4 +21,11 @@ int read_int(const char *prompt, int *value);        /* 读取并验证整数输
 int read_double(const char *prompt, double *value);  /* 读取并验证浮点数输入 */
 void clear_input_buffer(void);                       /* 清空输入缓冲区 */
 
+/* UTF-8 辅助函数 */
+uint32_t utf8_next(const char **s, const char *end);  /* 解码一个码点并前进 */
+
+/* 文件定位辅助函数：偏移为 64 位（MinGW 下 long 只有 32 位，fseek / ftell 超过 2 GB 会截断） */
+int file_seek(FILE *fp, uint64_t offset);        /* 定位到距文件开头 offset 字节处，0 表示成功 */
+int file_size(FILE *fp, uint64_t *size);         /* 定位到文件末尾并取得文件长度，0 表示成功 */
+
 #endif /* UTILS_H */